@@ -32,6 +32,11 @@ extern "C" {
 #define ASTERA_DEFAUT_SFX_RANGE 20
 #endif
 
+// The gain below which a sfx is considered inaudible & kept virtual
+#if !defined(ASTERA_SFX_AUDIBLE_GAIN)
+#define ASTERA_SFX_AUDIBLE_GAIN 0.001f
+#endif
+
 typedef struct {
   float gain;
   vec3  position, orientation, velocity;
@@ -144,6 +149,10 @@ typedef struct {
   // max_loop - the max amount of times the sound/song can loop
   uint16_t max_loop;
 
+  // priority - how important the sound is, when there aren't enough voices
+  //            higher priority sounds keep theirs & steal from lower ones
+  uint8_t priority;
+
   // loop - if the sound/song should loop (1 = true, 0 = false)
   // stop - if the sound/song should stop (1 = true, 0 = false)
   uint8_t loop;
@@ -155,11 +164,24 @@ typedef struct {
   // loop_count - the amount of times the sound/song has looped
   // time - the current time in the sound/song
   // state - the current state of the sound/song
+  // NOTE: While the context is threaded, read time & state with
+  //       a_req_get_time & a_req_get_state
   uint16_t loop_count;
   time_s   time;
-  uint8_t  state, valid;
+  uint32_t state, valid;
 } a_req;
 
+typedef struct {
+  // gain - the gain applied to the source (including its layer's gain)
+  // position, velocity, range, loop - the values applied from the request
+  vec3    position, velocity;
+  float   gain, range;
+  uint8_t loop;
+} a_params;
+
+// A page of a song's seek index (opaque, see a_song_set_time)
+typedef struct a_seek_page a_seek_page;
+
 typedef struct {
   // id - the ID for this song in an a_ctx
   uint16_t id;
@@ -194,31 +216,92 @@ typedef struct {
   // packets_per_buffer - the amount of packets to decode per buffer
   uint16_t packets_per_buffer;
 
+  // seek_pages - every page a frame ends on, in order, built on creation so
+  //              seeking doesn't have to search the stream
+  // seek_count - the number of pages in the index
+  a_seek_page* seek_pages;
+  uint32_t     seek_count;
+
+  // pcm - the song's own buffer for decoding into
+  // pcm_length - the number of shorts the pcm can hold
+  uint16_t* pcm;
+  uint32_t  pcm_length;
+
   // data - the raw data of the OGG Vorbis track
   uint8_t* data;
 
   // req - where & how to play the song
-  a_req* req;
+  // applied - the request's values last given to OpenAL, so updates only
+  //           push what's changed
+  // layer - the layer the song plays on (0 = none)
+  a_req*   req;
+  a_params applied;
+  uint16_t layer;
 
   // loop - if the song should loop or not
-  uint8_t loop;
+  // playing - if the song is meant to be playing (play / resume until stop /
+  //           pause / its end), its source stops on its own if it runs dry
+  // state - the song's state as of the last update, for a_song_get_state
+  uint8_t  loop;
+  uint8_t  playing;
+  uint32_t state;
 } a_song;
 
 typedef struct {
   // id - the id / index of this sfx in an a_ctx
   uint16_t id;
 
-  // buffer - the OpenAL Buffer attached to this slot
-  // source - the OpenAL source attached to this slot
+  // buffer - the ID of the buffer attached to this slot
+  // source - the OpenAL source the sfx is playing on, 0 = virtual
   uint32_t buffer, source;
 
-  // length - the length in samples
+  // length - the length in samples (per channel)
+  // duration - the length in seconds
   uint32_t length;
+  float    duration;
+
+  // time - the playback position while virtual (seconds)
+  // audibility - the gain the listener hears the sfx at, as of the last update
+  // paused - if the sfx is paused
+  float   time, audibility;
+  uint8_t paused;
 
   // req - the request attached
-  a_req* req;
+  // applied - the request's values last given to OpenAL
+  // layer - the layer the sfx plays on (0 = none)
+  a_req*   req;
+  a_params applied;
+  uint16_t layer;
+
+  // claimed - if the slot is taken (claimed atomically while threaded)
+  // rank - the sfx's priority & audibility as one key, published so
+  //        a_sfx_play can pick which to steal from any thread
+  uint32_t claimed;
+  uint64_t rank;
 } a_sfx;
 
+typedef struct {
+  // id - the ID of the emitter (index + 1), 0 = free slot
+  uint16_t id;
+
+  // buffer - the audio buffer the emitter loops
+  // layer - the layer to play on (0 = none)
+  // sfx - the sfx playing the emitter, 0 = out of the listener's range
+  uint16_t buffer, layer, sfx;
+
+  // req - where & how to play the emitter
+  a_req req;
+
+  // cell - the grid cell the emitter is in
+  // next - the next emitter in the same grid bucket (ID, 0 = end)
+  int32_t  cell[2];
+  uint16_t next;
+
+  // start - when the emitter was created (ms), so loops stay in phase while
+  //         out of range
+  time_s start;
+} a_emitter;
+
 typedef struct {
   // ID is also considered it's index
   uint16_t id;
@@ -230,10 +313,28 @@ typedef struct {
 
   uint16_t sfx_count, sfx_capacity;
   uint16_t song_count, song_capacity;
-
-  uint8_t gain_change;
 } a_layer;
 
+typedef struct {
+  // data - the raw data of the file
+  // data_length - the length of the raw data
+  // name - a string name for the buffer (optional)
+  // is_ogg - if the data is OGG or WAV (1 = ogg, 0 = wav)
+  unsigned char* data;
+  uint32_t       data_length;
+  const char*    name;
+  uint8_t        is_ogg;
+} a_buf_load;
+
+// A command for the audio thread (opaque, see a_ctx_thread_start)
+typedef struct a_cmd a_cmd;
+
+// An active sfx being ranked for a voice (opaque, see a_ctx_set_voice_limit)
+typedef struct a_voice a_voice;
+
+// An emitter in range waiting to start (opaque, see a_ctx_emitters_create)
+typedef struct a_emitter_rank a_emitter_rank;
+
 // TODO define more errors for accurate feedback / debugging
 typedef enum {
   ASTERA_NO_ERROR = 0,
@@ -261,8 +362,47 @@ typedef struct {
   // sfx_count - the current amount of sfx
   // sfx_capacity - the max amount of sfx
   // sfx_high - the high water mark for sfx in the sfx list
-  a_sfx*   sfx;
-  uint16_t sfx_count, sfx_capacity, sfx_high;
+  // sfx_free - a stack of the free sfx slots (indices)
+  // sfx_free_count - the amount of slots on the stack
+  a_sfx*    sfx;
+  uint16_t  sfx_count, sfx_capacity, sfx_high;
+  uint16_t* sfx_free;
+  uint16_t  sfx_free_count;
+
+  // voice_sources - the OpenAL sources shared by the sfx, the free ones first
+  // voice_free - the amount of free sources at the start of voice_sources
+  // voice_capacity - the amount of sources created (the device may allow
+  //                  fewer than max_sfx)
+  // voice_limit - the max amount of sfx playing on a source at once
+  // voice_origin - the listener position the sfx are ranked from
+  // voice_time - the time of the last update (ms), to advance virtual sfx
+  // voices - space to rank the active sfx in
+  uint32_t* voice_sources;
+  uint16_t  voice_free, voice_capacity, voice_limit;
+  vec3      voice_origin;
+  time_s    voice_time;
+  a_voice*  voices;
+
+  // emitters - the list of world emitters (see a_ctx_emitters_create)
+  // emitter_count - the current amount of emitters
+  // emitter_capacity - the max amount of emitters
+  // emitter_high - the high water mark for emitters in the list
+  a_emitter* emitters;
+  uint16_t   emitter_count, emitter_capacity, emitter_high;
+
+  // emitter_buckets - the first emitter (ID) in each bucket of the grid
+  // emitter_bucket_count - the amount of buckets (a power of 2)
+  // emitter_cell - the size of each grid cell
+  // emitter_range - the largest range of any emitter, how far out to look
+  // emitter_active - the IDs of the emitters currently playing
+  // emitter_active_count - the amount of emitters currently playing
+  // emitter_queue - scratch list of emitters in range, ranked before starting
+  uint16_t*       emitter_buckets;
+  uint32_t        emitter_bucket_count;
+  float           emitter_cell, emitter_range;
+  uint16_t*       emitter_active;
+  uint16_t        emitter_active_count;
+  a_emitter_rank* emitter_queue;
 
   // layers - the list of audio layers
   // layer_names - a list of names for the layers
@@ -299,6 +439,10 @@ typedef struct {
   uint8_t resizable; // allow for dynamic resizing of arrays
   uint8_t allow;     // allow playback
   uint8_t use_fx;    // allow effect usage
+  uint8_t loopback;  // renders with a_ctx_render instead of playing out
+
+  // cache_dir - the directory decoded OGG sfx are cached in, 0 = none
+  const char* cache_dir;
 
   // pcm - a buffer for decoding
   // pcm_length - the number of shorts the pcm can hold
@@ -308,6 +452,33 @@ typedef struct {
 
   // error - the last error value set
   int32_t error;
+
+#if !defined(ASTERA_NO_THREADS)
+  // stream_thread - the thread decoding songs, 0 = songs decode in update
+  // stream_lock - guards the songs between the stream thread & the caller
+  // stream_interval - the time between each check of the songs (ms)
+  // stream_quit - tells the stream thread to exit
+  s_thread* stream_thread;
+  s_mutex*  stream_lock;
+  time_s    stream_interval;
+  uint8_t   stream_quit;
+
+  // audio_thread - the thread owning the OpenAL calls, 0 = the caller
+  // audio_interval - the time between each update of the audio thread (ms)
+  // audio_quit - tells the audio thread to exit
+  s_thread*         audio_thread;
+  time_s            audio_interval;
+  volatile uint32_t audio_quit;
+
+  // cmds - the ring of commands for the audio thread
+  // cmd_capacity - the amount of commands the ring holds (a power of 2)
+  // cmd_head - the next position to push to (any thread)
+  // cmd_tail - the next position to apply (audio thread)
+  a_cmd*            cmds;
+  uint32_t          cmd_capacity;
+  volatile uint32_t cmd_head;
+  uint32_t          cmd_tail;
+#endif
 } a_ctx;
 
 /* Print various info about the OpenAL EFX Extension capabilities on this
@@ -334,7 +505,8 @@ uint8_t a_ctx_play_allowed(a_ctx* ctx);
 /* Create an audio context for playback
  * device - the device's name to use (NULL for default)
  * layers - the number of layers to create for managing sounds
- * max_sfx - the max amount of sfx for the context to handle
+ * max_sfx - the max amount of sfx for the context to handle, each gets an
+ *           OpenAL source while the device allows, the rest are virtual
  * max_buffers - the max amount of audio buffers for the context to handle
  * max_fx - the max amount of audio fx for the context to handle
  * max_songs - the max amount of songs for the context to handle
@@ -343,13 +515,128 @@ a_ctx* a_ctx_create(const char* device, uint8_t layers, uint16_t max_sfx,
                     uint16_t max_buffers, uint16_t max_songs, uint16_t max_fx,
                     uint16_t max_filters, uint32_t pcm_size);
 
+/* Create an audio context that renders into memory instead of playing on a
+ * device (ALC_SOFT_loopback), nothing is mixed until a_ctx_render is called.
+ * Works without a sound card, i.e for benchmarks & tests
+ * frequency - the sample rate to render at (i.e 44100)
+ * the rest are the same as a_ctx_create
+ * returns: the context, 0 = fail / loopback unsupported */
+a_ctx* a_ctx_create_loopback(uint32_t frequency, uint8_t layers,
+                             uint16_t max_sfx, uint16_t max_buffers,
+                             uint16_t max_songs, uint16_t max_fx,
+                             uint16_t max_filters, uint32_t pcm_size);
+
+/* Mix the next frames of a loopback context's output
+ * ctx - the loopback context to render
+ * dst - where to write the interleaved stereo floats (frames * 2)
+ * frames - the number of sample frames to render
+ * returns: success = 1, fail = 0 (not a loopback context) */
+uint8_t a_ctx_render(a_ctx* ctx, float* dst, uint32_t frames);
+
 /* Destroy the Audio Context & all of it's contents */
 uint8_t a_ctx_destroy(a_ctx* ctx);
 
-/* Update the Audio Context
+/* Update the Audio Context, only the request values (gain, position,
+ * velocity, range, loop) changed since the last update are given to OpenAL,
+ * batched together where AL_SOFT_deferred_updates is supported
  * ctx - the context to update */
 void a_ctx_update(a_ctx* ctx);
 
+/* Check if a context's songs are being decoded on the stream thread
+ * returns: 1 = yes, 0 = no */
+uint8_t a_ctx_streaming(a_ctx* ctx);
+
+#if !defined(ASTERA_NO_THREADS)
+/* Start a thread to keep every playing song's buffers decoded & queued,
+ * independent of how often a_ctx_update is called (i.e during loading)
+ * ctx - the context to stream songs for
+ * interval - the time between each check of the songs (ms), keep this well
+ *            under the length of a song's queued buffers
+ * returns: 1 = success, 0 = fail */
+uint8_t a_ctx_stream_start(a_ctx* ctx, time_s interval);
+
+/* Stop the stream thread, songs go back to decoding in a_ctx_update
+ * ctx - the context to stop streaming for */
+void a_ctx_stream_stop(a_ctx* ctx);
+
+/* Start a dedicated audio thread which owns all OpenAL calls & updates the
+ * context on its own. Playback, layer gain & listener calls push a command
+ * for it (from any thread) instead of calling OpenAL, a_ctx_update does
+ * nothing while threaded
+ * ctx - the context to thread
+ * queue_size - the amount of commands that can be waiting at once
+ * interval - the time between each update of the audio thread (ms)
+ * NOTE: Resources (buffers, songs, fx, filters) & streaming can't be created
+ *       or changed while threaded, call a_ctx_thread_stop first. Buffers &
+ *       songs can be destroyed, it's queued like playback
+ * returns: 1 = success, 0 = fail */
+uint8_t a_ctx_thread_start(a_ctx* ctx, uint32_t queue_size, time_s interval);
+
+/* Stop the audio thread, applying any commands left first
+ * ctx - the context to stop threading */
+void a_ctx_thread_stop(a_ctx* ctx);
+#endif
+
+/* Check if a context is running on its own audio thread
+ * returns: 1 = yes, 0 = no */
+uint8_t a_ctx_threaded(a_ctx* ctx);
+
+/* Limit how many sfx play on an OpenAL source at once. Each update the
+ * active sfx are ranked by priority then audibility (gain, layer gain &
+ * distance within their range), only the top ones get a source. The rest are
+ * virtual, keeping time silently until they rank high enough again
+ * ctx - the context to limit
+ * limit - the max amount of real voices, clamped to the sources available
+ * returns: the limit used */
+uint16_t a_ctx_set_voice_limit(a_ctx* ctx, uint16_t limit);
+
+/* Get the amount of sfx playing on an OpenAL source (not virtual)
+ * returns: the amount of real voices */
+uint16_t a_ctx_get_voice_count(a_ctx* ctx);
+
+/* Create the grid for world emitters, looping sounds placed in the world
+ * (ambience, machines, torches) that only take a sfx while the listener is
+ * within their range. Each update only the grid cells around the listener
+ * are checked, so thousands of emitters cost a small query
+ * ctx - the context to create the emitters in
+ * max_emitters - the max amount of emitters
+ * cell_size - the size of each grid cell, around the typical emitter range
+ * NOTE: The grid is on the X/Y plane, Z is only used for distance
+ * returns: 1 = success, 0 = fail */
+uint8_t a_ctx_emitters_create(a_ctx* ctx, uint16_t max_emitters,
+                              float cell_size);
+
+/* Place a looping emitter in the world
+ * ctx - the context to place it in
+ * layer - the layer to play on (0 for none)
+ * buf_id - the audio buffer to loop
+ * position - the position of the emitter
+ * gain - the gain of the emitter
+ * range - how far away it can be heard from
+ * priority - the priority of the emitter's sfx (see a_ctx_set_voice_limit)
+ * NOTE: Emitters can't be created or destroyed while threaded
+ * returns: the ID of the emitter (non-zero, 0 = error) */
+uint16_t a_emitter_create(a_ctx* ctx, uint16_t layer, uint16_t buf_id,
+                          vec3 position, float gain, float range,
+                          uint8_t priority);
+
+/* Remove an emitter from the world, stopping it if it's playing
+ * ctx - the context containing the emitter
+ * emitter_id - the ID of the emitter
+ * returns: 1 = success, 0 = fail */
+uint8_t a_emitter_destroy(a_ctx* ctx, uint16_t emitter_id);
+
+/* Move an emitter
+ * ctx - the context containing the emitter
+ * emitter_id - the ID of the emitter
+ * position - the new position of the emitter
+ * returns: 1 = success, 0 = fail */
+uint8_t a_emitter_set_pos(a_ctx* ctx, uint16_t emitter_id, vec3 position);
+
+/* Check if an emitter is playing (within the listener's range)
+ * returns: 1 = yes, 0 = no */
+uint8_t a_emitter_playing(a_ctx* ctx, uint16_t emitter_id);
+
 /* Create a layer to manage various audio resources
  * name - the name of the layer
  * max_sfx - the max amount of sfx for the layer to manage
@@ -363,6 +650,9 @@ uint16_t a_ctx_layer_create(a_ctx* ctx, const char* name, uint16_t max_sfx,
  * layer - a layer to use to manage this sfx (optional, 0 for none)
  * buf_id - the audio buffer ID of the sound data
  * req - the request callback for specifics of where / how to play the sfx
+ * NOTE: If every slot is taken, the lowest ranked sfx is stolen when the new
+ *       one outranks it (see a_ctx_set_voice_limit). While threaded it's
+ *       stopped once the audio thread starts the new one
  * returns: the ID of the sfx (non-zero, 0 = error) */
 uint16_t a_sfx_play(a_ctx* ctx, uint16_t layer, uint16_t buf_id, a_req* req);
 
@@ -396,7 +686,7 @@ uint8_t a_sfx_resume(a_ctx* ctx, uint16_t sfx_id);
  * returns: the ID of the layer (non-zero, 0 = error) */
 uint16_t a_layer_get_id(a_ctx* ctx, const char* name);
 
-/* Set the gain of a layer & update it's contents to reflect that
+/* Set the gain of a layer, applied to it's contents at the next update
  * ctx - the context containing the layer
  * layer_id - the ID of the layer
  * gain - the gain of the layer
@@ -436,14 +726,35 @@ uint8_t a_layer_remove_sfx(a_ctx* ctx, uint16_t layer_id, uint16_t sfx_id);
  * length - the length of the raw data
  * packets_per_buffer - the amount of packets to put into a buffer
  * buffers - the number of OpenAL buffers to use
+ * max_buffer_size - the size of the song's decode buffer (in shorts), must
+ *                   hold at least one frame of every channel
  * returns: the song ID (non-zero = success, 0 = fail) */
 uint16_t a_song_create(a_ctx* ctx, unsigned char* data, uint32_t data_length,
                        const char* name, uint16_t packets_per_buffer,
                        uint8_t buffers, uint32_t max_buffer_size);
 
+/* Create a song streamed from a file, only the vorbis decoder's state & a
+ * small read buffer stay in memory rather than the whole file
+ * ctx - the context to create the song within
+ * path - the path of the file
+ * offset - where the OGG data starts in the file (i.e pak_offset)
+ * length - the length of the OGG data (i.e pak_size), 0 = to the end
+ * name - the name of the song (optional)
+ * packets_per_buffer - the amount of packets to put into a buffer
+ * buffers - the number of OpenAL buffers to use
+ * max_buffer_size - the size of the song's decode buffer (in shorts), must
+ *                   hold at least one frame of every channel
+ * returns: the song ID (non-zero = success, 0 = fail) */
+uint16_t a_song_create_file(a_ctx* ctx, const char* path, uint32_t offset,
+                            uint32_t length, const char* name,
+                            uint16_t packets_per_buffer, uint8_t buffers,
+                            uint32_t max_buffer_size);
+
 /* Destroy a song & it's contents
  * ctx - the context the song is contained within
- * id - the ID of the song from creation */
+ * id - the ID of the song from creation
+ * NOTE: While threaded it's destroyed once the audio thread gets to it, keep
+ *       the song's data around until then (i.e until a_ctx_thread_stop) */
 uint8_t a_song_destroy(a_ctx* ctx, uint16_t id);
 
 /* Get the pointer of a song
@@ -496,7 +807,8 @@ uint32_t a_song_get_sample_count(a_ctx* ctx, uint16_t song_id);
  * returns: time (milliseconds), -1 for fail */
 time_s a_song_get_length(a_ctx* ctx, uint16_t song_id);
 
-/* Set a song to play from a given time
+/* Set a song to play from a given time, sample accurate, anything already
+ * queued is dropped & refilled from the new time
  * ctx - the context that contains the song
  * song_id - the ID of the song returned on creation
  * from_start - the time (in Milliseconds) from the start of the song
@@ -511,7 +823,9 @@ uint8_t a_song_reset(a_ctx* ctx, uint16_t song_id);
 
 /* Get the state of a song (stop, play, pause)
  * ctx - the context containing the song
- * song_id - the ID of the song returned on creation */
+ * song_id - the ID of the song returned on creation
+ * NOTE: While threaded this is the state as of the audio thread's last
+ *       update / command */
 ALenum a_song_get_state(a_ctx* ctx, uint16_t song_id);
 
 /* Find the ID of a song based on it's name */
@@ -523,13 +837,37 @@ uint16_t a_song_get_id(a_ctx* ctx, const char* name);
  * data_length - the length of the raw data
  * name - a string name for the buffer (optional)
  * is_ogg - if you want to decode using OGG or WAV format (1 = ogg, 0 = wav)
+ * NOTE: WAV files can be 8/16 bit PCM or IMA / MS ADPCM, ADPCM is kept
+ *       compressed by OpenAL (see tools/adpcm)
+ * NOTE: OGG files are read from the cache if one is set & it's been decoded
+ *       before (see a_ctx_set_cache_dir)
  * returns: ID of the buffer in the context (non-zero, 0 = fail) */
 uint16_t a_buf_create(a_ctx* ctx, unsigned char* data, uint32_t data_length,
                       const char* name, uint8_t is_ogg);
 
+/* Create many audio buffers at once, OGG files are decoded in parallel on
+ * worker threads (the OpenAL buffers are still made on the calling thread)
+ * ctx - the context to manage the buffers with
+ * loads - the files to create buffers from
+ * count - the amount of files
+ * ids - the IDs of the buffers created in the same order, 0 = failed
+ *       (optional)
+ * workers - the amount of threads to decode with, including the caller
+ * returns: the amount of buffers created */
+uint16_t a_buf_create_many(a_ctx* ctx, a_buf_load* loads, uint16_t count,
+                           uint16_t* ids, uint8_t workers);
+
+/* Set a directory to cache decoded OGG sfx in, keyed by the hash of the
+ * file's contents. Later loads of the same file read the decoded samples
+ * straight from the cache instead of decoding again
+ * ctx - the context to cache for
+ * dir - the directory (must exist & stay valid), 0 to disable caching */
+void a_ctx_set_cache_dir(a_ctx* ctx, const char* dir);
+
 /* Destroy an audio buffer
  * ctx - the context that contains the audio buffer
  * buf_id - the ID of the buffer returned on the creation
+ * NOTE: While threaded it's destroyed once the audio thread gets to it
  * returns: success = 1, fail = 0 */
 uint8_t a_buf_destroy(a_ctx* ctx, uint16_t buf_id);
 
@@ -605,6 +943,16 @@ a_req a_req_create(vec3 position, float gain, float range, uint8_t loop,
                    uint16_t* fx, uint16_t fx_count, uint16_t* filters,
                    uint16_t filter_count);
 
+/* Get the current time of a request's song/sound, safe while threaded
+ * req - the request to check
+ * returns: the time in the song/sound */
+time_s a_req_get_time(a_req* req);
+
+/* Get the current state of a request's song/sound, safe while threaded
+ * req - the request to check
+ * returns: the OpenAL source state (AL_PLAYING, AL_STOPPED, ...) */
+uint32_t a_req_get_state(a_req* req);
+
 /* Use an effect within a context
  * ctx - the context to use
  * type - the type of effect to create
@@ -7,6 +7,12 @@
 
 #include <math.h>
 
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define LINMATH_SSE2
+#endif
+
 #ifdef LINMATH_NO_INLINE
 #define LINMATH_H_FUNC static
 #else
@@ -332,6 +338,99 @@ LINMATH_H_FUNC void mat4x4_rotate_z(mat4x4 Q, mat4x4 M, float angle) {
               {0.f, 0.f, 0.f, 1.f}};
   mat4x4_mul(Q, M, R);
 }
+/* Build the 2D transforms of many quads at once from separate arrays, each
+ * scaled by its size, rotated about its pivot & moved to its position
+ * M - the transforms to fill (count of them)
+ * x, y, z - the position of each quad (z may be 0 for none)
+ * w, h - the size of each quad
+ * rotation - the rotation of each quad in radians (may be 0 for none)
+ * pivot_x, pivot_y - the point to rotate about & place at the position,
+ *                    relative to the quad's center in units of its size
+ *                    (may be 0 for the center) */
+LINMATH_H_FUNC void mat4x4_2d_bulk(mat4x4* M, const float* x, const float* y,
+                                   const float* z, const float* w,
+                                   const float* h, const float* rotation,
+                                   const float* pivot_x, const float* pivot_y,
+                                   int count) {
+  int i = 0;
+
+#if defined(LINMATH_SSE2)
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 one  = _mm_set1_ps(1.f);
+
+  for (; i + 4 <= count; i += 4) {
+    float sin_v[4] = {0.f, 0.f, 0.f, 0.f}, cos_v[4] = {1.f, 1.f, 1.f, 1.f};
+    if (rotation) {
+      for (int j = 0; j < 4; ++j) {
+        sin_v[j] = sinf(rotation[i + j]);
+        cos_v[j] = cosf(rotation[i + j]);
+      }
+    }
+
+    __m128 s  = _mm_loadu_ps(sin_v);
+    __m128 c  = _mm_loadu_ps(cos_v);
+    __m128 sw = _mm_loadu_ps(&w[i]);
+    __m128 sh = _mm_loadu_ps(&h[i]);
+
+    // Columns 0 & 1: the rotated & scaled axes
+    __m128 ax = _mm_mul_ps(c, sw), ay = _mm_mul_ps(s, sw);
+    __m128 bx = _mm_mul_ps(_mm_sub_ps(zero, s), sh), by = _mm_mul_ps(c, sh);
+
+    // Column 3: the position, less the rotated & scaled pivot
+    __m128 tx = _mm_loadu_ps(&x[i]), ty = _mm_loadu_ps(&y[i]);
+    __m128 tz = (z) ? _mm_loadu_ps(&z[i]) : zero;
+    if (pivot_x) {
+      __m128 px = _mm_loadu_ps(&pivot_x[i]);
+      tx        = _mm_sub_ps(tx, _mm_mul_ps(ax, px));
+      ty        = _mm_sub_ps(ty, _mm_mul_ps(ay, px));
+    }
+    if (pivot_y) {
+      __m128 py = _mm_loadu_ps(&pivot_y[i]);
+      tx        = _mm_sub_ps(tx, _mm_mul_ps(bx, py));
+      ty        = _mm_sub_ps(ty, _mm_mul_ps(by, py));
+    }
+
+    // Transpose from a component per register to a column per register
+    __m128 a2 = zero, a3 = zero, b2 = zero, b3 = zero, t3 = one;
+    _MM_TRANSPOSE4_PS(ax, ay, a2, a3);
+    _MM_TRANSPOSE4_PS(bx, by, b2, b3);
+    _MM_TRANSPOSE4_PS(tx, ty, tz, t3);
+
+    __m128 col2 = _mm_set_ps(0.f, 1.f, 0.f, 0.f);
+    __m128 a[4] = {ax, ay, a2, a3}, b[4] = {bx, by, b2, b3};
+    __m128 t[4] = {tx, ty, tz, t3};
+    for (int j = 0; j < 4; ++j) {
+      _mm_storeu_ps(M[i + j][0], a[j]);
+      _mm_storeu_ps(M[i + j][1], b[j]);
+      _mm_storeu_ps(M[i + j][2], col2);
+      _mm_storeu_ps(M[i + j][3], t[j]);
+    }
+  }
+#endif
+
+  for (; i < count; ++i) {
+    float s = (rotation) ? sinf(rotation[i]) : 0.f;
+    float c = (rotation) ? cosf(rotation[i]) : 1.f;
+
+    float ax = c * w[i], ay = s * w[i];
+    float bx = -s * h[i], by = c * h[i];
+    float px = (pivot_x) ? pivot_x[i] : 0.f;
+    float py = (pivot_y) ? pivot_y[i] : 0.f;
+
+    M[i][0][0] = ax;
+    M[i][0][1] = ay;
+    M[i][0][2] = M[i][0][3] = 0.f;
+    M[i][1][0] = bx;
+    M[i][1][1] = by;
+    M[i][1][2] = M[i][1][3] = 0.f;
+    M[i][2][0] = M[i][2][1] = M[i][2][3] = 0.f;
+    M[i][2][2] = 1.f;
+    M[i][3][0] = x[i] - (ax * px) - (bx * py);
+    M[i][3][1] = y[i] - (ay * px) - (by * py);
+    M[i][3][2] = (z) ? z[i] : 0.f;
+    M[i][3][3] = 1.f;
+  }
+}
 LINMATH_H_FUNC void mat4x4_invert(mat4x4 T, mat4x4 M) {
   float s[6];
   float c[6];
@@ -1,6 +1,3 @@
-// TODO animation loading from file
-// TODO Sprite sheet auto loading (pixel bounding)
-// TODO Sprite sheet layout from file
 // TODO Baked_sheet update/rebuffer from modifications??
 // TODO Remove `fix` from shaders since we now have internal padding
 
@@ -191,8 +188,68 @@ typedef struct {
   vec2 position, size, scale;
   /* model - just the OpenGL Model Matrix to render with */
   mat4x4 model;
+  /* opaque - 1 = draw without blending (no translucent pixels), 0 = blend */
+  uint8_t opaque;
 } r_baked_sheet;
 
+typedef struct {
+  /* position - the center of the light in world units
+   * radius - the distance the light reaches in world units
+   * intensity - the strength of the light at its center
+   * color - the RGB color of the light (0 - 1) */
+  vec2  position;
+  float radius, intensity;
+  vec3  color;
+} r_light;
+
+/* Called with the pixels of a readback (see r_readback_request)
+ * pixels - RGBA, 8 bits per channel, bottom row first, 0 if the read failed
+ *          NOTE: Only valid until the callback returns
+ * width, height - the size of the area read
+ * data - the user data passed with the request */
+typedef void (*r_readback_func)(unsigned char* pixels, uint32_t width,
+                                uint32_t height, void* data);
+
+/* The kinds of OpenGL objects tracked (see r_res_get_stats) */
+typedef enum {
+  R_RES_TEXTURE = 0,
+  R_RES_BUFFER,
+  R_RES_VAO,
+  R_RES_PROGRAM,
+  R_RES_FRAMEBUFFER,
+  R_RES_RENDERBUFFER,
+  R_RES_TYPE_COUNT
+} r_res_type;
+
+typedef struct {
+  /* type - the r_res_type of the object
+   * id - the OpenGL name of the object
+   * size - the (estimated) size of its storage in bytes, 0 for objects
+   *        without storage (VAOs, programs, framebuffers)
+   * serial - the order the object was created in (unique) */
+  uint32_t type, id, size, serial;
+  /* site - the name of the function that created it */
+  const char* site;
+} r_res_info;
+
+typedef struct {
+  /* counts - the amount of live objects of each type
+   * bytes - the size of the live objects of each type */
+  uint32_t counts[R_RES_TYPE_COUNT];
+  uint64_t bytes[R_RES_TYPE_COUNT];
+  /* total_count, total_bytes - the sums across every type */
+  uint32_t total_count;
+  uint64_t total_bytes;
+} r_res_stats;
+
+/* A copy of the tracked objects at a point in time */
+typedef struct r_res_snapshot r_res_snapshot;
+
+/* A set of baked chunks sharing a sheet & shader, stored in one vertex buffer
+ * & drawn with a single multi-draw call (see r_baked_pack_create)
+ * NOTE: Packs aren't stored in frame captures, a replay is missing them */
+typedef struct r_baked_pack r_baked_pack;
+
 /* I think this is relatively self explanatory */
 typedef enum {
   R_ANIM_STOP  = 0,
@@ -231,6 +288,13 @@ typedef struct {
    * size - the size of the sprite in world units */
   vec2 position, size;
 
+  /* rotation - the rotation of the sprite in radians (counter clockwise)
+   * pivot - the point rotated about & placed at the position, relative to
+   *         the sprite's center in units of its size (0, 0 = center,
+   *         -0.5, -0.5 = bottom left corner) */
+  float rotation;
+  vec2  pivot;
+
   /* shader - the shader program to draw the sprite with
    * sheet - the sheet to use for the sprite */
   r_shader shader;
@@ -238,6 +302,7 @@ typedef struct {
   union {
     r_anim   anim;
     uint32_t tex;
+    uint32_t inst;
   } render;
 
   vec4 color;
@@ -249,6 +314,8 @@ typedef struct {
   int change : 1;
   int animated : 1;
   int visible : 1;
+  int pooled : 1;
+  int opaque : 1;
 } r_sprite;
 
 typedef struct {
@@ -262,6 +329,11 @@ typedef struct {
   vec4*    colors;
   vec4*    coords;
 
+  // layers - the layer of each instance, used to sort the batch
+  uint8_t* layers;
+
+  // opaque - if the batch is drawn in the opaque pass
+  uint8_t  opaque;
   uint32_t count, capacity;
 } r_batch;
 
@@ -351,6 +423,72 @@ struct r_particles {
 
 typedef struct r_ctx r_ctx;
 
+/* A loaded frame capture, see r_capture_load */
+typedef struct r_capture r_capture;
+
+/* Function used to get the shader for a name stored in a capture
+ * name - the name the shader was cached with (or shader_<id> if uncached)
+ * data - the user data passed to r_capture_load
+ * returns: the shader to use, 0 = skip draws with this shader */
+typedef r_shader (*r_capture_shader_loader)(const char* name, void* data);
+
+/* Layout files describe sheets' subtextures & animations, they're made from
+ * text with the astera_layout tool & loaded with r_layout_load.
+ *
+ * The file is laid out as (all values little endian):
+ * r_layout_header
+ * r_layout_sheet[sheet_count]
+ * r_subtex[subtex_count] (sub_id is relative to the sheet)
+ * r_layout_anim[anim_count]
+ * uint32_t[frame_count] (subtex ids relative to the animation's sheet)
+ * r_layout_name[name_count] (sorted by hash)
+ * char[string_size] (null terminated names) */
+#define R_LAYOUT_VERSION 1
+
+typedef enum { R_LAYOUT_SHEET = 0, R_LAYOUT_ANIM = 1 } r_layout_type;
+
+typedef struct {
+  /* magic - "ALAY"
+   * version - R_LAYOUT_VERSION */
+  char     magic[4];
+  uint32_t version;
+
+  /* The amount of each section in the file */
+  uint32_t sheet_count, subtex_count, anim_count, frame_count, name_count;
+  uint32_t string_size;
+} r_layout_header;
+
+typedef struct {
+  /* name - the offset of the name in the string table
+   * width, height - the size of the sheet's image in pixels
+   * subtex_start - the index of the sheet's first subtex
+   * subtex_count - the amount of subtexs the sheet has */
+  uint32_t name;
+  uint32_t width, height;
+  uint32_t subtex_start, subtex_count;
+} r_layout_sheet;
+
+typedef struct {
+  /* name - the offset of the name in the string table
+   * sheet - the index of the sheet the animation uses
+   * rate - the amount of frames per second
+   * loop - 1 = yes, 0 = no
+   * frame_start - the index of the animation's first frame
+   * frame_count - the amount of frames in the animation */
+  uint32_t name, sheet, rate, loop;
+  uint32_t frame_start, frame_count;
+} r_layout_anim;
+
+typedef struct {
+  /* hash - the s_hash_str of the name
+   * type - the r_layout_type of the entry
+   * index - the index of the sheet / animation */
+  uint32_t hash, type, index;
+} r_layout_name;
+
+/* A loaded layout file, see r_layout_load */
+typedef struct r_layout r_layout;
+
 /* Create a basic version of the window params structure for context creation
  * width - the width of the window
  * height - the height of the window
@@ -407,6 +545,136 @@ void r_ctx_update(r_ctx* ctx);
 /* Call for the context to draw it's contents */
 void r_ctx_draw(r_ctx* ctx);
 
+/* Immediate mode primitives, for debug overlays & the like
+ * Primitives are queued for the frame & drawn on top of everything else with
+ * a built in shader in (at most) two draw calls at r_ctx_draw
+ * NOTE: Positions are in world units (same space as sprites) & colors are
+ *       RGBA in the range of 0 - 1 */
+
+/* Queue a line
+ * a - the start of the line
+ * b - the end of the line */
+void r_im_line(r_ctx* ctx, vec2 a, vec2 b, vec4 color);
+
+/* Queue a filled rectangle
+ * position - the center of the rectangle
+ * size - the width & height of the rectangle */
+void r_im_rect(r_ctx* ctx, vec2 position, vec2 size, vec4 color);
+
+/* Queue a rectangle outline
+ * position - the center of the rectangle
+ * size - the width & height of the rectangle */
+void r_im_rect_outline(r_ctx* ctx, vec2 position, vec2 size, vec4 color);
+
+/* Queue a filled circle */
+void r_im_circle(r_ctx* ctx, vec2 center, float radius, vec4 color);
+
+/* Queue a circle outline */
+void r_im_circle_outline(r_ctx* ctx, vec2 center, float radius, vec4 color);
+
+/* Queue a filled convex polygon
+ * points - the points of the polygon in order (i.e a c_comp's verts)
+ * count - the amount of points */
+void r_im_poly(r_ctx* ctx, vec2* points, uint32_t count, vec4 color);
+
+/* Queue a polygon outline (closed)
+ * points - the points of the polygon in order (i.e a c_comp's verts)
+ * count - the amount of points */
+void r_im_poly_outline(r_ctx* ctx, vec2* points, uint32_t count, vec4 color);
+
+/* Light everything drawn to the bound target (window or framebuffer) with
+ * point lights, the lights are binned into 32x32 pixel tiles so each pixel
+ * only shades the lights that reach it
+ * ctx - the context to draw with (using its camera)
+ * lights - the lights to draw
+ * count - the amount of lights
+ * ambient - the light applied everywhere (RGB)
+ * NOTE: Call after r_ctx_draw, the lighting multiplies what has been drawn so
+ *       far. Light beyond 1 only brightens when drawing into a framebuffer */
+void r_lights_draw(r_ctx* ctx, r_light* lights, uint32_t count,
+                   vec3 ambient);
+
+/* Start a dedicated render thread for the context
+ * Once started, the GL context is owned by the render thread & draw calls
+ * (r_sprite_draw, r_baked_sheet_draw, r_particles_draw, r_framebuffer_bind /
+ * draw, r_window_clear / clear_color, r_im_* & r_ctx_draw) are recorded into a
+ * command list instead. r_window_swap_buffers hands the list to the render
+ * thread, which executes & presents it while the next frame is recorded.
+ * NOTE: Resources (textures, sheets, shaders, baked sheets, framebuffers) &
+ *       raw OpenGL calls have to be made while the thread is stopped, & any
+ *       sheets referenced by draw calls must outlive the frame
+ * ctx - the context to thread
+ * returns: 1 = success, 0 = fail */
+uint8_t r_ctx_thread_start(r_ctx* ctx);
+
+/* Finish any submitted frame, stop the render thread & take the GL context
+ * back onto the calling thread
+ * ctx - the context to stop threading */
+void r_ctx_thread_stop(r_ctx* ctx);
+
+/* Check if a context is rendering with a dedicated render thread
+ * ctx - the context to check
+ * returns: 1 = threaded, 0 = not threaded */
+uint8_t r_ctx_is_threaded(r_ctx* ctx);
+
+/* Start capturing the frames submitted to the context to a file
+ * The sprites, baked sheets, particles, camera & framebuffer passes of each
+ * frame are written as they're presented by r_window_swap_buffers, along with
+ * any textures / baked sheet buffers they reference (once)
+ * NOTE: Start & stop captures between frames, shaders are only referenced by
+ *       their cached name (see r_shader_cache)
+ * NOTE: Baked pack draws & readbacks are left out, so a replay of a frame
+ *       drawn with packs is missing their geometry
+ * ctx - the context to capture
+ * path - the file path to write the capture to
+ * frames - the amount of frames to capture (0 = until r_ctx_capture_stop)
+ * returns: 1 = success, 0 = fail */
+uint8_t r_ctx_capture_start(r_ctx* ctx, const char* path, uint32_t frames);
+
+/* Stop capturing & close the capture file
+ * ctx - the context to stop capturing */
+void r_ctx_capture_stop(r_ctx* ctx);
+
+/* Check if a context is still capturing frames
+ * ctx - the context to check
+ * returns: 1 = capturing, 0 = not capturing */
+uint8_t r_ctx_is_capturing(r_ctx* ctx);
+
+/* Get the window size a capture was recorded with
+ * data - the capture file's data
+ * length - the length of the data
+ * width - the width to set (optional)
+ * height - the height to set (optional)
+ * returns: 1 = success, 0 = fail */
+uint8_t r_capture_get_size(unsigned char* data, uint32_t length,
+                           uint32_t* width, uint32_t* height);
+
+/* Load a capture & recreate the resources it references
+ * NOTE: The context can't be threaded or capturing
+ * ctx - the context to load the capture's resources with
+ * data - the capture file's data (not kept after loading)
+ * length - the length of the data
+ * loader - the function to get shaders by name with
+ * loader_data - user data passed to the loader
+ * returns: the loaded capture, 0 = fail */
+r_capture* r_capture_load(r_ctx* ctx, unsigned char* data, uint32_t length,
+                          r_capture_shader_loader loader, void* loader_data);
+
+/* Get the amount of frames in a capture
+ * capture - the capture to check
+ * returns: the frame count */
+uint32_t r_capture_frame_count(r_capture* capture);
+
+/* Re-submit a captured frame through the renderer (without presenting it)
+ * ctx - the context to draw with
+ * capture - the capture to replay
+ * frame - the index of the frame to replay */
+void r_capture_replay(r_ctx* ctx, r_capture* capture, uint32_t frame);
+
+/* Free a capture & the resources it created (shaders are left to the loader)
+ * capture - the capture to destroy */
+void r_capture_destroy(r_capture* capture);
+
 /* Check if OpenGL has thrown an error */
 uint32_t r_check_error(void);
 
@@ -465,6 +733,25 @@ void r_framebuffer_bind(r_framebuffer fbo);
  * fbo - the framebuffer to draw */
 void r_framebuffer_draw(r_ctx* ctx, r_framebuffer fbo);
 
+/* Read a framebuffer's pixels without stalling, the read is queued into a
+ * pixel buffer & delivered to func a frame or two later once the GPU is done
+ * ctx - the context to read from
+ * fbo - the framebuffer to read, 0 = the window (call after drawing, before
+ *       r_window_swap_buffers)
+ * func - the function to deliver the pixels to
+ * data - user data to pass to func
+ * NOTE: func is called on the thread that owns the GL context (the render
+ *       thread if started), at most 4 readbacks can be in flight at once */
+void r_readback_request(r_ctx* ctx, r_framebuffer* fbo, r_readback_func func,
+                        void* data);
+
+/* Read a framebuffer's pixels without stalling & save them as a PNG, encoded
+ * & written on a worker thread
+ * ctx - the context to read from
+ * fbo - the framebuffer to read, 0 = the window
+ * path - the file to write to (copied) */
+void r_readback_png(r_ctx* ctx, r_framebuffer* fbo, const char* path);
+
 /* Create an OpenGL Width data
  * data - the unformatted raw data of the texture file
  * length - the length of the image data */
@@ -487,17 +774,25 @@ r_sheet r_sheet_create(unsigned char* data, uint32_t length, vec4* sub_sprites,
                        uint32_t subsprite_count);
 
 /* Automatically create sprites by automatically detecting pixel bounds
- * NOTE: Padding between subsprites is highly recommended for this, also this
- * method isn't provento work in higher resolutions
+ * NOTE: Padding between subsprites is highly recommended for this, subsprites
+ * are each connected region of non-transparent pixels in reading order
  *
  * data - the image data
  * length - the length of the image data
- * tollerance - the amount of pixels you can go before breaking a subsprite
- *
- * NOTE: CURRENTLY NOT WORKING, TO BE IMPLEMENTED */
+ * tollerance - the amount of pixels you can go before breaking a subsprite */
 r_sheet r_sheet_create_auto(unsigned char* data, uint32_t length,
                             uint32_t tollerance);
 
+/* Same as r_sheet_create_auto, but the detected bounds are cached to a file &
+ * only detected again when the image or tollerance changes
+ *
+ * data - the image data
+ * length - the length of the image data
+ * tollerance - the amount of pixels you can go before breaking a subsprite
+ * cache_path - the file to store the detected bounds in */
+r_sheet r_sheet_create_auto_cached(unsigned char* data, uint32_t length,
+                                   uint32_t tollerance, const char* cache_path);
+
 /* Automatically create sprites based on a grid size
  * data - the image data
  * length - the length of the image data
@@ -514,6 +809,50 @@ r_sheet r_sheet_create_tiled(unsigned char* data, uint32_t length,
  * sheet - the sheet to destroy */
 void r_sheet_destroy(r_sheet* sheet);
 
+/* Load a layout file (see astera_layout)
+ * data - the layout file's data
+ * length - the length of the data
+ * returns: the loaded layout, 0 = fail
+ * NOTE: The data is copied in a single allocation, so it can be freed after */
+r_layout* r_layout_load(unsigned char* data, uint32_t length);
+
+/* Free a layout
+ * NOTE: Animations cached with r_layout_cache_anims use the layout's names, so
+ *       remove them from the cache before destroying the layout */
+void r_layout_destroy(r_layout* layout);
+
+/* Find a sheet in a layout by name
+ * returns: the index of the sheet, -1 = not found */
+int32_t r_layout_find_sheet(r_layout* layout, const char* name);
+
+/* Find an animation in a layout by name
+ * returns: the index of the animation, -1 = not found */
+int32_t r_layout_find_anim(r_layout* layout, const char* name);
+
+/* Create a texture sheet with the subtextures of a layout's sheet
+ * data - the image data
+ * length - the length of the image data
+ * layout - the layout to use
+ * sheet_index - the index of the sheet within the layout */
+r_sheet r_sheet_create_layout(unsigned char* data, uint32_t length,
+                              r_layout* layout, uint32_t sheet_index);
+
+/* Create an animation from a layout
+ * layout - the layout to use
+ * anim_index - the index of the animation within the layout
+ * sheet - the sheet created for the animation's layout sheet */
+r_anim r_layout_get_anim(r_layout* layout, uint32_t anim_index,
+                         r_sheet* sheet);
+
+/* Cache all of the animations of a layout's sheet in a context by name
+ * ctx - the context to cache the animations in
+ * layout - the layout to use
+ * sheet_index - the index of the sheet within the layout
+ * sheet - the sheet created for the layout sheet
+ * returns: the amount of animations cached */
+uint32_t r_layout_cache_anims(r_ctx* ctx, r_layout* layout,
+                              uint32_t sheet_index, r_sheet* sheet);
+
 /* Create a baked sheet (series of quads) to render
  *
  * sheet - the texture sheet you want to use
@@ -536,6 +875,90 @@ void r_baked_sheet_draw(r_ctx* ctx, r_shader shader, r_baked_sheet* sheet);
  *       just the baked sheet's vertex data */
 void r_baked_sheet_destroy(r_baked_sheet* sheet);
 
+/* Create a baked pack, chunks of baked quads sharing one sheet & one set of
+ * buffers so any list of them can be drawn in a single call
+ * sheet - the texture sheet every chunk uses
+ * chunk_capacity - the max amount of chunks in the pack
+ * quad_capacity - the max amount of quads across all chunks
+ * returns: the pack, 0 = fail */
+r_baked_pack* r_baked_pack_create(r_sheet* sheet, uint32_t chunk_capacity,
+                                  uint32_t quad_capacity);
+
+/* Add a chunk of quads to a baked pack
+ * pack - the pack to add to
+ * quads - the quads of the chunk (relative to position)
+ * quad_count - the number of quads (max 16384 per chunk)
+ * position - the offset of the chunk
+ * returns: the index of the chunk, -1 = fail
+ * NOTE: After adding, you're able to free the `quads` array */
+int32_t r_baked_pack_add(r_baked_pack* pack, r_baked_quad* quads,
+                         uint32_t quad_count, vec2 position);
+
+/* Move a chunk of a baked pack
+ * pack - the pack the chunk is in
+ * chunk - the index of the chunk
+ * position - the new offset of the chunk
+ * NOTE: Positions are baked into the chunk's vertices, so this re-uploads
+ *       them, it's meant for occasional moves rather than every frame */
+void r_baked_pack_set_position(r_baked_pack* pack, uint32_t chunk,
+                               vec2 position);
+
+/* Get the chunks of a baked pack overlapping an area
+ * pack - the pack to check
+ * bounds - the area to check [min_x, min_y, max_x, max_y]
+ * chunks - the array to store the chunk indices in
+ * capacity - the max amount of indices to store
+ * returns: the amount of chunks stored */
+uint32_t r_baked_pack_get_visible(r_baked_pack* pack, vec4 bounds,
+                                  uint32_t* chunks, uint32_t capacity);
+
+/* Set whether a baked pack is drawn without blending
+ * pack - the pack to affect
+ * opaque - 1 = draw without blending, 0 = blend */
+void r_baked_pack_set_opaque(r_baked_pack* pack, uint8_t opaque);
+
+/* Draw chunks of a baked pack in one call
+ * shader - the shader to use (same uniforms as r_baked_sheet_draw)
+ * pack - the pack to draw
+ * chunks - the indices of the chunks to draw, 0 = every chunk
+ * count - the amount of indices in chunks
+ * NOTE: Pack draws are recorded but left out of frame captures, a replay
+ *       won't have this geometry */
+void r_baked_pack_draw(r_ctx* ctx, r_shader shader, r_baked_pack* pack,
+                       uint32_t* chunks, uint32_t count);
+
+/* Destroy & free a baked pack
+ * NOTE: This will not destroy shaders & textures, just the pack's buffers */
+void r_baked_pack_destroy(r_baked_pack* pack);
+
+/* Resource accounting, every OpenGL object astera creates (textures, sheets,
+ * buffers, VAOs, shaders, framebuffers) is tracked until it's destroyed
+ * NOTE: Sizes are estimates from the storage requested, drivers may pad them */
+
+/* Get the counts & sizes of the live OpenGL objects
+ * dst - the stats to fill */
+void r_res_get_stats(r_res_stats* dst);
+
+/* Copy the list of live OpenGL objects
+ * returns: the snapshot, 0 = fail */
+r_res_snapshot* r_res_snapshot_create(void);
+
+/* Get the objects in one snapshot that aren't in another, i.e to find what
+ * was created (& not destroyed) between them
+ * before - the earlier snapshot, 0 = every object in after
+ * after - the later snapshot
+ * dst - the array to store the objects in (in creation order)
+ * capacity - the max amount of objects to store
+ * returns: the amount of objects stored */
+uint32_t r_res_snapshot_diff(r_res_snapshot* before, r_res_snapshot* after,
+                             r_res_info* dst, uint32_t capacity);
+
+/* Get the amount of objects in a snapshot */
+uint32_t r_res_snapshot_count(r_res_snapshot* snapshot);
+
+/* Free a snapshot */
+void r_res_snapshot_destroy(r_res_snapshot* snapshot);
+
 /* Create a particle system
  * emit_rate - the amount of particles to emit per second
  * particle_capacity - the maximum amount of particles alive at any given
@@ -665,6 +1088,42 @@ void r_anim_pause(r_anim* anim);
 /* Reset an animation's state & time */
 void r_anim_reset(r_anim* anim);
 
+/* Create a pooled instance of a cached animation
+ * ctx - the context to create the instance in
+ * anim_id - the id of the cached animation to play
+ * returns: the instance handle, 0 = fail
+ * NOTE: Pooled instances are all advanced at once by r_anim_pool_update
+ *       rather than per sprite, prefer them for large amounts of sprites */
+uint32_t r_anim_inst_create(r_ctx* ctx, uint32_t anim_id);
+
+/* Release a pooled animation instance
+ * ctx - the context the instance belongs to
+ * inst - the instance handle
+ * NOTE: Destroyed handles are ignored by the r_anim_inst functions, removing
+ *       an animation stops its instances, they can't be played again */
+void r_anim_inst_destroy(r_ctx* ctx, uint32_t inst);
+
+/* Set a pooled animation instance's state to play */
+void r_anim_inst_play(r_ctx* ctx, uint32_t inst);
+
+/* Set a pooled animation instance's state to paused */
+void r_anim_inst_pause(r_ctx* ctx, uint32_t inst);
+
+/* Stop a pooled animation instance & reset it to the first frame */
+void r_anim_inst_stop(r_ctx* ctx, uint32_t inst);
+
+/* Get the state of a pooled animation instance
+ * returns: R_ANIM_PLAY, R_ANIM_STOP or R_ANIM_PAUSE */
+uint8_t r_anim_inst_get_state(r_ctx* ctx, uint32_t inst);
+
+/* Get the current frame of a pooled animation instance */
+uint32_t r_anim_inst_get_frame(r_ctx* ctx, uint32_t inst);
+
+/* Advance every pooled animation instance
+ * ctx - the context to update
+ * delta - the time since the last update (milliseconds) */
+void r_anim_pool_update(r_ctx* ctx, time_s delta);
+
 /* Create a sprite to draw
  * shader - the shader program to draw it with
  * pos - the position of the sprite
@@ -689,6 +1148,22 @@ r_subtex* r_subtex_create(r_sheet* sheet, uint32_t x, uint32_t y,
  * anim - the animation to set it to draw */
 void r_sprite_set_anim(r_sprite* sprite, r_anim anim);
 
+/* Set whether a sprite is fully opaque
+ * Opaque sprites are drawn before everything else at r_ctx_draw, front to
+ * back with blending off so hidden pixels are skipped by the depth test.
+ * Translucent sprites are drawn after, back to front by layer.
+ * NOTE: Pixels with partial alpha will be drawn solid, so only set this for
+ *       sprites without transparency (or shaders that discard it)
+ * sprite - the sprite to affect
+ * opaque - 1 = opaque, 0 = translucent (default) */
+void r_sprite_set_opaque(r_sprite* sprite, uint8_t opaque);
+
+/* Set a sprite to draw a pooled animation instance
+ * ctx - the context the instance belongs to
+ * sprite - the sprite to affect
+ * inst - the instance handle (see r_anim_inst_create) */
+void r_sprite_set_anim_inst(r_ctx* ctx, r_sprite* sprite, uint32_t inst);
+
 /* Set a sprite's texture
  * sprite - the sprite to affect
  * sheet - the texture sheet to use
@@ -700,6 +1175,14 @@ void r_sprite_set_tex(r_sprite* sprite, r_sheet* sheet, uint32_t tex);
  * delta - the time since last update / frame */
 void r_sprite_update(r_sprite* sprite, long delta);
 
+/* Update an array of sprites for drawing, building their transforms in bulk
+ * (several at a time with SIMD where available)
+ * sprites - the sprites to update
+ * count - the amount of sprites
+ * delta - the time since last update / frame
+ * NOTE: Prefer this over r_sprite_update for anything moving every frame */
+void r_sprites_update(r_sprite* sprites, uint32_t count, long delta);
+
 /* Call for a sprite to be drawn in the next batch
  * ctx - the context to draw the sprite in
  * sprite - the sprite to draw */
@@ -752,13 +1235,43 @@ void r_camera_set_size(r_camera* camera, vec2 size);
 /* dst is the vector to store the worldpsace to
  * camera is the camera to translate the point from
  * point is the point within the camera [0,1] on each axis */
-void r_camera_screen_to_world(vec2 dst, r_camera* camera, vec2 point);
+void r_cam_screen_to_world(vec2 dst, r_camera* camera, vec2 point);
 
 /* dst is the vector to store the screenspace point to
  * (translated to 0...1 scale of camera size)
  * camera is the camera to translate the point from
  * point is the point in worldspace to translate */
-void r_camera_screen_to_world(vec2 dst, r_camera* camera, vec2 point);
+void r_cam_world_to_screen(vec2 dst, r_camera* camera, vec2 point);
+
+/* Sprite picking, finds the sprites drawn under a point / within an area
+ * Sprites passed to r_sprite_draw are kept in a hashed grid, queries look at
+ * the sprites drawn in the last frame (before r_window_swap_buffers)
+ * NOTE: Positions are in world units, use r_cam_screen_to_world for the
+ *       cursor. Sprites are tested by the bounds of their model
+ * NOTE: The sprites returned are the pointers passed to r_sprite_draw last
+ *       frame, not copies. If a sprite was freed or moved since, its pointer
+ *       dangles, & none of them should be kept past the next
+ *       r_window_swap_buffers */
+
+/* Enable / disable sprite picking
+ * cell_size - the size of each grid cell in world units (around the size of
+ *             a typical sprite), 0 = disable & free the grid */
+void r_pick_enable(r_ctx* ctx, float cell_size);
+
+/* Get the top most sprite under a point
+ * point - the point to check in world units
+ * returns: the sprite on the highest layer (last drawn within a layer),
+ *          0 = none, only valid until the next r_window_swap_buffers */
+r_sprite* r_pick_point(r_ctx* ctx, vec2 point);
+
+/* Get the sprites overlapping an area
+ * bounds - the area to check [min_x, min_y, max_x, max_y]
+ * dst - the array to store the sprites in (in no particular order)
+ * capacity - the max amount of sprites to store
+ * returns: the amount of sprites stored, the pointers are only valid until the
+ *          next r_window_swap_buffers */
+uint32_t r_pick_rect(r_ctx* ctx, vec4 bounds, r_sprite** dst,
+                     uint32_t capacity);
 
 /* vert - the vertex shader program's data
  * frag - the fragment shader program's data */
@@ -44,6 +44,48 @@ typedef struct {
   time_s delta;
 } s_timer;
 
+/* The amount of frames s_pacer keeps stats for */
+#define S_PACER_HISTORY 128
+
+/* The most time s_pacer will spin for (ms) */
+#define S_PACER_MAX_SPIN 2.0
+
+typedef struct {
+  /* period - the time between frames (ms), 0 = unlimited
+     low_latency - start each frame just in time for the next present, rather
+                   than as soon as the last one was done
+     margin - the time left spare before the present in low latency mode (ms) */
+  time_s  period;
+  uint8_t low_latency;
+  time_s  margin;
+
+  /* start - when the current frame started (ms)
+     present - when the last frame was presented (ms), 0 if never marked
+     deadline - when the next frame should start (ms)
+     oversleep - the estimated amount the OS oversleeps by (ms), the pacer
+                 spins for this long instead
+     sleep_mean, sleep_var - the running mean & variance of oversleeping */
+  time_s start, present, deadline;
+  time_s oversleep, sleep_mean, sleep_var;
+
+  /* frames - the time between each frame's start (ms)
+     work - the time from each frame's start until its present (ms)
+     index - the current position in the history
+     count - the amount of frames in the history */
+  time_s   frames[S_PACER_HISTORY];
+  time_s   work[S_PACER_HISTORY];
+  uint32_t index, count;
+} s_pacer;
+
+typedef struct {
+  /* average, min, max - the frame times in the history (ms)
+     jitter - the standard deviation of the frame times (ms)
+     work - the average time from a frame's start to its present (ms)
+     missed - the amount of frames that took over 1.5x the period */
+  time_s   average, min, max, jitter, work;
+  uint32_t missed;
+} s_pacer_stats;
+
 #if !defined(ASTERA_NO_CONF)
 typedef struct {
   /* keys - an array of the key strings
@@ -96,6 +138,35 @@ s_timer s_timer_create();
    returns: time actually slept */
 time_s s_sleep(time_s duration);
 
+/* Create a frame pacer, which limits the frame rate by sleeping most of the
+   way to each frame's start & spinning the rest for accuracy
+   rate - the frames per second to limit to, 0 = unlimited
+   low_latency - with vsync, delay each frame's start until just before the
+                 next present (rate should be the refresh rate) so less time
+                 passes between input & display
+   returns: the pacer */
+s_pacer s_pacer_create(time_s rate, uint8_t low_latency);
+
+/* Change the frame rate of a pacer
+   pacer - the pacer to affect
+   rate - the frames per second to limit to, 0 = unlimited */
+void s_pacer_set_rate(s_pacer* pacer, time_s rate);
+
+/* Wait until the next frame should start, call at the start of each frame
+   pacer - the pacer to wait on
+   returns: the time since the last frame started (ms) */
+time_s s_pacer_wait(s_pacer* pacer);
+
+/* Mark the frame as presented, call right after r_window_swap_buffers
+   pacer - the pacer to mark
+   NOTE: Only needed for low latency mode & the work stats */
+void s_pacer_presented(s_pacer* pacer);
+
+/* Get the frame time stats of the pacer's history
+   pacer - the pacer to get the stats of
+   dst - the stats to fill */
+void s_pacer_get_stats(s_pacer* pacer, s_pacer_stats* dst);
+
 /* Convert integer to String
    value - the value to convert to string
    string - the storage for the string
@@ -103,6 +174,98 @@ time_s s_sleep(time_s duration);
    returns: pointer to the string */
 char* s_itoa(int32_t value, char* string, int8_t base);
 
+/* Hash a string (FNV-1a)
+   str - the null terminated string to hash
+   returns: the 32 bit hash of the string */
+uint32_t s_hash_str(const char* str);
+
+/* Hash a block of data (FNV-1a)
+   data - the data to hash
+   length - the length of the data in bytes
+   returns: the 32 bit hash of the data */
+uint32_t s_hash_data(const void* data, uint32_t length);
+
+#if !defined(ASTERA_NO_THREADS)
+/* Thin wrappers around the OS's threading primitives (pthreads / Win32)
+ * NOTE: These are opaque & heap allocated, so only pointers get passed around */
+typedef struct s_thread s_thread;
+typedef struct s_mutex  s_mutex;
+typedef struct s_cond   s_cond;
+
+/* The entry point type of a thread
+   data - the user data passed into s_thread_create */
+typedef void (*s_thread_func)(void* data);
+
+/* Create & start a thread
+   func - the function for the thread to run
+   data - user data to pass to the function
+   returns: the thread handle, 0 = fail */
+s_thread* s_thread_create(s_thread_func func, void* data);
+
+/* Wait for a thread to finish & free its handle
+   thread - the thread to join */
+void s_thread_join(s_thread* thread);
+
+/* Create a mutex
+   returns: the mutex, 0 = fail */
+s_mutex* s_mutex_create(void);
+
+/* Lock a mutex (blocking) */
+void s_mutex_lock(s_mutex* mutex);
+
+/* Unlock a mutex */
+void s_mutex_unlock(s_mutex* mutex);
+
+/* Destroy & free a mutex */
+void s_mutex_destroy(s_mutex* mutex);
+
+/* Create a condition variable
+   returns: the condition variable, 0 = fail */
+s_cond* s_cond_create(void);
+
+/* Wait on a condition variable
+   cond - the condition variable to wait on
+   mutex - the mutex (locked by the caller) to release while waiting */
+void s_cond_wait(s_cond* cond, s_mutex* mutex);
+
+/* Wake a single thread waiting on a condition variable */
+void s_cond_signal(s_cond* cond);
+
+/* Wake all threads waiting on a condition variable */
+void s_cond_broadcast(s_cond* cond);
+
+/* Destroy & free a condition variable */
+void s_cond_destroy(s_cond* cond);
+
+/* Atomically load a value, seeing everything written before its store
+   value - the value to load
+   returns: the value */
+uint32_t s_atomic_load(volatile uint32_t* value);
+
+/* Atomically store a value, publishing everything written before it
+   value - the value to store to
+   desired - the value to store */
+void s_atomic_store(volatile uint32_t* value, uint32_t desired);
+
+/* Atomically add to a value
+   value - the value to add to
+   amount - the amount to add
+   returns: the value before adding */
+uint32_t s_atomic_add(volatile uint32_t* value, uint32_t amount);
+
+/* Atomically swap a value, only if it's still what's expected
+   value - the value to swap
+   expected - the value it should be
+   desired - the value to swap in
+   returns: 1 = swapped, 0 = the value had changed */
+uint8_t s_atomic_cas(volatile uint32_t* value, uint32_t expected,
+                     uint32_t desired);
+
+/* 64 bit versions of s_atomic_load & s_atomic_store */
+uint64_t s_atomic_load64(volatile uint64_t* value);
+void     s_atomic_store64(volatile uint64_t* value, uint64_t desired);
+#endif
+
 #ifdef __cplusplus
 }
 #endif
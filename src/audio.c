@@ -13,8 +13,20 @@
 #define STB_VORBIS_MAX_CHANNELS 2
 #include <stb_vorbis.c>
 
+#include <math.h>
 #include <string.h>
 
+#include <AL/alext.h>
+
+// Batches source updates (AL_SOFT_deferred_updates), 0 if unsupported
+static LPALDEFERUPDATESSOFT   alDeferUpdatesSOFT;
+static LPALPROCESSUPDATESSOFT alProcessUpdatesSOFT;
+
+// Renders a context into memory (ALC_SOFT_loopback), see a_ctx_create_loopback
+static LPALCLOOPBACKOPENDEVICESOFT      alcLoopbackOpenDeviceSOFT;
+static LPALCISRENDERFORMATSUPPORTEDSOFT alcIsRenderFormatSupportedSOFT;
+static LPALCRENDERSAMPLESSOFT           alcRenderSamplesSOFT;
+
 #if !defined(ASTERA_AL_NO_EFX)
 #include <AL/efx.h>
 
@@ -50,6 +62,29 @@ static LPALGETAUXILIARYEFFECTSLOTF    alGetAuxiliaryEffectSlotf;
 static LPALGETAUXILIARYEFFECTSLOTFV   alGetAuxiliaryEffectSlotfv;
 #endif
 
+struct a_voice {
+  // audibility, priority - what the sfx is ranked by
+  // index - the index of the sfx in the context
+  float    audibility;
+  uint16_t index;
+  uint8_t  priority;
+};
+
+struct a_emitter_rank {
+  // distance - how far the emitter is from the listener
+  // priority - the priority of the emitter's sfx
+  // id - the ID of the emitter
+  float    distance;
+  uint16_t id;
+  uint8_t  priority;
+};
+
+struct a_seek_page {
+  // start, end - the byte offsets of the page in the stream
+  // sample - the last sample decoded by the page's frames
+  uint32_t start, end, sample;
+};
+
 static inline float _a_clamp(float value, float min, float max, float def) {
   return (value == -1.f) ? def
                          : (value < min) ? min : (value > max) ? max : value;
@@ -88,57 +123,98 @@ const char* a_ctx_get_device(a_ctx* ctx, uint8_t* string_length) {
 
 uint8_t a_ctx_play_allowed(a_ctx* ctx) { return ctx->allow; }
 
-a_ctx* a_ctx_create(const char* device, uint8_t layers, uint16_t max_sfx,
-                    uint16_t max_buffers, uint16_t max_songs, uint16_t max_fx,
-                    uint16_t max_filters, uint32_t pcm_size) {
+/* Set up a context on an opened device, the device is closed on failure
+ * format - the loopback format attributes (0 terminated), 0 if the device
+ *          plays out */
+static a_ctx* a_ctx_open(ALCdevice* al_device, const ALCint* format,
+                         uint8_t layers, uint16_t max_sfx, uint16_t max_buffers,
+                         uint16_t max_songs, uint16_t max_fx,
+                         uint16_t max_filters, uint32_t pcm_size) {
+  if (!al_device) {
+    ASTERA_DBG("a_ctx_create: unable to open OpenAL device.\n");
+    return 0;
+  }
+
   a_ctx* ctx = (a_ctx*)malloc(sizeof(a_ctx));
 
   ASTERA_DBG("Test 2!.\n");
 
   if (!ctx) {
     ASTERA_DBG("a_ctx_create: unable to malloc initial space for context.\n");
+    alcCloseDevice(al_device);
     return 0;
   }
 
-  ALCdevice* al_device = alcOpenDevice(device);
-
   if (alcIsExtensionPresent(al_device, "ALC_EXT_EFX") == AL_FALSE) {
     ctx->use_fx = 0;
   } else {
     ctx->use_fx = 1;
   }
 
-  ctx->max_fx = max_fx;
+  ctx->max_fx        = max_fx;
+  ctx->fx_per_source = 0;
+  ctx->fx_slots      = 0;
+  ctx->fx_count      = 0;
+  ctx->fx_capacity   = 0;
+  ctx->fx_high       = 0;
+
+  ctx->filter_slots    = 0;
+  ctx->filter_count    = 0;
+  ctx->filter_capacity = 0;
+  ctx->filter_high     = 0;
 
   // Disable effects if we're not using any of them
   if (!ctx->max_fx && !max_filters) {
     ctx->use_fx = 0;
   }
 
-  ALint attribs[4] = {0};
+  ALint   attribs[12] = {0};
+  uint8_t attrib_count = 0;
+
+  if (format) {
+    for (; format[attrib_count] && attrib_count < 8; attrib_count += 2) {
+      attribs[attrib_count]     = format[attrib_count];
+      attribs[attrib_count + 1] = format[attrib_count + 1];
+    }
+  }
 
   if (ctx->use_fx) {
-    attribs[0] = ALC_MAX_AUXILIARY_SENDS;
-    attribs[1] = 4;
+    attribs[attrib_count]     = ALC_MAX_AUXILIARY_SENDS;
+    attribs[attrib_count + 1] = 4;
   }
 
   ALCcontext* context = alcCreateContext(al_device, attribs);
 
-  if (!alcMakeContextCurrent(context)) {
+  if (!context || !alcMakeContextCurrent(context)) {
     ASTERA_DBG("Error creating OpenAL Context\n");
+    if (context) {
+      alcDestroyContext(context);
+    }
+    alcCloseDevice(al_device);
     free(ctx);
     return 0;
   }
 
-  ctx->context = context;
-  ctx->device  = al_device;
+  ctx->context  = context;
+  ctx->device   = al_device;
+  ctx->loopback = (format != 0);
 
 #if defined(ASTERA_AL_DISTANCE_MODEL)
   alDistanceModel(ASTERA_AL_DISTANCE_MODEL);
 #endif
 
+  if (alIsExtensionPresent("AL_SOFT_deferred_updates")) {
+    alDeferUpdatesSOFT =
+        (LPALDEFERUPDATESSOFT)alGetProcAddress("alDeferUpdatesSOFT");
+    alProcessUpdatesSOFT =
+        (LPALPROCESSUPDATESSOFT)alGetProcAddress("alProcessUpdatesSOFT");
+  }
+
   if (ctx->use_fx) {
-    alcGetIntegerv(al_device, ALC_MAX_AUXILIARY_SENDS, 1, &ctx->fx_per_source);
+    // Read whole, fx_per_source is narrower than an ALCint
+    ALCint sends = 0;
+    alcGetIntegerv(al_device, ALC_MAX_AUXILIARY_SENDS, 1, &sends);
+    ctx->fx_per_source = (uint16_t)sends;
 
     if (!ctx->fx_per_source) {
       ASTERA_DBG(
@@ -232,6 +308,8 @@ a_ctx* a_ctx_create(const char* device, uint8_t layers, uint16_t max_sfx,
     }
   }
 
+  ctx->cache_dir = 0;
+
   ctx->pcm_length = pcm_size;
   ctx->pcm_index  = 0;
   if (pcm_size) {
@@ -278,16 +356,62 @@ a_ctx* a_ctx_create(const char* device, uint8_t layers, uint16_t max_sfx,
   ctx->sfx_count    = 0;
   ctx->sfx_high     = 0;
 
+  ctx->sfx_free_count = 0;
+  ctx->voice_capacity = 0;
+  ctx->voice_free     = 0;
+  ctx->voice_time     = 0.0;
+  vec3_clear(ctx->voice_origin);
+
   if (max_sfx) {
-    ctx->sfx = (a_sfx*)malloc(sizeof(a_sfx) * ctx->sfx_capacity);
+    ctx->sfx           = (a_sfx*)malloc(sizeof(a_sfx) * ctx->sfx_capacity);
+    ctx->sfx_free      = (uint16_t*)malloc(sizeof(uint16_t) * max_sfx);
+    ctx->voice_sources = (uint32_t*)malloc(sizeof(uint32_t) * max_sfx);
+    ctx->voices        = (a_voice*)malloc(sizeof(a_voice) * max_sfx);
+
+    memset(ctx->sfx, 0, sizeof(a_sfx) * max_sfx);
+
+    // Pushed in reverse so the lowest slots are used first
+    for (uint16_t i = 0; i < max_sfx; ++i) {
+      ctx->sfx[i].id   = i + 1;
+      ctx->sfx_free[i] = max_sfx - 1 - i;
+    }
+    ctx->sfx_free_count = max_sfx;
 
+    // Devices can cap the amount of sources, any sfx past that are virtual
+    alGetError();
     for (uint16_t i = 0; i < max_sfx; ++i) {
-      ctx->sfx[i].id = i + 1;
-      alGenSources(1, &ctx->sfx[i].source);
-      ctx->sfx[i].req = 0;
+      uint32_t source = 0;
+      alGenSources(1, &source);
+      if (alGetError() != AL_NO_ERROR || !source) {
+        ASTERA_DBG("a_ctx_create: only %i sources available for sfx.\n", i);
+        break;
+      }
+
+      ctx->voice_sources[i] = source;
+      ++ctx->voice_capacity;
     }
+    ctx->voice_free = ctx->voice_capacity;
+  } else {
+    ctx->sfx           = 0;
+    ctx->sfx_free      = 0;
+    ctx->voice_sources = 0;
+    ctx->voices        = 0;
   }
 
+  ctx->voice_limit = ctx->voice_capacity;
+
+  ctx->emitters             = 0;
+  ctx->emitter_count        = 0;
+  ctx->emitter_capacity     = 0;
+  ctx->emitter_high         = 0;
+  ctx->emitter_buckets      = 0;
+  ctx->emitter_bucket_count = 0;
+  ctx->emitter_cell         = 0.f;
+  ctx->emitter_range        = 0.f;
+  ctx->emitter_active       = 0;
+  ctx->emitter_active_count = 0;
+  ctx->emitter_queue        = 0;
+
   ctx->layer_count    = 0;
   ctx->layer_capacity = layers;
   ctx->layer_high     = 0;
@@ -296,20 +420,108 @@ a_ctx* a_ctx_create(const char* device, uint8_t layers, uint16_t max_sfx,
     ctx->layer_names = (const char**)malloc(sizeof(char*) * layers);
 
     for (uint16_t i = 0; i < layers; ++i) {
-      ctx->layers[i].id = i + 1;
+      ctx->layers[i]      = (a_layer){0};
+      ctx->layers[i].id   = i + 1;
+      ctx->layers[i].gain = 1.f;
     }
   }
 
+#if !defined(ASTERA_NO_THREADS)
+  ctx->stream_thread   = 0;
+  ctx->stream_lock     = 0;
+  ctx->stream_interval = 0.0;
+  ctx->stream_quit     = 0;
+
+  ctx->audio_thread   = 0;
+  ctx->audio_interval = 0.0;
+  ctx->audio_quit     = 0;
+  ctx->cmds           = 0;
+  ctx->cmd_capacity   = 0;
+  ctx->cmd_head       = 0;
+  ctx->cmd_tail       = 0;
+#endif
+
   ctx->allow = 1;
   return ctx;
 }
 
+a_ctx* a_ctx_create(const char* device, uint8_t layers, uint16_t max_sfx,
+                    uint16_t max_buffers, uint16_t max_songs, uint16_t max_fx,
+                    uint16_t max_filters, uint32_t pcm_size) {
+  return a_ctx_open(alcOpenDevice(device), 0, layers, max_sfx, max_buffers,
+                    max_songs, max_fx, max_filters, pcm_size);
+}
+
+a_ctx* a_ctx_create_loopback(uint32_t frequency, uint8_t layers,
+                             uint16_t max_sfx, uint16_t max_buffers,
+                             uint16_t max_songs, uint16_t max_fx,
+                             uint16_t max_filters, uint32_t pcm_size) {
+  if (!alcIsExtensionPresent(0, "ALC_SOFT_loopback")) {
+    ASTERA_DBG("a_ctx_create_loopback: ALC_SOFT_loopback not supported.\n");
+    return 0;
+  }
+
+  alcLoopbackOpenDeviceSOFT = (LPALCLOOPBACKOPENDEVICESOFT)alcGetProcAddress(
+      0, "alcLoopbackOpenDeviceSOFT");
+  alcIsRenderFormatSupportedSOFT =
+      (LPALCISRENDERFORMATSUPPORTEDSOFT)alcGetProcAddress(
+          0, "alcIsRenderFormatSupportedSOFT");
+  alcRenderSamplesSOFT = (LPALCRENDERSAMPLESSOFT)alcGetProcAddress(
+      0, "alcRenderSamplesSOFT");
+
+  if (!alcLoopbackOpenDeviceSOFT || !alcIsRenderFormatSupportedSOFT ||
+      !alcRenderSamplesSOFT) {
+    ASTERA_DBG("a_ctx_create_loopback: unable to load loopback functions.\n");
+    return 0;
+  }
+
+  ALCdevice* al_device = alcLoopbackOpenDeviceSOFT(0);
+  if (!al_device) {
+    ASTERA_DBG("a_ctx_create_loopback: unable to open loopback device.\n");
+    return 0;
+  }
+
+  if (!alcIsRenderFormatSupportedSOFT(al_device, (ALCsizei)frequency,
+                                      ALC_STEREO_SOFT, ALC_FLOAT_SOFT)) {
+    ASTERA_DBG("a_ctx_create_loopback: can't render stereo float at %ihz.\n",
+               frequency);
+    alcCloseDevice(al_device);
+    return 0;
+  }
+
+  ALCint format[7] = {ALC_FORMAT_CHANNELS_SOFT,
+                      ALC_STEREO_SOFT,
+                      ALC_FORMAT_TYPE_SOFT,
+                      ALC_FLOAT_SOFT,
+                      ALC_FREQUENCY,
+                      (ALCint)frequency,
+                      0};
+
+  return a_ctx_open(al_device, format, layers, max_sfx, max_buffers, max_songs,
+                    max_fx, max_filters, pcm_size);
+}
+
+uint8_t a_ctx_render(a_ctx* ctx, float* dst, uint32_t frames) {
+  if (!ctx->loopback) {
+    ASTERA_DBG("a_ctx_render: context isn't a loopback context.\n");
+    return 0;
+  }
+
+  alcRenderSamplesSOFT(ctx->device, dst, (ALCsizei)frames);
+  return 1;
+}
+
 uint8_t a_ctx_destroy(a_ctx* ctx) {
   if (!ctx) {
     ASTERA_DBG("a_ctx_destroy: no context passed to destroy.\n");
     return 0;
   }
 
+#if !defined(ASTERA_NO_THREADS)
+  a_ctx_thread_stop(ctx);
+  a_ctx_stream_stop(ctx);
+#endif
+
   for (uint16_t i = 0; i < ctx->song_capacity; ++i) {
     a_song* song = &ctx->songs[i];
 
@@ -321,6 +533,12 @@ uint8_t a_ctx_destroy(a_ctx* ctx) {
 
     if (song->buffer_sizes)
       free(song->buffer_sizes);
+
+    if (song->pcm)
+      free(song->pcm);
+
+    if (song->seek_pages)
+      free(song->seek_pages);
   }
 
   if (ctx->fx_capacity && ctx->fx_slots) {
@@ -346,6 +564,29 @@ uint8_t a_ctx_destroy(a_ctx* ctx) {
   if (ctx->sfx)
     free(ctx->sfx);
 
+  if (ctx->voice_sources) {
+    alDeleteSources(ctx->voice_capacity, ctx->voice_sources);
+    free(ctx->voice_sources);
+  }
+
+  if (ctx->sfx_free)
+    free(ctx->sfx_free);
+
+  if (ctx->voices)
+    free(ctx->voices);
+
+  if (ctx->emitters)
+    free(ctx->emitters);
+
+  if (ctx->emitter_buckets)
+    free(ctx->emitter_buckets);
+
+  if (ctx->emitter_active)
+    free(ctx->emitter_active);
+
+  if (ctx->emitter_queue)
+    free(ctx->emitter_queue);
+
   if (ctx->layers) {
     for (uint32_t i = 0; i < ctx->layer_count; ++i) {
       if (ctx->layers[i].sfx_capacity > 0 && ctx->layers[i].sfx) {
@@ -372,266 +613,808 @@ uint8_t a_ctx_destroy(a_ctx* ctx) {
   return 1;
 }
 
-void a_song_update_decode(a_ctx* ctx, a_song* song) {
-  ALenum state;
-  ALint  proc;
+/* Publish a request's state & time, which the caller may read from
+ * another thread while the context is threaded */
+static inline void a_req_set_state(a_req* req, uint32_t state) {
+#if !defined(ASTERA_NO_THREADS)
+  s_atomic_store(&req->state, state);
+#else
+  req->state = state;
+#endif
+}
 
-  alGetSourcei(song->source, AL_SOURCE_STATE, &state);
-  alGetSourcei(song->source, AL_BUFFERS_PROCESSED, &proc);
+static inline void a_req_set_valid(a_req* req, uint32_t valid) {
+#if !defined(ASTERA_NO_THREADS)
+  s_atomic_store(&req->valid, valid);
+#else
+  req->valid = valid;
+#endif
+}
 
-  float sec_offset;
-  alGetSourcef(song->source, AL_SEC_OFFSET, &sec_offset);
+static inline void a_req_set_time(a_req* req, time_s time) {
+#if !defined(ASTERA_NO_THREADS)
+  if (sizeof(time_s) == sizeof(uint64_t)) {
+    uint64_t bits;
+    memcpy(&bits, &time, sizeof(uint64_t));
+    s_atomic_store64((volatile uint64_t*)&req->time, bits);
+  } else {
+    uint32_t bits;
+    memcpy(&bits, &time, sizeof(uint32_t));
+    s_atomic_store((volatile uint32_t*)&req->time, bits);
+  }
+#else
+  req->time = time;
+#endif
+}
 
-  song->delta     = song->curr + (sec_offset * 1000.f);
-  song->req->time = song->delta;
+/* The states of a sfx slot's claim
+ * FREE - nothing has the slot
+ * CLAIMED - taken for a sfx that hasn't started yet
+ * LIVE - playing (or virtual)
+ * STOLEN - playing, but promised to a sfx that's taking it over (threaded) */
+#define A_SFX_FREE    0
+#define A_SFX_CLAIMED 1
+#define A_SFX_LIVE    2
+#define A_SFX_STOLEN  3
+
+/* Mark whether a sfx slot is taken, slots are claimed by the caller (any
+ * thread) & released by whoever owns the OpenAL calls */
+static inline void a_sfx_set_claimed(a_sfx* sfx, uint32_t claimed) {
+#if !defined(ASTERA_NO_THREADS)
+  s_atomic_store(&sfx->claimed, claimed);
+#else
+  sfx->claimed = claimed;
+#endif
+}
 
-  if (proc > 0) {
-    uint32_t al_error;
-    uint32_t buffer, offset = stb_vorbis_get_sample_offset(song->vorbis);
+/* Keep a song's state for a_song_get_state, read from any thread */
+static inline void a_song_set_state(a_song* song, uint32_t state) {
+#if !defined(ASTERA_NO_THREADS)
+  s_atomic_store(&song->state, state);
+#else
+  song->state = state;
+#endif
+}
 
-    if (offset >= song->sample_count) {
-      if (song->req->loop) {
-        stb_vorbis_seek_start(song->vorbis);
-      } else {
-        return;
-      }
-    }
+/* Get the key voices are ranked by, priority then audibility (non-negative
+ * floats order the same as their bits) */
+static inline uint64_t a_rank_key(uint8_t priority, float audibility) {
+  uint32_t bits;
+  memcpy(&bits, &audibility, sizeof(uint32_t));
+  return ((uint64_t)priority << 32) | bits;
+}
 
-    for (uint8_t i = 0; i < proc; ++i) {
-      float buf_time =
-          (float)((float)song->buffer_sizes[0] / song->info.sample_rate) *
-          1000.f;
-      song->curr += buf_time;
+/* Publish a sfx's rank for a_sfx_play to steal by from other threads */
+static inline void a_sfx_set_rank(a_sfx* sfx) {
+#if !defined(ASTERA_NO_THREADS)
+  s_atomic_store64(&sfx->rank,
+                   a_rank_key(sfx->req->priority, sfx->audibility));
+#else
+  sfx->rank = a_rank_key(sfx->req->priority, sfx->audibility);
+#endif
+}
 
-      memset(ctx->pcm, 0, ctx->pcm_length * sizeof(uint16_t));
-      uint32_t pcm_total_length = 0;
+static uint8_t a_song_stop_now(a_ctx* ctx, uint16_t song_id);
+static void    a_emitters_update(a_ctx* ctx);
 
-      alSourceUnqueueBuffers(song->source, 1, &buffer);
-      for (uint16_t p = 0; p < song->packets_per_buffer; ++p) {
-        uint32_t pcm_remaining = ctx->pcm_length - pcm_total_length;
+/* Hold back source updates so they're applied together at a_defer_end */
+static inline void a_defer_begin(a_ctx* ctx) {
+  if (alDeferUpdatesSOFT && alProcessUpdatesSOFT) {
+    alDeferUpdatesSOFT();
+  } else {
+    alcSuspendContext(ctx->context);
+  }
+}
 
-        if (pcm_remaining < song->info.max_frame_size) {
-          break;
-        }
+static inline void a_defer_end(a_ctx* ctx) {
+  if (alDeferUpdatesSOFT && alProcessUpdatesSOFT) {
+    alProcessUpdatesSOFT();
+  } else {
+    alcProcessContext(ctx->context);
+  }
+}
 
-        if (pcm_remaining == 0) {
-          break;
-        }
+/* Get the gain of the layer a sound/song is on, 1 if it's on none */
+static inline float a_layer_gain(a_ctx* ctx, uint16_t layer_id) {
+  if (!layer_id || layer_id > ctx->layer_capacity) {
+    return 1.f;
+  }
+
+  return ctx->layers[layer_id - 1].gain;
+}
 
-        uint32_t num_samples = stb_vorbis_get_samples_short_interleaved(
-            song->vorbis, song->channels, ctx->pcm + pcm_total_length,
-            pcm_remaining);
+/* Push a request's parameters to a source, only those changed since they
+ * were last applied unless forced
+ * applied - the values last applied to the source
+ * layer_gain - the gain of the layer the source is on
+ * use_loop - if the source loops itself (songs loop by decoding) */
+static void a_source_sync(uint32_t source, a_params* applied, a_req* req,
+                          float layer_gain, uint8_t use_loop, uint8_t force) {
+  float gain = req->gain * layer_gain;
+
+  if (force || applied->gain != gain) {
+    alSourcef(source, AL_GAIN, gain);
+    applied->gain = gain;
+  }
 
-        if (num_samples > 0) {
-          int32_t sample_count = song->channels * num_samples;
-          pcm_total_length += sample_count;
-        }
+  if (force || !vec3_cmp(applied->position, req->position)) {
+    alSource3f(source, AL_POSITION, req->position[0], req->position[1],
+               req->position[2]);
+    vec3_dup(applied->position, req->position);
+  }
 
-        for (uint8_t i = 0; i < song->buffer_count - 1; ++i) {
-          song->buffer_sizes[i] = song->buffer_sizes[i + 1];
-        }
+  if (force || !vec3_cmp(applied->velocity, req->velocity)) {
+    alSource3f(source, AL_VELOCITY, req->velocity[0], req->velocity[1],
+               req->velocity[2]);
+    vec3_dup(applied->velocity, req->velocity);
+  }
 
-        song->buffer_sizes[song->buffer_count - 1] = num_samples;
-      }
+  if (force || applied->range != req->range) {
+    alSourcef(source, AL_MAX_DISTANCE, req->range);
+    applied->range = req->range;
+  }
 
-      stb_vorbis_info info = stb_vorbis_get_info(song->vorbis);
+  if (use_loop && (force || applied->loop != req->loop)) {
+    alSourcei(source, AL_LOOPING, req->loop);
+    applied->loop = req->loop;
+  }
+}
 
-      alBufferData(buffer, song->format, ctx->pcm,
-                   pcm_total_length * sizeof(uint16_t), info.sample_rate);
-      alSourceQueueBuffers(song->source, 1, &buffer);
+/* Get the gain a listener at origin would hear a sound at, anything further
+ * than its range counts as inaudible (inverse distance, reference distance
+ * of 1) */
+static float a_audibility(a_req* req, float layer_gain, vec3 origin) {
+  float gain = req->gain * layer_gain;
 
-      if ((al_error = alGetError()) == AL_INVALID_VALUE) {
-        ASTERA_DBG("a_song_update_decode: AL Error %i\n", al_error);
-      }
-    }
+  if (req->range <= 0.f) {
+    return gain;
   }
 
-  if (proc == song->buffer_count && state == AL_PLAYING) {
-    alSourcePlay(song->source);
+  vec3 offset;
+  vec3_sub(offset, req->position, origin);
+  float distance = vec3_len(offset);
+
+  if (distance > req->range) {
+    return 0.f;
+  } else if (distance <= 1.f) {
+    return gain;
   }
+
+  return gain / (1.f + ASTERA_AL_ROLLOFF_FACTOR * (distance - 1.f));
 }
 
-void a_ctx_update(a_ctx* ctx) {
-  for (uint16_t i = 0; i < ctx->song_capacity; ++i) {
-    a_song* song = &ctx->songs[i];
-    if (!song)
-      continue;
+static float a_sfx_audibility(a_ctx* ctx, a_req* req, uint16_t layer) {
+  return a_audibility(req, a_layer_gain(ctx, layer), ctx->voice_origin);
+}
 
-    if (song->req) {
-      if (song->req->stop) {
-        a_song_stop(ctx, song->id);
-        continue;
-      }
+/* Rank voices highest priority, then most audible first (qsort order) */
+static int a_voice_compare(const void* a, const void* b) {
+  const a_voice* voice_a = (const a_voice*)a;
+  const a_voice* voice_b = (const a_voice*)b;
 
-      ALenum state;
-      alGetSourcei(song->source, AL_SOURCE_STATE, &state);
+  if (voice_a->priority != voice_b->priority) {
+    return (voice_a->priority < voice_b->priority) ? 1 : -1;
+  }
+
+  return (voice_a->audibility < voice_b->audibility) -
+         (voice_a->audibility > voice_b->audibility);
+}
 
-      song->req->state = state;
+uint16_t a_ctx_get_voice_count(a_ctx* ctx) {
+  return ctx->voice_capacity - ctx->voice_free;
+}
 
-      if (state == AL_PLAYING) {
-        a_song_update_decode(ctx, song);
-        alSourcef(song->source, AL_GAIN, song->req->gain);
-        alSource3f(song->source, AL_POSITION, song->req->position[0],
-                   song->req->position[1], song->req->position[2]);
-        alSource3f(song->source, AL_VELOCITY, song->req->velocity[0],
-                   song->req->velocity[1], song->req->velocity[2]);
-        alSourcef(song->source, AL_MAX_DISTANCE, song->req->range);
+uint16_t a_ctx_set_voice_limit(a_ctx* ctx, uint16_t limit) {
+  ctx->voice_limit = (limit < ctx->voice_capacity) ? limit : ctx->voice_capacity;
+  return ctx->voice_limit;
+}
+
+/* Give a virtual sfx a source, playing from where its virtual time is at
+ * returns: 1 = success, 0 = no source available */
+static uint8_t a_sfx_promote(a_ctx* ctx, a_sfx* sfx) {
+  if (!ctx->voice_free || a_ctx_get_voice_count(ctx) >= ctx->voice_limit) {
+    return 0;
+  }
+
+  a_buf* buf = a_buf_get_id(ctx, sfx->buffer);
+  if (!buf) {
+    return 0;
+  }
+
+  a_req*   req    = sfx->req;
+  uint32_t source = ctx->voice_sources[--ctx->voice_free];
+
+  alSourcei(source, AL_BUFFER, buf->buf);
+
+  // Apply fx, each one through its own send
+  if (req->fx_count > 0) {
+    for (uint16_t i = 0; i < req->fx_count && i < ctx->fx_per_source; ++i) {
+      // Make sure it's a created effect
+      if (req->fx[i] && req->fx[i] <= ctx->fx_high &&
+          ctx->fx_slots[req->fx[i] - 1].slot_id) {
+        alSource3i(source, AL_AUXILIARY_SEND_FILTER,
+                   (ALint)ctx->fx_slots[req->fx[i] - 1].slot_id, i, 0);
       }
     }
   }
 
-  uint32_t sfx_count = 0, sfx_high = 0;
-  for (uint16_t i = 0; i < ctx->sfx_capacity; ++i) {
-    a_sfx* sfx = &ctx->sfx[i];
+  // Apply filters
+  if (req->filter_count > 0) {
+    for (uint16_t i = 0; i < req->filter_count; ++i) {
+      // Make sure it's a created filter
+      if (req->filters[i] && req->filters[i] - 1 <= ctx->filter_high &&
+          req->filters[i] <= ctx->filter_capacity &&
+          ctx->filter_slots[req->filters[i] - 1].al_id) {
+        alSourcei(source, AL_DIRECT_FILTER,
+                  ctx->filter_slots[req->filters[i] - 1].al_id);
+      }
+    }
+  }
 
-    if (!sfx)
-      continue;
+  a_source_sync(source, &sfx->applied, req, a_layer_gain(ctx, sfx->layer), 1,
+                1);
 
-    if (!sfx->buffer || !sfx->req || !sfx->source) {
-      continue;
-    }
+  alSourcef(source, AL_SEC_OFFSET, sfx->time);
+  alSourcePlay(source);
 
-    if (!sfx->req)
-      continue;
+  sfx->source = source;
+  return 1;
+}
 
-    ALenum state;
-    alGetSourcei(sfx->source, AL_SOURCE_STATE, &state);
+/* Take a sfx's source back for another sfx to use */
+static void a_sfx_free_source(a_ctx* ctx, a_sfx* sfx) {
+  alSourceStop(sfx->source);
+  alSourcei(sfx->source, AL_BUFFER, 0);
 
-    int8_t remove = state == AL_STOPPED || sfx->req->stop;
+  // Don't let the next sfx inherit the effects
+  if (sfx->req && (sfx->req->fx_count || sfx->req->filter_count)) {
+    alSourcei(sfx->source, AL_DIRECT_FILTER, 0);
+    for (uint16_t i = 0; i < sfx->req->fx_count; ++i) {
+      alSource3i(sfx->source, AL_AUXILIARY_SEND_FILTER, 0, i, 0);
+    }
+  }
 
-    if (remove) {
-      --ctx->sfx_count;
+  ctx->voice_sources[ctx->voice_free++] = sfx->source;
+  sfx->source                           = 0;
+}
 
-      if (sfx->req) {
-        sfx->req->valid = 0;
-        sfx->req->state = AL_STOPPED;
-      }
+/* Make a sfx virtual, it carries on from where the source was at */
+static void a_sfx_demote(a_ctx* ctx, a_sfx* sfx) {
+  float offset = 0.f;
+  alGetSourcef(sfx->source, AL_SEC_OFFSET, &offset);
+  sfx->time = offset;
 
-      sfx->req    = 0;
-      sfx->buffer = 0;
-      sfx->length = 0;
+  a_sfx_free_source(ctx, sfx);
+}
 
-      alSourceStop(sfx->source);
-      alSourcei(sfx->source, AL_BUFFER, 0);
+/* Stop a sfx, leaving its slot claimed */
+static void a_sfx_clear(a_ctx* ctx, a_sfx* sfx) {
+  if (sfx->source) {
+    a_sfx_free_source(ctx, sfx);
+  }
 
-      continue;
-    } else {
-      if (i > ctx->sfx_high) {
-        ctx->sfx_high = i;
-      }
+  if (sfx->req) {
+    a_req_set_valid(sfx->req, 0);
+    a_req_set_state(sfx->req, AL_STOPPED);
+  }
 
-      ++sfx_count;
-      sfx_high = i;
-    }
+  sfx->req    = 0;
+  sfx->buffer = 0;
+  sfx->length = 0;
+  sfx->paused = 0;
 
-    float gain = sfx->req->gain;
+  --ctx->sfx_count;
+}
 
-    alSourcef(sfx->source, AL_GAIN, sfx->req->gain);
-    alSource3f(sfx->source, AL_POSITION, sfx->req->position[0],
-               sfx->req->position[1], sfx->req->position[2]);
-    alSource3f(sfx->source, AL_VELOCITY, sfx->req->velocity[0],
-               sfx->req->velocity[1], sfx->req->velocity[2]);
-    alSourcef(sfx->source, AL_MAX_DISTANCE, sfx->req->range);
-    alSourcei(sfx->source, AL_LOOPING, sfx->req->loop);
+/* Stop a sfx & free its slot */
+static void a_sfx_release(a_ctx* ctx, a_sfx* sfx) {
+  a_sfx_clear(ctx, sfx);
 
-    uint32_t sample_offset;
-    alGetSourcei(sfx->source, AL_SAMPLE_OFFSET, &sample_offset);
-    if (sample_offset >= sfx->length) {
-      if (sfx->req->loop)
-        ++sfx->req->loop_count;
+#if !defined(ASTERA_NO_THREADS)
+  // Threaded slots are claimed by their flag instead (see a_sfx_play), one
+  // promised to a_sfx_play goes to the sfx that stole it
+  if (a_ctx_threaded(ctx)) {
+    if (!s_atomic_cas(&sfx->claimed, A_SFX_LIVE, A_SFX_FREE)) {
+      a_sfx_set_claimed(sfx, A_SFX_CLAIMED);
     }
-
-    alGetSourcef(sfx->source, AL_SEC_OFFSET, &sfx->req->time);
+    return;
   }
+#endif
 
-  ctx->sfx_count = sfx_count;
-  ctx->sfx_high  = sfx_high;
+  ctx->sfx_free[ctx->sfx_free_count++] = sfx->id - 1;
+  a_sfx_set_claimed(sfx, A_SFX_FREE);
+}
 
-  // Update the layer's gain
-  for (uint16_t i = 0; i < ctx->layer_high; ++i) {
-    a_layer* layer = &ctx->layers[i];
+/* Take the lowest ranked sfx's slot, if a request outranks it (owner of the
+ * OpenAL calls only)
+ * returns: the slot taken (left claimed), 0 = nothing ranks lower */
+static a_sfx* a_sfx_steal(a_ctx* ctx, uint16_t layer, a_req* req) {
+  a_voice incoming = (a_voice){.audibility = a_sfx_audibility(ctx, req, layer),
+                               .priority   = req->priority};
+  a_voice lowest   = (a_voice){0};
+  a_sfx*  victim   = 0;
 
-    if (ctx->layers[i].sfx) {
-      for (uint16_t j = 0; j < layer->sfx_count; ++j) {
-        if (layer->sfx[j]->req) {
-          alSourcef(layer->sfx[j]->source, AL_GAIN,
-                    layer->gain * layer->sfx[j]->req->gain);
-        }
-      }
+  for (uint16_t i = 0; i < ctx->sfx_capacity; ++i) {
+    a_sfx* sfx = &ctx->sfx[i];
+    if (!sfx->buffer || !sfx->req || sfx->claimed != A_SFX_LIVE) {
+      continue;
     }
 
-    if (ctx->layers[i].songs) {
-      for (uint16_t j = 0; j < layer->song_count; ++j) {
-        if (layer->songs[j]->req) {
-          alSourcef(layer->songs[j]->source, AL_GAIN,
-                    layer->gain * layer->songs[j]->req->gain);
-        }
-      }
+    a_voice rank = (a_voice){.audibility = sfx->audibility,
+                             .priority   = sfx->req->priority};
+    if (!victim || a_voice_compare(&rank, &lowest) > 0) {
+      victim = sfx;
+      lowest = rank;
     }
   }
-}
 
-uint16_t a_ctx_layer_create(a_ctx* ctx, const char* name, uint16_t max_sfx,
-                            uint16_t max_songs) {
-  if (ctx->layer_count == ctx->layer_capacity) {
-    ASTERA_DBG("a_ctx_layer_create: no free layer slots.\n");
+  if (!victim || a_voice_compare(&incoming, &lowest) >= 0) {
     return 0;
   }
 
-  if (!max_sfx && !max_songs) {
-    ASTERA_DBG("a_ctx_layer_create: not going to create a completely empty "
-               "layer.\n");
+#if !defined(ASTERA_NO_THREADS)
+  // a_sfx_play might be promising it to another sfx
+  if (a_ctx_threaded(ctx) &&
+      !s_atomic_cas(&victim->claimed, A_SFX_LIVE, A_SFX_CLAIMED)) {
     return 0;
   }
+#endif
 
-  a_layer* layer = 0;
+  a_sfx_clear(ctx, victim);
 
-  for (uint16_t i = 0; i < ctx->layer_high; ++i) {
-    if (!ctx->layers[i].songs && !ctx->layers[i].sfx) {
-      layer = &ctx->layers[i];
-      break;
-    }
-  }
+  return victim;
+}
 
-  int8_t new_high = 0;
-  if (!layer && ctx->layer_high < ctx->layer_capacity) {
-    layer    = &ctx->layers[ctx->layer_high];
-    new_high = 1;
-  } else {
-    ctx->layer_count = ctx->layer_capacity;
-    ASTERA_DBG("a_ctx_layer_create: no free layer slots.\n");
-    return 0;
-  }
+/* Give the highest ranked sfx the sources, the rest go virtual
+ * count - the amount of active sfx in ctx->voices */
+static void a_sfx_assign(a_ctx* ctx, uint32_t count) {
+  uint32_t limit = ctx->voice_limit;
 
-  layer->sfx_capacity = max_sfx;
-  layer->sfx_count    = 0;
-  if (max_sfx) {
-    layer->sfx = (a_sfx**)malloc(sizeof(a_sfx*) * max_sfx);
+  // Only rank them if there's not enough sources to go around
+  if (count > limit) {
+    qsort(ctx->voices, count, sizeof(a_voice), a_voice_compare);
   }
 
-  layer->song_capacity = max_songs;
-  layer->song_count    = 0;
-  if (max_songs) {
-    layer->songs = (a_song**)malloc(sizeof(a_song*) * max_songs);
+  // Demote first so the sources are free to promote with
+  for (uint32_t i = 0; i < count; ++i) {
+    a_sfx*  sfx     = &ctx->sfx[ctx->voices[i].index];
+    uint8_t audible = ctx->voices[i].audibility >= ASTERA_SFX_AUDIBLE_GAIN;
+
+    if (sfx->source && (i >= limit || !audible)) {
+      a_sfx_demote(ctx, sfx);
+    }
   }
 
-  layer->gain        = 1.f;
-  layer->gain_change = 0;
+  for (uint32_t i = 0; i < count && i < limit; ++i) {
+    a_sfx*  sfx     = &ctx->sfx[ctx->voices[i].index];
+    uint8_t audible = ctx->voices[i].audibility >= ASTERA_SFX_AUDIBLE_GAIN;
 
-  if (new_high) {
-    ctx->layer_high = layer->id - 1;
+    if (!sfx->source && audible) {
+      a_sfx_promote(ctx, sfx);
+    }
   }
-
-  ++ctx->layer_count;
-  return layer->id;
 }
 
-uint16_t a_sfx_play(a_ctx* ctx, uint16_t layer, uint16_t buf_id, a_req* req) {
-  if (ctx->sfx_count == ctx->sfx_capacity) {
-    ASTERA_DBG("a_sfx_play: no free sfx slots.\n");
+/* Lock the songs against the stream thread (if running) */
+static inline void a_stream_lock(a_ctx* ctx) {
+#if !defined(ASTERA_NO_THREADS)
+  if (ctx->stream_thread) {
+    s_mutex_lock(ctx->stream_lock);
+  }
+#else
+  (void)ctx;
+#endif
+}
+
+static inline void a_stream_unlock(a_ctx* ctx) {
+#if !defined(ASTERA_NO_THREADS)
+  if (ctx->stream_thread) {
+    s_mutex_unlock(ctx->stream_lock);
+  }
+#else
+  (void)ctx;
+#endif
+}
+
+/* Decode the next packets of a song into its PCM & queue them in a buffer
+ * returns: the amount of samples (per channel) queued */
+static uint32_t a_song_fill(a_song* song, uint32_t buffer) {
+  uint32_t pcm_total_length = 0, frames = 0;
+
+  for (uint16_t p = 0; p < song->packets_per_buffer; ++p) {
+    uint32_t pcm_remaining = song->pcm_length - pcm_total_length;
+
+    if ((pcm_remaining / song->channels) < (uint32_t)song->info.max_frame_size) {
+      break;
+    }
+
+    int32_t num_samples = stb_vorbis_get_samples_short_interleaved(
+        song->vorbis, song->channels, (short*)song->pcm + pcm_total_length,
+        pcm_remaining);
+
+    if (num_samples <= 0) {
+      break;
+    }
+
+    pcm_total_length += song->channels * num_samples;
+    frames += num_samples;
+  }
+
+  // buffer_sizes holds the samples of each queued buffer, oldest first
+  for (uint8_t i = 0; i < song->buffer_count - 1; ++i) {
+    song->buffer_sizes[i] = song->buffer_sizes[i + 1];
+  }
+  song->buffer_sizes[song->buffer_count - 1] = frames;
+
+  alBufferData(buffer, song->format, song->pcm,
+               pcm_total_length * sizeof(uint16_t), song->info.sample_rate);
+  alSourceQueueBuffers(song->source, 1, &buffer);
+
+  return frames;
+}
+
+void a_song_update_decode(a_ctx* ctx, a_song* song) {
+  (void)ctx;
+
+  ALenum state;
+  ALint  proc;
+
+  alGetSourcei(song->source, AL_SOURCE_STATE, &state);
+  alGetSourcei(song->source, AL_BUFFERS_PROCESSED, &proc);
+
+  float sec_offset;
+  alGetSourcef(song->source, AL_SEC_OFFSET, &sec_offset);
+
+  song->delta     = song->curr + (sec_offset * 1000.f);
+  a_req_set_time(song->req, song->delta);
+
+  if (proc > 0) {
+    uint32_t al_error;
+    uint32_t buffer, offset = stb_vorbis_get_sample_offset(song->vorbis);
+
+    if (offset >= song->sample_count) {
+      if (song->req->loop) {
+        stb_vorbis_seek_start(song->vorbis);
+      } else {
+        // Done once the last buffers have played out
+        if (state != AL_PLAYING) {
+          song->playing = 0;
+        }
+        return;
+      }
+    }
+
+    for (uint8_t i = 0; i < proc; ++i) {
+      float buf_time =
+          (float)((float)song->buffer_sizes[0] / song->info.sample_rate) *
+          1000.f;
+      song->curr += buf_time;
+
+      alSourceUnqueueBuffers(song->source, 1, &buffer);
+      a_song_fill(song, buffer);
+
+      if ((al_error = alGetError()) == AL_INVALID_VALUE) {
+        ASTERA_DBG("a_song_update_decode: AL Error %i\n", al_error);
+      }
+    }
+  }
+
+  // The source stops if every buffer played before they were refilled
+  if (song->playing && state != AL_PLAYING) {
+    alSourcePlay(song->source);
+  }
+}
+
+static void a_ctx_update_now(a_ctx* ctx) {
+  for (uint16_t i = 0; i < ctx->song_capacity; ++i) {
+    a_song* song = &ctx->songs[i];
+    if (!song)
+      continue;
+
+    if (song->req) {
+      if (song->req->stop) {
+        a_song_stop_now(ctx, song->id);
+        continue;
+      }
+
+      ALenum state;
+      alGetSourcei(song->source, AL_SOURCE_STATE, &state);
+
+      // A source that ran dry is still playing as far as the request goes
+      state = (song->playing) ? AL_PLAYING : state;
+      a_req_set_state(song->req, state);
+      a_song_set_state(song, state);
+
+      // The stream thread keeps the song decoded if it's running
+      if (song->playing && !a_ctx_streaming(ctx)) {
+        a_song_update_decode(ctx, song);
+      }
+    }
+  }
+
+  // Virtual sfx keep time with the update rate
+  time_s now = s_get_time();
+  float  delta =
+      (ctx->voice_time > 0.0) ? (float)((now - ctx->voice_time) / MS_TO_SEC)
+                              : 0.f;
+  ctx->voice_time = now;
+
+  // Start/stop emitters as the listener moves, before the sfx are ranked
+  a_emitters_update(ctx);
+
+  uint32_t sfx_count = 0, sfx_high = 0, active = 0;
+  for (uint16_t i = 0; i < ctx->sfx_capacity; ++i) {
+    a_sfx* sfx = &ctx->sfx[i];
+
+    if (!sfx->buffer || !sfx->req) {
+      continue;
+    }
+
+    uint8_t remove = sfx->req->stop;
+
+    if (sfx->source) {
+      ALenum state;
+      alGetSourcei(sfx->source, AL_SOURCE_STATE, &state);
+      a_req_set_state(sfx->req, state);
+
+      if (state == AL_STOPPED) {
+        remove = 1;
+      } else {
+        float sec_offset;
+        alGetSourcef(sfx->source, AL_SEC_OFFSET, &sec_offset);
+
+        // The offset only goes backwards when the source looped
+        if (sec_offset < sfx->time && sfx->req->loop) {
+          ++sfx->req->loop_count;
+        }
+
+        sfx->time = sec_offset;
+      }
+    } else if (!sfx->paused) {
+      sfx->time += delta;
+
+      if (sfx->time >= sfx->duration) {
+        if (sfx->req->loop && sfx->duration > 0.f) {
+          sfx->time = fmodf(sfx->time, sfx->duration);
+          ++sfx->req->loop_count;
+        } else {
+          remove = 1;
+        }
+      }
+
+      a_req_set_state(sfx->req, AL_PLAYING);
+    }
+
+    if (remove) {
+      a_sfx_release(ctx, sfx);
+      continue;
+    }
+
+    a_req_set_time(sfx->req, sfx->time);
+
+    sfx->audibility = a_sfx_audibility(ctx, sfx->req, sfx->layer);
+    a_sfx_set_rank(sfx);
+
+    // Paused sfx hold no source, so they're left out of the ranking
+    if (!sfx->paused) {
+      ctx->voices[active] = (a_voice){.audibility = sfx->audibility,
+                                      .index      = i,
+                                      .priority   = sfx->req->priority};
+      ++active;
+    }
+
+    ++sfx_count;
+    sfx_high = i;
+  }
+
+  ctx->sfx_count = sfx_count;
+  ctx->sfx_high  = sfx_high;
+
+  // Push only what changed since the last update (including layer gains),
+  // applied together as one batch along with any voices changing hands
+  a_defer_begin(ctx);
+
+  a_sfx_assign(ctx, active);
+
+  for (uint16_t i = 0; i < ctx->song_capacity; ++i) {
+    a_song* song = &ctx->songs[i];
+
+    if (song->req && song->req->state == AL_PLAYING) {
+      a_source_sync(song->source, &song->applied, song->req,
+                    a_layer_gain(ctx, song->layer), 0, 0);
+    }
+  }
+
+  for (uint16_t i = 0; i < ctx->sfx_capacity; ++i) {
+    a_sfx* sfx = &ctx->sfx[i];
+
+    if (sfx->req && sfx->buffer && sfx->source) {
+      a_source_sync(sfx->source, &sfx->applied, sfx->req,
+                    a_layer_gain(ctx, sfx->layer), 1, 0);
+    }
+  }
+
+  a_defer_end(ctx);
+}
+
+uint8_t a_ctx_streaming(a_ctx* ctx) {
+#if !defined(ASTERA_NO_THREADS)
+  return ctx->stream_thread != 0;
+#else
+  (void)ctx;
+  return 0;
+#endif
+}
+
+#if !defined(ASTERA_NO_THREADS)
+static void a_stream_thread(void* data) {
+  a_ctx* ctx = (a_ctx*)data;
+
+  while (1) {
+    time_s start = s_get_time();
+
+    s_mutex_lock(ctx->stream_lock);
+    uint8_t quit = ctx->stream_quit;
+    s_mutex_unlock(ctx->stream_lock);
+
+    if (quit) {
+      break;
+    }
+
+    // Lock per song so the caller isn't held up by every song's decoding
+    for (uint16_t i = 0; i < ctx->song_high; ++i) {
+      a_song* song = &ctx->songs[i];
+
+      s_mutex_lock(ctx->stream_lock);
+      // Serviced by intent, a starved source has stopped until it's refilled
+      if (song->req && song->vorbis && song->playing && !song->req->stop) {
+        a_song_update_decode(ctx, song);
+      }
+      s_mutex_unlock(ctx->stream_lock);
+    }
+
+    time_s remaining = ctx->stream_interval - (s_get_time() - start);
+    if (remaining > 0.0) {
+      s_sleep(remaining);
+    }
+  }
+}
+
+uint8_t a_ctx_stream_start(a_ctx* ctx, time_s interval) {
+  if (ctx->stream_thread) {
+    ASTERA_DBG("a_ctx_stream_start: already streaming.\n");
+    return 0;
+  }
+
+  if (interval <= 0.0) {
+    ASTERA_DBG("a_ctx_stream_start: interval must be above 0.\n");
+    return 0;
+  }
+
+  ctx->stream_lock = s_mutex_create();
+  if (!ctx->stream_lock) {
+    ASTERA_DBG("a_ctx_stream_start: unable to create lock.\n");
+    return 0;
+  }
+
+  ctx->stream_interval = interval;
+  ctx->stream_quit     = 0;
+  ctx->stream_thread   = s_thread_create(a_stream_thread, ctx);
+
+  if (!ctx->stream_thread) {
+    ASTERA_DBG("a_ctx_stream_start: unable to create thread.\n");
+    s_mutex_destroy(ctx->stream_lock);
+    ctx->stream_lock = 0;
+    return 0;
+  }
+
+  return 1;
+}
+
+void a_ctx_stream_stop(a_ctx* ctx) {
+  if (!ctx->stream_thread) {
+    return;
+  }
+
+  s_mutex_lock(ctx->stream_lock);
+  ctx->stream_quit = 1;
+  s_mutex_unlock(ctx->stream_lock);
+
+  s_thread_join(ctx->stream_thread);
+  ctx->stream_thread = 0;
+
+  s_mutex_destroy(ctx->stream_lock);
+  ctx->stream_lock = 0;
+}
+#endif
+
+uint16_t a_ctx_layer_create(a_ctx* ctx, const char* name, uint16_t max_sfx,
+                            uint16_t max_songs) {
+  if (ctx->layer_count == ctx->layer_capacity) {
+    ASTERA_DBG("a_ctx_layer_create: no free layer slots.\n");
+    return 0;
+  }
+
+  if (!max_sfx && !max_songs) {
+    ASTERA_DBG("a_ctx_layer_create: not going to create a completely empty "
+               "layer.\n");
+    return 0;
+  }
+
+  a_layer* layer = 0;
+
+  for (uint16_t i = 0; i < ctx->layer_high; ++i) {
+    if (!ctx->layers[i].songs && !ctx->layers[i].sfx) {
+      layer = &ctx->layers[i];
+      break;
+    }
+  }
+
+  int8_t new_high = 0;
+  if (!layer && ctx->layer_high < ctx->layer_capacity) {
+    layer    = &ctx->layers[ctx->layer_high];
+    new_high = 1;
+  } else {
+    ctx->layer_count = ctx->layer_capacity;
+    ASTERA_DBG("a_ctx_layer_create: no free layer slots.\n");
     return 0;
   }
 
+  layer->sfx_capacity = max_sfx;
+  layer->sfx_count    = 0;
+  if (max_sfx) {
+    layer->sfx = (a_sfx**)malloc(sizeof(a_sfx*) * max_sfx);
+  }
+
+  layer->song_capacity = max_songs;
+  layer->song_count    = 0;
+  if (max_songs) {
+    layer->songs = (a_song**)malloc(sizeof(a_song*) * max_songs);
+  }
+
+  layer->gain = 1.f;
+
+  if (new_high) {
+    ctx->layer_high = layer->id - 1;
+  }
+
+  ++ctx->layer_count;
+  return layer->id;
+}
+
+/* Start a sfx playing in a slot, it gets a source right away if one is
+ * free, otherwise the next update decides if it's worth one */
+static void a_sfx_start(a_ctx* ctx, uint16_t layer, a_sfx* slot, a_buf* buf,
+                        a_req* req) {
+  slot->buffer   = buf->id;
+  slot->length   = buf->length;
+  slot->duration = (buf->sample_rate) ? (float)buf->length / buf->sample_rate
+                                      : 0.f;
+  slot->req      = req;
+  slot->layer    = layer;
+  slot->time     = 0.f;
+  slot->paused   = 0;
+
+  slot->audibility = a_sfx_audibility(ctx, req, layer);
+
+  a_req_set_valid(req, 1);
+  a_req_set_state(req, AL_PLAYING);
+
+  a_sfx_set_claimed(slot, A_SFX_LIVE);
+  a_sfx_set_rank(slot);
+  ++ctx->sfx_count;
+
+  if (slot->id - 1 > ctx->sfx_high) {
+    ctx->sfx_high = slot->id - 1;
+  }
+
+  if (slot->audibility >= ASTERA_SFX_AUDIBLE_GAIN) {
+    a_sfx_promote(ctx, slot);
+  }
+}
+
+static uint16_t a_sfx_play_now(a_ctx* ctx, uint16_t layer, uint16_t buf_id,
+                               a_req* req) {
   a_buf* buf = a_buf_get_id(ctx, buf_id);
   if (!buf) {
     ASTERA_DBG("a_sfx_play: unable to find %i\n", buf_id);
@@ -639,38 +1422,952 @@ uint16_t a_sfx_play(a_ctx* ctx, uint16_t layer, uint16_t buf_id, a_req* req) {
   }
 
   a_sfx* slot = 0;
-  for (uint16_t i = 0; i < ctx->sfx_capacity; ++i) {
-    if (ctx->sfx[i].source) {
-      uint32_t buffer_id;
-      alGetSourcei(ctx->sfx[i].source, AL_BUFFER, &buffer_id);
-      if (buffer_id == 0) {
+  if (a_ctx_threaded(ctx)) {
+#if !defined(ASTERA_NO_THREADS)
+    // Emitters start on the audio thread, claim by flag like a_sfx_play
+    for (uint16_t i = 0; i < ctx->sfx_capacity; ++i) {
+      if (s_atomic_cas(&ctx->sfx[i].claimed, A_SFX_FREE, A_SFX_CLAIMED)) {
         slot = &ctx->sfx[i];
         break;
       }
-    } else {
-      slot = &ctx->sfx[i];
-      break;
     }
+#endif
+  } else if (ctx->sfx_free_count) {
+    slot = &ctx->sfx[ctx->sfx_free[--ctx->sfx_free_count]];
+  }
+
+  if (!slot) {
+    slot = a_sfx_steal(ctx, layer, req);
+  }
+
+  if (!slot) {
+    ASTERA_DBG("a_sfx_play: no free sfx slots.\n");
+    return 0;
+  }
+
+  a_sfx_start(ctx, layer, slot, buf, req);
+
+  return slot->id;
+}
+
+/* Get an active sfx by ID
+ * returns: the sfx, 0 = not playing */
+static a_sfx* a_sfx_get_active(a_ctx* ctx, uint16_t sfx_id) {
+  if (!sfx_id || sfx_id > ctx->sfx_capacity) {
+    return 0;
   }
 
-  if (!slot) {
-    ASTERA_DBG("No slots open, really.\n");
-    return 0;
+  a_sfx* sfx = &ctx->sfx[sfx_id - 1];
+  return (sfx->buffer && sfx->req) ? sfx : 0;
+}
+
+static uint8_t a_sfx_remove_now(a_ctx* ctx, uint16_t sfx_id) {
+  a_sfx* sfx = a_sfx_get_active(ctx, sfx_id);
+  if (!sfx) {
+    ASTERA_DBG("a_sfx_remove: no sfx in slot %i\n", sfx_id);
+    return 0;
+  }
+
+  a_sfx_release(ctx, sfx);
+  return 1;
+}
+
+static uint8_t a_sfx_stop_now(a_ctx* ctx, uint16_t sfx_id) {
+  a_sfx* sfx = a_sfx_get_active(ctx, sfx_id);
+  if (!sfx) {
+    ASTERA_DBG("a_sfx_stop: no sfx in slot %i\n", sfx_id);
+    return 0;
+  }
+
+  a_sfx_release(ctx, sfx);
+  return 1;
+}
+
+static uint8_t a_sfx_pause_now(a_ctx* ctx, uint16_t sfx_id) {
+  a_sfx* sfx = a_sfx_get_active(ctx, sfx_id);
+  if (!sfx) {
+    ASTERA_DBG("a_sfx_pause: no sfx in slot %i\n", sfx_id);
+    return 0;
+  }
+
+  sfx->paused = 1;
+
+  // Give the source to an audible sfx, it picks back up from here on resume
+  if (sfx->source) {
+    a_sfx_demote(ctx, sfx);
+  }
+
+  a_req_set_state(sfx->req, AL_PAUSED);
+
+  return 1;
+}
+
+static uint8_t a_sfx_resume_now(a_ctx* ctx, uint16_t sfx_id) {
+  a_sfx* sfx = a_sfx_get_active(ctx, sfx_id);
+  if (!sfx) {
+    ASTERA_DBG("a_sfx_resume: no sfx in slot %i\n", sfx_id);
+    return 0;
+  }
+
+  sfx->paused = 0;
+
+  if (!sfx->source && sfx->audibility >= ASTERA_SFX_AUDIBLE_GAIN) {
+    a_sfx_promote(ctx, sfx);
+  }
+
+  a_req_set_state(sfx->req, AL_PLAYING);
+
+  return 1;
+}
+
+uint8_t a_ctx_emitters_create(a_ctx* ctx, uint16_t max_emitters,
+                              float cell_size) {
+  if (ctx->emitters) {
+    ASTERA_DBG("a_ctx_emitters_create: emitters already created.\n");
+    return 0;
+  }
+
+  if (!max_emitters || cell_size <= 0.f) {
+    ASTERA_DBG("a_ctx_emitters_create: invalid emitter count or cell size.\n");
+    return 0;
+  }
+
+  // A bucket per emitter (rounded up to a power of 2) keeps chains short
+  uint32_t bucket_count = 1;
+  while (bucket_count < max_emitters) {
+    bucket_count <<= 1;
+  }
+
+  ctx->emitters = (a_emitter*)calloc(max_emitters, sizeof(a_emitter));
+  ctx->emitter_buckets = (uint16_t*)calloc(bucket_count, sizeof(uint16_t));
+  ctx->emitter_active  = (uint16_t*)malloc(sizeof(uint16_t) * max_emitters);
+  ctx->emitter_queue =
+      (a_emitter_rank*)malloc(sizeof(a_emitter_rank) * max_emitters);
+
+  if (!ctx->emitters || !ctx->emitter_buckets || !ctx->emitter_active ||
+      !ctx->emitter_queue) {
+    ASTERA_DBG("a_ctx_emitters_create: unable to allocate %i emitters.\n",
+               max_emitters);
+    free(ctx->emitters);
+    free(ctx->emitter_buckets);
+    free(ctx->emitter_active);
+    free(ctx->emitter_queue);
+    ctx->emitters        = 0;
+    ctx->emitter_buckets = 0;
+    ctx->emitter_active  = 0;
+    ctx->emitter_queue   = 0;
+    return 0;
+  }
+
+  ctx->emitter_capacity     = max_emitters;
+  ctx->emitter_count        = 0;
+  ctx->emitter_high         = 0;
+  ctx->emitter_bucket_count = bucket_count;
+  ctx->emitter_cell         = cell_size;
+  ctx->emitter_range        = 0.f;
+  ctx->emitter_active_count = 0;
+
+  return 1;
+}
+
+/* Get the bucket of a grid cell */
+static inline uint32_t a_emitter_bucket(a_ctx* ctx, int32_t x, int32_t y) {
+  uint32_t hash = ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u);
+  return hash & (ctx->emitter_bucket_count - 1);
+}
+
+static void a_emitter_link(a_ctx* ctx, a_emitter* emitter) {
+  emitter->cell[0] = (int32_t)floorf(emitter->req.position[0] / ctx->emitter_cell);
+  emitter->cell[1] = (int32_t)floorf(emitter->req.position[1] / ctx->emitter_cell);
+
+  uint32_t bucket = a_emitter_bucket(ctx, emitter->cell[0], emitter->cell[1]);
+  emitter->next   = ctx->emitter_buckets[bucket];
+  ctx->emitter_buckets[bucket] = emitter->id;
+}
+
+static void a_emitter_unlink(a_ctx* ctx, a_emitter* emitter) {
+  uint32_t  bucket = a_emitter_bucket(ctx, emitter->cell[0], emitter->cell[1]);
+  uint16_t* link   = &ctx->emitter_buckets[bucket];
+
+  while (*link) {
+    if (*link == emitter->id) {
+      *link = emitter->next;
+      break;
+    }
+
+    link = &ctx->emitters[*link - 1].next;
+  }
+
+  emitter->next = 0;
+}
+
+/* Stop an emitter's sfx, unless it was already stopped (i.e stolen) */
+static void a_emitter_stop(a_ctx* ctx, a_emitter* emitter) {
+  a_sfx* sfx = a_sfx_get_active(ctx, emitter->sfx);
+  if (sfx && sfx->req == &emitter->req) {
+    a_sfx_release(ctx, sfx);
+  }
+
+  emitter->sfx = 0;
+}
+
+/* Start an emitter's sfx, where its loop would be if it'd always played
+ * returns: 1 = success, 0 = no sfx slot */
+static uint8_t a_emitter_start(a_ctx* ctx, a_emitter* emitter) {
+  uint16_t sfx_id =
+      a_sfx_play_now(ctx, emitter->layer, emitter->buffer, &emitter->req);
+  if (!sfx_id) {
+    return 0;
+  }
+
+  a_sfx* sfx = &ctx->sfx[sfx_id - 1];
+  if (sfx->duration > 0.f) {
+    time_s elapsed = (s_get_time() - emitter->start) / MS_TO_SEC;
+    sfx->time      = (float)fmod(elapsed, sfx->duration);
+
+    if (sfx->source) {
+      alSourcef(sfx->source, AL_SEC_OFFSET, sfx->time);
+    }
+  }
+
+  emitter->sfx = sfx_id;
+  ctx->emitter_active[ctx->emitter_active_count++] = emitter->id;
+  return 1;
+}
+
+static inline float a_emitter_distance(a_ctx* ctx, a_emitter* emitter) {
+  vec3 offset;
+  vec3_sub(offset, emitter->req.position, ctx->voice_origin);
+  return vec3_len(offset);
+}
+
+/* Rank emitters highest priority, then nearest first (qsort order) */
+static int a_emitter_rank_compare(const void* a, const void* b) {
+  const a_emitter_rank* rank_a = (const a_emitter_rank*)a;
+  const a_emitter_rank* rank_b = (const a_emitter_rank*)b;
+
+  if (rank_a->priority != rank_b->priority) {
+    return (rank_a->priority < rank_b->priority) ? 1 : -1;
+  }
+
+  return (rank_a->distance > rank_b->distance) -
+         (rank_a->distance < rank_b->distance);
+}
+
+/* Queue an idle emitter to start if it's within range of the listener
+ * returns: the new amount of queued emitters */
+static uint16_t a_emitter_enqueue(a_ctx* ctx, a_emitter* emitter,
+                                  uint16_t count) {
+  float distance = a_emitter_distance(ctx, emitter);
+  if (distance > emitter->req.range) {
+    return count;
+  }
+
+  ctx->emitter_queue[count] =
+      (a_emitter_rank){.distance = distance,
+                       .id       = emitter->id,
+                       .priority = emitter->req.priority};
+  return count + 1;
+}
+
+/* Keep only the emitters within range of the listener playing
+ * NOTE: Emitters in range start highest priority, then nearest first, so the
+ *       ones that matter most get the free sfx slots */
+static void a_emitters_update(a_ctx* ctx) {
+  if (!ctx->emitter_count) {
+    return;
+  }
+
+  // Stop the emitters that went out of range, or lost their sfx
+  for (uint16_t i = 0; i < ctx->emitter_active_count;) {
+    a_emitter* emitter = &ctx->emitters[ctx->emitter_active[i] - 1];
+    a_sfx*     sfx     = a_sfx_get_active(ctx, emitter->sfx);
+
+    if (!sfx || sfx->req != &emitter->req ||
+        a_emitter_distance(ctx, emitter) > emitter->req.range) {
+      a_emitter_stop(ctx, emitter);
+      ctx->emitter_active[i] =
+          ctx->emitter_active[--ctx->emitter_active_count];
+    } else {
+      ++i;
+    }
+  }
+
+  float   cell = ctx->emitter_cell;
+  int32_t min_x =
+      (int32_t)floorf((ctx->voice_origin[0] - ctx->emitter_range) / cell);
+  int32_t max_x =
+      (int32_t)floorf((ctx->voice_origin[0] + ctx->emitter_range) / cell);
+  int32_t min_y =
+      (int32_t)floorf((ctx->voice_origin[1] - ctx->emitter_range) / cell);
+  int32_t max_y =
+      (int32_t)floorf((ctx->voice_origin[1] + ctx->emitter_range) / cell);
+
+  uint64_t cells = (uint64_t)(max_x - min_x + 1) * (uint64_t)(max_y - min_y + 1);
+  uint16_t count = 0;
+
+  // Once the query covers more cells than there are emitters, checking
+  // every emitter is cheaper
+  if (cells > ctx->emitter_count) {
+    for (uint16_t i = 0; i < ctx->emitter_high; ++i) {
+      a_emitter* emitter = &ctx->emitters[i];
+      if (emitter->id && !emitter->sfx) {
+        count = a_emitter_enqueue(ctx, emitter, count);
+      }
+    }
+  } else {
+    for (int32_t y = min_y; y <= max_y; ++y) {
+      for (int32_t x = min_x; x <= max_x; ++x) {
+        uint16_t next = ctx->emitter_buckets[a_emitter_bucket(ctx, x, y)];
+
+        while (next) {
+          a_emitter* emitter = &ctx->emitters[next - 1];
+          next               = emitter->next;
+
+          // Buckets are shared between cells
+          if (emitter->cell[0] != x || emitter->cell[1] != y || emitter->sfx) {
+            continue;
+          }
+
+          count = a_emitter_enqueue(ctx, emitter, count);
+        }
+      }
+    }
+  }
+
+  if (count > 1) {
+    qsort(ctx->emitter_queue, count, sizeof(a_emitter_rank),
+          a_emitter_rank_compare);
+  }
+
+  for (uint16_t i = 0; i < count; ++i) {
+    // No slot for this one (nothing it can steal), try again next update
+    a_emitter_start(ctx, &ctx->emitters[ctx->emitter_queue[i].id - 1]);
+  }
+}
+
+uint16_t a_emitter_create(a_ctx* ctx, uint16_t layer, uint16_t buf_id,
+                          vec3 position, float gain, float range,
+                          uint8_t priority) {
+  if (a_ctx_threaded(ctx)) {
+    ASTERA_DBG("a_emitter_create: can't create emitters while threaded.\n");
+    return 0;
+  }
+
+  if (ctx->emitter_count == ctx->emitter_capacity) {
+    ASTERA_DBG("a_emitter_create: no free emitter slots.\n");
+    return 0;
+  }
+
+  if (!a_buf_get_id(ctx, buf_id)) {
+    ASTERA_DBG("a_emitter_create: unable to find buffer %i\n", buf_id);
+    return 0;
+  }
+
+  a_emitter* emitter = 0;
+  for (uint16_t i = 0; i < ctx->emitter_capacity; ++i) {
+    if (!ctx->emitters[i].id) {
+      emitter = &ctx->emitters[i];
+      emitter->id = i + 1;
+      break;
+    }
+  }
+
+  if (range <= 0.f) {
+    range = ASTERA_DEFAUT_SFX_RANGE;
+  }
+
+  emitter->buffer = buf_id;
+  emitter->layer  = layer;
+  emitter->sfx    = 0;
+  emitter->start  = s_get_time();
+  emitter->req    = a_req_create(position, gain, range, 1, 0, 0, 0, 0);
+  emitter->req.priority = priority;
+
+  a_emitter_link(ctx, emitter);
+
+  if (range > ctx->emitter_range) {
+    ctx->emitter_range = range;
+  }
+
+  if (emitter->id > ctx->emitter_high) {
+    ctx->emitter_high = emitter->id;
+  }
+
+  ++ctx->emitter_count;
+  return emitter->id;
+}
+
+/* Get an emitter by ID
+ * returns: the emitter, 0 = not found */
+static a_emitter* a_emitter_get(a_ctx* ctx, uint16_t emitter_id) {
+  if (!emitter_id || emitter_id > ctx->emitter_high) {
+    return 0;
+  }
+
+  a_emitter* emitter = &ctx->emitters[emitter_id - 1];
+  return (emitter->id) ? emitter : 0;
+}
+
+uint8_t a_emitter_destroy(a_ctx* ctx, uint16_t emitter_id) {
+  if (a_ctx_threaded(ctx)) {
+    ASTERA_DBG("a_emitter_destroy: can't destroy emitters while threaded.\n");
+    return 0;
+  }
+
+  a_emitter* emitter = a_emitter_get(ctx, emitter_id);
+  if (!emitter) {
+    ASTERA_DBG("a_emitter_destroy: no emitter %i\n", emitter_id);
+    return 0;
+  }
+
+  if (emitter->sfx) {
+    a_emitter_stop(ctx, emitter);
+
+    for (uint16_t i = 0; i < ctx->emitter_active_count; ++i) {
+      if (ctx->emitter_active[i] == emitter_id) {
+        ctx->emitter_active[i] =
+            ctx->emitter_active[--ctx->emitter_active_count];
+        break;
+      }
+    }
+  }
+
+  a_emitter_unlink(ctx, emitter);
+  emitter->id = 0;
+
+  --ctx->emitter_count;
+  return 1;
+}
+
+static uint8_t a_emitter_set_pos_now(a_ctx* ctx, uint16_t emitter_id,
+                                     vec3 position) {
+  a_emitter* emitter = a_emitter_get(ctx, emitter_id);
+  if (!emitter) {
+    ASTERA_DBG("a_emitter_set_pos: no emitter %i\n", emitter_id);
+    return 0;
+  }
+
+  int32_t x = (int32_t)floorf(position[0] / ctx->emitter_cell);
+  int32_t y = (int32_t)floorf(position[1] / ctx->emitter_cell);
+
+  // Only re-bucket when it changes cells
+  if (x != emitter->cell[0] || y != emitter->cell[1]) {
+    a_emitter_unlink(ctx, emitter);
+    vec3_dup(emitter->req.position, position);
+    a_emitter_link(ctx, emitter);
+  } else {
+    vec3_dup(emitter->req.position, position);
+  }
+
+  return 1;
+}
+
+uint8_t a_emitter_playing(a_ctx* ctx, uint16_t emitter_id) {
+  a_emitter* emitter = a_emitter_get(ctx, emitter_id);
+  return emitter && emitter->sfx;
+}
+
+uint16_t a_layer_get_id(a_ctx* ctx, const char* name) {
+  for (uint16_t i = 0; i < ctx->layer_high; ++i) {
+    if (strcmp(ctx->layer_names[i], name) == 0) {
+      // NOTE: ID is the index + 1 of the slot
+      return i + 1;
+    }
+  }
+
+  return 0;
+}
+
+static uint8_t a_layer_set_gain_now(a_ctx* ctx, uint16_t layer_id,
+                                    float gain) {
+  if (ctx->layer_high < layer_id - 1) {
+    ASTERA_DBG("a_layer_set_gain: no layer in slot %i\n", layer_id);
+    return 0;
+  }
+
+  a_layer* layer = &ctx->layers[layer_id - 1];
+
+  // Applied to the layer's songs & sounds at the next update
+#if !defined(ASTERA_NO_THREADS)
+  // a_sfx_play ranks new sfx with it from other threads
+  uint32_t bits;
+  memcpy(&bits, &gain, sizeof(uint32_t));
+  s_atomic_store((volatile uint32_t*)&layer->gain, bits);
+#else
+  layer->gain = gain;
+#endif
+
+  return 1;
+}
+
+uint8_t a_layer_add_song(a_ctx* ctx, uint16_t layer_id, uint16_t song_id) {
+  if (ctx->layer_high < layer_id - 1) {
+    ASTERA_DBG("a_layer_add_song: no layer in slot %i\n", layer_id);
+    return 0;
+  }
+
+  a_layer* layer = &ctx->layers[layer_id - 1];
+
+  if (layer->song_count == layer->song_capacity) {
+    ASTERA_DBG("a_layer_add_song: no open song slots in layer %i\n", layer_id);
+    return 0;
+  }
+
+  layer->songs[layer->song_count] = &ctx->songs[song_id - 1];
+  ctx->songs[song_id - 1].layer   = layer_id;
+  ++layer->song_count;
+
+  return 1;
+}
+
+uint8_t a_layer_add_sfx(a_ctx* ctx, uint16_t layer_id, uint16_t sfx_id) {
+  if (ctx->layer_high < layer_id - 1) {
+    ASTERA_DBG("a_layer_add_sfx: no layer in slot %i\n", layer_id);
+    return 0;
+  }
+
+  a_layer* layer = &ctx->layers[layer_id - 1];
+
+  if (layer->sfx_count == layer->sfx_capacity) {
+    ASTERA_DBG("a_layer_add_sfx: no free sfx slots in layer %i\n", layer_id);
+    return 0;
+  }
+
+  layer->sfx[layer->sfx_count] = &ctx->sfx[sfx_id - 1];
+  ctx->sfx[sfx_id - 1].layer   = layer_id;
+  ++layer->sfx_count;
+
+  return 1;
+}
+
+uint8_t a_layer_remove_song(a_ctx* ctx, uint16_t layer_id, uint16_t song_id) {
+  if (ctx->layer_high < layer_id - 1) {
+    ASTERA_DBG("a_layer_add_song: no layer in slot %i\n", layer_id);
+    return 0;
+  }
+
+  a_layer* layer = &ctx->layers[layer_id - 1];
+
+  int8_t start = 0;
+  for (uint16_t i = 0; i < layer->song_capacity - 1; ++i) {
+    if (layer->songs[i]->id == song_id) {
+      start = 1;
+    }
+
+    if (start) {
+      layer->songs[i] = layer->songs[i + 1];
+    }
+  }
+
+  if (start || layer->songs[layer->song_count - 1]->id == song_id) {
+    ctx->songs[song_id - 1].layer   = 0;
+    layer->songs[layer->song_count] = 0;
+    layer->song_count--;
+  } else {
+    ASTERA_DBG("a_layer_remove_song: unable to find song with ID %i\n",
+               song_id);
+    return 0;
+  }
+
+  return 1;
+}
+
+uint8_t a_layer_remove_sfx(a_ctx* ctx, uint16_t layer_id, uint16_t sfx_id) {
+  if (ctx->layer_high < layer_id - 1) {
+    ASTERA_DBG("a_layer_remove_sfx: no layer in slot %i\n", layer_id);
+    return 0;
+  }
+
+  a_layer* layer = &ctx->layers[layer_id - 1];
+
+  int8_t start = 0;
+  for (uint16_t i = 0; i < layer->sfx_capacity - 1; ++i) {
+    if (layer->songs[i]->id == sfx_id) {
+      start = 1;
+    }
+
+    if (start) {
+      layer->sfx[i] = layer->sfx[i + 1];
+    }
+  }
+
+  if (start || layer->sfx[layer->sfx_count - 1]->id == sfx_id) {
+    ctx->sfx[sfx_id - 1].layer   = 0;
+    layer->sfx[layer->sfx_count] = 0;
+    layer->sfx_count--;
+  } else {
+    ASTERA_DBG("a_layer_remove_sfx: unable to find sfx in layer with ID %i\n",
+               sfx_id);
+    return 0;
+  }
+
+  return 1;
+}
+
+float a_layer_get_gain(a_ctx* ctx, uint16_t layer_id) {
+  if (ctx->layer_high > layer_id - 1) {
+    ASTERA_DBG("a_layer_get_gain: no layer contained with ID %i\n", layer_id);
+    return -1.f;
+  }
+
+  return ctx->layers[layer_id - 1].gain;
+}
+
+/* Index the start & last sample of every page a frame ends on, so a seek
+ * can find its page without probing the stream
+ * returns: the amount of pages indexed, 0 = fail */
+static uint32_t a_song_index(a_song* song) {
+  stb_vorbis* f        = song->vorbis;
+  uint32_t    restore  = stb_vorbis_get_file_offset(f);
+  uint32_t    capacity = 64, count = 0;
+  ProbedPage  page;
+
+  a_seek_page* pages = (a_seek_page*)malloc(sizeof(a_seek_page) * capacity);
+  if (!pages) {
+    return 0;
+  }
+
+  // p_last is found by stb_vorbis_stream_length_in_samples
+  set_file_offset(f, f->p_first.page_start);
+  while (stb_vorbis_get_file_offset(f) <= f->p_last.page_start &&
+         get_seek_page_info(f, &page)) {
+    if (page.last_decoded_sample != ~0U) {
+      if (count == capacity) {
+        capacity *= 2;
+        a_seek_page* grown =
+            (a_seek_page*)realloc(pages, sizeof(a_seek_page) * capacity);
+        if (!grown) {
+          free(pages);
+          set_file_offset(f, restore);
+          return 0;
+        }
+        pages = grown;
+      }
+
+      pages[count] = (a_seek_page){.start  = page.page_start,
+                                   .end    = page.page_end,
+                                   .sample = page.last_decoded_sample};
+      ++count;
+    }
+
+    set_file_offset(f, page.page_end);
+  }
+
+  set_file_offset(f, restore);
+
+  if (!count) {
+    free(pages);
+    return 0;
+  }
+
+  song->seek_pages = pages;
+  song->seek_count = count;
+
+  return count;
+}
+
+/* Seek a song's stream to an exact sample
+ * returns: success = 1, fail = 0 */
+static uint8_t a_song_seek(a_song* song, uint32_t sample) {
+  stb_vorbis* f = song->vorbis;
+
+  if (!song->seek_pages) {
+    return stb_vorbis_seek(f, sample) != 0;
+  }
+
+  // stb_vorbis searches between p_first & p_last for the last page ending
+  // before sample (less the window padding), so narrowing them to that page
+  // & the one after it skips straight to decoding
+  uint32_t padding = (f->blocksize_1 - f->blocksize_0) >> 2;
+  uint32_t limit   = (sample > padding) ? sample - padding : 0;
+
+  uint32_t low = 0, high = song->seek_count;
+  while (low < high) {
+    uint32_t mid = low + (high - low) / 2;
+    if (song->seek_pages[mid].sample < limit) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  // Before the first indexed page or past the end, stb_vorbis handles both
+  if (low == 0 || low == song->seek_count) {
+    return stb_vorbis_seek(f, sample) != 0;
+  }
+
+  a_seek_page* left  = &song->seek_pages[low - 1];
+  a_seek_page* right = &song->seek_pages[low];
+  ProbedPage   first = f->p_first, last = f->p_last;
+
+  f->p_first = (ProbedPage){left->start, left->end, left->sample};
+  f->p_last  = (ProbedPage){right->start, right->end, right->sample};
+
+  int result = stb_vorbis_seek(f, sample);
+
+  f->p_first = first;
+  f->p_last  = last;
+
+  return result != 0;
+}
+
+/* Set up a song slot around an opened vorbis stream, the stream is closed
+ * on failure
+ * data - the memory the stream reads from, 0 if it's file backed */
+static uint16_t a_song_open(a_ctx* ctx, stb_vorbis* vorbis, uint8_t* data,
+                            const char* name, uint16_t packets_per_buffer,
+                            uint8_t buffers, uint32_t max_buffer_size) {
+  a_song* song = 0;
+
+  for (uint16_t i = 0; i < ctx->song_high; ++i) {
+    if (!ctx->songs[i].buffers) {
+      song = &ctx->songs[i];
+      break;
+    }
+  }
+
+  int8_t new_high = 0;
+  if (!song) {
+    if (ctx->song_high < ctx->song_capacity) {
+      song     = &ctx->songs[ctx->song_high];
+      new_high = 1;
+    } else {
+      ASTERA_DBG("a_song_create: no free song slots.\n");
+      stb_vorbis_close(vorbis);
+      return 0;
+    }
+  }
+
+  song->data    = data;
+  song->vorbis  = vorbis;
+  song->req     = 0;
+  song->curr    = 0.f;
+  song->playing = 0;
+  a_song_set_state(song, AL_INITIAL);
+
+  song->packets_per_buffer = packets_per_buffer;
+
+  song->info = stb_vorbis_get_info(song->vorbis);
+
+  song->channels = (song->info.channels > 2) ? 2 : song->info.channels;
+  song->format   = (song->channels > 1) ? AL_FORMAT_STEREO16 : AL_FORMAT_MONO16;
+
+  // Each buffer's decoding needs room for at least one full frame
+  if (max_buffer_size < (uint32_t)song->info.max_frame_size * song->channels) {
+    ASTERA_DBG("a_song_create: max_buffer_size is smaller than the listed max "
+               "frame size of this OGG file: %i vs %i\n",
+               max_buffer_size, song->info.max_frame_size * song->channels);
+
+    stb_vorbis_close(song->vorbis);
+    song->vorbis = 0;
+    song->data   = 0;
+    song->req    = 0;
+
+    return 0;
+  }
+
+  song->buffers      = (uint32_t*)malloc(sizeof(uint32_t) * buffers);
+  song->buffer_sizes = (uint32_t*)calloc(buffers, sizeof(uint32_t));
+  song->pcm          = (uint16_t*)malloc(sizeof(uint16_t) * max_buffer_size);
+  song->pcm_length   = max_buffer_size;
+  song->buffer_count = buffers;
+  song->sample_count = stb_vorbis_stream_length_in_samples(song->vorbis);
+  song->length = stb_vorbis_stream_length_in_seconds(song->vorbis) * 1000.f;
+  song->seek_pages = 0;
+  song->seek_count = 0;
+
+  if (!song->buffers || !song->buffer_sizes || !song->pcm) {
+    free(song->buffers);
+    free(song->buffer_sizes);
+    free(song->pcm);
+    stb_vorbis_close(song->vorbis);
+
+    song->buffers      = 0;
+    song->buffer_sizes = 0;
+    song->pcm          = 0;
+    song->vorbis       = 0;
+    song->data         = 0;
+    song->req          = 0;
+
+    ASTERA_DBG("a_song_create: unable to allocate buffers.\n");
+
+    return 0;
+  }
+
+  // Without an index seeking still works, it just probes the stream
+  if (song->sample_count && !a_song_index(song)) {
+    ASTERA_DBG("a_song_create: unable to index song for seeking.\n");
+  }
+
+  alGenBuffers(buffers, song->buffers);
+  if (!song->source) {
+    alGenSources(1, &song->source);
+  }
+
+  for (uint8_t i = 0; i < buffers; ++i) {
+    a_song_fill(song, song->buffers[i]);
+  }
+
+  ctx->song_names[song->id - 1] = name;
+
+  if (new_high)
+    ++ctx->song_high;
+
+  ++ctx->song_count;
+
+  return song->id;
+}
+
+uint16_t a_song_create(a_ctx* ctx, unsigned char* data, uint32_t data_length,
+                       const char* name, uint16_t packets_per_buffer,
+                       uint8_t buffers, uint32_t max_buffer_size) {
+  if (!data || !data_length || !packets_per_buffer || !buffers ||
+      !max_buffer_size) {
+    ASTERA_DBG("a_song_create: Invalid parameters passed\n");
+    return 0;
+  }
+
+  int32_t     error;
+  stb_vorbis* vorbis = stb_vorbis_open_memory(data, data_length, &error, 0);
+
+  if (!vorbis) {
+    ASTERA_DBG("a_song_create: Unable to load vorbis, that sucks.\n");
+    return 0;
+  }
+
+  return a_song_open(ctx, vorbis, data, name, packets_per_buffer, buffers,
+                     max_buffer_size);
+}
+
+uint16_t a_song_create_file(a_ctx* ctx, const char* path, uint32_t offset,
+                            uint32_t length, const char* name,
+                            uint16_t packets_per_buffer, uint8_t buffers,
+                            uint32_t max_buffer_size) {
+  if (!path || !packets_per_buffer || !buffers || !max_buffer_size) {
+    ASTERA_DBG("a_song_create_file: Invalid parameters passed\n");
+    return 0;
+  }
+
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    ASTERA_DBG("a_song_create_file: unable to open %s\n", path);
+    return 0;
+  }
+
+  if (!length) {
+    fseek(file, 0, SEEK_END);
+    long end = ftell(file);
+    length   = (end > (long)offset) ? (uint32_t)(end - offset) : 0;
+  }
+
+  if (!length || fseek(file, offset, SEEK_SET) != 0) {
+    ASTERA_DBG("a_song_create_file: no data at %i in %s\n", offset, path);
+    fclose(file);
+    return 0;
+  }
+
+  // The stream owns the file from here (even on failure), it's closed with
+  // the song
+  int32_t     error;
+  stb_vorbis* vorbis = stb_vorbis_open_file_section(file, 1, &error, 0, length);
+
+  if (!vorbis) {
+    ASTERA_DBG("a_song_create_file: unable to load vorbis, vorbis error %i\n",
+               error);
+    return 0;
+  }
+
+  return a_song_open(ctx, vorbis, 0, name, packets_per_buffer, buffers,
+                     max_buffer_size);
+}
+
+static uint8_t a_song_destroy_now(a_ctx* ctx, uint16_t id) {
+  if (ctx->song_high < id - 1) {
+    ASTERA_DBG("a_song_destroy: no song in context with ID %i\n", id);
+    return 0;
+  }
+
+  a_song* song = &ctx->songs[id - 1];
+
+  a_stream_lock(ctx);
+
+  // The source is kept for the slot's next song
+  alSourceStop(song->source);
+  alSourcei(song->source, AL_BUFFER, 0);
+  alDeleteBuffers(song->buffer_count, song->buffers);
+
+  stb_vorbis_close(song->vorbis);
+
+  free(song->buffers);
+  free(song->buffer_sizes);
+  free(song->pcm);
+  free(song->seek_pages);
+
+  song->vorbis       = 0;
+  song->buffers      = 0;
+  song->buffer_sizes = 0;
+  song->pcm          = 0;
+  song->seek_pages   = 0;
+  song->seek_count   = 0;
+  song->data         = 0;
+  song->req          = 0;
+  song->playing      = 0;
+  a_song_set_state(song, AL_STOPPED);
+
+  --ctx->song_count;
+
+  a_stream_unlock(ctx);
+
+  return 1;
+}
+
+a_song* a_song_get_ptr(a_ctx* ctx, uint16_t song_id) {
+  if (ctx->song_high < song_id - 1) {
+    ASTERA_DBG("a_song_destroy: no song in context with ID %i\n", song_id);
+    return 0;
+  }
+
+  return &ctx->songs[song_id - 1];
+}
+
+a_song* a_song_get_open(a_ctx* ctx) {
+  if (ctx->song_count == ctx->song_capacity) {
+    ASTERA_DBG("a_song_get_open: no open song slots.\n");
+    return 0;
+  }
+
+  for (uint16_t i = 0; i < ctx->song_capacity; ++i) {
+    a_song* song = &ctx->songs[i];
+    if (!song->source) {
+      return song;
+    }
+  }
+
+  return 0;
+}
+
+static uint8_t a_song_play_now(a_ctx* ctx, uint16_t layer_id,
+                               uint16_t song_id, a_req* req) {
+  if (layer_id > ctx->layer_capacity) {
+    layer_id = 0;
   }
 
-  if (!slot->source) {
-    alGenSources(1, &slot->source);
+  if (ctx->song_high < song_id - 1) {
+    ASTERA_DBG("a_song_play: invalid song ID\n");
+    return 0;
   }
 
-  alSourcei(slot->source, AL_BUFFER, buf->buf);
+  a_song* song = &ctx->songs[song_id - 1];
 
-  // Apply fx
+  // Apply fx, each one through its own send
   if (req->fx_count > 0) {
-    for (uint16_t i = 0; i < req->fx_count; ++i) {
-      // Make sure it's valid within the range of filters
-      if (req->fx[i] < ctx->filter_high) {
-        alSource3i(slot->source, AL_AUXILIARY_SEND_FILTER,
-                   (ALint)ctx->filter_slots[req->fx[i] - 1].al_id, i, 0);
+    for (uint16_t i = 0; i < req->fx_count && i < ctx->fx_per_source; ++i) {
+      // Make sure it's a created effect
+      if (req->fx[i] && req->fx[i] <= ctx->fx_high &&
+          ctx->fx_slots[req->fx[i] - 1].slot_id) {
+        alSource3i(song->source, AL_AUXILIARY_SEND_FILTER,
+                   (ALint)ctx->fx_slots[req->fx[i] - 1].slot_id, i, 0);
       }
     }
   }
@@ -678,876 +2375,1314 @@ uint16_t a_sfx_play(a_ctx* ctx, uint16_t layer, uint16_t buf_id, a_req* req) {
   // Apply filters
   if (req->filter_count > 0) {
     for (uint16_t i = 0; i < req->filter_count; ++i) {
-      if (ctx->filter_high < req->filters[i] - 1) {
-        alSourcei(slot->source, AL_DIRECT_FILTER,
+      // Make sure it's a created filter
+      if (req->filters[i] && req->filters[i] - 1 <= ctx->filter_high &&
+          req->filters[i] <= ctx->filter_capacity &&
+          ctx->filter_slots[req->filters[i] - 1].al_id) {
+        alSourcei(song->source, AL_DIRECT_FILTER,
                   ctx->filter_slots[req->filters[i] - 1].al_id);
       }
     }
   }
 
-  slot->buffer = buf->id;
-  slot->length = buf->length;
-  slot->req    = req;
+  a_stream_lock(ctx);
+  song->delta   = 0;
+  song->req     = req;
+  song->playing = 1;
+  a_stream_unlock(ctx);
 
-  uint32_t size;
-  alGetBufferi(buf->buf, AL_SIZE, &size);
+  a_song_set_state(song, AL_PLAYING);
 
-  alSourcef(slot->source, AL_GAIN, req->gain);
-  alSource3f(slot->source, AL_POSITION, req->position[0], req->position[1],
-             req->position[2]);
-  alSource3f(slot->source, AL_VELOCITY, req->velocity[0], req->velocity[1],
-             req->velocity[2]);
-  alSourcei(slot->source, AL_LOOPING, req->loop);
+  song->layer = layer_id;
+  a_source_sync(song->source, &song->applied, req,
+                a_layer_gain(ctx, layer_id), 0, 1);
 
-  alSourcePlay(slot->source);
-
-  ++ctx->sfx_count;
+  alSourcePlay(song->source);
 
-  return slot->id;
+  return 1;
 }
 
-uint8_t a_sfx_remove(a_ctx* ctx, uint16_t sfx_id) {
-  if (ctx->sfx_high < sfx_id - 1) {
-    ASTERA_DBG("a_sfx_remove: no sfx in slot %i\n", sfx_id);
+static uint8_t a_song_stop_now(a_ctx* ctx, uint16_t song_id) {
+  if (ctx->song_high < song_id - 1) {
+    ASTERA_DBG("a_song_resume: no song in slot %i\n", song_id);
     return 0;
   }
 
-  a_sfx* sfx = &ctx->sfx[sfx_id - 1];
+  a_song* song = &ctx->songs[song_id - 1];
 
-  if (sfx->req) {
-    sfx->req->valid = 0;
-    sfx->req->state = AL_STOPPED;
-  }
+  a_stream_lock(ctx);
+  song->playing = 0;
+  alSourceStop(song->source);
+  a_stream_unlock(ctx);
 
-  sfx->buffer = 0;
-  sfx->length = 0;
+  a_song_set_state(song, AL_STOPPED);
 
-  --ctx->sfx_count;
+  return 1;
+}
 
-  if (ctx->sfx_high == sfx->id - 1) {
-    if (ctx->sfx_count > 0) {
-      for (uint16_t i = sfx->id - 1; i > 0; --i) {
-        if (ctx->sfx[i].buffer) {
-          ctx->sfx_high = i;
-          break;
-        }
-      }
-    } else {
-      ctx->sfx_high = 0;
-    }
+static uint8_t a_song_pause_now(a_ctx* ctx, uint16_t song_id) {
+  if (ctx->song_high < song_id - 1) {
+    ASTERA_DBG("a_song_resume: no song in slot %i\n", song_id);
+    return 0;
   }
 
+  a_song* song = &ctx->songs[song_id - 1];
+
+  a_stream_lock(ctx);
+  song->playing = 0;
+  alSourcePause(song->source);
+  a_stream_unlock(ctx);
+
+  a_song_set_state(song, AL_PAUSED);
+
   return 1;
 }
 
-uint8_t a_sfx_stop(a_ctx* ctx, uint16_t sfx_id) {
-  if (ctx->sfx_high < sfx_id - 1) {
-    ASTERA_DBG("a_sfx_pause: no sfx in slot %i\n", sfx_id);
+static uint8_t a_song_resume_now(a_ctx* ctx, uint16_t song_id) {
+  if (ctx->song_high < song_id - 1) {
+    ASTERA_DBG("a_song_resume: no song in slot %i\n", song_id);
     return 0;
   }
 
-  a_sfx* sfx = &ctx->sfx[sfx_id - 1];
-
-  if (sfx->req) {
-    sfx->req->valid = 0;
-    sfx->req->state = AL_STOPPED;
-  }
+  a_song* song = &ctx->songs[song_id - 1];
 
-  alSourceStop(sfx->source);
+  a_stream_lock(ctx);
+  song->playing = 1;
+  alSourcePlay(song->source);
+  a_stream_unlock(ctx);
 
-  sfx->buffer = 0;
-  sfx->length = 0;
+  a_song_set_state(song, AL_PLAYING);
 
-  --ctx->sfx_count;
+  return 1;
+}
 
-  if (ctx->sfx_high == sfx->id - 1) {
-    if (ctx->sfx_count > 0) {
-      for (uint16_t i = sfx->id - 1; i > 0; --i) {
-        if (ctx->sfx[i].buffer) {
-          ctx->sfx_high = i;
-          break;
-        }
-      }
-    } else {
-      ctx->sfx_high = 0;
-    }
+time_s a_song_get_time(a_ctx* ctx, uint16_t song_id) {
+  if (ctx->song_high < song_id - 1) {
+    ASTERA_DBG("a_song_get_time: no song in slot %i\n", song_id);
+    return -1;
   }
 
-  return 1;
+  a_song* song = &ctx->songs[song_id - 1];
+  return song->delta;
 }
 
-uint8_t a_sfx_pause(a_ctx* ctx, uint16_t sfx_id) {
-  if (ctx->sfx_high < sfx_id - 1) {
-    ASTERA_DBG("a_sfx_pause: no sfx in slot %i\n", sfx_id);
-    return 0;
+uint32_t a_song_get_sample_count(a_ctx* ctx, uint16_t song_id) {
+  if (ctx->song_high < song_id - 1) {
+    ASTERA_DBG("a_song_get_time: no song in slot %i\n", song_id);
+    return -1;
   }
 
-  a_sfx* sfx = &ctx->sfx[sfx_id - 1];
+  a_song* song = &ctx->songs[song_id - 1];
 
-  alSourcePause(sfx->source);
+  return song->sample_count;
+}
 
-  if (sfx->req) {
-    sfx->req->state = AL_PAUSED;
+time_s a_song_get_length(a_ctx* ctx, uint16_t song_id) {
+  if (ctx->song_high < song_id - 1) {
+    ASTERA_DBG("a_song_get_length: no song in slot %i\n", song_id);
+    return -1;
   }
 
-  return 1;
+  a_song* song = &ctx->songs[song_id - 1];
+  return (time_s)(song->length);
 }
 
-uint8_t a_sfx_resume(a_ctx* ctx, uint16_t sfx_id) {
-  if (ctx->sfx_high < sfx_id - 1) {
-    ASTERA_DBG("a_sfx_resume: no sfx in slot %i\n", sfx_id);
+static uint8_t a_song_set_time_now(a_ctx* ctx, uint16_t song_id, time_s from_start) {
+  if (ctx->song_high < song_id - 1) {
+    ASTERA_DBG("a_song_set_time: no song in list with id %i\n", song_id);
     return 0;
   }
 
-  a_sfx* sfx = &ctx->sfx[sfx_id - 1];
+  a_song* song = &ctx->songs[song_id - 1];
 
-  alSourcePlay(sfx->source);
+  if (from_start < 0.0) {
+    from_start = 0.0;
+  }
 
-  return 1;
-}
+  uint32_t sample =
+      (uint32_t)((from_start / MS_TO_SEC) * song->info.sample_rate);
 
-uint16_t a_layer_get_id(a_ctx* ctx, const char* name) {
-  for (uint16_t i = 0; i < ctx->layer_high; ++i) {
-    if (strcmp(ctx->layer_names[i], name) == 0) {
-      // NOTE: ID is the index + 1 of the slot
-      return i + 1;
-    }
+  if (sample > song->sample_count) {
+    ASTERA_DBG("a_song_set_time: sample requested %i out of range of song %i\n",
+               sample, song->sample_count);
+    return 0;
   }
 
-  return 0;
-}
+  a_stream_lock(ctx);
 
-uint8_t a_layer_set_gain(a_ctx* ctx, uint16_t layer_id, float gain) {
-  if (ctx->layer_high < layer_id - 1) {
-    ASTERA_DBG("a_layer_set_gain: no layer in slot %i\n", layer_id);
+  if (!a_song_seek(song, sample)) {
+    a_stream_unlock(ctx);
+    ASTERA_DBG("a_song_set_time: unable to seek to sample %i\n", sample);
     return 0;
   }
 
-  a_layer* layer = &ctx->layers[layer_id - 1];
-
-  layer->gain = gain;
+  // Drop everything queued from the old time, then refill from the new one
+  alSourceStop(song->source);
+  alSourcei(song->source, AL_BUFFER, 0);
 
-  if (layer->song_count) {
-    for (uint16_t i = 0; i < layer->song_count; ++i) {
-      a_song* song = layer->songs[i];
-      if (song->req) {
-        alSourcef(song->source, AL_GAIN, gain * song->req->gain);
-      }
-    }
+  for (uint8_t i = 0; i < song->buffer_count; ++i) {
+    a_song_fill(song, song->buffers[i]);
   }
 
-  if (layer->sfx_count) {
-    for (uint16_t i = 0; i < layer->sfx_count; ++i) {
-      a_sfx* sfx = layer->sfx[i];
-      if (sfx->req) {
-        alSourcef(sfx->source, AL_GAIN, gain * sfx->req->gain);
-      }
-    }
+  song->curr          = from_start;
+  song->delta         = from_start;
+  song->sample_offset = sample;
+
+  // A paused song is left stopped, resuming plays from the new time either way
+  if (song->playing) {
+    alSourcePlay(song->source);
   }
 
+  a_stream_unlock(ctx);
+
   return 1;
 }
 
-uint8_t a_layer_add_song(a_ctx* ctx, uint16_t layer_id, uint16_t song_id) {
-  if (ctx->layer_high < layer_id - 1) {
-    ASTERA_DBG("a_layer_add_song: no layer in slot %i\n", layer_id);
+static uint8_t a_song_reset_now(a_ctx* ctx, uint16_t song_id) {
+  if (ctx->song_high < song_id - 1) {
+    ASTERA_DBG("a_song_resume: no song in slot %i\n", song_id);
     return 0;
   }
 
-  a_layer* layer = &ctx->layers[layer_id - 1];
+  a_song* song = &ctx->songs[song_id - 1];
 
-  if (layer->song_count == layer->song_capacity) {
-    ASTERA_DBG("a_layer_add_song: no open song slots in layer %i\n", layer_id);
-    return 0;
+  a_stream_lock(ctx);
+
+  song->delta         = 0.f;
+  song->curr          = 0.f;
+  song->sample_offset = 0;
+
+  stb_vorbis_seek_start(song->vorbis);
+
+  // Unqueue anything existing, it's left stopped until played
+  song->playing = 0;
+  alSourceStop(song->source);
+  a_song_set_state(song, AL_STOPPED);
+  alSourceUnqueueBuffers(song->source, song->buffer_count, song->buffers);
+
+  for (uint8_t i = 0; i < song->buffer_count; ++i) {
+    a_song_fill(song, song->buffers[i]);
   }
 
-  layer->songs[layer->song_count] = &ctx->songs[song_id - 1];
-  ++layer->song_count;
+  a_stream_unlock(ctx);
 
   return 1;
 }
 
-uint8_t a_layer_add_sfx(a_ctx* ctx, uint16_t layer_id, uint16_t sfx_id) {
-  if (ctx->layer_high < layer_id - 1) {
-    ASTERA_DBG("a_layer_add_sfx: no layer in slot %i\n", layer_id);
-    return 0;
+ALenum a_song_get_state(a_ctx* ctx, uint16_t song_id) {
+  if (ctx->song_high < song_id - 1) {
+    ASTERA_DBG("a_song_get_state: no song with ID %i\n", song_id);
+    return AL_STOPPED;
   }
 
-  a_layer* layer = &ctx->layers[layer_id - 1];
+#if !defined(ASTERA_NO_THREADS)
+  // OpenAL belongs to the audio thread, it keeps the state up to date
+  if (ctx->audio_thread) {
+    return (ALenum)s_atomic_load(&ctx->songs[song_id - 1].state);
+  }
+#endif
 
-  if (layer->sfx_count == layer->sfx_capacity) {
-    ASTERA_DBG("a_layer_add_sfx: no free sfx slots in layer %i\n", layer_id);
+  ALenum   state;
+  uint32_t source = ctx->songs[song_id - 1].source;
+  if (!source) {
+    return AL_STOPPED;
+  } else {
+    alGetSourcei(source, AL_SOURCE_STATE, &state);
+    return state;
+  }
+}
+
+uint16_t a_song_get_id(a_ctx* ctx, const char* name) {
+  if (ctx->song_count == 0) {
+    ASTERA_DBG("a_song_get_id: no songs in context.\n");
     return 0;
   }
 
-  layer->sfx[layer->sfx_count] = &ctx->sfx[sfx_id - 1];
-  ++layer->sfx_count;
+  for (uint16_t i = 0; i < ctx->song_high; ++i) {
+    if (strcmp(ctx->song_names[i], name) == 0) {
+      // Song IDs are their index + 1
+      return i + 1;
+    }
+  }
 
-  return 1;
+  return 0;
 }
 
-uint8_t a_layer_remove_song(a_ctx* ctx, uint16_t layer_id, uint16_t song_id) {
-  if (ctx->layer_high < layer_id - 1) {
-    ASTERA_DBG("a_layer_add_song: no layer in slot %i\n", layer_id);
-    return 0;
-  }
+static int16_t _a_load_int16(unsigned char* data, int offset) {
+  return *((int16_t*)&data[offset]);
+}
 
-  a_layer* layer = &ctx->layers[layer_id - 1];
+static int32_t _a_load_int32(unsigned char* data, int offset) {
+  return *((int32_t*)&data[offset]);
+}
 
-  int8_t start = 0;
-  for (uint16_t i = 0; i < layer->song_capacity - 1; ++i) {
-    if (layer->songs[i]->id == song_id) {
-      start = 1;
-    }
+typedef struct {
+  // magic - "APCM"
+  // hash, length - the s_hash_data & length of the encoded file
+  // channels, sample_rate - the format of the samples
+  // samples - the amount of samples (per channel) following
+  char     magic[4];
+  uint32_t hash, length;
+  uint32_t channels, sample_rate, samples;
+} a_pcm_header;
+
+typedef struct {
+  // pcm - the decoded 16 bit samples (interleaved)
+  // samples - the amount of samples per channel
+  // channels, sample_rate - the format of the samples
+  int16_t* pcm;
+  uint32_t samples;
+  int32_t  channels, sample_rate;
+} a_pcm;
+
+void a_ctx_set_cache_dir(a_ctx* ctx, const char* dir) { ctx->cache_dir = dir; }
+
+/* Get the path of an encoded file's decoded PCM in the cache directory */
+static void a_pcm_cache_path(const char* dir, a_pcm_header* key, char* dst,
+                             uint32_t dst_length) {
+  snprintf(dst, dst_length, "%s/%08x%08x.apcm", dir, key->hash, key->length);
+}
 
-    if (start) {
-      layer->songs[i] = layer->songs[i + 1];
-    }
+/* Read previously decoded PCM if the cache matches the file
+ * returns: 1 = cache hit, 0 = missing or stale */
+static uint8_t a_pcm_cache_read(const char* path, a_pcm_header* key,
+                                a_pcm* dst) {
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    return 0;
   }
 
-  if (start || layer->songs[layer->song_count - 1]->id == song_id) {
-    layer->songs[layer->song_count] = 0;
-    layer->song_count--;
-  } else {
-    ASTERA_DBG("a_layer_remove_song: unable to find song with ID %i\n",
-               song_id);
-    return 0;
+  a_pcm_header header;
+  uint8_t      hit = 0;
+
+  if (fread(&header, sizeof(a_pcm_header), 1, file) == 1 &&
+      memcmp(header.magic, key->magic, 4) == 0 && header.hash == key->hash &&
+      header.length == key->length && header.channels > 0 &&
+      header.channels <= 2 && header.samples > 0) {
+    uint32_t count = header.samples * header.channels;
+    int16_t* pcm   = (int16_t*)malloc(sizeof(int16_t) * count);
+
+    if (pcm && fread(pcm, sizeof(int16_t), count, file) == count) {
+      *dst = (a_pcm){.pcm         = pcm,
+                     .samples     = header.samples,
+                     .channels    = (int32_t)header.channels,
+                     .sample_rate = (int32_t)header.sample_rate};
+      hit  = 1;
+    } else {
+      free(pcm);
+    }
   }
 
-  return 1;
+  fclose(file);
+  return hit;
 }
 
-uint8_t a_layer_remove_sfx(a_ctx* ctx, uint16_t layer_id, uint16_t sfx_id) {
-  if (ctx->layer_high < layer_id - 1) {
-    ASTERA_DBG("a_layer_remove_sfx: no layer in slot %i\n", layer_id);
-    return 0;
+static void a_pcm_cache_write(const char* path, a_pcm_header* key,
+                              a_pcm* pcm) {
+  FILE* file = fopen(path, "wb");
+  if (!file) {
+    ASTERA_DBG("a_pcm_cache_write: unable to open %s.\n", path);
+    return;
   }
 
-  a_layer* layer = &ctx->layers[layer_id - 1];
+  key->channels    = (uint32_t)pcm->channels;
+  key->sample_rate = (uint32_t)pcm->sample_rate;
+  key->samples     = pcm->samples;
 
-  int8_t start = 0;
-  for (uint16_t i = 0; i < layer->sfx_capacity - 1; ++i) {
-    if (layer->songs[i]->id == sfx_id) {
-      start = 1;
-    }
+  fwrite(key, sizeof(a_pcm_header), 1, file);
+  fwrite(pcm->pcm, sizeof(int16_t), pcm->samples * pcm->channels, file);
 
-    if (start) {
-      layer->sfx[i] = layer->sfx[i + 1];
+  fclose(file);
+}
+
+/* Decode an OGG Vorbis file, from the cache directory if it's been decoded
+ * before (safe to call from any thread)
+ * cache_dir - the directory to cache decoded PCM in, 0 = no caching
+ * returns: 1 = success, 0 = fail */
+static uint8_t a_pcm_decode(const char* cache_dir, unsigned char* data,
+                            uint32_t data_length, a_pcm* dst) {
+  a_pcm_header key = {.magic = {'A', 'P', 'C', 'M'}, .length = data_length};
+  char         path[512];
+
+  if (cache_dir) {
+    key.hash = s_hash_data(data, data_length);
+    a_pcm_cache_path(cache_dir, &key, path, sizeof(path));
+
+    if (a_pcm_cache_read(path, &key, dst)) {
+      return 1;
     }
   }
 
-  if (start || layer->sfx[layer->sfx_count - 1]->id == sfx_id) {
-    layer->sfx[layer->sfx_count] = 0;
-    layer->sfx_count--;
-  } else {
-    ASTERA_DBG("a_layer_remove_sfx: unable to find sfx in layer with ID %i\n",
-               sfx_id);
+  int32_t channels, sample_rate;
+  int16_t* pcm;
+
+  // Returns the amount of samples per channel
+  int32_t samples = stb_vorbis_decode_memory(data, data_length, &channels,
+                                             &sample_rate, &pcm);
+
+  if (samples <= 0 || !pcm) {
     return 0;
   }
 
-  return 1;
-}
+  *dst = (a_pcm){.pcm         = pcm,
+                 .samples     = (uint32_t)samples,
+                 .channels    = channels,
+                 .sample_rate = sample_rate};
 
-float a_layer_get_gain(a_ctx* ctx, uint16_t layer_id) {
-  if (ctx->layer_high > layer_id - 1) {
-    ASTERA_DBG("a_layer_get_gain: no layer contained with ID %i\n", layer_id);
-    return -1.f;
+  if (cache_dir) {
+    a_pcm_cache_write(path, &key, dst);
   }
 
-  return ctx->layers[layer_id - 1].gain;
+  return 1;
 }
 
-uint16_t a_song_create(a_ctx* ctx, unsigned char* data, uint32_t data_length,
-                       const char* name, uint16_t packets_per_buffer,
-                       uint8_t buffers, uint32_t max_buffer_size) {
-  if (!data || !data_length || !packets_per_buffer || !buffers ||
-      !max_buffer_size) {
-    ASTERA_DBG("a_song_create: Invalid parameters passed\n");
-    return 0;
-  }
-
-  a_song* song = 0;
+/* Put audio data into a free buffer slot
+ * format - the OpenAL format of the data
+ * samples - the amount of samples per channel
+ * block_align - the samples per block of ADPCM data, 0 = the default
+ * returns: the ID of the buffer (non-zero, 0 = fail) */
+static uint16_t a_buf_upload(a_ctx* ctx, const char* name, int32_t format,
+                             const void* data, uint32_t size,
+                             uint16_t channels, uint32_t sample_rate,
+                             uint32_t samples, uint32_t block_align) {
+  a_buf* buffer = 0;
 
-  for (uint16_t i = 0; i < ctx->song_high; ++i) {
-    if (!ctx->songs[i].buffers) {
-      song = &ctx->songs[i];
+  // Find open buffer
+  for (uint16_t i = 0; i < ctx->buffer_high; ++i) {
+    if (ctx->buffers[i].buf == 0) {
+      buffer = &ctx->buffers[i];
+      break;
     }
   }
 
   int8_t new_high = 0;
-  if (!song && ctx->song_high < ctx->song_capacity) {
-    song     = &ctx->songs[ctx->song_high];
+  if (!buffer) {
+    if (ctx->buffer_high == ctx->buffer_capacity) {
+      ASTERA_DBG("a_buf_create: no free buffer slots.\n");
+      return 0;
+    }
+
+    buffer   = &ctx->buffers[ctx->buffer_high];
     new_high = 1;
-  } else {
-    return 0;
   }
 
-  int32_t error;
-
-  song->data   = data;
-  song->vorbis = stb_vorbis_open_memory(data, data_length, &error, 0);
-  song->req    = 0;
-  song->curr   = 0.f;
+  alGenBuffers(1, &buffer->buf);
 
-  if (!song->vorbis) {
-    song->data = 0;
-    song->req  = 0;
-    ASTERA_DBG("a_song_create: Unable to load vorbis, that sucks.\n");
-    return 0;
+  if (block_align) {
+    alBufferi(buffer->buf, AL_UNPACK_BLOCK_ALIGNMENT_SOFT, block_align);
   }
 
-  song->packets_per_buffer = packets_per_buffer;
-
-  song->info = stb_vorbis_get_info(song->vorbis);
-
-  if (max_buffer_size < song->info.max_frame_size) {
-    ASTERA_DBG("a_song_create: max_buffer_size is smaller than the listed max "
-               "frame size of this OGG file: %i vs %i\n",
-               max_buffer_size, song->info.max_frame_size);
+  alBufferData(buffer->buf, format, data, size, sample_rate);
 
-    free(song->vorbis);
-    song->data = 0;
-    song->req  = 0;
+  buffer->channels    = channels;
+  buffer->sample_rate = sample_rate;
+  buffer->length      = samples;
 
-    return 0;
-  }
+  ctx->buffer_names[buffer->id - 1] = name;
 
-  if (song->info.channels > 2) {
-    song->channels = 2;
-  }
+  if (new_high)
+    ++ctx->buffer_high;
 
-  song->format   = (song->channels > 1) ? AL_FORMAT_STEREO16 : AL_FORMAT_MONO16;
-  song->channels = song->info.channels;
+  ++ctx->buffer_count;
+  return buffer->id;
+}
 
-  song->buffers      = (uint32_t*)malloc(sizeof(uint32_t) * buffers);
-  song->buffer_sizes = (uint32_t*)malloc(sizeof(uint32_t) * buffers);
-  song->buffer_count = buffers;
-  song->sample_count = stb_vorbis_stream_length_in_samples(song->vorbis);
-  song->length = stb_vorbis_stream_length_in_seconds(song->vorbis) * 1000.f;
+/* Put decoded PCM into a buffer & free it */
+static uint16_t a_buf_upload_pcm(a_ctx* ctx, const char* name, a_pcm* pcm) {
+  int32_t format = (pcm->channels > 1) ? AL_FORMAT_STEREO16 : AL_FORMAT_MONO16;
 
-  if (!song->buffers) {
-    song->data = 0;
-    song->req  = 0;
+  uint16_t id = a_buf_upload(
+      ctx, name, format, pcm->pcm,
+      pcm->samples * pcm->channels * sizeof(int16_t),
+      (uint16_t)pcm->channels, (uint32_t)pcm->sample_rate, pcm->samples, 0);
 
-    free(song->vorbis);
+  free(pcm->pcm);
+  pcm->pcm = 0;
 
-    ASTERA_DBG("a_song_create: unable to allocate %i bytes for buffer IDs",
-               (buffers * sizeof(int32_t)));
+  return id;
+}
 
+// WAV format tags
+#define A_WAV_PCM     0x0001
+#define A_WAV_MSADPCM 0x0002
+#define A_WAV_IMA4    0x0011
+
+/* Load a WAV file's chunks, 8/16 bit PCM & 4 bit IMA ADPCM / MS ADPCM are
+ * supported, ADPCM stays compressed in OpenAL (about 4:1) where the
+ * implementation allows it */
+static uint16_t a_buf_create_wav(a_ctx* ctx, unsigned char* data,
+                                 uint32_t data_length, const char* name) {
+  if (data_length < 12 || strncmp((char*)data, "RIFF", 4) != 0 ||
+      strncmp((char*)&data[8], "WAVE", 4) != 0) {
+    ASTERA_DBG("a_buf_create: not a wave file.\n");
     return 0;
   }
 
-  alGenBuffers(buffers, song->buffers);
-  alGenSources(1, &song->source);
+  uint16_t       tag = 0, channels = 0, block_bytes = 0, bps = 0;
+  uint16_t       block_samples = 0;
+  uint32_t       sample_rate = 0, fact_samples = 0, byte_length = 0;
+  unsigned char* samples = 0;
 
-  for (uint8_t i = 0; i < buffers; ++i) {
-    uint32_t buffer = song->buffers[i], pcm_total_length = 0;
+  // Walk the chunks (padded to 2 bytes), anything unknown is skipped
+  uint32_t offset = 12;
+  while (offset + 8 <= data_length) {
+    uint32_t size  = (uint32_t)_a_load_int32(data, offset + 4);
+    uint32_t start = offset + 8;
 
-    // clear out the pcm for each buffer
-    memset(ctx->pcm, 0, sizeof(uint16_t) * ctx->pcm_length);
+    if (size > data_length - start) {
+      size = data_length - start;
+    }
 
-    for (uint16_t j = 0; j < packets_per_buffer; ++j) {
-      uint32_t pcm_remaining = ctx->pcm_length - pcm_total_length;
+    if (strncmp((char*)&data[offset], "fmt ", 4) == 0 && size >= 16) {
+      tag         = (uint16_t)_a_load_int16(data, start);
+      channels    = (uint16_t)_a_load_int16(data, start + 2);
+      sample_rate = (uint32_t)_a_load_int32(data, start + 4);
+      block_bytes = (uint16_t)_a_load_int16(data, start + 12);
+      bps         = (uint16_t)_a_load_int16(data, start + 14);
 
-      if ((pcm_remaining / song->info.channels) < song->info.max_frame_size) {
-        break;
+      // ADPCM has the samples per block after the extra size
+      if (size >= 20) {
+        block_samples = (uint16_t)_a_load_int16(data, start + 18);
       }
+    } else if (strncmp((char*)&data[offset], "fact", 4) == 0 && size >= 4) {
+      fact_samples = (uint32_t)_a_load_int32(data, start);
+    } else if (strncmp((char*)&data[offset], "data", 4) == 0) {
+      samples     = &data[start];
+      byte_length = size;
+    }
+
+    offset = start + size + (size & 1);
+  }
 
-      uint32_t num_samples = stb_vorbis_get_samples_short_interleaved(
-          song->vorbis, song->channels, ctx->pcm + pcm_total_length,
-          pcm_remaining);
+  if (!samples || !channels || channels > 2 || !sample_rate) {
+    ASTERA_DBG("a_buf_create: missing or invalid wave fmt / data chunk.\n");
+    return 0;
+  }
 
-      song->buffer_sizes[i] = num_samples;
+  if (tag == A_WAV_PCM) {
+    if (bps != 8 && bps != 16) {
+      ASTERA_DBG("a_buf_create: Unsupported wave file format.\n");
+      return 0;
+    }
 
-      if (num_samples > 0) {
-        int32_t sample_count = song->channels * num_samples;
-        pcm_total_length += sample_count;
-      }
+    int32_t format;
+    if (channels == 2) {
+      format = (bps == 16) ? AL_FORMAT_STEREO16 : AL_FORMAT_STEREO8;
+    } else {
+      format = (bps == 16) ? AL_FORMAT_MONO16 : AL_FORMAT_MONO8;
     }
 
-    alBufferData(buffer, song->format, ctx->pcm,
-                 pcm_total_length * sizeof(uint16_t), song->info.sample_rate);
-    alSourceQueueBuffers(song->source, 1, &buffer);
+    return a_buf_upload(ctx, name, format, samples, byte_length, channels,
+                        sample_rate, byte_length / (channels * (bps / 8)),
+                        0);
   }
 
-  if (new_high)
-    ++ctx->song_high;
+  if (tag != A_WAV_IMA4 && tag != A_WAV_MSADPCM) {
+    ASTERA_DBG("a_buf_create: Unsupported wave format tag %x.\n", tag);
+    return 0;
+  }
 
-  ++ctx->song_count;
+  uint8_t ima = tag == A_WAV_IMA4;
 
-  return song->id;
-}
+  if (!alIsExtensionPresent(ima ? "AL_EXT_IMA4" : "AL_SOFT_MSADPCM")) {
+    ASTERA_DBG("a_buf_create: %s ADPCM isn't supported by OpenAL here.\n",
+               ima ? "IMA" : "MS");
+    return 0;
+  }
 
-uint8_t a_song_destroy(a_ctx* ctx, uint16_t id) {
-  if (ctx->song_high < id - 1) {
-    ASTERA_DBG("a_song_destroy: no song in context with ID %i\n", id);
+  // Each block has a header per channel, IMA: 4 bytes then 2 samples a byte,
+  // MS: 7 bytes (holding 2 samples) then 2 samples a byte
+  uint32_t header = (ima ? 4 : 7) * channels;
+  if (block_bytes <= header) {
+    ASTERA_DBG("a_buf_create: invalid ADPCM block size.\n");
     return 0;
   }
 
-  a_song* song = &ctx->songs[id - 1];
+  uint32_t expected = (block_bytes - header) * 2 / channels + (ima ? 1 : 2);
+  if (!block_samples) {
+    block_samples = (uint16_t)expected;
+  }
 
-  alDeleteBuffers(song->buffer_count, song->buffers);
-  alDeleteSources(1, &song->source);
+  if (block_samples != expected) {
+    ASTERA_DBG("a_buf_create: ADPCM block size doesn't match its samples.\n");
+    return 0;
+  }
 
-  stb_vorbis_close(song->vorbis);
+  // Anything but the default block size (IMA 65, MS 64) needs
+  // AL_SOFT_block_alignment
+  uint16_t default_samples = ima ? 65 : 64;
+  if (block_samples != default_samples &&
+      !alIsExtensionPresent("AL_SOFT_block_alignment")) {
+    ASTERA_DBG("a_buf_create: ADPCM block size %i isn't supported here.\n",
+               block_samples);
+    return 0;
+  }
 
-  free(song->buffers);
-  free(song->vorbis);
+  // OpenAL only takes whole blocks
+  uint32_t blocks = byte_length / block_bytes;
+  if (!blocks) {
+    ASTERA_DBG("a_buf_create: no whole ADPCM blocks in the data chunk.\n");
+    return 0;
+  }
 
-  return 1;
-}
+  uint32_t length = blocks * block_samples;
+  if (fact_samples && fact_samples < length) {
+    length = fact_samples;
+  }
 
-a_song* a_song_get_ptr(a_ctx* ctx, uint16_t song_id) {
-  if (ctx->song_high < song_id - 1) {
-    ASTERA_DBG("a_song_destroy: no song in context with ID %i\n", song_id);
-    return 0;
+  int32_t format;
+  if (ima) {
+    format = (channels == 2) ? AL_FORMAT_STEREO_IMA4 : AL_FORMAT_MONO_IMA4;
+  } else {
+    format = (channels == 2) ? AL_FORMAT_STEREO_MSADPCM_SOFT
+                             : AL_FORMAT_MONO_MSADPCM_SOFT;
   }
 
-  return &ctx->songs[song_id - 1];
+  return a_buf_upload(ctx, name, format, samples, blocks * block_bytes,
+                      channels, sample_rate, length, block_samples);
 }
 
-a_song* a_song_get_open(a_ctx* ctx) {
-  if (ctx->song_count == ctx->song_capacity) {
-    ASTERA_DBG("a_song_get_open: no open song slots.\n");
+uint16_t a_buf_create(a_ctx* ctx, unsigned char* data, uint32_t data_length,
+                      const char* name, uint8_t is_ogg) {
+  if (!data || !data_length) {
+    ASTERA_DBG("a_buf_create: no asset passed to load into audio buffer.\n");
     return 0;
   }
 
-  for (uint16_t i = 0; i < ctx->song_capacity; ++i) {
-    a_song* song = &ctx->songs[i];
-    if (!song->source) {
-      return song;
-    }
+  if (ctx->buffer_count == ctx->buffer_capacity) {
+    ASTERA_DBG("a_buf_create: no free buffer slots.\n");
+    return 0;
   }
 
-  return 0;
+  if (!is_ogg) {
+    return a_buf_create_wav(ctx, data, data_length, name);
+  }
+
+  a_pcm pcm;
+  if (!a_pcm_decode(ctx->cache_dir, data, data_length, &pcm)) {
+    ASTERA_DBG("a_buf_create: unable to decode vorbis data.\n");
+    return 0;
+  }
+
+  return a_buf_upload_pcm(ctx, name, &pcm);
 }
 
-uint8_t a_song_play(a_ctx* ctx, uint16_t layer_id, uint16_t song_id,
-                    a_req* req) {
-  a_layer* target_layer = 0;
+typedef struct {
+  // cache_dir - the directory to cache decoded PCM in
+  // loads, results - the files to decode & what they decoded to
+  // count - the amount of files
+  // next - the next file to take (taken atomically)
+  const char* cache_dir;
+  a_buf_load* loads;
+  a_pcm*      results;
+  uint32_t    count;
+  uint32_t    next;
+} a_decode_job;
+
+/* Decode files until there's none left to take */
+static void a_decode_worker(void* data) {
+  a_decode_job* job = (a_decode_job*)data;
+
+  while (1) {
+#if !defined(ASTERA_NO_THREADS)
+    uint32_t i = s_atomic_add(&job->next, 1);
+#else
+    uint32_t i = job->next++;
+#endif
+    if (i >= job->count) {
+      break;
+    }
 
-  if (layer_id) {
-    if (ctx->layer_high >= layer_id - 1) {
-      target_layer = &ctx->layers[layer_id - 1];
+    a_buf_load* load = &job->loads[i];
+    if (load->is_ogg && load->data && load->data_length) {
+      if (!a_pcm_decode(job->cache_dir, load->data, load->data_length,
+                        &job->results[i])) {
+        job->results[i].pcm = 0;
+      }
     }
   }
+}
 
-  if (ctx->song_high < song_id - 1) {
-    ASTERA_DBG("a_song_play: invalid song ID\n");
+uint16_t a_buf_create_many(a_ctx* ctx, a_buf_load* loads, uint16_t count,
+                           uint16_t* ids, uint8_t workers) {
+  if (!loads || !count) {
+    ASTERA_DBG("a_buf_create_many: no buffers passed to create.\n");
     return 0;
   }
 
-  a_song* song = &ctx->songs[song_id - 1];
+  a_pcm* results = (a_pcm*)calloc(count, sizeof(a_pcm));
+  if (!results) {
+    ASTERA_DBG("a_buf_create_many: unable to allocate results.\n");
+    return 0;
+  }
 
-  // Apply fx
-  if (req->fx_count > 0) {
-    for (uint16_t i = 0; i < req->fx_count; ++i) {
-      // Make sure it's valid within the range of filters
-      if (req->fx[i] < ctx->filter_high) {
-        alSource3i(song->source, AL_AUXILIARY_SEND_FILTER,
-                   (ALint)ctx->filter_slots[req->fx[i] - 1].al_id, i, 0);
+  a_decode_job job = (a_decode_job){.cache_dir = ctx->cache_dir,
+                                    .loads     = loads,
+                                    .results   = results,
+                                    .count     = count,
+                                    .next      = 0};
+
+#if !defined(ASTERA_NO_THREADS)
+  // The calling thread decodes too, so it's one less thread to start
+  s_thread* threads[32];
+  uint8_t   thread_count = 0;
+
+  if (workers > 1) {
+    uint8_t want = (workers - 1 < 32) ? workers - 1 : 32;
+    for (uint8_t i = 0; i < want && i + 1 < count; ++i) {
+      threads[thread_count] = s_thread_create(a_decode_worker, &job);
+      if (threads[thread_count]) {
+        ++thread_count;
       }
     }
   }
 
-  // Apply filters
-  if (req->filter_count > 0) {
-    for (uint16_t i = 0; i < req->filter_count; ++i) {
-      if (ctx->filter_high < req->filters[i] - 1) {
-        alSourcei(song->source, AL_DIRECT_FILTER,
-                  ctx->filter_slots[req->filters[i] - 1].al_id);
-      }
-    }
+  a_decode_worker(&job);
+
+  for (uint8_t i = 0; i < thread_count; ++i) {
+    s_thread_join(threads[i]);
   }
+#else
+  (void)workers;
+  a_decode_worker(&job);
+#endif
+
+  // OpenAL buffers are made on the calling thread, in order
+  uint16_t created = 0;
+  for (uint16_t i = 0; i < count; ++i) {
+    a_buf_load* load = &loads[i];
+    uint16_t    id   = 0;
+
+    if (!load->data || !load->data_length) {
+      ASTERA_DBG("a_buf_create_many: no data for %i\n", i);
+    } else if (!load->is_ogg) {
+      id = a_buf_create_wav(ctx, load->data, load->data_length, load->name);
+    } else if (results[i].pcm) {
+      id = a_buf_upload_pcm(ctx, load->name, &results[i]);
+    } else {
+      ASTERA_DBG("a_buf_create_many: unable to decode %i\n", i);
+    }
 
-  song->delta = 0;
-  song->req   = req;
+    if (ids) {
+      ids[i] = id;
+    }
 
-  alSourcef(song->source, AL_GAIN, req->gain);
-  alSource3f(song->source, AL_POSITION, req->position[0], req->position[1],
-             req->position[2]);
-  alSource3f(song->source, AL_VELOCITY, req->velocity[0], req->velocity[1],
-             req->velocity[2]);
+    if (id) {
+      ++created;
+    }
+  }
 
-  alSourcePlay(song->source);
+  // Anything decoded that couldn't be uploaded
+  for (uint16_t i = 0; i < count; ++i) {
+    free(results[i].pcm);
+  }
 
-  return 1;
+  free(results);
+  return created;
 }
 
-uint8_t a_song_stop(a_ctx* ctx, uint16_t song_id) {
-  if (ctx->song_high < song_id - 1) {
-    ASTERA_DBG("a_song_resume: no song in slot %i\n", song_id);
+static uint8_t a_buf_destroy_now(a_ctx* ctx, uint16_t buf_id) {
+  if (ctx->buffer_high < buf_id - 1) {
+    ASTERA_DBG("a_buf_destroy: no buffer in slot %i\n", buf_id);
     return 0;
   }
 
-  a_song* song = &ctx->songs[song_id - 1];
+  a_buf* buffer = &ctx->buffers[buf_id - 1];
+  if (!buffer->buf) {
+    ASTERA_DBG("a_buf_destroy: no buffer in slot %i\n", buf_id);
+    return 0;
+  }
 
-  alSourceStop(song->source);
+  alDeleteBuffers(1, &buffer->buf);
+  buffer->buf = 0;
+
+  --ctx->buffer_count;
 
   return 1;
 }
 
-uint8_t a_song_pause(a_ctx* ctx, uint16_t song_id) {
-  if (ctx->song_high < song_id - 1) {
-    ASTERA_DBG("a_song_resume: no song in slot %i\n", song_id);
-    return 0;
+uint16_t a_buf_get(a_ctx* ctx, const char* name) {
+  for (uint16_t i = 0; i < ctx->buffer_capacity; ++i) {
+    if (strcmp(name, ctx->buffer_names[i]) == 0) {
+      return ctx->buffers[i].id;
+    }
   }
 
-  a_song* song = &ctx->songs[song_id - 1];
+  return 0;
+}
 
-  alSourcePause(song->source);
+a_buf* a_buf_get_id(a_ctx* ctx, uint16_t id) {
+  if (ctx->buffer_high < id - 1) {
+    ASTERA_DBG("a_buf_get_id: id is above the high mark for buffers.\n");
+    return 0;
+  }
 
-  return 1;
+  return &ctx->buffers[id - 1];
 }
 
-uint8_t a_song_resume(a_ctx* ctx, uint16_t song_id) {
-  if (ctx->song_high < song_id - 1) {
-    ASTERA_DBG("a_song_resume: no song in slot %i\n", song_id);
+a_buf* a_buf_get_open(a_ctx* ctx) {
+  if (ctx->buffer_capacity == ctx->buffer_count) {
+    ASTERA_DBG("a_buf_get_open: no open buffers.\n");
     return 0;
   }
 
-  a_song* song = &ctx->songs[song_id - 1];
-
-  alSourcePlay(song->source);
+  for (uint16_t i = 0; i < ctx->buffer_capacity; ++i) {
+    a_buf* buf = &ctx->buffers[i];
+    if (!buf->buf) {
+      return buf;
+    }
+  }
 
-  return 1;
+  return 0;
 }
 
-time_s a_song_get_time(a_ctx* ctx, uint16_t song_id) {
-  if (ctx->song_high < song_id - 1) {
-    ASTERA_DBG("a_song_get_time: no song in slot %i\n", song_id);
-    return -1;
-  }
+float a_listener_get_gain(a_ctx* ctx) { return ctx->listener.gain; }
 
-  a_song* song = &ctx->songs[song_id - 1];
-  return song->delta;
+void a_listener_get_pos(a_ctx* ctx, vec3 dst) {
+  vec3_dup(dst, ctx->listener.position);
 }
 
-uint32_t a_song_get_sample_count(a_ctx* ctx, uint16_t song_id) {
-  if (ctx->song_high < song_id - 1) {
-    ASTERA_DBG("a_song_get_time: no song in slot %i\n", song_id);
-    return -1;
+void a_listener_get_ori(a_ctx* ctx, float dst[6]) {
+  for (uint8_t i = 0; i < 6; ++i) {
+    dst[i] = ctx->listener._ori[i];
   }
+}
 
-  a_song* song = &ctx->songs[song_id - 1];
-
-  return song->sample_count;
+void a_listener_get_vel(a_ctx* ctx, vec3 dst) {
+  vec3_dup(dst, ctx->listener.velocity);
 }
 
-time_s a_song_get_length(a_ctx* ctx, uint16_t song_id) {
-  if (ctx->song_high < song_id - 1) {
-    ASTERA_DBG("a_song_get_length: no song in slot %i\n", song_id);
-    return -1;
-  }
+// The listener's values are kept by the caller for the getters, these only
+// pass them to OpenAL
+static void a_listener_set_gain_now(a_ctx* ctx, float gain) {
+  (void)ctx;
+  alListenerf(AL_GAIN, gain);
+}
 
-  a_song* song = &ctx->songs[song_id - 1];
-  return (time_s)(song->length);
+static void a_listener_set_pos_now(a_ctx* ctx, vec3 position) {
+  alListener3f(AL_POSITION, position[0], position[1], position[2]);
+  vec3_dup(ctx->voice_origin, position);
 }
 
-uint8_t a_song_set_time(a_ctx* ctx, uint16_t song_id, time_s from_start) {
-  if (ctx->song_high < song_id - 1) {
-    ASTERA_DBG("a_song_set_time: no song in list with id %i\n", song_id);
-    return 0;
-  }
+static void a_listener_set_ori_now(a_ctx* ctx, float ori[6]) {
+  (void)ctx;
+  alListenerfv(AL_ORIENTATION, ori);
+}
 
-  a_song* song = &ctx->songs[song_id - 1];
+static void a_listener_set_vel_now(a_ctx* ctx, vec3 velocity) {
+  (void)ctx;
+  alListener3f(AL_VELOCITY, velocity[0], velocity[1], velocity[2]);
+}
 
-  // TODO test this whole thin
-  double  conv_time     = from_start * 1000.0;
-  int32_t approx_sample = conv_time * song->info.sample_rate;
+/* The audio thread's commands, any thread can push them & only the audio
+ * thread applies them */
+typedef enum {
+  A_CMD_SFX_PLAY = 0,
+  A_CMD_SFX_REMOVE,
+  A_CMD_SFX_STOP,
+  A_CMD_SFX_PAUSE,
+  A_CMD_SFX_RESUME,
+  A_CMD_SONG_PLAY,
+  A_CMD_SONG_STOP,
+  A_CMD_SONG_PAUSE,
+  A_CMD_SONG_RESUME,
+  A_CMD_SONG_RESET,
+  A_CMD_SONG_SET_TIME,
+  A_CMD_LAYER_GAIN,
+  A_CMD_LISTENER_GAIN,
+  A_CMD_LISTENER_POS,
+  A_CMD_LISTENER_ORI,
+  A_CMD_LISTENER_VEL,
+  A_CMD_EMITTER_POS,
+  A_CMD_SONG_DESTROY,
+  A_CMD_BUF_DESTROY,
+} a_cmd_type;
+
+typedef struct {
+  // type - the a_cmd_type
+  // id - the sfx, song, layer or emitter affected
+  // target - the layer or buffer to play with
+  // layer - the layer to play a sfx on
+  // req - the request to play with
+  // values - gain, position, orientation or velocity
+  // time - the time to seek to
+  uint32_t type;
+  uint16_t id, target, layer;
+  a_req*   req;
+  float    values[6];
+  time_s   time;
+} a_cmd_data;
+
+struct a_cmd {
+  // seq - the position in the ring this slot is ready for (see a_cmd_push)
+  volatile uint32_t seq;
+  a_cmd_data        data;
+};
+
+#if !defined(ASTERA_NO_THREADS)
+/* Push a command for the audio thread, safe from any amount of threads
+ * (a bounded MPMC queue, each slot's seq says who it belongs to)
+ * returns: 1 = success, 0 = the queue is full */
+static uint8_t a_cmd_push(a_ctx* ctx, a_cmd_data* data) {
+  uint32_t mask = ctx->cmd_capacity - 1;
+  uint32_t pos  = s_atomic_load(&ctx->cmd_head);
+
+  while (1) {
+    a_cmd*  cmd  = &ctx->cmds[pos & mask];
+    int32_t diff = (int32_t)(s_atomic_load(&cmd->seq) - pos);
+
+    if (diff == 0) {
+      // The slot is free for this position, claim the position
+      if (s_atomic_cas(&ctx->cmd_head, pos, pos + 1)) {
+        cmd->data = *data;
+        s_atomic_store(&cmd->seq, pos + 1);
+        return 1;
+      }
+    } else if (diff < 0) {
+      ASTERA_DBG("a_cmd_push: command queue full.\n");
+      return 0;
+    }
 
-  if (approx_sample > song->sample_count) {
-    ASTERA_DBG("a_song_set_time: sample requested %i out of range of song %i\n",
-               approx_sample, song->sample_count);
-    return 0;
+    pos = s_atomic_load(&ctx->cmd_head);
   }
+}
 
-  stb_vorbis_seek_frame(song->vorbis, approx_sample);
+static void a_cmd_exec(a_ctx* ctx, a_cmd_data* cmd) {
+  switch (cmd->type) {
+    case A_CMD_SFX_PLAY: {
+      a_sfx* slot = &ctx->sfx[cmd->id - 1];
+      a_buf* buf  = a_buf_get_id(ctx, cmd->target);
 
-  return 1;
-}
+      // A stolen slot might still be playing the sfx it was taken from
+      uint8_t stolen = slot->buffer && slot->req;
 
-uint8_t a_song_reset(a_ctx* ctx, uint16_t song_id) {
-  if (ctx->song_high < song_id - 1) {
-    ASTERA_DBG("a_song_resume: no song in slot %i\n", song_id);
-    return 0;
+      if (buf) {
+        if (stolen) {
+          a_sfx_clear(ctx, slot);
+        }
+        a_sfx_start(ctx, cmd->layer, slot, buf, cmd->req);
+      } else {
+        a_req_set_valid(cmd->req, 0);
+        a_req_set_state(cmd->req, AL_STOPPED);
+        a_sfx_set_claimed(slot, (stolen) ? A_SFX_LIVE : A_SFX_FREE);
+      }
+    } break;
+    case A_CMD_SFX_REMOVE:
+      a_sfx_remove_now(ctx, cmd->id);
+      break;
+    case A_CMD_SFX_STOP:
+      a_sfx_stop_now(ctx, cmd->id);
+      break;
+    case A_CMD_SFX_PAUSE:
+      a_sfx_pause_now(ctx, cmd->id);
+      break;
+    case A_CMD_SFX_RESUME:
+      a_sfx_resume_now(ctx, cmd->id);
+      break;
+    case A_CMD_SONG_PLAY:
+      a_song_play_now(ctx, cmd->target, cmd->id, cmd->req);
+      break;
+    case A_CMD_SONG_STOP:
+      a_song_stop_now(ctx, cmd->id);
+      break;
+    case A_CMD_SONG_PAUSE:
+      a_song_pause_now(ctx, cmd->id);
+      break;
+    case A_CMD_SONG_RESUME:
+      a_song_resume_now(ctx, cmd->id);
+      break;
+    case A_CMD_SONG_RESET:
+      a_song_reset_now(ctx, cmd->id);
+      break;
+    case A_CMD_SONG_SET_TIME:
+      a_song_set_time_now(ctx, cmd->id, cmd->time);
+      break;
+    case A_CMD_LAYER_GAIN:
+      a_layer_set_gain_now(ctx, cmd->id, cmd->values[0]);
+      break;
+    case A_CMD_LISTENER_GAIN:
+      a_listener_set_gain_now(ctx, cmd->values[0]);
+      break;
+    case A_CMD_LISTENER_POS:
+      a_listener_set_pos_now(ctx, cmd->values);
+      break;
+    case A_CMD_LISTENER_ORI:
+      a_listener_set_ori_now(ctx, cmd->values);
+      break;
+    case A_CMD_LISTENER_VEL:
+      a_listener_set_vel_now(ctx, cmd->values);
+      break;
+    case A_CMD_EMITTER_POS:
+      a_emitter_set_pos_now(ctx, cmd->id, cmd->values);
+      break;
+    case A_CMD_SONG_DESTROY:
+      a_song_destroy_now(ctx, cmd->id);
+      break;
+    case A_CMD_BUF_DESTROY:
+      a_buf_destroy_now(ctx, cmd->id);
+      break;
   }
+}
 
-  a_song* song = &ctx->songs[song_id - 1];
+/* Apply every command pushed so far (audio thread only) */
+static void a_cmd_apply(a_ctx* ctx) {
+  uint32_t mask = ctx->cmd_capacity - 1;
 
-  song->delta         = 0.f;
-  song->curr          = 0.f;
-  song->sample_offset = 0;
+  while (1) {
+    uint32_t pos = ctx->cmd_tail;
+    a_cmd*   cmd = &ctx->cmds[pos & mask];
 
-  stb_vorbis_seek_start(song->vorbis);
+    if ((int32_t)(s_atomic_load(&cmd->seq) - (pos + 1)) < 0) {
+      break;
+    }
 
-  // uint32_t error = stb_vorbis_get_error(song->vorbis);
+    a_cmd_exec(ctx, &cmd->data);
 
-  // Unqueue anything existing
-  alSourceStop(song->source);
-  alSourceUnqueueBuffers(song->source, song->buffer_count, song->buffers);
+    // Hand the slot back to producers for its next lap of the ring
+    s_atomic_store(&cmd->seq, pos + ctx->cmd_capacity);
+    ctx->cmd_tail = pos + 1;
+  }
+}
 
-  for (uint8_t i = 0; i < song->buffer_count; ++i) {
-    uint32_t buffer = song->buffers[i];
-    float    buf_time =
-        (float)((float)song->buffer_sizes[0] / song->info.sample_rate) * 1000.f;
-    song->curr += buf_time;
+static void a_audio_thread(void* data) {
+  a_ctx* ctx = (a_ctx*)data;
 
-    memset(ctx->pcm, 0, ctx->pcm_length * sizeof(uint16_t));
-    uint32_t pcm_total_length = 0;
+  while (!s_atomic_load(&ctx->audio_quit)) {
+    time_s start = s_get_time();
 
-    for (uint16_t p = 0; p < song->packets_per_buffer; ++p) {
-      uint32_t pcm_remaining = ctx->pcm_length - pcm_total_length;
+    a_cmd_apply(ctx);
+    a_ctx_update_now(ctx);
 
-      if (pcm_remaining < song->info.max_frame_size) {
-        break;
-      }
+    time_s remaining = ctx->audio_interval - (s_get_time() - start);
+    if (remaining > 0.0) {
+      s_sleep(remaining);
+    }
+  }
 
-      if (pcm_remaining == 0) {
-        break;
-      }
+  // Anything pushed before stopping still gets applied
+  a_cmd_apply(ctx);
+}
 
-      uint32_t num_samples = stb_vorbis_get_samples_short_interleaved(
-          song->vorbis, song->channels, ctx->pcm + pcm_total_length,
-          pcm_remaining);
+uint8_t a_ctx_thread_start(a_ctx* ctx, uint32_t queue_size, time_s interval) {
+  if (ctx->audio_thread) {
+    ASTERA_DBG("a_ctx_thread_start: already threaded.\n");
+    return 0;
+  }
 
-      if (num_samples > 0) {
-        int32_t sample_count = song->channels * num_samples;
-        pcm_total_length += sample_count;
-      }
+  if (interval <= 0.0) {
+    ASTERA_DBG("a_ctx_thread_start: interval must be above 0.\n");
+    return 0;
+  }
 
-      for (uint8_t i = 0; i < song->buffer_count - 1; ++i) {
-        song->buffer_sizes[i] = song->buffer_sizes[i + 1];
-      }
+  // The ring's positions wrap with a mask, so round up to a power of 2
+  uint32_t capacity = 64;
+  while (capacity < queue_size) {
+    capacity *= 2;
+  }
 
-      song->buffer_sizes[song->buffer_count - 1] = num_samples;
-    }
+  ctx->cmds = (a_cmd*)malloc(sizeof(a_cmd) * capacity);
+  if (!ctx->cmds) {
+    ASTERA_DBG("a_ctx_thread_start: unable to allocate command queue.\n");
+    return 0;
+  }
 
-    stb_vorbis_info info = stb_vorbis_get_info(song->vorbis);
+  for (uint32_t i = 0; i < capacity; ++i) {
+    ctx->cmds[i].seq = i;
+  }
 
-    alBufferData(buffer, song->format, ctx->pcm,
-                 pcm_total_length * sizeof(uint16_t), info.sample_rate);
-    alSourceQueueBuffers(song->source, 1, &buffer);
+  ctx->cmd_capacity   = capacity;
+  ctx->cmd_head       = 0;
+  ctx->cmd_tail       = 0;
+  ctx->audio_interval = interval;
+  ctx->audio_quit     = 0;
+
+  ctx->audio_thread = s_thread_create(a_audio_thread, ctx);
+  if (!ctx->audio_thread) {
+    ASTERA_DBG("a_ctx_thread_start: unable to create thread.\n");
+    free(ctx->cmds);
+    ctx->cmds         = 0;
+    ctx->cmd_capacity = 0;
+    return 0;
   }
 
   return 1;
 }
 
-ALenum a_song_get_state(a_ctx* ctx, uint16_t song_id) {
-  if (ctx->song_high < song_id - 1) {
-    ASTERA_DBG("a_song_get_state: no song with ID %i\n", song_id);
-    return AL_STOPPED;
+void a_ctx_thread_stop(a_ctx* ctx) {
+  if (!ctx->audio_thread) {
+    return;
   }
 
-  ALenum   state;
-  uint32_t source = ctx->songs[song_id - 1].source;
-  if (!source) {
-    return AL_STOPPED;
-  } else {
-    alGetSourcei(source, AL_SOURCE_STATE, &state);
-    return state;
-  }
-}
+  s_atomic_store(&ctx->audio_quit, 1);
+  s_thread_join(ctx->audio_thread);
+  ctx->audio_thread = 0;
 
-uint16_t a_song_get_id(a_ctx* ctx, const char* name) {
-  if (ctx->song_count == 0) {
-    ASTERA_DBG("a_song_get_id: no songs in context.\n");
-    return 0;
-  }
+  free(ctx->cmds);
+  ctx->cmds         = 0;
+  ctx->cmd_capacity = 0;
 
-  for (uint16_t i = 0; i < ctx->song_high; ++i) {
-    if (strcmp(ctx->song_names[i], name) == 0) {
-      // Song IDs are their index + 1
-      return i + 1;
+  // Slots were claimed by their flag while threaded, rebuild the free list
+  ctx->sfx_free_count = 0;
+  for (uint16_t i = ctx->sfx_capacity; i > 0; --i) {
+    if (!ctx->sfx[i - 1].claimed) {
+      ctx->sfx_free[ctx->sfx_free_count++] = i - 1;
     }
   }
-
-  return 0;
-}
-
-static int16_t _a_load_int16(unsigned char* data, int offset) {
-  return *((int16_t*)&data[offset]);
 }
+#endif
 
-static int32_t _a_load_int32(unsigned char* data, int offset) {
-  return *((int32_t*)&data[offset]);
+uint8_t a_ctx_threaded(a_ctx* ctx) {
+#if !defined(ASTERA_NO_THREADS)
+  return ctx->audio_thread != 0;
+#else
+  (void)ctx;
+  return 0;
+#endif
 }
 
-uint16_t a_buf_create(a_ctx* ctx, unsigned char* data, uint32_t data_length,
-                      const char* name, uint8_t is_ogg) {
-  if (!data || !data_length) {
-    ASTERA_DBG("a_buf_create: no asset passed to load into audio buffer.\n");
-    return 0;
-  }
+#if !defined(ASTERA_NO_THREADS)
+#define A_CMD_PUSH(ctx, ...)                                                   \
+  do {                                                                         \
+    a_cmd_data _cmd = (a_cmd_data){__VA_ARGS__};                               \
+    return a_cmd_push(ctx, &_cmd);                                             \
+  } while (0)
+#endif
 
-  if (ctx->buffer_count == ctx->buffer_capacity) {
-    ASTERA_DBG("a_buf_create: no free buffer slots.\n");
-    return 0;
+void a_ctx_update(a_ctx* ctx) {
+  // The audio thread updates itself
+  if (a_ctx_threaded(ctx)) {
+    return;
   }
 
-  a_buf* buffer = 0;
+  a_ctx_update_now(ctx);
+}
 
-  // Find open buffer
-  for (uint16_t i = 0; i < ctx->buffer_high; ++i) {
-    if (ctx->buffers[i].buf == 0) {
-      buffer = &ctx->buffers[i];
-      break;
-    }
+#if !defined(ASTERA_NO_THREADS)
+/* Get a layer's gain from outside the audio thread while threaded */
+static float a_layer_gain_shared(a_ctx* ctx, uint16_t layer_id) {
+  if (!layer_id || layer_id > ctx->layer_capacity) {
+    return 1.f;
   }
 
-  int8_t new_high = 0;
-  if (!buffer && ctx->buffer_high < ctx->buffer_capacity - 1) {
-    buffer   = &ctx->buffers[ctx->buffer_high];
-    new_high = 1;
-  } else {
-    ASTERA_DBG("a_buf_create: no free buffer slots.\n");
-    return 0;
-  }
+  uint32_t bits =
+      s_atomic_load((volatile uint32_t*)&ctx->layers[layer_id - 1].gain);
 
-  alGenBuffers(1, &buffer->buf);
+  float gain;
+  memcpy(&gain, &bits, sizeof(float));
+  return gain;
+}
 
-  if (is_ogg) {
-    int32_t error;
+/* Promise the lowest ranked sfx's slot to a request that outranks it, from
+ * outside the audio thread. The audio thread stops the old sfx once the new
+ * one's play command reaches it (see a_sfx_steal)
+ * returns: the slot promised, 0 = nothing ranks lower */
+static a_sfx* a_sfx_steal_shared(a_ctx* ctx, uint16_t layer, a_req* req) {
+  float    audibility = a_audibility(req, a_layer_gain_shared(ctx, layer),
+                                     ctx->listener.position);
+  uint64_t incoming   = a_rank_key(req->priority, audibility);
 
-    stb_vorbis* vorbis = stb_vorbis_open_memory(data, data_length, &error, 0);
+  a_sfx*   victim = 0;
+  uint64_t lowest = 0;
 
-    if (!vorbis) {
-      ASTERA_DBG(
-          "a_buf_create: unable to open vorbis header, vorbis error %i\n",
-          error);
-      return 0;
+  for (uint16_t i = 0; i < ctx->sfx_capacity; ++i) {
+    a_sfx* sfx = &ctx->sfx[i];
+    if (s_atomic_load(&sfx->claimed) != A_SFX_LIVE) {
+      continue;
     }
 
-    uint16_t* pcm;
-    int32_t   format, sample_rate, channels;
-
-    int32_t byte_length = stb_vorbis_decode_memory(data, data_length, &channels,
-                                                   &sample_rate, &pcm);
-
-    format = (channels > 1) ? AL_FORMAT_STEREO16 : AL_FORMAT_MONO16;
-
-    buffer->length      = vorbis->total_samples;
-    buffer->sample_rate = sample_rate;
-    buffer->channels    = channels;
+    uint64_t rank = s_atomic_load64(&sfx->rank);
+    if (!victim || rank < lowest) {
+      victim = sfx;
+      lowest = rank;
+    }
+  }
 
-    alBufferData(buffer->buf, format, pcm, byte_length, sample_rate);
+  if (!victim || incoming <= lowest) {
+    return 0;
+  }
 
-    // TODO test if we can free this buffer directly after
-    // free(pcm);
+  // Fails if it stopped or was taken since
+  if (!s_atomic_cas(&victim->claimed, A_SFX_LIVE, A_SFX_STOLEN)) {
+    return 0;
+  }
 
-    free(vorbis);
-  } else {
-    int16_t channels    = _a_load_int16(data, 22);
-    int32_t sample_rate = _a_load_int32(data, 24);
-    int32_t byte_rate   = _a_load_int32(data, 28);
-    int32_t bps         = _a_load_int16(data, 34);
+  return victim;
+}
+#endif
 
-    if (strncmp(&data[36], "data", 4) != 0) {
+uint16_t a_sfx_play(a_ctx* ctx, uint16_t layer, uint16_t buf_id, a_req* req) {
+#if !defined(ASTERA_NO_THREADS)
+  if (ctx->audio_thread) {
+    if (!a_buf_get_id(ctx, buf_id)) {
+      ASTERA_DBG("a_sfx_play: unable to find %i\n", buf_id);
       return 0;
     }
 
-    int32_t byte_length = _a_load_int32(data, 40);
+    // Claim a slot here so the ID can be returned right away
+    a_sfx* slot = 0;
+    for (uint16_t i = 0; i < ctx->sfx_capacity; ++i) {
+      if (s_atomic_cas(&ctx->sfx[i].claimed, A_SFX_FREE, A_SFX_CLAIMED)) {
+        slot = &ctx->sfx[i];
+        break;
+      }
+    }
 
-    int32_t format = -1;
-    if (channels == 2) {
-      format = (bps == 16) ? AL_FORMAT_STEREO16 : AL_FORMAT_STEREO8;
-    } else if (channels == 1) {
-      format = (bps == 16) ? AL_FORMAT_MONO16 : AL_FORMAT_MONO8;
+    uint8_t stolen = 0;
+    if (!slot) {
+      slot   = a_sfx_steal_shared(ctx, layer, req);
+      stolen = 1;
     }
 
-    if (format == -1) {
-      ASTERA_DBG("a_buf_create: Unsupported wave file format.\n");
+    if (!slot) {
+      ASTERA_DBG("a_sfx_play: no free sfx slots.\n");
       return 0;
     }
 
-    buffer->channels    = channels;
-    buffer->sample_rate = sample_rate;
-    buffer->length      = (uint32_t)byte_length / bps;
+    a_req_set_valid(req, 1);
+    a_req_set_state(req, AL_INITIAL);
+
+    a_cmd_data cmd = (a_cmd_data){.type   = A_CMD_SFX_PLAY,
+                                  .id     = slot->id,
+                                  .target = buf_id,
+                                  .layer  = layer,
+                                  .req    = req};
+    if (!a_cmd_push(ctx, &cmd)) {
+      // Give a stolen slot back, unless it stopped & was handed over already
+      if (!stolen ||
+          !s_atomic_cas(&slot->claimed, A_SFX_STOLEN, A_SFX_LIVE)) {
+        a_sfx_set_claimed(slot, A_SFX_FREE);
+      }
+      a_req_set_valid(req, 0);
+      a_req_set_state(req, AL_STOPPED);
+      return 0;
+    }
 
-    alBufferData(buffer->buf, format, &data[44], byte_length, sample_rate);
+    return slot->id;
   }
+#endif
 
-  ctx->buffer_names[buffer->id - 1] = name;
-
-  if (new_high)
-    ++ctx->buffer_high;
-
-  ++ctx->buffer_count;
-  return buffer->id;
+  return a_sfx_play_now(ctx, layer, buf_id, req);
 }
 
-uint8_t a_buf_destroy(a_ctx* ctx, uint16_t buf_id) {
-  if (ctx->buffer_high < buf_id - 1) {
-    ASTERA_DBG("a_buf_destroy: no buffer in slot %i\n", buf_id);
-    return 0;
-  }
-
-  a_buf* buffer = &ctx->buffers[buf_id - 1];
-  alDeleteBuffers(1, buffer->buf);
-  buffer->buf = 0;
-
-  return 1;
+uint8_t a_sfx_remove(a_ctx* ctx, uint16_t sfx_id) {
+#if !defined(ASTERA_NO_THREADS)
+  if (ctx->audio_thread)
+    A_CMD_PUSH(ctx, .type = A_CMD_SFX_REMOVE, .id = sfx_id);
+#endif
+  return a_sfx_remove_now(ctx, sfx_id);
 }
 
-uint16_t a_buf_get(a_ctx* ctx, const char* name) {
-  for (uint16_t i = 0; i < ctx->buffer_capacity; ++i) {
-    if (strcmp(name, ctx->buffer_names[i]) == 0) {
-      return ctx->buffers[i].id;
-    }
-  }
-
-  return 0;
+uint8_t a_sfx_stop(a_ctx* ctx, uint16_t sfx_id) {
+#if !defined(ASTERA_NO_THREADS)
+  if (ctx->audio_thread)
+    A_CMD_PUSH(ctx, .type = A_CMD_SFX_STOP, .id = sfx_id);
+#endif
+  return a_sfx_stop_now(ctx, sfx_id);
 }
 
-a_buf* a_buf_get_id(a_ctx* ctx, uint16_t id) {
-  if (ctx->buffer_high < id - 1) {
-    ASTERA_DBG("a_buf_get_id: id is above the high mark for buffers.\n");
-    return 0;
-  }
+uint8_t a_sfx_pause(a_ctx* ctx, uint16_t sfx_id) {
+#if !defined(ASTERA_NO_THREADS)
+  if (ctx->audio_thread)
+    A_CMD_PUSH(ctx, .type = A_CMD_SFX_PAUSE, .id = sfx_id);
+#endif
+  return a_sfx_pause_now(ctx, sfx_id);
+}
 
-  return &ctx->buffers[id - 1];
+uint8_t a_sfx_resume(a_ctx* ctx, uint16_t sfx_id) {
+#if !defined(ASTERA_NO_THREADS)
+  if (ctx->audio_thread)
+    A_CMD_PUSH(ctx, .type = A_CMD_SFX_RESUME, .id = sfx_id);
+#endif
+  return a_sfx_resume_now(ctx, sfx_id);
 }
 
-a_buf* a_buf_get_open(a_ctx* ctx) {
-  if (ctx->buffer_capacity == ctx->buffer_count) {
-    ASTERA_DBG("a_buf_get_open: no open buffers.\n");
-    return 0;
-  }
+uint8_t a_song_play(a_ctx* ctx, uint16_t layer_id, uint16_t song_id,
+                    a_req* req) {
+#if !defined(ASTERA_NO_THREADS)
+  if (ctx->audio_thread)
+    A_CMD_PUSH(ctx, .type = A_CMD_SONG_PLAY, .id = song_id, .target = layer_id,
+               .req = req);
+#endif
+  return a_song_play_now(ctx, layer_id, song_id, req);
+}
 
-  for (uint16_t i = 0; i < ctx->buffer_capacity; ++i) {
-    a_buf* buf = &ctx->buffers[i];
-    if (!buf->buf) {
-      return buf;
-    }
-  }
+uint8_t a_song_stop(a_ctx* ctx, uint16_t song_id) {
+#if !defined(ASTERA_NO_THREADS)
+  if (ctx->audio_thread)
+    A_CMD_PUSH(ctx, .type = A_CMD_SONG_STOP, .id = song_id);
+#endif
+  return a_song_stop_now(ctx, song_id);
+}
 
-  return 0;
+uint8_t a_song_pause(a_ctx* ctx, uint16_t song_id) {
+#if !defined(ASTERA_NO_THREADS)
+  if (ctx->audio_thread)
+    A_CMD_PUSH(ctx, .type = A_CMD_SONG_PAUSE, .id = song_id);
+#endif
+  return a_song_pause_now(ctx, song_id);
 }
 
-float a_listener_get_gain(a_ctx* ctx) { return ctx->listener.gain; }
+uint8_t a_song_resume(a_ctx* ctx, uint16_t song_id) {
+#if !defined(ASTERA_NO_THREADS)
+  if (ctx->audio_thread)
+    A_CMD_PUSH(ctx, .type = A_CMD_SONG_RESUME, .id = song_id);
+#endif
+  return a_song_resume_now(ctx, song_id);
+}
 
-void a_listener_get_pos(a_ctx* ctx, vec3 dst) {
-  vec3_dup(dst, ctx->listener.position);
+uint8_t a_song_reset(a_ctx* ctx, uint16_t song_id) {
+#if !defined(ASTERA_NO_THREADS)
+  if (ctx->audio_thread)
+    A_CMD_PUSH(ctx, .type = A_CMD_SONG_RESET, .id = song_id);
+#endif
+  return a_song_reset_now(ctx, song_id);
 }
 
-void a_listener_get_ori(a_ctx* ctx, float dst[6]) {
-  for (uint8_t i = 0; i < 6; ++i) {
-    dst[i] = ctx->listener._ori[i];
-  }
+uint8_t a_song_set_time(a_ctx* ctx, uint16_t song_id, time_s from_start) {
+#if !defined(ASTERA_NO_THREADS)
+  if (ctx->audio_thread)
+    A_CMD_PUSH(ctx, .type = A_CMD_SONG_SET_TIME, .id = song_id,
+               .time = from_start);
+#endif
+  return a_song_set_time_now(ctx, song_id, from_start);
 }
 
-void a_listener_get_vel(a_ctx* ctx, vec3 dst) {
-  vec3_dup(dst, ctx->listener.velocity);
+uint8_t a_layer_set_gain(a_ctx* ctx, uint16_t layer_id, float gain) {
+#if !defined(ASTERA_NO_THREADS)
+  if (ctx->audio_thread)
+    A_CMD_PUSH(ctx, .type = A_CMD_LAYER_GAIN, .id = layer_id,
+               .values = {gain});
+#endif
+  return a_layer_set_gain_now(ctx, layer_id, gain);
 }
 
 void a_listener_set_gain(a_ctx* ctx, float gain) {
   ctx->listener.gain = gain;
-  alListenerf(AL_GAIN, gain);
+
+#if !defined(ASTERA_NO_THREADS)
+  if (ctx->audio_thread) {
+    a_cmd_data cmd = (a_cmd_data){.type = A_CMD_LISTENER_GAIN, .values = {gain}};
+    a_cmd_push(ctx, &cmd);
+    return;
+  }
+#endif
+
+  a_listener_set_gain_now(ctx, gain);
 }
 
 void a_listener_set_pos(a_ctx* ctx, vec3 position) {
   vec3_dup(ctx->listener.position, position);
-  alListener3f(AL_POSITION, position[0], position[1], position[2]);
+
+#if !defined(ASTERA_NO_THREADS)
+  if (ctx->audio_thread) {
+    a_cmd_data cmd = (a_cmd_data){.type = A_CMD_LISTENER_POS};
+    vec3_dup(cmd.values, position);
+    a_cmd_push(ctx, &cmd);
+    return;
+  }
+#endif
+
+  a_listener_set_pos_now(ctx, position);
 }
 
 void a_listener_set_ori(a_ctx* ctx, float ori[6]) {
@@ -1555,12 +3690,84 @@ void a_listener_set_ori(a_ctx* ctx, float ori[6]) {
     ctx->listener._ori[i] = ori[i];
   }
 
-  alListenerfv(AL_ORIENTATION, ctx->listener._ori);
+#if !defined(ASTERA_NO_THREADS)
+  if (ctx->audio_thread) {
+    a_cmd_data cmd = (a_cmd_data){.type = A_CMD_LISTENER_ORI};
+    memcpy(cmd.values, ori, sizeof(float) * 6);
+    a_cmd_push(ctx, &cmd);
+    return;
+  }
+#endif
+
+  a_listener_set_ori_now(ctx, ori);
 }
 
 void a_listener_set_vel(a_ctx* ctx, vec3 velocity) {
   vec3_dup(ctx->listener.velocity, velocity);
-  alListener3f(AL_VELOCITY, velocity[0], velocity[1], velocity[2]);
+
+#if !defined(ASTERA_NO_THREADS)
+  if (ctx->audio_thread) {
+    a_cmd_data cmd = (a_cmd_data){.type = A_CMD_LISTENER_VEL};
+    vec3_dup(cmd.values, velocity);
+    a_cmd_push(ctx, &cmd);
+    return;
+  }
+#endif
+
+  a_listener_set_vel_now(ctx, velocity);
+}
+
+uint8_t a_emitter_set_pos(a_ctx* ctx, uint16_t emitter_id, vec3 position) {
+#if !defined(ASTERA_NO_THREADS)
+  if (ctx->audio_thread) {
+    a_cmd_data cmd = (a_cmd_data){.type = A_CMD_EMITTER_POS, .id = emitter_id};
+    vec3_dup(cmd.values, position);
+    return a_cmd_push(ctx, &cmd);
+  }
+#endif
+
+  return a_emitter_set_pos_now(ctx, emitter_id, position);
+}
+
+uint8_t a_song_destroy(a_ctx* ctx, uint16_t id) {
+#if !defined(ASTERA_NO_THREADS)
+  // The audio thread might be decoding it
+  if (ctx->audio_thread)
+    A_CMD_PUSH(ctx, .type = A_CMD_SONG_DESTROY, .id = id);
+#endif
+  return a_song_destroy_now(ctx, id);
+}
+
+uint8_t a_buf_destroy(a_ctx* ctx, uint16_t buf_id) {
+#if !defined(ASTERA_NO_THREADS)
+  if (ctx->audio_thread)
+    A_CMD_PUSH(ctx, .type = A_CMD_BUF_DESTROY, .id = buf_id);
+#endif
+  return a_buf_destroy_now(ctx, buf_id);
+}
+
+time_s a_req_get_time(a_req* req) {
+#if !defined(ASTERA_NO_THREADS)
+  time_s time;
+  if (sizeof(time_s) == sizeof(uint64_t)) {
+    uint64_t bits = s_atomic_load64((volatile uint64_t*)&req->time);
+    memcpy(&time, &bits, sizeof(uint64_t));
+  } else {
+    uint32_t bits = s_atomic_load((volatile uint32_t*)&req->time);
+    memcpy(&time, &bits, sizeof(uint32_t));
+  }
+  return time;
+#else
+  return req->time;
+#endif
+}
+
+uint32_t a_req_get_state(a_req* req) {
+#if !defined(ASTERA_NO_THREADS)
+  return s_atomic_load(&req->state);
+#else
+  return req->state;
+#endif
 }
 
 a_req a_req_create(vec3 position, float gain, float range, uint8_t loop,
@@ -1581,7 +3788,7 @@ a_req a_req_create(vec3 position, float gain, float range, uint8_t loop,
 }
 
 uint16_t a_fx_create(a_ctx* ctx, a_fx_type type, void* data) {
-  if (type != REVERB || type != EQ) {
+  if (type != REVERB && type != EQ) {
     ASTERA_DBG("a_fx_use: invalid type of effect passed.\n");
     return 0;
   }
@@ -1598,7 +3805,7 @@ uint16_t a_fx_create(a_ctx* ctx, a_fx_type type, void* data) {
   int8_t new_high = 0;
   if (!slot) {
     // Check for a free slot after the high water mark
-    if (ctx->fx_high < ctx->fx_capacity - 1) {
+    if (ctx->fx_high < ctx->fx_capacity) {
       slot     = &ctx->fx_slots[ctx->fx_high];
       new_high = 1;
     } else {
@@ -1607,7 +3814,6 @@ uint16_t a_fx_create(a_ctx* ctx, a_fx_type type, void* data) {
     }
   }
 
-  ++ctx->fx_count;
   alGenEffects(1, &slot->effect_id);
   alGenAuxiliaryEffectSlots(1, &slot->slot_id);
 
@@ -1659,9 +3865,13 @@ uint16_t a_fx_create(a_ctx* ctx, a_fx_type type, void* data) {
       return 0;
   }
 
+  // Sources send to the slot, which runs the effect
+  alAuxiliaryEffectSloti(slot->slot_id, AL_EFFECTSLOT_EFFECT,
+                         (ALint)slot->effect_id);
+
   ++ctx->fx_count;
   if (new_high) {
-    ctx->fx_high = slot->id - 1;
+    ctx->fx_high = slot->id;
   }
 
   // NOTE: slot->id is the index + 1 of the slot in the context's array of
@@ -1674,31 +3884,30 @@ uint16_t a_fx_create(a_ctx* ctx, a_fx_type type, void* data) {
  * fx_id - the ID of the effect
  * returns: success = 1, fail = 0 */
 uint8_t a_fx_destroy(a_ctx* ctx, uint16_t fx_id) {
-  if (ctx->fx_high < fx_id - 1) {
-    ASTERA_DBG("a_fx_remove: no fx in that slot.\n");
+  if (!fx_id || fx_id > ctx->fx_high || !ctx->fx_slots[fx_id - 1].slot_id) {
+    ASTERA_DBG("a_fx_destroy: no fx in slot %i\n", fx_id);
     return 0;
   }
 
-  alDeleteEffects(1, &ctx->fx_slots[fx_id - 1].effect_id);
-  alDeleteAuxiliaryEffectSlots(1, &ctx->fx_slots[fx_id - 1].slot_id);
+  a_fx* slot = &ctx->fx_slots[fx_id - 1];
+
+  // The slot goes first, it holds onto the effect
+  alDeleteAuxiliaryEffectSlots(1, &slot->slot_id);
+  alDeleteEffects(1, &slot->effect_id);
+
+  slot->slot_id   = 0;
+  slot->effect_id = 0;
 
   --ctx->fx_count;
-  if (ctx->fx_high == fx_id - 1) {
-    if (ctx->fx_count > 0) {
-      for (uint16_t i = ctx->fx_high; i > 0; --i) {
-        if (ctx->fx_slots[i].slot_id) {
-          ctx->fx_high = i;
-          break;
-        }
-      }
-    }
+  while (ctx->fx_high > 0 && !ctx->fx_slots[ctx->fx_high - 1].slot_id) {
+    --ctx->fx_high;
   }
 
   return 1;
 }
 
 uint8_t a_fx_update(a_ctx* ctx, uint16_t fx_id) {
-  if (ctx->fx_high < fx_id - 1) {
+  if (!fx_id || fx_id > ctx->fx_high || !ctx->fx_slots[fx_id - 1].slot_id) {
     ASTERA_DBG("a_fx_update: no fx in slot %i\n", fx_id);
     return 0;
   }
@@ -1744,16 +3953,16 @@ uint8_t a_fx_update(a_ctx* ctx, uint16_t fx_id) {
 }
 
 a_fx_type a_fx_get_type(a_ctx* ctx, uint16_t fx_id) {
-  if (ctx->fx_high < fx_id - 1) {
+  if (!fx_id || fx_id > ctx->fx_high || !ctx->fx_slots[fx_id - 1].slot_id) {
     ASTERA_DBG("a_fx_get_type: no fx in slot %i\n", fx_id);
-    return 0;
+    return NONE;
   }
 
   return ctx->fx_slots[fx_id - 1].type;
 }
 
 a_fx* a_fx_get_slot(a_ctx* ctx, uint16_t fx_id) {
-  if (ctx->fx_high < fx_id - 1) {
+  if (!fx_id || fx_id > ctx->fx_high || !ctx->fx_slots[fx_id - 1].slot_id) {
     ASTERA_DBG("a_fx_get_slot: no fx in slot %i\n", fx_id);
     return 0;
   }
@@ -11,10 +11,382 @@
 #include <assert.h>
 
 #include <string.h>
+#include <stdio.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb_image.h>
 
+// PNG encoding for readbacks, miniz itself is compiled with zip.c
+#define MINIZ_HEADER_FILE_ONLY
+#define MINIZ_NO_ZLIB_COMPATIBLE_NAMES
+#include <miniz.h>
+
+// Used to build alpha masks for r_sheet_create_auto & to bin lights
+#if defined(__SSE2__) || defined(_M_X64) || \
+    (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define R_SSE2
+#endif
+
+typedef enum {
+  R_CMD_NONE = 0,
+  R_CMD_CAMERA,
+  R_CMD_CLEAR,
+  R_CMD_CLEAR_COLOR,
+  R_CMD_VIEWPORT,
+  R_CMD_FBO_BIND,
+  R_CMD_FBO_DRAW,
+  R_CMD_SPRITE,
+  R_CMD_BAKED,
+  R_CMD_PARTICLES,
+  R_CMD_FLUSH,
+  R_CMD_IM,
+  R_CMD_BAKED_PACK,
+  R_CMD_READBACK,
+  R_CMD_LIGHTS,
+} r_cmd_type;
+
+typedef struct {
+  // type - the r_cmd_type of the command
+  // size - the size of the payload following this header (8 byte aligned)
+  uint32_t type, size;
+} r_cmd;
+
+typedef struct {
+  // data - the packed commands (header followed by payload)
+  // size - the amount of bytes used
+  // capacity - the amount of bytes allocated
+  uint8_t* data;
+  uint32_t size, capacity;
+} r_cmd_list;
+
+typedef struct {
+  mat4x4 view, projection;
+} r_cmd_camera;
+
+typedef struct {
+  vec4 color;
+} r_cmd_color;
+
+typedef struct {
+  int32_t width, height;
+} r_cmd_viewport;
+
+typedef struct {
+  // fbo - the framebuffer to bind / draw
+  // gamma - the gamma to draw the framebuffer with
+  r_framebuffer fbo;
+  float         gamma;
+} r_cmd_fbo;
+
+typedef struct {
+  r_shader shader;
+  r_sheet* sheet;
+  mat4x4   model;
+  vec4     color, coords;
+  uint8_t  flip_x, flip_y, layer, opaque;
+} r_cmd_sprite;
+
+typedef struct {
+  // pack - the pack to draw (must outlive the frame)
+  // count - the amount of chunk indices following the command
+  // all - draw every chunk rather than the list
+  r_shader      shader;
+  r_baked_pack* pack;
+  uint32_t      count, all;
+} r_cmd_baked_pack;
+
+typedef struct {
+  // count - the amount of lights following the command
+  // ambient - the light applied everywhere
+  uint32_t count;
+  vec3     ambient;
+} r_cmd_lights;
+
+typedef struct {
+  // fbo - the framebuffer to read from, 0 = the window
+  // width, height - the size of the area to read
+  // func, data - the callback to deliver the pixels to
+  uint32_t        fbo, width, height;
+  r_readback_func func;
+  void*           data;
+} r_cmd_readback;
+
+typedef struct {
+  // tri_count - the amount of triangle vertices following the command
+  // line_count - the amount of line vertices following the triangles
+  uint32_t tri_count, line_count;
+} r_cmd_im;
+
+typedef struct {
+  // sheet - a copy of the baked sheet (so the caller can keep modifying theirs)
+  r_shader      shader;
+  r_baked_sheet sheet;
+} r_cmd_baked;
+
+typedef struct {
+  // count - the amount of particles, followed in memory by the mats, colors &
+  //         coords arrays each `count` long
+  // uniform_cap - the max amount of particles to draw per call
+  r_shader shader;
+  r_sheet* sheet;
+  int8_t   type;
+  uint16_t uniform_cap;
+  uint32_t count;
+} r_cmd_particles;
+
+typedef enum {
+  R_CAP_NONE = 0,
+  R_CAP_TEX,
+  R_CAP_SHADER,
+  R_CAP_BAKED,
+  R_CAP_FBO,
+  R_CAP_FRAME,
+} r_cap_type;
+
+// Bumped whenever a recorded command's layout changes
+#define R_CAP_VERSION 2
+
+typedef struct {
+  // magic - "ACAP"
+  // version - the version of the capture format
+  // ptr_size - the size of pointers in the recorded commands
+  // width, height - the size of the window captured
+  // frames - the amount of frames within the capture
+  char     magic[4];
+  uint16_t version, ptr_size;
+  uint32_t width, height, frames;
+} r_cap_header;
+
+typedef struct {
+  // type - the r_cap_type of the chunk
+  // size - the size of the chunk's data following this header
+  uint32_t type, size;
+} r_cap_chunk;
+
+typedef struct {
+  uint32_t id, width, height;
+} r_cap_tex;
+
+typedef struct {
+  uint32_t id;
+  char     name[64];
+} r_cap_shader;
+
+typedef struct {
+  uint32_t vao, quad_count;
+} r_cap_baked;
+
+typedef struct {
+  uint32_t fbo, width, height, shader;
+} r_cap_fbo;
+
+typedef struct {
+  // x, y, z - the position in world units
+  // color - RGBA8 color
+  float    x, y, z;
+  uint32_t color;
+} r_im_vert;
+
+// The amount of frames the stream buffer is split into, a segment is only
+// written again once the GPU has finished the frame that last used it
+#define R_STREAM_SEGMENTS 3
+
+// The initial size of the stream buffer in bytes
+#define R_STREAM_SIZE (1 << 21)
+
+typedef struct {
+  // vbo - the buffer streamed vertices are suballocated from
+  // size - the size of the buffer in bytes
+  // segment_size - the size of each frame's segment in bytes
+  uint32_t vbo, size, segment_size;
+
+  // segment - the segment being written to
+  // offset - the write position within the segment
+  // fences - signaled once the GPU is done with each segment, 0 if free
+  uint32_t segment, offset;
+  GLsync   fences[R_STREAM_SEGMENTS];
+} r_stream;
+
+typedef struct {
+  // tris - vertices of filled shapes (GL_TRIANGLES)
+  // lines - vertices of outlines (GL_LINES)
+  r_im_vert* tris;
+  r_im_vert* lines;
+  uint32_t   tri_count, tri_capacity;
+  uint32_t   line_count, line_capacity;
+
+  // shader, vao - the OpenGL objects, created on the first flush
+  r_shader shader;
+  uint32_t vao;
+} r_im;
+
+// Sprites covering more grid cells than this are checked on every query
+#define R_PICK_MAX_CELLS 16
+
+typedef struct {
+  // sprite - the sprite drawn
+  // bounds - the sprite's world space bounds [min_x, min_y, max_x, max_y]
+  // layer - the layer the sprite was drawn on
+  r_sprite* sprite;
+  vec4      bounds;
+  uint32_t  layer;
+} r_pick_entry;
+
+typedef struct {
+  // cell_size - the size of each grid cell in world units, 0 = disabled
+  float cell_size;
+
+  // entries - the sprites drawn this frame
+  // ready - the sprites drawn last frame, the ones queried
+  r_pick_entry* entries;
+  uint32_t      entry_count, entry_capacity;
+  r_pick_entry* ready;
+  uint32_t      ready_count, ready_capacity;
+
+  // cell_starts - the first item of each bucket (bucket_count + 1)
+  // cell_items - the ready entries in each bucket of the hashed grid
+  // bucket_count - the amount of buckets (power of 2)
+  // large - ready entries too big for the grid, checked on every query
+  // built - whether the grid is up to date with the ready entries
+  uint32_t* cell_starts;
+  uint32_t* cell_items;
+  uint32_t  item_capacity, bucket_count, bucket_capacity;
+  uint32_t* large;
+  uint32_t  large_count, large_capacity;
+  uint8_t   built;
+
+  // stamps - the last query each ready entry was reported by
+  // query - the current query (to skip duplicates across cells)
+  uint32_t* stamps;
+  uint32_t  stamp_capacity, query;
+} r_pick;
+
+// The size of each light tile in pixels
+#define R_LIGHT_TILE 32
+
+typedef struct {
+  // shader, vao - the lighting pass (a fullscreen triangle)
+  // light_buf, light_tex - texture buffer of the lights, 2 RGBA32F texels each
+  // tile_buf, tile_tex - texture buffer of each tile's start & count, followed
+  //                      by the light indices of every tile
+  r_shader shader;
+  uint32_t vao;
+  uint32_t light_buf, light_tex;
+  uint32_t tile_buf, tile_tex;
+
+  // lights - the light data to upload (8 floats per light)
+  // ranges - the tiles each light covers [min_x, min_y, max_x, max_y]
+  // tiles - the tile data to upload
+  float*    lights;
+  int32_t*  ranges;
+  uint32_t  light_capacity;
+  uint32_t* tiles;
+  uint32_t  tile_capacity;
+} r_lighting;
+
+// The max amount of readbacks in flight at once
+#define R_READBACK_SLOTS 4
+
+typedef struct {
+  // pbo - the pixel buffer the pixels are read into
+  // size - the size of the pixel buffer's storage
+  // fence - signaled once the GPU has finished the read
+  uint32_t pbo, size;
+  GLsync   fence;
+
+  // width, height - the size of the area read
+  // func, data - the callback to deliver the pixels to
+  uint32_t        width, height;
+  r_readback_func func;
+  void*           data;
+} r_readback;
+
+typedef struct r_png_job r_png_job;
+typedef struct r_png_worker r_png_worker;
+
+struct r_png_job {
+  // worker - the worker to encode on (0 = encode on the calling thread)
+  // pixels - a copy of the pixels read (bottom row first)
+  // path - the file to write to
+  r_png_worker*  worker;
+  unsigned char* pixels;
+  uint32_t       width, height;
+  char*          path;
+  r_png_job*     next;
+};
+
+#if !defined(ASTERA_NO_THREADS)
+struct r_png_worker {
+  // thread - encodes & writes queued PNGs
+  // head, tail - the queue of jobs
+  // quit - set for the thread to finish the queue & exit
+  s_thread*  thread;
+  s_mutex*   lock;
+  s_cond*    cond;
+  r_png_job* head;
+  r_png_job* tail;
+  uint8_t    quit;
+};
+#endif
+
+// The anim of a pooled instance whose animation was removed
+#define R_ANIM_POOL_NONE 0xFFFFFFFF
+
+typedef struct {
+  // anim - the cached animation (index) each instance plays
+  // frames - the frame count of each instance's animation
+  // curr - the current frame of each instance
+  // subtex - the subtexture of each instance's current frame
+  uint32_t* anim;
+  uint32_t* frames;
+  uint32_t* curr;
+  uint32_t* subtex;
+
+  // frame_time - the time each frame is shown for (milliseconds)
+  // time - the time spent on the current frame (milliseconds)
+  float* frame_time;
+  float* time;
+
+  // state - the r_anim_state of each instance
+  // loop - if each instance loops
+  // alive - if each slot holds an instance (0 once destroyed)
+  uint8_t* state;
+  uint8_t* loop;
+  uint8_t* alive;
+
+  // free_list - stack of released instance slots
+  // free_count - the amount of slots in the free list
+  // high - the high mark of slots used
+  // capacity - the amount of slots allocated
+  uint32_t* free_list;
+  uint32_t  free_count, high, capacity;
+} r_anim_pool;
+
+struct r_capture {
+  // width, height - the size of the window captured
+  uint32_t width, height;
+
+  // sheets / sheet_keys - sheets recreated from captured textures
+  // shaders / shader_keys - shaders returned by the loader
+  // baked / baked_keys - baked sheets recreated from captured buffers
+  // fbos / fbo_keys - framebuffers recreated from captured sizes
+  r_sheet*       sheets;
+  uint32_t*      sheet_keys;
+  r_shader*      shaders;
+  uint32_t*      shader_keys;
+  r_baked_sheet* baked;
+  uint32_t*      baked_keys;
+  r_framebuffer* fbos;
+  uint32_t*      fbo_keys;
+  uint32_t       sheet_count, shader_count, baked_count, fbo_count;
+
+  // frames - the command list of each frame, resolved to local resources
+  // frame_count - the amount of frames
+  r_cmd_list* frames;
+  uint32_t    frame_count;
+};
+
 struct r_ctx {
   // window - the rendering context's window
   // camera - the rendering context's camera
@@ -45,6 +417,15 @@ struct r_ctx {
   uint16_t     anim_high;
   uint16_t     anim_count, anim_capacity;
 
+  // anim_hashes - the hash of each cached animation's name
+  // anim_map - open addressed map of name hashes to animation index + 1
+  // anim_map_size - the amount of slots in the map (power of 2)
+  // anim_pool - playback state for pooled animation instances
+  uint32_t*   anim_hashes;
+  uint16_t*   anim_map;
+  uint32_t    anim_map_size;
+  r_anim_pool anim_pool;
+
   // shaders - an array of shaders (Kappa)
   // shader_names - an array of strings naming each shader (by index)
   // shader_count - the number of shaders currently held
@@ -61,17 +442,469 @@ struct r_ctx {
   uint8_t  batch_count, batch_capacity;
   uint32_t batch_size;
 
+  // sort_batch - scratch storage batches are sorted into (swapped after)
+  // sort_cursors - each batch's position in the translucent pass
+  r_batch   sort_batch;
+  uint32_t* sort_cursors;
+
+  // stream - ring buffer for per-frame vertex data (render thread only)
+  // im - immediate mode primitives queued for the frame
+  r_stream stream;
+  r_im     im;
+
+  // pick - spatial index of the sprites drawn, for r_pick_x queries
+  r_pick pick;
+
+  // lighting - the tiled lighting pass (GL thread only)
+  r_lighting lighting;
+
+  // readbacks - ring of pixel reads in flight (GL thread only)
+  // readback_head - the oldest readback in flight
+  // readback_count - the amount of readbacks in flight
+  // png_worker - the thread PNG readbacks are encoded on (if started)
+  r_readback    readbacks[R_READBACK_SLOTS];
+  uint32_t      readback_head, readback_count;
+  r_png_worker* png_worker;
+
   // input_ctx - a pointer to an input context for glfw callbacks
   i_ctx* input_ctx;
 
   // allowed - allow rendering
   // scaled - whether the resolution has changed
   uint8_t allowed, scaled;
+
+  // cmd_lists - double buffered command lists (one recording, one executing)
+  // cmd_record - the index of the command list being recorded into
+  r_cmd_list cmd_lists[2];
+  uint8_t    cmd_record;
+
+  // exec_camera - the camera state of the commands being executed
+  // rec_view / rec_projection - the camera state last recorded
+  // rec_camera_valid - if the recorded camera state is valid for this frame
+  // executing - if commands are being executed (draw with exec_camera)
+  r_camera exec_camera;
+  mat4x4   rec_view, rec_projection;
+  uint8_t  rec_camera_valid, executing;
+
+  // capture - the file being captured to, 0 if not capturing
+  // capture_frames - the amount of frames to capture, 0 = until stopped
+  // capture_count - the amount of frames captured so far
+  // capture_keys - the resources already written to the capture
+  // capture_scratch - the frame being patched before it's written
+  FILE*      capture;
+  uint32_t   capture_frames, capture_count;
+  uint64_t*  capture_keys;
+  uint32_t   capture_key_count, capture_key_capacity;
+  r_cmd_list capture_scratch;
+
+#if !defined(ASTERA_NO_THREADS)
+  // thread - the render thread, 0 if rendering on the calling thread
+  // cmd_lock - guards the handoff of command lists between threads
+  // cmd_cond - signals a submitted / finished frame
+  // cmd_pending - if a submitted frame is waiting on the render thread
+  // cmd_busy - if the render thread is executing a frame
+  // cmd_quit - tells the render thread to exit
+  s_thread* thread;
+  s_mutex*  cmd_lock;
+  s_cond*   cmd_cond;
+  uint8_t   cmd_pending, cmd_busy, cmd_quit;
+#endif
 };
 
 // For callbacks only
 static r_ctx* _r_ctx;
 
+// The context recording commands, for calls that don't pass a context
+static r_ctx* _r_rec_ctx;
+
+/* If draw calls should be recorded into the command list rather than issued */
+static uint8_t r_ctx_recording(r_ctx* ctx) {
+  if (!ctx) {
+    return 0;
+  }
+
+#if !defined(ASTERA_NO_THREADS)
+  return ctx->thread || ctx->capture;
+#else
+  return ctx->capture != 0;
+#endif
+}
+
+/* The camera to draw with, the snapshot while executing commands */
+static r_camera* r_ctx_draw_camera(r_ctx* ctx) {
+  return ctx->executing ? &ctx->exec_camera : &ctx->camera;
+}
+
+// Slot states of the resource table
+#define R_RES_EMPTY 0
+#define R_RES_LIVE  1
+#define R_RES_TOMB  2
+
+typedef struct {
+  // slots - open addressed table of live GL objects keyed by type & id
+  // states - R_RES_EMPTY / LIVE / TOMB for each slot
+  // capacity - the amount of slots (power of 2)
+  // live, tombs - the amount of live & removed slots
+  // serial - the serial to give the next object tracked
+  r_res_info* slots;
+  uint8_t*    states;
+  uint32_t    capacity, live, tombs;
+  uint32_t    serial;
+
+  // stats - running totals of the live objects
+  r_res_stats stats;
+
+#if !defined(ASTERA_NO_THREADS)
+  // lock - objects are created on the render thread & queried on others
+  s_mutex* lock;
+#endif
+} r_res_table;
+
+// GL objects are created through functions without a context, so they're
+// tracked for the whole process (they're shared between contexts anyway)
+static r_res_table _r_res;
+
+static void r_res_lock(void) {
+#if !defined(ASTERA_NO_THREADS)
+  if (_r_res.lock)
+    s_mutex_lock(_r_res.lock);
+#endif
+}
+
+static void r_res_unlock(void) {
+#if !defined(ASTERA_NO_THREADS)
+  if (_r_res.lock)
+    s_mutex_unlock(_r_res.lock);
+#endif
+}
+
+static inline uint32_t r_res_slot(uint32_t type, uint32_t id) {
+  return ((id * 2654435761u) ^ (type * 40503u)) & (_r_res.capacity - 1);
+}
+
+/* Find the slot of a live object
+ * returns: the slot, -1 = not tracked */
+static int64_t r_res_find(uint32_t type, uint32_t id) {
+  if (!_r_res.capacity) {
+    return -1;
+  }
+
+  uint32_t slot = r_res_slot(type, id);
+  for (uint32_t i = 0; i < _r_res.capacity; ++i) {
+    uint8_t state = _r_res.states[slot];
+    if (state == R_RES_EMPTY) {
+      return -1;
+    }
+
+    if (state == R_RES_LIVE && _r_res.slots[slot].type == type &&
+        _r_res.slots[slot].id == id) {
+      return slot;
+    }
+
+    slot = (slot + 1) & (_r_res.capacity - 1);
+  }
+
+  return -1;
+}
+
+/* Grow (or clean the tombs out of) the resource table
+ * returns: 1 = success, 0 = fail */
+static uint8_t r_res_rehash(uint32_t capacity) {
+  r_res_info* slots  = (r_res_info*)calloc(capacity, sizeof(r_res_info));
+  uint8_t*    states = (uint8_t*)calloc(capacity, sizeof(uint8_t));
+
+  if (!slots || !states) {
+    ASTERA_DBG("r_res_rehash: unable to allocate resource table.\n");
+    free(slots);
+    free(states);
+    return 0;
+  }
+
+  r_res_info* old_slots    = _r_res.slots;
+  uint8_t*    old_states   = _r_res.states;
+  uint32_t    old_capacity = _r_res.capacity;
+
+  _r_res.slots    = slots;
+  _r_res.states   = states;
+  _r_res.capacity = capacity;
+  _r_res.tombs    = 0;
+
+  for (uint32_t i = 0; i < old_capacity; ++i) {
+    if (old_states[i] != R_RES_LIVE) {
+      continue;
+    }
+
+    uint32_t slot = r_res_slot(old_slots[i].type, old_slots[i].id);
+    while (states[slot] != R_RES_EMPTY) {
+      slot = (slot + 1) & (capacity - 1);
+    }
+
+    slots[slot]  = old_slots[i];
+    states[slot] = R_RES_LIVE;
+  }
+
+  free(old_slots);
+  free(old_states);
+
+  return 1;
+}
+
+/* Track a GL object, or update the size of one already tracked
+ * type - the r_res_type of the object
+ * id - the OpenGL name of the object
+ * size - the (estimated) size of the object's storage in bytes
+ * site - the function that created it */
+static void r_res_track(uint32_t type, uint32_t id, uint32_t size,
+                        const char* site) {
+  if (!id) {
+    return;
+  }
+
+  r_res_lock();
+
+  int64_t found = r_res_find(type, id);
+  if (found != -1) {
+    r_res_info* info = &_r_res.slots[found];
+    _r_res.stats.bytes[type] += (uint64_t)size - info->size;
+    _r_res.stats.total_bytes += (uint64_t)size - info->size;
+    info->size = size;
+    r_res_unlock();
+    return;
+  }
+
+  if ((_r_res.live + _r_res.tombs + 1) * 2 > _r_res.capacity) {
+    uint32_t capacity = (_r_res.capacity) ? _r_res.capacity : 256;
+    while ((_r_res.live + 1) * 2 > capacity) {
+      capacity *= 2;
+    }
+
+    if (!r_res_rehash(capacity)) {
+      r_res_unlock();
+      return;
+    }
+  }
+
+  uint32_t slot = r_res_slot(type, id);
+  while (_r_res.states[slot] == R_RES_LIVE) {
+    slot = (slot + 1) & (_r_res.capacity - 1);
+  }
+
+  if (_r_res.states[slot] == R_RES_TOMB) {
+    --_r_res.tombs;
+  }
+
+  _r_res.slots[slot]  = (r_res_info){.type   = type,
+                                    .id     = id,
+                                    .size   = size,
+                                    .serial = ++_r_res.serial,
+                                    .site   = site};
+  _r_res.states[slot] = R_RES_LIVE;
+  ++_r_res.live;
+
+  ++_r_res.stats.counts[type];
+  ++_r_res.stats.total_count;
+  _r_res.stats.bytes[type] += size;
+  _r_res.stats.total_bytes += size;
+
+  r_res_unlock();
+}
+
+/* Stop tracking a GL object (called as it's deleted) */
+static void r_res_untrack(uint32_t type, uint32_t id) {
+  r_res_lock();
+
+  int64_t found = r_res_find(type, id);
+  if (found != -1) {
+    r_res_info* info = &_r_res.slots[found];
+
+    --_r_res.stats.counts[type];
+    --_r_res.stats.total_count;
+    _r_res.stats.bytes[type] -= info->size;
+    _r_res.stats.total_bytes -= info->size;
+
+    _r_res.states[found] = R_RES_TOMB;
+    --_r_res.live;
+    ++_r_res.tombs;
+  } else if (id) {
+    ASTERA_DBG("r_res_untrack: deleting untracked object %i (type %i).\n", id,
+               type);
+  }
+
+  r_res_unlock();
+}
+
+/* Forget every tracked object, their GL context is gone */
+static void r_res_clear(void) {
+  if (_r_res.live) {
+    ASTERA_DBG("r_res_clear: %i GL objects (%llu bytes) were never "
+               "destroyed.\n",
+               _r_res.live, (unsigned long long)_r_res.stats.total_bytes);
+  }
+
+  free(_r_res.slots);
+  free(_r_res.states);
+
+#if !defined(ASTERA_NO_THREADS)
+  if (_r_res.lock)
+    s_mutex_destroy(_r_res.lock);
+#endif
+
+  _r_res = (r_res_table){0};
+}
+
+void r_res_get_stats(r_res_stats* dst) {
+  if (!dst) {
+    return;
+  }
+
+  r_res_lock();
+  *dst = _r_res.stats;
+  r_res_unlock();
+}
+
+struct r_res_snapshot {
+  // infos - the objects live at the time, sorted by serial
+  r_res_info* infos;
+  uint32_t    count;
+};
+
+static int r_res_compare_serial(const void* a, const void* b) {
+  uint32_t serial_a = ((const r_res_info*)a)->serial;
+  uint32_t serial_b = ((const r_res_info*)b)->serial;
+  return (serial_a > serial_b) - (serial_a < serial_b);
+}
+
+r_res_snapshot* r_res_snapshot_create(void) {
+  r_res_snapshot* snapshot =
+      (r_res_snapshot*)calloc(1, sizeof(r_res_snapshot));
+  if (!snapshot) {
+    ASTERA_DBG("r_res_snapshot_create: unable to allocate snapshot.\n");
+    return 0;
+  }
+
+  r_res_lock();
+
+  snapshot->infos = (r_res_info*)malloc(sizeof(r_res_info) * (_r_res.live + 1));
+  if (!snapshot->infos) {
+    r_res_unlock();
+    ASTERA_DBG("r_res_snapshot_create: unable to allocate snapshot.\n");
+    free(snapshot);
+    return 0;
+  }
+
+  for (uint32_t i = 0; i < _r_res.capacity; ++i) {
+    if (_r_res.states[i] == R_RES_LIVE) {
+      snapshot->infos[snapshot->count] = _r_res.slots[i];
+      ++snapshot->count;
+    }
+  }
+
+  r_res_unlock();
+
+  qsort(snapshot->infos, snapshot->count, sizeof(r_res_info),
+        r_res_compare_serial);
+
+  return snapshot;
+}
+
+uint32_t r_res_snapshot_diff(r_res_snapshot* before, r_res_snapshot* after,
+                             r_res_info* dst, uint32_t capacity) {
+  if (!after || !dst) {
+    return 0;
+  }
+
+  // Both are sorted by serial, so walk them together
+  uint32_t found = 0, j = 0;
+  for (uint32_t i = 0; i < after->count && found < capacity; ++i) {
+    uint32_t serial = after->infos[i].serial;
+
+    if (before) {
+      while (j < before->count && before->infos[j].serial < serial) {
+        ++j;
+      }
+
+      if (j < before->count && before->infos[j].serial == serial) {
+        continue;
+      }
+    }
+
+    dst[found] = after->infos[i];
+    ++found;
+  }
+
+  return found;
+}
+
+uint32_t r_res_snapshot_count(r_res_snapshot* snapshot) {
+  return (snapshot) ? snapshot->count : 0;
+}
+
+void r_res_snapshot_destroy(r_res_snapshot* snapshot) {
+  if (!snapshot) {
+    return;
+  }
+
+  free(snapshot->infos);
+  free(snapshot);
+}
+
+/* Reserve a command in the list, returns a pointer to its payload */
+static void* r_cmd_push(r_cmd_list* list, uint32_t type, uint32_t size) {
+  size = (size + 7) & ~7u;
+
+  uint32_t needed = list->size + sizeof(r_cmd) + size;
+  if (needed > list->capacity) {
+    uint32_t capacity = (list->capacity) ? list->capacity : 4096;
+    while (capacity < needed) {
+      capacity *= 2;
+    }
+
+    uint8_t* data = (uint8_t*)realloc(list->data, capacity);
+    if (!data) {
+      ASTERA_DBG("r_cmd_push: unable to grow command list.\n");
+      return 0;
+    }
+
+    list->data     = data;
+    list->capacity = capacity;
+  }
+
+  r_cmd* cmd = (r_cmd*)(list->data + list->size);
+  cmd->type  = type;
+  cmd->size  = size;
+
+  list->size = needed;
+  return (void*)(cmd + 1);
+}
+
+/* Reserve a command in the list currently being recorded */
+static void* r_cmd_rec(r_ctx* ctx, uint32_t type, uint32_t size) {
+  return r_cmd_push(&ctx->cmd_lists[ctx->cmd_record], type, size);
+}
+
+/* Record the camera if it has changed since it was last recorded */
+static void r_cmd_camera_sync(r_ctx* ctx) {
+  r_camera* camera = &ctx->camera;
+
+  if (ctx->rec_camera_valid &&
+      !memcmp(ctx->rec_view, camera->view, sizeof(mat4x4)) &&
+      !memcmp(ctx->rec_projection, camera->projection, sizeof(mat4x4))) {
+    return;
+  }
+
+  r_cmd_camera* cmd = r_cmd_rec(ctx, R_CMD_CAMERA, sizeof(r_cmd_camera));
+  if (!cmd) {
+    return;
+  }
+
+  mat4x4_dup(cmd->view, camera->view);
+  mat4x4_dup(cmd->projection, camera->projection);
+
+  mat4x4_dup(ctx->rec_view, camera->view);
+  mat4x4_dup(ctx->rec_projection, camera->projection);
+  ctx->rec_camera_valid = 1;
+}
+
 static void glfw_err_cb(int error, const char* msg) {
   ASTERA_DBG("GLFW ERROR: %i %s\n", error, msg);
 }
@@ -87,7 +920,18 @@ static void glfw_window_size_cb(GLFWwindow* window, int w, int h) {
   if (_r_ctx->window.glfw == window) {
     _r_ctx->window.params.width  = w;
     _r_ctx->window.params.height = h;
-    glViewport(0, 0, w, h);
+
+    if (r_ctx_recording(_r_ctx)) {
+      r_cmd_viewport* cmd =
+          r_cmd_rec(_r_ctx, R_CMD_VIEWPORT, sizeof(r_cmd_viewport));
+      if (cmd) {
+        cmd->width  = w;
+        cmd->height = h;
+      }
+    } else {
+      glViewport(0, 0, w, h);
+    }
+
     _r_ctx->scaled = 1;
   }
 }
@@ -156,6 +1000,7 @@ static void r_batch_clear(r_batch* batch) {
   memset(batch->colors, 0, sizeof(vec4) * batch->count);
   memset(batch->flip_x, 0, sizeof(uint8_t) * batch->count);
   memset(batch->flip_y, 0, sizeof(uint8_t) * batch->count);
+  memset(batch->layers, 0, sizeof(uint8_t) * batch->count);
   batch->count = 0;
 }
 
@@ -188,34 +1033,112 @@ static void r_batch_check(r_batch* batch) {
     batch->flip_y = (uint8_t*)malloc(sizeof(uint8_t) * batch->capacity);
     memset(batch->flip_y, 0, sizeof(uint8_t) * batch->capacity);
   }
+
+  if (!batch->layers) {
+    batch->layers = (uint8_t*)malloc(sizeof(uint8_t) * batch->capacity);
+    memset(batch->layers, 0, sizeof(uint8_t) * batch->capacity);
+  }
 }
 
-static void r_batch_add(r_batch* batch, r_sprite* sprite) {
-  batch->flip_x[batch->count] = sprite->flip_x;
-  batch->flip_y[batch->count] = sprite->flip_y;
+static void r_batch_add(r_batch* batch, mat4x4 model, vec4 color, vec4 coords,
+                        uint8_t flip_x, uint8_t flip_y, uint8_t layer) {
+  batch->flip_x[batch->count] = flip_x;
+  batch->flip_y[batch->count] = flip_y;
+  batch->layers[batch->count] = layer;
 
-  mat4x4_dup(batch->mats[batch->count], sprite->model);
-  vec4_dup(batch->colors[batch->count], sprite->color);
+  mat4x4_dup(batch->mats[batch->count], model);
+  vec4_dup(batch->colors[batch->count], color);
+  vec4_dup(batch->coords[batch->count], coords);
 
-  if (sprite->animated) {
-    vec4_dup(batch->coords[batch->count],
-             batch->sheet
+  ++batch->count;
+}
+
+/* Stable counting sort of a batch's instances by layer
+ * front_to_back - 1 = highest layer first, 0 = lowest layer first */
+static void r_batch_sort(r_ctx* ctx, r_batch* batch, uint8_t front_to_back) {
+  uint32_t offsets[256] = {0};
+  uint8_t  sorted       = 1;
+
+  for (uint32_t i = 0; i < batch->count; ++i) {
+    uint8_t key = front_to_back ? 255 - batch->layers[i] : batch->layers[i];
+    ++offsets[key];
+
+    if (i > 0) {
+      uint8_t prev = front_to_back ? 255 - batch->layers[i - 1]
+                                   : batch->layers[i - 1];
+      sorted &= (prev <= key);
+    }
+  }
+
+  // Most batches are submitted in layer order already
+  if (sorted) {
+    return;
+  }
+
+  uint32_t total = 0;
+  for (uint32_t i = 0; i < 256; ++i) {
+    uint32_t bucket = offsets[i];
+    offsets[i]      = total;
+    total += bucket;
+  }
+
+  r_batch* dst = &ctx->sort_batch;
+  dst->capacity = batch->capacity;
+  r_batch_check(dst);
+
+  for (uint32_t i = 0; i < batch->count; ++i) {
+    uint8_t  key   = front_to_back ? 255 - batch->layers[i] : batch->layers[i];
+    uint32_t index = offsets[key]++;
+
+    mat4x4_dup(dst->mats[index], batch->mats[i]);
+    vec4_dup(dst->colors[index], batch->colors[i]);
+    vec4_dup(dst->coords[index], batch->coords[i]);
+    dst->flip_x[index] = batch->flip_x[i];
+    dst->flip_y[index] = batch->flip_y[i];
+    dst->layers[index] = batch->layers[i];
+  }
+
+  // Swap storage with the scratch batch rather than copying back
+  r_batch tmp = *batch;
+
+  batch->mats   = dst->mats;
+  batch->colors = dst->colors;
+  batch->coords = dst->coords;
+  batch->flip_x = dst->flip_x;
+  batch->flip_y = dst->flip_y;
+  batch->layers = dst->layers;
+
+  dst->mats   = tmp.mats;
+  dst->colors = tmp.colors;
+  dst->coords = tmp.coords;
+  dst->flip_x = tmp.flip_x;
+  dst->flip_y = tmp.flip_y;
+  dst->layers = tmp.layers;
+}
+
+/* Get the texture coordinates of the sprite's current subtexture */
+static void r_sprite_get_coords(r_ctx* ctx, r_sprite* sprite, vec4 dst) {
+  if (sprite->pooled) {
+    uint32_t subtex = ctx->anim_pool.subtex[sprite->render.inst - 1];
+    vec4_dup(dst, sprite->sheet->subtexs[subtex].coords);
+  } else if (sprite->animated) {
+    vec4_dup(dst,
+             sprite->sheet
                  ->subtexs[sprite->render.anim.frames[sprite->render.anim.curr]]
                  .coords);
   } else {
-    vec4_dup(batch->coords[batch->count],
-             batch->sheet->subtexs[sprite->render.tex].coords);
+    vec4_dup(dst, sprite->sheet->subtexs[sprite->render.tex].coords);
   }
-
-  ++batch->count;
 }
 
-static r_batch* r_batch_get(r_ctx* ctx, r_sheet* sheet, r_shader shader) {
+static r_batch* r_batch_get(r_ctx* ctx, r_sheet* sheet, r_shader shader,
+                            uint8_t opaque) {
   for (uint32_t i = 0; i < ctx->batch_capacity; ++i) {
     r_batch* batch = &ctx->batches[i];
 
     if (batch->sheet && batch->shader) {
-      if (sheet->id == batch->sheet->id && shader == batch->shader) {
+      if (sheet->id == batch->sheet->id && shader == batch->shader &&
+          opaque == batch->opaque) {
         return batch;
       }
     }
@@ -228,6 +1151,7 @@ static r_batch* r_batch_get(r_ctx* ctx, r_sheet* sheet, r_shader shader) {
       r_batch_check(batch);
       batch->sheet  = sheet;
       batch->shader = shader;
+      batch->opaque = opaque;
       return batch;
     }
   }
@@ -235,14 +1159,16 @@ static r_batch* r_batch_get(r_ctx* ctx, r_sheet* sheet, r_shader shader) {
   return 0;
 }
 
-static void r_batch_draw(r_ctx* ctx, r_batch* batch) {
-  if (!batch->count) {
-    ASTERA_DBG("r_batch_draw: nothing in batch to draw.\n");
+/* Draw a range of a batch's instances */
+static void r_batch_draw_range(r_ctx* ctx, r_batch* batch, uint32_t start,
+                               uint32_t count) {
+  if (!batch || !ctx) {
+    ASTERA_DBG("r_batch_draw: incomplete arguments passed.\n");
     return;
   }
 
-  if (!batch || !ctx) {
-    ASTERA_DBG("r_batch_draw: incomplete arguments passed.\n");
+  if (!count) {
+    ASTERA_DBG("r_batch_draw: nothing in batch to draw.\n");
     return;
   }
 
@@ -257,14 +1183,15 @@ static void r_batch_draw(r_ctx* ctx, r_batch* batch) {
   vec2 sheet_size = {batch->sheet->width, batch->sheet->height};
   r_set_v2(batch->shader, "sheet_size", sheet_size);
 
-  r_set_m4(batch->shader, "view", ctx->camera.view);
-  r_set_m4(batch->shader, "projection", ctx->camera.projection);
+  r_camera* camera = r_ctx_draw_camera(ctx);
+  r_set_m4(batch->shader, "view", camera->view);
+  r_set_m4(batch->shader, "projection", camera->projection);
 
-  r_set_ix(batch->shader, batch->count, "flip_x", (int*)batch->flip_x);
-  r_set_ix(batch->shader, batch->count, "flip_y", (int*)batch->flip_y);
-  r_set_v4x(batch->shader, batch->count, "coords", batch->coords);
-  r_set_v4x(batch->shader, batch->count, "colors", batch->colors);
-  r_set_m4x(batch->shader, batch->count, "mats", batch->mats);
+  r_set_ix(batch->shader, count, "flip_x", (int*)&batch->flip_x[start]);
+  r_set_ix(batch->shader, count, "flip_y", (int*)&batch->flip_y[start]);
+  r_set_v4x(batch->shader, count, "coords", &batch->coords[start]);
+  r_set_v4x(batch->shader, count, "colors", &batch->colors[start]);
+  r_set_m4x(batch->shader, count, "mats", &batch->mats[start]);
 
   glBindVertexArray(ctx->default_quad.vao);
   glBindBuffer(GL_ARRAY_BUFFER, ctx->default_quad.vbo);
@@ -276,1008 +1203,4840 @@ static void r_batch_draw(r_ctx* ctx, r_batch* batch) {
   glEnableVertexAttribArray(0);
   glEnableVertexAttribArray(1);
 
-  glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0, batch->count);
+  glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0, count);
 
   glDisableVertexAttribArray(0);
   glDisableVertexAttribArray(1);
 
-  r_batch_clear(batch);
-
   // TODO test this
   glBindVertexArray(0);
   r_tex_bind(0);
   r_shader_bind(0);
 }
 
-uint32_t r_check_error(void) { return glGetError(); }
-
-uint32_t r_check_error_loc(const char* loc) {
-  uint32_t error = glGetError();
-
-  if (error != GL_NO_ERROR) {
-    ASTERA_DBG("GL Error: %i at location: %s\n", error, loc);
+/* Draw a single batch on its own (i.e when it fills up mid frame) */
+static void r_batch_draw(r_ctx* ctx, r_batch* batch) {
+  if (batch->opaque) {
+    r_batch_sort(ctx, batch, 1);
+    glDisable(GL_BLEND);
+    r_batch_draw_range(ctx, batch, 0, batch->count);
+    glEnable(GL_BLEND);
+  } else {
+    r_batch_sort(ctx, batch, 0);
+    r_batch_draw_range(ctx, batch, 0, batch->count);
   }
 
-  return error;
+  r_batch_clear(batch);
 }
 
-r_quad r_quad_create(float width, float height, uint8_t use_vto) {
-  uint32_t vao = 0, vbo = 0, vboi = 0, vto = 0;
+/* Add an instance to the matching batch, drawing the batch if it's full */
+static void r_batch_submit(r_ctx* ctx, r_sheet* sheet, r_shader shader,
+                           mat4x4 model, vec4 color, vec4 coords,
+                           uint8_t flip_x, uint8_t flip_y, uint8_t layer,
+                           uint8_t opaque) {
+  r_batch* batch = r_batch_get(ctx, sheet, shader, opaque);
 
-  glGenVertexArrays(1, &vao);
-  glBindVertexArray(vao);
+  if (batch) {
+    if (batch->count == batch->capacity) {
+      r_batch_draw(ctx, batch);
+    }
 
-  glGenBuffers(1, &vbo);
-  glGenBuffers(1, &vboi);
+    r_batch_add(batch, model, color, coords, flip_x, flip_y, layer);
+  }
+}
 
-  uint16_t inds[6] = {0, 1, 2, 2, 3, 0};
+/* Draw all of the batches with contents
+ * Opaque batches go first, front to back with blending off so hidden pixels
+ * fail the depth test early. Translucent batches follow back to front, a
+ * layer at a time across every batch so they blend in the right order */
+static void r_batch_draw_all(r_ctx* ctx) {
+  glDisable(GL_BLEND);
+  for (uint32_t i = 0; i < ctx->batch_capacity; ++i) {
+    r_batch* batch = &ctx->batches[i];
 
-  if (use_vto) {
-    glGenBuffers(1, &vto);
+    if (batch->count != 0 && batch->opaque) {
+      r_batch_sort(ctx, batch, 1);
+      r_batch_draw_range(ctx, batch, 0, batch->count);
+      r_batch_clear(batch);
+    }
+  }
+  glEnable(GL_BLEND);
 
-    float verts[12] = {-0.5f, -0.5f, 0.f, -0.5f, 0.5f,  0.f,
-                       0.5f,  0.5f,  0.f, 0.5f,  -0.5f, 0.f};
-    float texcs[8]  = {0.f, 0.f, 0.f, 1.f, 1.f, 1.f, 1.f, 0.f};
+  uint32_t* cursors     = ctx->sort_cursors;
+  uint8_t   translucent = 0;
+  for (uint32_t i = 0; i < ctx->batch_capacity; ++i) {
+    r_batch* batch = &ctx->batches[i];
+    cursors[i]     = 0;
 
-    for (uint8_t i = 0; i < 12; i += 3) {
-      verts[i] *= width;
-      verts[i + 1] *= height;
+    if (batch->count != 0) {
+      r_batch_sort(ctx, batch, 0);
+      translucent = 1;
     }
+  }
 
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, 12 * sizeof(float), verts, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+  while (translucent) {
+    // Find the lowest layer left in any batch
+    uint32_t layer = 256;
+    for (uint32_t i = 0; i < ctx->batch_capacity; ++i) {
+      r_batch* batch = &ctx->batches[i];
+      if (cursors[i] < batch->count && batch->layers[cursors[i]] < layer) {
+        layer = batch->layers[cursors[i]];
+      }
+    }
 
-    glBindBuffer(GL_ARRAY_BUFFER, vto);
-    glBufferData(GL_ARRAY_BUFFER, 8 * sizeof(float), texcs, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, 0);
-  } else {
-    float verts[20] = {-0.5f, -0.5f, 0.f,   0.f,  0.f,  -0.5f, 0.5f,
-                       0.f,   0.f,   1.f,   0.5f, 0.5f, 0.f,   1.f,
-                       1.f,   0.5f,  -0.5f, 0.f,  1.f,  0.f};
+    if (layer == 256) {
+      break;
+    }
 
-    for (uint8_t i = 0; i < 20; i += 5) {
-      verts[i] *= width;
-      verts[i + 1] *= height;
+    for (uint32_t i = 0; i < ctx->batch_capacity; ++i) {
+      r_batch* batch = &ctx->batches[i];
+      uint32_t end   = cursors[i];
+
+      while (end < batch->count && batch->layers[end] == layer) {
+        ++end;
+      }
+
+      if (end != cursors[i]) {
+        r_batch_draw_range(ctx, batch, cursors[i], end - cursors[i]);
+        cursors[i] = end;
+      }
     }
+  }
 
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBufferData(GL_ARRAY_BUFFER, 20 * sizeof(float), verts, GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 20, 0);
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 20, 12);
+  for (uint32_t i = 0; i < ctx->batch_capacity; ++i) {
+    if (ctx->batches[i].count != 0) {
+      r_batch_clear(&ctx->batches[i]);
+    }
   }
+}
 
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vboi);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, 6 * sizeof(uint16_t), inds,
-               GL_STATIC_DRAW);
+/* Wait for the GPU to finish with a segment of the stream buffer */
+static void r_stream_wait(r_stream* stream, uint32_t segment) {
+  GLsync fence = stream->fences[segment];
+  if (!fence) {
+    return;
+  }
 
-  glBindVertexArray(0);
+  GLenum result = glClientWaitSync(fence, 0, 0);
+  while (result == GL_TIMEOUT_EXPIRED) {
+    result = glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+  }
 
-  return (r_quad){.vao     = vao,
-                  .vbo     = vbo,
-                  .vto     = vto,
-                  .vboi    = vboi,
-                  .width   = width,
-                  .height  = height,
-                  .use_vto = use_vto};
+  glDeleteSync(fence);
+  stream->fences[segment] = 0;
 }
 
-void r_quad_draw(r_quad quad) {
-  glBindVertexArray(quad.vao);
+/* (Re)create the stream buffer's storage
+ * NOTE: Waits for every segment, so only called on creation & growth */
+static void r_stream_resize(r_stream* stream, uint32_t size) {
+  for (uint32_t i = 0; i < R_STREAM_SEGMENTS; ++i) {
+    r_stream_wait(stream, i);
+  }
 
-  glEnableVertexAttribArray(0);
-  glEnableVertexAttribArray(1);
+  if (!stream->vbo) {
+    glGenBuffers(1, &stream->vbo);
+  }
 
-  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
+  glBindBuffer(GL_ARRAY_BUFFER, stream->vbo);
+  glBufferData(GL_ARRAY_BUFFER, size, 0, GL_STREAM_DRAW);
+  r_res_track(R_RES_BUFFER, stream->vbo, size, __func__);
 
-  // TODO test if this is something we need to do
-  glBindVertexArray(0);
-  glUseProgram(0);
+  // Segments start on 256 byte boundaries so any allocation's alignment only
+  // depends on its offset within the segment
+  stream->size         = size;
+  stream->segment_size = (size / R_STREAM_SEGMENTS) & ~255u;
+  stream->segment      = 0;
+  stream->offset       = 0;
 }
 
-void r_quad_draw_instanced(r_quad quad, uint32_t count) {
-  glBindVertexArray(quad.vao);
-
-  glEnableVertexAttribArray(0);
-  glEnableVertexAttribArray(1);
+/* Fence the current segment & move on to the next one */
+static void r_stream_advance(r_stream* stream) {
+  if (!stream->vbo) {
+    return;
+  }
 
-  glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0, count);
+  if (stream->offset) {
+    stream->fences[stream->segment] =
+        glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  }
 
-  // TODO test if this is something we need to do
-  glBindVertexArray(0);
-  glUseProgram(0);
-}
+  stream->segment = (stream->segment + 1) % R_STREAM_SEGMENTS;
+  stream->offset  = 0;
+
+  r_stream_wait(stream, stream->segment);
+}
+
+/* Map space in the stream buffer for writing (binds it to GL_ARRAY_BUFFER)
+ * size - the amount of bytes to map
+ * align - the alignment of the allocation (i.e vertex size, up to 256)
+ * offset - set to the allocation's offset within the buffer
+ * returns: the mapped pointer, 0 = fail
+ * NOTE: The range is mapped unsynchronized, the segment's fence is what keeps
+ *       it from being written while the GPU could still be reading it */
+static void* r_stream_map(r_stream* stream, uint32_t size, uint32_t align,
+                          uint32_t* offset) {
+  if (!stream->vbo || size > stream->segment_size) {
+    uint32_t new_size = (stream->size) ? stream->size : R_STREAM_SIZE;
+    while (size > ((new_size / R_STREAM_SEGMENTS) & ~255u)) {
+      new_size *= 2;
+    }
 
-void r_quad_destroy(r_quad* quad) {
-  glDeleteVertexArrays(1, &quad->vao);
-  glDeleteBuffers(1, &quad->vbo);
-  glDeleteBuffers(1, &quad->vboi);
+    if (new_size != stream->size) {
+      r_stream_resize(stream, new_size);
+    }
+  }
 
-  if (quad->use_vto) {
-    glDeleteBuffers(1, &quad->vto);
+  uint32_t start = ((stream->offset + align - 1) / align) * align;
+  if (start + size > stream->segment_size) {
+    r_stream_advance(stream);
+    start = 0;
   }
-}
 
-r_window_params r_window_params_create(uint32_t width, uint32_t height,
-                                       uint8_t resizable, uint8_t fullscreen,
-                                       uint8_t vsync, uint8_t borderless,
-                                       uint16_t    refresh_rate,
-                                       const char* title) {
-  return (r_window_params){.width        = width,
-                           .height       = height,
-                           .resizable    = resizable,
-                           .fullscreen   = fullscreen,
-                           .vsync        = vsync,
-                           .borderless   = borderless,
-                           .refresh_rate = refresh_rate,
-                           .title        = title,
-                           .min_width    = 0,
-                           .min_height   = 0,
-                           .max_width    = 0,
-                           .max_height   = 0,
-                           .x            = 0,
-                           .y            = 0};
-}
+  uint32_t base = stream->segment * stream->segment_size;
 
-r_ctx* r_ctx_create(r_window_params params, uint8_t use_fbo,
-                    uint32_t batch_count, uint32_t batch_size,
-                    uint32_t anim_map_size, uint32_t shader_map_size) {
-  r_ctx* ctx = (r_ctx*)malloc(sizeof(r_ctx));
+  glBindBuffer(GL_ARRAY_BUFFER, stream->vbo);
+  void* ptr = glMapBufferRange(GL_ARRAY_BUFFER, base + start, size,
+                               GL_MAP_WRITE_BIT | GL_MAP_UNSYNCHRONIZED_BIT |
+                                   GL_MAP_INVALIDATE_RANGE_BIT);
 
-  if (!r_window_create(ctx, params)) {
-    ASTERA_DBG("r_ctx_create: unable to create window.\n");
-    free(ctx);
+  if (!ptr) {
+    ASTERA_DBG("r_stream_map: unable to map stream buffer.\n");
     return 0;
   }
 
-  if (use_fbo) {
-    ctx->framebuffer = r_framebuffer_create(params.width, params.height, 0);
-  }
+  stream->offset = start + size;
+  *offset        = base + start;
+  return ptr;
+}
 
-  if (batch_count > 0) {
-    ctx->batches = (r_batch*)malloc(sizeof(r_batch) * batch_count);
-    memset(ctx->batches, 0, sizeof(r_batch) * batch_count);
-  } else {
-    ctx->batches = 0;
-  }
+static void r_stream_unmap(r_stream* stream) {
+  glBindBuffer(GL_ARRAY_BUFFER, stream->vbo);
+  glUnmapBuffer(GL_ARRAY_BUFFER);
+}
 
-  ctx->batch_capacity = batch_count;
-  ctx->batch_count    = 0;
-  ctx->batch_size     = batch_size;
+static void r_stream_destroy(r_stream* stream) {
+  for (uint32_t i = 0; i < R_STREAM_SEGMENTS; ++i) {
+    if (stream->fences[i]) {
+      glDeleteSync(stream->fences[i]);
+    }
+  }
 
-  for (uint32_t i = 0; i < batch_count; ++i) {
-    ctx->batches[i].capacity = batch_size;
+  if (stream->vbo) {
+    r_res_untrack(R_RES_BUFFER, stream->vbo);
+    glDeleteBuffers(1, &stream->vbo);
   }
+}
 
-  if (anim_map_size > 0) {
-    ctx->anim_names = (const char**)malloc(sizeof(char*) * anim_map_size);
-    ctx->anims      = (r_anim*)malloc(sizeof(r_anim) * anim_map_size);
-  } else {
-    ctx->anim_names = 0;
-    ctx->anims      = 0;
+/* Start reading pixels into a pixel buffer, delivered once its fence passes
+ * NOTE: Only called on the GL thread */
+static void r_readback_read(r_ctx* ctx, uint32_t fbo, uint32_t width,
+                            uint32_t height, r_readback_func func,
+                            void* data) {
+  if (ctx->readback_count == R_READBACK_SLOTS) {
+    ASTERA_DBG("r_readback_read: too many readbacks in flight.\n");
+    func(0, width, height, data);
+    return;
   }
 
-  ctx->anim_count    = 0;
-  ctx->anim_capacity = anim_map_size;
+  uint32_t index =
+      (ctx->readback_head + ctx->readback_count) % R_READBACK_SLOTS;
+  r_readback* readback = &ctx->readbacks[index];
+  uint32_t    size     = width * height * 4;
 
-  if (shader_map_size > 0) {
-    ctx->shaders      = (r_shader*)malloc(sizeof(r_shader) * shader_map_size);
-    ctx->shader_names = (const char**)malloc(sizeof(char*) * shader_map_size);
-  } else {
-    ctx->shaders      = 0;
-    ctx->shader_names = 0;
+  if (!readback->pbo) {
+    glGenBuffers(1, &readback->pbo);
   }
 
-  ctx->shader_count    = 0;
-  ctx->shader_capacity = shader_map_size;
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, readback->pbo);
+  if (readback->size != size) {
+    glBufferData(GL_PIXEL_PACK_BUFFER, size, 0, GL_STREAM_READ);
+    r_res_track(R_RES_BUFFER, readback->pbo, size, __func__);
+    readback->size = size;
+  }
 
-  ctx->default_quad = r_quad_create(1.f, 1.f, 0);
+  // The read is queued into the pixel buffer, so this doesn't wait on the GPU
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, fbo);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, 0);
+  glBindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  readback->fence  = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  readback->width  = width;
+  readback->height = height;
+  readback->func   = func;
+  readback->data   = data;
+
+  ++ctx->readback_count;
+}
+
+/* Deliver the readbacks the GPU has finished, in the order they were made
+ * wait - 1 = wait for every readback in flight, 0 = only the finished ones
+ * NOTE: Only called on the GL thread */
+static void r_readback_poll(r_ctx* ctx, uint8_t wait) {
+  while (ctx->readback_count) {
+    r_readback* readback = &ctx->readbacks[ctx->readback_head];
+
+    GLenum result = glClientWaitSync(readback->fence, 0, 0);
+    while (wait && result == GL_TIMEOUT_EXPIRED) {
+      result =
+          glClientWaitSync(readback->fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000);
+    }
 
-  vec3 camera_position = {0.f, 0.f, 0.f};
-  vec2 camera_size     = {(float)params.width, (float)params.height};
-  ctx->camera = r_camera_create(camera_position, camera_size, -100.f, 100.f);
+    if (result == GL_TIMEOUT_EXPIRED) {
+      return;
+    }
 
-  return ctx;
-}
+    glDeleteSync(readback->fence);
+    readback->fence = 0;
 
-r_camera* r_ctx_get_camera(r_ctx* ctx) { return &ctx->camera; }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, readback->pbo);
+    unsigned char* pixels = (unsigned char*)glMapBufferRange(
+        GL_PIXEL_PACK_BUFFER, 0, readback->size, GL_MAP_READ_BIT);
 
-void r_ctx_make_current(r_ctx* ctx) { _r_ctx = ctx; }
+    readback->func(pixels, readback->width, readback->height, readback->data);
 
-void r_ctx_set_i_ctx(r_ctx* ctx, i_ctx* input) { ctx->input_ctx = input; }
+    if (pixels) {
+      glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
 
-void r_ctx_set_fbo_shader(r_ctx* ctx, r_shader shader) {
-  ctx->framebuffer.shader = shader;
+    ctx->readback_head = (ctx->readback_head + 1) % R_READBACK_SLOTS;
+    --ctx->readback_count;
+  }
 }
 
-void r_ctx_destroy(r_ctx* ctx) {
-  if (ctx->anims) {
-    for (int i = 0; i < ctx->anim_count; ++i) {
-      r_anim* anim = &ctx->anims[i];
-      if (anim->count != 0 && anim->frames)
-        free(anim->frames);
+static void r_readback_destroy(r_ctx* ctx) {
+  r_readback_poll(ctx, 1);
+
+  for (uint32_t i = 0; i < R_READBACK_SLOTS; ++i) {
+    if (ctx->readbacks[i].pbo) {
+      r_res_untrack(R_RES_BUFFER, ctx->readbacks[i].pbo);
+      glDeleteBuffers(1, &ctx->readbacks[i].pbo);
     }
-    free(ctx->anims);
   }
+}
 
-  if (ctx->anim_names) {
-    free(ctx->anim_names);
+void r_readback_request(r_ctx* ctx, r_framebuffer* fbo, r_readback_func func,
+                        void* data) {
+  if (!ctx || !func) {
+    ASTERA_DBG("r_readback_request: invalid context or callback.\n");
+    return;
   }
 
-  if (ctx->shaders) {
-    for (uint16_t i = 0; i < ctx->shader_capacity; ++i) {
-      if (ctx->shaders[i])
-        glDeleteProgram(ctx->shaders[i]);
+  uint32_t id     = (fbo) ? fbo->fbo : 0;
+  uint32_t width  = (fbo) ? fbo->width : ctx->window.params.width;
+  uint32_t height = (fbo) ? fbo->height : ctx->window.params.height;
+
+  if (r_ctx_recording(ctx)) {
+    r_cmd_readback* cmd =
+        r_cmd_rec(ctx, R_CMD_READBACK, sizeof(r_cmd_readback));
+    if (!cmd) {
+      func(0, width, height, data);
+      return;
     }
 
-    free(ctx->shaders);
-    free(ctx->shader_names);
+    cmd->fbo    = id;
+    cmd->width  = width;
+    cmd->height = height;
+    cmd->func   = func;
+    cmd->data   = data;
+    return;
   }
 
-  if (ctx->batches) {
-    for (uint16_t i = 0; i < ctx->batch_capacity; ++i) {
-      if (ctx->batches[i].mats)
-        free(ctx->batches[i].mats);
-
-      if (ctx->batches[i].coords)
-        free(ctx->batches[i].coords);
-
-      if (ctx->batches[i].colors)
-        free(ctx->batches[i].colors);
+  r_readback_read(ctx, id, width, height, func, data);
+}
 
-      if (ctx->batches[i].flip_x)
-        free(ctx->batches[i].flip_x);
+/* Encode & write a PNG job, then free it */
+static void r_png_job_write(r_png_job* job) {
+  size_t length = 0;
+  void*  png    = tdefl_write_image_to_png_file_in_memory_ex(
+      job->pixels, job->width, job->height, 4, &length, MZ_DEFAULT_LEVEL,
+      MZ_TRUE);
 
-      if (ctx->batches[i].flip_y)
-        free(ctx->batches[i].flip_y);
+  if (png) {
+    FILE* file = fopen(job->path, "wb");
+    if (file) {
+      fwrite(png, 1, length, file);
+      fclose(file);
+    } else {
+      ASTERA_DBG("r_png_job_write: unable to open %s.\n", job->path);
     }
 
-    free(ctx->batches);
+    mz_free(png);
+  } else {
+    ASTERA_DBG("r_png_job_write: unable to encode %s.\n", job->path);
   }
 
-  r_quad_destroy(&ctx->default_quad);
-
-  r_window_destroy(ctx);
-  glfwTerminate();
+  free(job->pixels);
+  free(job->path);
+  free(job);
 }
 
-void r_ctx_update(r_ctx* ctx) { r_camera_update(&ctx->camera); }
+#if !defined(ASTERA_NO_THREADS)
+static void r_png_worker_run(void* data) {
+  r_png_worker* worker = (r_png_worker*)data;
 
-void r_ctx_draw(r_ctx* ctx) {
-  for (uint32_t i = 0; i < ctx->batch_capacity; ++i) {
-    r_batch* batch = &ctx->batches[i];
+  s_mutex_lock(worker->lock);
+  for (;;) {
+    while (!worker->head && !worker->quit) {
+      s_cond_wait(worker->cond, worker->lock);
+    }
 
-    if (batch->count != 0) {
-      r_batch_draw(ctx, batch);
+    // Always finish the queue before quitting
+    r_png_job* job = worker->head;
+    if (!job) {
+      break;
     }
+
+    worker->head = job->next;
+    if (!worker->head) {
+      worker->tail = 0;
+    }
+    s_mutex_unlock(worker->lock);
+
+    r_png_job_write(job);
+
+    s_mutex_lock(worker->lock);
   }
+  s_mutex_unlock(worker->lock);
 }
 
-r_camera r_camera_create(vec3 position, vec2 size, float near, float far) {
-  r_camera cam = (r_camera){.near = near, .far = far, .rotation = 0.f};
+static r_png_worker* r_png_worker_create(void) {
+  r_png_worker* worker = (r_png_worker*)calloc(1, sizeof(r_png_worker));
+  if (!worker) {
+    return 0;
+  }
 
-  mat4x4_identity(cam.projection);
-  mat4x4_ortho(cam.projection, 0, size[0], size[1], 0, near, far);
-  vec2_dup(cam.size, size);
-  vec2_dup(cam.position, position);
+  worker->lock = s_mutex_create();
+  worker->cond = s_cond_create();
 
-  mat4x4_identity(cam.view);
-  mat4x4_translate(cam.view, position[0], position[1], 0.f);
+  if (worker->lock && worker->cond) {
+    worker->thread = s_thread_create(r_png_worker_run, worker);
+  }
 
-  return cam;
-}
+  if (!worker->thread) {
+    if (worker->lock)
+      s_mutex_destroy(worker->lock);
+    if (worker->cond)
+      s_cond_destroy(worker->cond);
+    free(worker);
+    return 0;
+  }
 
-void r_camera_move(r_camera* camera, vec3 dist) {
-  vec3_add(camera->position, camera->position, dist);
+  return worker;
 }
 
-void r_camera_get_size(vec2 dst, r_camera* camera) {
-  vec2_dup(dst, camera->size);
-}
+static void r_png_worker_destroy(r_png_worker* worker) {
+  if (!worker) {
+    return;
+  }
 
-void r_camera_set_size(r_camera* camera, vec2 size) {
-  vec2_dup(camera->size, size);
-  mat4x4_ortho(camera->projection, 0, camera->size[0], camera->size[1], 0,
-               camera->near, camera->far);
-}
+  s_mutex_lock(worker->lock);
+  worker->quit = 1;
+  s_cond_signal(worker->cond);
+  s_mutex_unlock(worker->lock);
 
-void r_camera_update(r_camera* camera) {
-  mat4x4_identity(camera->view);
-  mat4x4_translate(camera->view, camera->position[0], camera->position[1],
-                   camera->position[2]);
+  s_thread_join(worker->thread);
+  s_mutex_destroy(worker->lock);
+  s_cond_destroy(worker->cond);
+  free(worker);
 }
+#endif
 
-void r_cam_screen_to_world(vec2 dst, r_camera* camera, vec2 point) {
-  if (!dst || !camera || !point) {
+/* Copy a PNG readback's pixels out of the pixel buffer & queue its encode */
+static void r_readback_png_func(unsigned char* pixels, uint32_t width,
+                                uint32_t height, void* data) {
+  r_png_job* job = (r_png_job*)data;
+
+  if (pixels) {
+    job->pixels = (unsigned char*)malloc(width * height * 4);
+  }
+
+  if (!job->pixels) {
+    ASTERA_DBG("r_readback_png: unable to read pixels for %s.\n", job->path);
+    free(job->path);
+    free(job);
     return;
   }
 
-  dst[0] = point[0] * camera->size[0] + camera->position[0];
-  dst[1] = point[1] * camera->size[1] + camera->position[1];
-}
+  memcpy(job->pixels, pixels, width * height * 4);
+  job->width  = width;
+  job->height = height;
 
-void r_cam_world_to_screen(vec2 dst, r_camera* camera, vec2 point) {
-  if (!dst || !camera || !point) {
+#if !defined(ASTERA_NO_THREADS)
+  r_png_worker* worker = job->worker;
+  if (worker) {
+    s_mutex_lock(worker->lock);
+    if (worker->tail) {
+      worker->tail->next = job;
+    } else {
+      worker->head = job;
+    }
+    worker->tail = job;
+    s_cond_signal(worker->cond);
+    s_mutex_unlock(worker->lock);
     return;
   }
+#endif
 
-  dst[0] =
-      (point[0] / camera->size[0]) - (camera->position[0] / camera->size[0]);
-  dst[1] =
-      (point[1] / camera->size[1]) - (camera->position[1] / camera->size[1]);
+  r_png_job_write(job);
 }
 
-r_framebuffer r_framebuffer_create(uint32_t width, uint32_t height,
-                                   r_shader shader) {
-  r_framebuffer fbo =
-      (r_framebuffer){.width = width, .height = height, .shader = shader};
+void r_readback_png(r_ctx* ctx, r_framebuffer* fbo, const char* path) {
+  if (!ctx || !path) {
+    ASTERA_DBG("r_readback_png: invalid context or path.\n");
+    return;
+  }
 
-  glGenFramebuffers(1, &fbo.fbo);
-  glBindFramebuffer(GL_FRAMEBUFFER, fbo.fbo);
+  r_png_job* job = (r_png_job*)calloc(1, sizeof(r_png_job));
+  if (!job) {
+    ASTERA_DBG("r_readback_png: unable to allocate job.\n");
+    return;
+  }
 
-  glGenTextures(1, &fbo.tex);
-  glBindTexture(GL_TEXTURE_2D, fbo.tex);
+  size_t path_length = strlen(path) + 1;
+  job->path          = (char*)malloc(path_length);
+  if (!job->path) {
+    ASTERA_DBG("r_readback_png: unable to allocate job.\n");
+    free(job);
+    return;
+  }
+  memcpy(job->path, path, path_length);
 
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA,
-               GL_FLOAT, NULL);
+#if !defined(ASTERA_NO_THREADS)
+  if (!ctx->png_worker) {
+    ctx->png_worker = r_png_worker_create();
+  }
+  job->worker = ctx->png_worker;
+#endif
 
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  r_readback_request(ctx, fbo, r_readback_png_func, job);
+}
+
+// The amount of segments used to draw circles
+#define R_IM_CIRCLE_SEGMENTS 32
+
+static const char* r_im_vert_src =
+    "#version 330\n"
+    "layout(location = 0) in vec3 in_pos;\n"
+    "layout(location = 1) in vec4 in_color;\n"
+    "uniform mat4 projection;\n"
+    "uniform mat4 view;\n"
+    "out vec4 pass_color;\n"
+    "void main() {\n"
+    "  pass_color = in_color;\n"
+    "  gl_Position = projection * view * vec4(in_pos, 1.0);\n"
+    "}\n";
+
+static const char* r_im_frag_src = "#version 330\n"
+                                   "in vec4 pass_color;\n"
+                                   "out vec4 out_color;\n"
+                                   "void main() { out_color = pass_color; }\n";
+
+/* Create the immediate mode shader & vertex array */
+static uint8_t r_im_init(r_im* im, r_stream* stream) {
+  im->shader = r_shader_create((unsigned char*)r_im_vert_src,
+                               (unsigned char*)r_im_frag_src);
+  if (!im->shader) {
+    ASTERA_DBG("r_im_init: unable to create shader.\n");
+    return 0;
+  }
 
-  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
-                         fbo.tex, 0);
+  glGenVertexArrays(1, &im->vao);
+  glBindVertexArray(im->vao);
+  r_res_track(R_RES_VAO, im->vao, 0, __func__);
 
-  glGenRenderbuffers(1, &fbo.rbo);
-  glBindRenderbuffer(GL_RENDERBUFFER, fbo.rbo);
-  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
-  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
-                            GL_RENDERBUFFER, fbo.rbo);
+  // Vertices are streamed at vertex aligned offsets, so the draws pick them
+  // out with their first vertex rather than rebinding the attributes
+  glBindBuffer(GL_ARRAY_BUFFER, stream->vbo);
 
-  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-    ASTERA_DBG("Incomplete FBO: %i\n", fbo.fbo);
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, sizeof(r_im_vert), 0);
+  glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(r_im_vert),
+                        (void*)12);
 
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
 
-  float verts[20] = {-0.5f, -0.5f, 0.f, 0.f, 0.f, -0.5f, 0.5f,  0.f, 0.f, 1.f,
-                     0.5f,  0.5f,  0.f, 1.f, 1.f, 0.5f,  -0.5f, 0.f, 1.f, 0.f};
+  return 1;
+}
 
-  for (uint8_t i = 0; i < 20; i += 5) {
-    verts[i] *= 2;
-    verts[i + 1] *= 2;
+static void r_im_destroy(r_im* im) {
+  if (im->shader) {
+    r_res_untrack(R_RES_PROGRAM, im->shader);
+    r_res_untrack(R_RES_VAO, im->vao);
+    glDeleteProgram(im->shader);
+    glDeleteVertexArrays(1, &im->vao);
   }
 
-  uint16_t indices[6] = {0, 1, 2, 2, 3, 0};
+  if (im->tris)
+    free(im->tris);
 
-  glGenVertexArrays(1, &fbo.vao);
-  glGenBuffers(1, &fbo.vbo);
-  glGenBuffers(1, &fbo.vboi);
+  if (im->lines)
+    free(im->lines);
+}
 
-  glBindVertexArray(fbo.vao);
+/* Draw immediate mode vertices, triangles then lines, over everything else */
+static void r_im_render(r_ctx* ctx, r_im_vert* tris, uint32_t tri_count,
+                        r_im_vert* lines, uint32_t line_count) {
+  r_im* im = &ctx->im;
 
-  glBindBuffer(GL_ARRAY_BUFFER, fbo.vbo);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 20, verts, GL_STATIC_DRAW);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 20, 0);
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 20, 12);
-  glEnableVertexAttribArray(0);
-  glEnableVertexAttribArray(1);
+  if (!tri_count && !line_count) {
+    return;
+  }
 
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, fbo.vboi);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * 6, indices,
-               GL_STATIC_DRAW);
+  uint32_t tri_size  = tri_count * sizeof(r_im_vert);
+  uint32_t line_size = line_count * sizeof(r_im_vert);
+  uint32_t offset;
 
-  glBindVertexArray(0);
+  r_im_vert* mapped = (r_im_vert*)r_stream_map(
+      &ctx->stream, tri_size + line_size, sizeof(r_im_vert), &offset);
+  if (!mapped) {
+    return;
+  }
 
-  return fbo;
-}
+  if (tri_size)
+    memcpy(mapped, tris, tri_size);
+  if (line_size)
+    memcpy(mapped + tri_count, lines, line_size);
+  r_stream_unmap(&ctx->stream);
 
-void r_framebuffer_destroy(r_framebuffer fbo) {
-  glDeleteFramebuffers(1, &fbo.fbo);
-  glDeleteTextures(1, &fbo.tex);
-  glDeleteBuffers(1, &fbo.vbo);
-  glDeleteVertexArrays(1, &fbo.vao);
-}
+  if (!im->shader && !r_im_init(im, &ctx->stream)) {
+    return;
+  }
 
-void r_framebuffer_bind(r_framebuffer fbo) {
-  glBindFramebuffer(GL_FRAMEBUFFER, fbo.fbo);
-}
+  uint32_t first = offset / sizeof(r_im_vert);
 
-void r_framebuffer_draw(r_ctx* ctx, r_framebuffer fbo) {
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  glDisable(GL_DEPTH_TEST);
+  glBindVertexArray(im->vao);
+  r_shader_bind(im->shader);
 
-  glBindVertexArray(fbo.vao);
-  glUseProgram(fbo.shader);
+  r_camera* camera = r_ctx_draw_camera(ctx);
+  r_set_m4(im->shader, "view", camera->view);
+  r_set_m4(im->shader, "projection", camera->projection);
 
-  r_set_uniformf(fbo.shader, "gamma", ctx->window.params.gamma);
+  glDisable(GL_DEPTH_TEST);
 
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, fbo.tex);
+  if (tri_count)
+    glDrawArrays(GL_TRIANGLES, first, tri_count);
+  if (line_count)
+    glDrawArrays(GL_LINES, first + tri_count, line_count);
 
-  glBindBuffer(GL_ARRAY_BUFFER, fbo.vbo);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, fbo.vboi);
+  glEnable(GL_DEPTH_TEST);
 
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 20, 0);
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 20, 12);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  glBindVertexArray(0);
+  r_shader_bind(0);
+}
 
-  glEnableVertexAttribArray(0);
-  glEnableVertexAttribArray(1);
+/* Draw (or record) the queued primitives & reset the queue */
+static void r_im_flush(r_ctx* ctx) {
+  r_im* im = &ctx->im;
 
-  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
+  if (!im->tri_count && !im->line_count) {
+    return;
+  }
 
-  glBindVertexArray(0);
-  glUseProgram(0);
+  if (r_ctx_recording(ctx)) {
+    r_cmd_camera_sync(ctx);
 
-  glEnable(GL_DEPTH_TEST);
-}
+    uint32_t  verts = im->tri_count + im->line_count;
+    r_cmd_im* cmd   = r_cmd_rec(ctx, R_CMD_IM,
+                              sizeof(r_cmd_im) + (verts * sizeof(r_im_vert)));
+    if (cmd) {
+      cmd->tri_count     = im->tri_count;
+      cmd->line_count    = im->line_count;
+      r_im_vert* payload = (r_im_vert*)(cmd + 1);
 
-void r_tex_bind(uint32_t tex) {
-  glActiveTexture(GL_TEXTURE0);
-  glBindTexture(GL_TEXTURE_2D, tex);
+      memcpy(payload, im->tris, im->tri_count * sizeof(r_im_vert));
+      memcpy(payload + im->tri_count, im->lines,
+             im->line_count * sizeof(r_im_vert));
+    }
+  } else {
+    r_im_render(ctx, im->tris, im->tri_count, im->lines, im->line_count);
+  }
+
+  im->tri_count  = 0;
+  im->line_count = 0;
 }
 
-r_tex r_tex_create(unsigned char* data, uint32_t length) {
-  int            w, h, ch;
-  unsigned char* img = stbi_load_from_memory(data, length, &w, &h, &ch, 0);
-  uint32_t       id;
-  glGenTextures(1, &id);
-  glBindTexture(GL_TEXTURE_2D, id);
+/* Reserve vertices in an immediate mode array
+ * returns: a pointer to the first vertex to write, 0 = fail */
+static r_im_vert* r_im_reserve(r_im_vert** verts, uint32_t* count,
+                               uint32_t* capacity, uint32_t needed) {
+  if (*count + needed > *capacity) {
+    uint32_t grown_capacity = (*capacity) ? *capacity : 1024;
+    while (grown_capacity < *count + needed) {
+      grown_capacity *= 2;
+    }
 
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    r_im_vert* grown =
+        (r_im_vert*)realloc(*verts, grown_capacity * sizeof(r_im_vert));
+    if (!grown) {
+      ASTERA_DBG("r_im_reserve: unable to grow vertex array.\n");
+      return 0;
+    }
 
-  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE,
-               img);
+    *verts    = grown;
+    *capacity = grown_capacity;
+  }
 
-  stbi_image_free(img);
+  r_im_vert* start = *verts + *count;
+  *count += needed;
+  return start;
+}
 
-  return (r_tex){id, (uint32_t)w, (uint32_t)h};
+static r_im_vert* r_im_tris(r_ctx* ctx, uint32_t count) {
+  r_im* im = &ctx->im;
+  return r_im_reserve(&im->tris, &im->tri_count, &im->tri_capacity, count);
 }
 
-void r_tex_destroy(r_tex* tex) { glDeleteTextures(1, &tex->id); }
+static r_im_vert* r_im_lines(r_ctx* ctx, uint32_t count) {
+  r_im* im = &ctx->im;
+  return r_im_reserve(&im->lines, &im->line_count, &im->line_capacity, count);
+}
 
-r_sheet r_sheet_create_tiled(unsigned char* data, uint32_t length,
-                             uint32_t sub_width, uint32_t sub_height,
-                             uint32_t width_pad, uint32_t height_pad) {
-  if (!data || !length || !sub_width || !sub_height) {
-    ASTERA_DBG("r_sheet_create_tiled: invalid texture data passed.\n");
-    return (r_sheet){0};
+static uint32_t r_im_pack_color(vec4 color) {
+  uint32_t packed = 0;
+  for (uint8_t i = 0; i < 4; ++i) {
+    float channel = color[i];
+    channel       = (channel < 0.f) ? 0.f : (channel > 1.f) ? 1.f : channel;
+    packed |= (uint32_t)(channel * 255.f + 0.5f) << (i * 8);
   }
-  // Load the texture data
-  uint32_t w, h, ch;
-  uint32_t id;
-
-  unsigned char* img = stbi_load_from_memory(data, length, &w, &h, &ch, 0);
+  return packed;
+}
 
-  int format = (ch == 4) ? GL_RGBA : (ch == 3) ? GL_RGB : GL_RGB;
+static inline r_im_vert r_im_vert_create(float x, float y, uint32_t color) {
+  return (r_im_vert){.x = x, .y = y, .z = 0.f, .color = color};
+}
 
-  glGenTextures(1, &id);
-  glBindTexture(GL_TEXTURE_2D, id);
+void r_im_line(r_ctx* ctx, vec2 a, vec2 b, vec4 color) {
+  r_im_vert* verts = r_im_lines(ctx, 2);
+  if (!verts)
+    return;
 
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+  uint32_t packed = r_im_pack_color(color);
+  verts[0]        = r_im_vert_create(a[0], a[1], packed);
+  verts[1]        = r_im_vert_create(b[0], b[1], packed);
+}
 
-  glTexImage2D(GL_TEXTURE_2D, 0, format, w, h, 0, format, GL_UNSIGNED_BYTE,
-               img);
+void r_im_rect(r_ctx* ctx, vec2 position, vec2 size, vec4 color) {
+  r_im_vert* verts = r_im_tris(ctx, 6);
+  if (!verts)
+    return;
 
-  glBindTexture(GL_TEXTURE_2D, 0);
+  uint32_t packed = r_im_pack_color(color);
+  float    min_x = position[0] - (size[0] * 0.5f), max_x = min_x + size[0];
+  float    min_y = position[1] - (size[1] * 0.5f), max_y = min_y + size[1];
 
-  stbi_image_free(img);
+  verts[0] = r_im_vert_create(min_x, min_y, packed);
+  verts[1] = r_im_vert_create(max_x, min_y, packed);
+  verts[2] = r_im_vert_create(max_x, max_y, packed);
+  verts[3] = verts[2];
+  verts[4] = r_im_vert_create(min_x, max_y, packed);
+  verts[5] = verts[0];
+}
 
-  uint32_t per_width = w / sub_width;
-  uint32_t rows      = h / sub_height;
-  uint32_t sub_count = rows * per_width;
+void r_im_rect_outline(r_ctx* ctx, vec2 position, vec2 size, vec4 color) {
+  r_im_vert* verts = r_im_lines(ctx, 8);
+  if (!verts)
+    return;
 
-  r_subtex* subtexs = (r_subtex*)malloc(sizeof(r_subtex) * sub_count);
+  uint32_t packed = r_im_pack_color(color);
+  float    min_x = position[0] - (size[0] * 0.5f), max_x = min_x + size[0];
+  float    min_y = position[1] - (size[1] * 0.5f), max_y = min_y + size[1];
+
+  verts[0] = r_im_vert_create(min_x, min_y, packed);
+  verts[1] = r_im_vert_create(max_x, min_y, packed);
+  verts[2] = verts[1];
+  verts[3] = r_im_vert_create(max_x, max_y, packed);
+  verts[4] = verts[3];
+  verts[5] = r_im_vert_create(min_x, max_y, packed);
+  verts[6] = verts[5];
+  verts[7] = verts[0];
+}
+
+/* Get the points around a circle, stepping by rotation rather than calling
+ * sin / cos for every point */
+static void r_im_circle_points(vec2 center, float radius, vec2* points) {
+  float step = (2.f * 3.141592654f) / R_IM_CIRCLE_SEGMENTS;
+  float c = cosf(step), s = sinf(step);
+  float x = radius, y = 0.f;
+
+  for (uint32_t i = 0; i < R_IM_CIRCLE_SEGMENTS; ++i) {
+    points[i][0] = center[0] + x;
+    points[i][1] = center[1] + y;
+
+    float next_x = (x * c) - (y * s);
+    y            = (x * s) + (y * c);
+    x            = next_x;
+  }
+}
 
-  for (uint32_t i = 0; i < sub_count; ++i) {
-    uint32_t x = i % per_width;
-    uint32_t y = i / per_width;
+void r_im_circle(r_ctx* ctx, vec2 center, float radius, vec4 color) {
+  r_im_vert* verts = r_im_tris(ctx, R_IM_CIRCLE_SEGMENTS * 3);
+  if (!verts)
+    return;
 
-    float x_offset = (x * sub_width) + width_pad;
-    float y_offset = (y * sub_height) + height_pad;
-    float width    = sub_width - (width_pad * 2);
-    float height   = sub_height - (height_pad * 2);
+  vec2 points[R_IM_CIRCLE_SEGMENTS];
+  r_im_circle_points(center, radius, points);
 
-    vec4 coords = {x_offset / w, y_offset / h, (x_offset + width) / w,
-                   (y_offset + height) / h};
+  uint32_t packed = r_im_pack_color(color);
+  for (uint32_t i = 0; i < R_IM_CIRCLE_SEGMENTS; ++i) {
+    float* next = points[(i + 1) % R_IM_CIRCLE_SEGMENTS];
 
-    subtexs[i] = (r_subtex){.x      = (uint32_t)x_offset,
-                            .y      = (uint32_t)y_offset,
-                            .width  = (uint32_t)width,
-                            .height = (uint32_t)height};
-    vec4_dup(subtexs[i].coords, coords);
+    verts[(i * 3) + 0] = r_im_vert_create(center[0], center[1], packed);
+    verts[(i * 3) + 1] = r_im_vert_create(points[i][0], points[i][1], packed);
+    verts[(i * 3) + 2] = r_im_vert_create(next[0], next[1], packed);
   }
+}
 
-  return (r_sheet){.id       = id,
-                   .width    = w,
-                   .height   = h,
-                   .subtexs  = subtexs,
-                   .count    = sub_count,
-                   .capacity = sub_count};
+void r_im_circle_outline(r_ctx* ctx, vec2 center, float radius, vec4 color) {
+  r_im_vert* verts = r_im_lines(ctx, R_IM_CIRCLE_SEGMENTS * 2);
+  if (!verts)
+    return;
+
+  vec2 points[R_IM_CIRCLE_SEGMENTS];
+  r_im_circle_points(center, radius, points);
+
+  uint32_t packed = r_im_pack_color(color);
+  for (uint32_t i = 0; i < R_IM_CIRCLE_SEGMENTS; ++i) {
+    float* next = points[(i + 1) % R_IM_CIRCLE_SEGMENTS];
+
+    verts[(i * 2) + 0] = r_im_vert_create(points[i][0], points[i][1], packed);
+    verts[(i * 2) + 1] = r_im_vert_create(next[0], next[1], packed);
+  }
 }
 
-void r_sheet_destroy(r_sheet* sheet) {
-  glDeleteTextures(1, &sheet->id);
-  free(sheet->subtexs);
+void r_im_poly(r_ctx* ctx, vec2* points, uint32_t count, vec4 color) {
+  if (!points || count < 3)
+    return;
+
+  r_im_vert* verts = r_im_tris(ctx, (count - 2) * 3);
+  if (!verts)
+    return;
+
+  // Triangle fan around the first point
+  uint32_t packed = r_im_pack_color(color);
+  for (uint32_t i = 1; i < count - 1; ++i) {
+    r_im_vert* tri = &verts[(i - 1) * 3];
+
+    tri[0] = r_im_vert_create(points[0][0], points[0][1], packed);
+    tri[1] = r_im_vert_create(points[i][0], points[i][1], packed);
+    tri[2] = r_im_vert_create(points[i + 1][0], points[i + 1][1], packed);
+  }
 }
 
-r_baked_sheet r_baked_sheet_create(r_sheet* sheet, r_baked_quad* quads,
-                                   uint32_t quad_count, vec2 position) {
-  if (!quads || !quad_count) {
-    ASTERA_DBG("r_baked_sheet_create: invalid quad parameters.\n");
-    return (r_baked_sheet){0};
+void r_im_poly_outline(r_ctx* ctx, vec2* points, uint32_t count, vec4 color) {
+  if (!points || count < 2)
+    return;
+
+  r_im_vert* verts = r_im_lines(ctx, count * 2);
+  if (!verts)
+    return;
+
+  uint32_t packed = r_im_pack_color(color);
+  for (uint32_t i = 0; i < count; ++i) {
+    float* next = points[(i + 1) % count];
+
+    verts[(i * 2) + 0] = r_im_vert_create(points[i][0], points[i][1], packed);
+    verts[(i * 2) + 1] = r_im_vert_create(next[0], next[1], packed);
   }
+}
 
-  uint32_t vert_cap = quad_count * 20, vert_count = 0;
-  uint32_t ind_cap = quad_count * 6, ind_count = 0;
-  uint32_t uvert_count = 0;
+static const char* r_light_vert_src =
+    "#version 330\n"
+    "void main() {\n"
+    "  vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);\n"
+    "  gl_Position = vec4((pos * 2.0) - 1.0, 0.0, 1.0);\n"
+    "}\n";
+
+static const char* r_light_frag_src =
+    "#version 330\n"
+    "uniform samplerBuffer lights;\n"
+    "uniform usamplerBuffer tiles;\n"
+    "uniform vec2 world_scale;\n"
+    "uniform vec2 world_offset;\n"
+    "uniform int tile_size;\n"
+    "uniform int tiles_x;\n"
+    "uniform vec3 ambient;\n"
+    "out vec4 out_color;\n"
+    "void main() {\n"
+    "  ivec2 tile = ivec2(gl_FragCoord.xy) / tile_size;\n"
+    "  int header = ((tile.y * tiles_x) + tile.x) * 2;\n"
+    "  int start = int(texelFetch(tiles, header).r);\n"
+    "  int count = int(texelFetch(tiles, header + 1).r);\n"
+    "  vec2 world = (gl_FragCoord.xy * world_scale) + world_offset;\n"
+    "  vec3 light = ambient;\n"
+    "  for (int i = 0; i < count; ++i) {\n"
+    "    int index = int(texelFetch(tiles, start + i).r) * 2;\n"
+    "    vec4 shape = texelFetch(lights, index);\n"
+    "    vec3 color = texelFetch(lights, index + 1).rgb;\n"
+    "    float falloff = clamp(1.0 - (distance(world, shape.xy) / shape.z),\n"
+    "                          0.0, 1.0);\n"
+    "    light += color * (falloff * falloff * shape.w);\n"
+    "  }\n"
+    "  out_color = vec4(light, 1.0);\n"
+    "}\n";
+
+/* Create a texture buffer & the buffer backing it
+ * format - the internal format of the texels */
+static void r_lighting_tbo(uint32_t* buf, uint32_t* tex, GLenum format) {
+  glGenBuffers(1, buf);
+  glBindBuffer(GL_TEXTURE_BUFFER, *buf);
+  glBufferData(GL_TEXTURE_BUFFER, 16, 0, GL_STREAM_DRAW);
+
+  glGenTextures(1, tex);
+  glBindTexture(GL_TEXTURE_BUFFER, *tex);
+  glTexBuffer(GL_TEXTURE_BUFFER, format, *buf);
+
+  r_res_track(R_RES_BUFFER, *buf, 16, "r_lighting_init");
+  r_res_track(R_RES_TEXTURE, *tex, 0, "r_lighting_init");
+}
+
+/* Create the lighting shader, vertex array & texture buffers */
+static uint8_t r_lighting_init(r_lighting* lighting) {
+  lighting->shader = r_shader_create((unsigned char*)r_light_vert_src,
+                                     (unsigned char*)r_light_frag_src);
+  if (!lighting->shader) {
+    ASTERA_DBG("r_lighting_init: unable to create shader.\n");
+    return 0;
+  }
 
-  float*    verts = (float*)malloc(sizeof(float) * vert_cap);
-  uint16_t* inds  = (uint16_t*)malloc(sizeof(uint16_t) * ind_cap);
+  // The fullscreen triangle comes from gl_VertexID, but core profiles still
+  // need a vertex array bound to draw
+  glGenVertexArrays(1, &lighting->vao);
+  r_res_track(R_RES_VAO, lighting->vao, 0, __func__);
 
-  uint16_t _inds[6]  = {0, 1, 2, 2, 3, 0};
-  float    _verts[8] = {-0.5f, 0.5f, 0.5f, 0.5f, 0.5f, -0.5f, -0.5f, -0.5f};
-  float    _texcs[8] = {0.f, 1.f, 1.f, 1.f, 1.f, 0.f, 0.f, 0.f};
+  r_lighting_tbo(&lighting->light_buf, &lighting->light_tex, GL_RGBA32F);
+  r_lighting_tbo(&lighting->tile_buf, &lighting->tile_tex, GL_R32UI);
 
-  vec4 bounds = {0.f, 0.f, 0.f, 0.f};
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
 
-  for (uint32_t i = 0; i < quad_count; ++i) {
-    r_baked_quad* quad   = &quads[i];
-    r_subtex*     subtex = &sheet->subtexs[quad->subtex];
+  return 1;
+}
 
-    vec2 _offset = {quad->x, quad->y};
-    vec2 _size   = {quad->width, quad->height};
+static void r_lighting_destroy(r_lighting* lighting) {
+  if (lighting->shader) {
+    r_res_untrack(R_RES_PROGRAM, lighting->shader);
+    r_res_untrack(R_RES_VAO, lighting->vao);
+    r_res_untrack(R_RES_BUFFER, lighting->light_buf);
+    r_res_untrack(R_RES_BUFFER, lighting->tile_buf);
+    r_res_untrack(R_RES_TEXTURE, lighting->light_tex);
+    r_res_untrack(R_RES_TEXTURE, lighting->tile_tex);
+
+    glDeleteProgram(lighting->shader);
+    glDeleteVertexArrays(1, &lighting->vao);
+    glDeleteBuffers(1, &lighting->light_buf);
+    glDeleteBuffers(1, &lighting->tile_buf);
+    glDeleteTextures(1, &lighting->light_tex);
+    glDeleteTextures(1, &lighting->tile_tex);
+  }
 
-    vec2 _tex_offset = {subtex->coords[0], subtex->coords[1]};
-    vec2 _tex_size   = {subtex->coords[2], subtex->coords[3]};
-    vec2_sub(_tex_size, _tex_size, _tex_offset);
+  free(lighting->lights);
+  free(lighting->ranges);
+  free(lighting->tiles);
+}
+
+/* Find the tiles each light covers, lights entirely off screen get an empty
+ * range (max < min)
+ * scale, offset - world to window pixels (pixel = world * scale + offset)
+ * tiles_x, tiles_y - the amount of tiles on each axis */
+static void r_lights_bin(const r_light* lights, uint32_t count,
+                         int32_t* ranges, vec2 scale, vec2 offset,
+                         int32_t tiles_x, int32_t tiles_y) {
+  float inv_tile = 1.f / R_LIGHT_TILE;
+  uint32_t i     = 0;
+
+#if defined(R_SSE2)
+  // 4 lights at a time, the bounds are clamped a tile past the edges before
+  // being truncated, so lights off screen end up past the range instead
+  const __m128 scale_x  = _mm_set1_ps(scale[0] * inv_tile);
+  const __m128 scale_y  = _mm_set1_ps(scale[1] * inv_tile);
+  const __m128 offset_x = _mm_set1_ps(offset[0] * inv_tile);
+  const __m128 offset_y = _mm_set1_ps(offset[1] * inv_tile);
+  const __m128 low      = _mm_set1_ps(-1.f);
+  const __m128 high_x   = _mm_set1_ps((float)tiles_x);
+  const __m128 high_y   = _mm_set1_ps((float)tiles_y);
+
+  for (; i + 4 <= count; i += 4) {
+    const r_light* l = &lights[i];
+
+    __m128 x = _mm_set_ps(l[3].position[0], l[2].position[0], l[1].position[0],
+                          l[0].position[0]);
+    __m128 y = _mm_set_ps(l[3].position[1], l[2].position[1], l[1].position[1],
+                          l[0].position[1]);
+    __m128 r =
+        _mm_set_ps(l[3].radius, l[2].radius, l[1].radius, l[0].radius);
+
+    __m128 x0 = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(x, r), scale_x), offset_x);
+    __m128 x1 = _mm_add_ps(_mm_mul_ps(_mm_add_ps(x, r), scale_x), offset_x);
+    __m128 y0 = _mm_add_ps(_mm_mul_ps(_mm_sub_ps(y, r), scale_y), offset_y);
+    __m128 y1 = _mm_add_ps(_mm_mul_ps(_mm_add_ps(y, r), scale_y), offset_y);
+
+    // The scale can flip an axis (window Y is up)
+    __m128 min_x = _mm_max_ps(_mm_min_ps(_mm_min_ps(x0, x1), high_x), low);
+    __m128 max_x = _mm_max_ps(_mm_min_ps(_mm_max_ps(x0, x1), high_x), low);
+    __m128 min_y = _mm_max_ps(_mm_min_ps(_mm_min_ps(y0, y1), high_y), low);
+    __m128 max_y = _mm_max_ps(_mm_min_ps(_mm_max_ps(y0, y1), high_y), low);
+
+    int32_t bounds[4][4];
+    _mm_storeu_si128((__m128i*)bounds[0], _mm_cvttps_epi32(min_x));
+    _mm_storeu_si128((__m128i*)bounds[1], _mm_cvttps_epi32(min_y));
+    _mm_storeu_si128((__m128i*)bounds[2], _mm_cvttps_epi32(max_x));
+    _mm_storeu_si128((__m128i*)bounds[3], _mm_cvttps_epi32(max_y));
 
     for (uint32_t j = 0; j < 4; ++j) {
-      verts[vert_count]     = (_verts[j * 2] * _size[0]) + _offset[0];
-      verts[vert_count + 1] = (_verts[(j * 2) + 1] * _size[1]) + _offset[1];
-      verts[vert_count + 2] = quad->layer * ASTERA_RENDER_LAYER_MOD;
+      int32_t* range = &ranges[(i + j) * 4];
+      range[0]       = bounds[0][j];
+      range[1]       = bounds[1][j];
+      range[2]       = bounds[2][j];
+      range[3]       = bounds[3][j];
+    }
+  }
+#endif
 
-      float sample_x = _texcs[j * 2];
-      float sample_y = _texcs[(j * 2) + 1];
+  for (; i < count; ++i) {
+    const r_light* l = &lights[i];
 
-      if (quad->flip_x) {
-        sample_x = 1.f - sample_x;
-      }
+    float x0 = ((l->position[0] - l->radius) * scale[0] + offset[0]) * inv_tile;
+    float x1 = ((l->position[0] + l->radius) * scale[0] + offset[0]) * inv_tile;
+    float y0 = ((l->position[1] - l->radius) * scale[1] + offset[1]) * inv_tile;
+    float y1 = ((l->position[1] + l->radius) * scale[1] + offset[1]) * inv_tile;
 
-      if (quad->flip_y) {
-        sample_y = 1.f - sample_y;
-      }
+    int32_t* range = &ranges[i * 4];
+    range[0] = (int32_t)fmaxf(fminf(fminf(x0, x1), (float)tiles_x), -1.f);
+    range[1] = (int32_t)fmaxf(fminf(fminf(y0, y1), (float)tiles_y), -1.f);
+    range[2] = (int32_t)fmaxf(fminf(fmaxf(x0, x1), (float)tiles_x), -1.f);
+    range[3] = (int32_t)fmaxf(fminf(fmaxf(y0, y1), (float)tiles_y), -1.f);
+  }
 
-      verts[vert_count + 3] = (sample_x * _tex_size[0]) + _tex_offset[0];
-      verts[vert_count + 4] = (sample_y * _tex_size[1]) + _tex_offset[1];
+  // Clip to the tiles, anything entirely off screen gets an empty range
+  for (i = 0; i < count; ++i) {
+    int32_t* range = &ranges[i * 4];
+    if (range[2] < 0 || range[3] < 0 || range[0] >= tiles_x ||
+        range[1] >= tiles_y || lights[i].radius <= 0.f) {
+      range[0] = range[1] = 0;
+      range[2] = range[3] = -1;
+      continue;
+    }
 
-      vert_count += 5;
+    range[0] = (range[0] < 0) ? 0 : range[0];
+    range[1] = (range[1] < 0) ? 0 : range[1];
+    range[2] = (range[2] >= tiles_x) ? tiles_x - 1 : range[2];
+    range[3] = (range[3] >= tiles_y) ? tiles_y - 1 : range[3];
+  }
+}
+
+/* Grow the lighting scratch storage
+ * returns: 1 = success, 0 = fail */
+static uint8_t r_lighting_reserve(r_lighting* lighting, uint32_t light_count,
+                                  uint32_t tile_count) {
+  if (light_count > lighting->light_capacity) {
+    uint32_t capacity = (lighting->light_capacity) ? lighting->light_capacity
+                                                   : 64;
+    while (capacity < light_count) {
+      capacity *= 2;
     }
 
-    for (uint32_t j = 0; j < 6; ++j) {
-      inds[ind_count] = _inds[j] + uvert_count;
-      ++ind_count;
+    float*   lights = (float*)realloc(lighting->lights,
+                                    sizeof(float) * 8 * capacity);
+    if (lights)
+      lighting->lights = lights;
+
+    int32_t* ranges = (int32_t*)realloc(lighting->ranges,
+                                        sizeof(int32_t) * 4 * capacity);
+    if (ranges)
+      lighting->ranges = ranges;
+
+    if (!lights || !ranges) {
+      ASTERA_DBG("r_lighting_reserve: unable to grow light storage.\n");
+      return 0;
     }
-    uvert_count += 4;
+
+    lighting->light_capacity = capacity;
   }
 
-  uint32_t vao, vbo, vboi;
-  glGenVertexArrays(1, &vao);
-  glBindVertexArray(vao);
+  if (tile_count > lighting->tile_capacity) {
+    uint32_t capacity = (lighting->tile_capacity) ? lighting->tile_capacity
+                                                  : 4096;
+    while (capacity < tile_count) {
+      capacity *= 2;
+    }
 
-  glGenBuffers(1, &vbo);
-  glGenBuffers(1, &vboi);
+    uint32_t* tiles =
+        (uint32_t*)realloc(lighting->tiles, sizeof(uint32_t) * capacity);
+    if (!tiles) {
+      ASTERA_DBG("r_lighting_reserve: unable to grow tile storage.\n");
+      return 0;
+    }
 
-  glBindBuffer(GL_ARRAY_BUFFER, vbo);
-  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vert_count, verts,
-               GL_STATIC_DRAW);
+    lighting->tiles         = tiles;
+    lighting->tile_capacity = capacity;
+  }
 
-  glEnableVertexAttribArray(0);
-  glEnableVertexAttribArray(1);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 20, 0);
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 20, 12);
+  return 1;
+}
+
+/* Bin the lights into tiles & draw the lighting pass over the bound target */
+static void r_lights_render(r_ctx* ctx, r_light* lights, uint32_t count,
+                            vec3 ambient) {
+  r_lighting* lighting = &ctx->lighting;
+
+  if (!lighting->shader && !r_lighting_init(lighting)) {
+    return;
+  }
+
+  GLint viewport[4];
+  glGetIntegerv(GL_VIEWPORT, viewport);
+
+  int32_t tiles_x    = (viewport[2] + R_LIGHT_TILE - 1) / R_LIGHT_TILE;
+  int32_t tiles_y    = (viewport[3] + R_LIGHT_TILE - 1) / R_LIGHT_TILE;
+  int32_t tile_count = tiles_x * tiles_y;
+
+  // One spare light past count, so the light buffer is never empty
+  if (tile_count <= 0 ||
+      !r_lighting_reserve(lighting, count + 1, (tile_count * 2) + 1)) {
+    return;
+  }
+
+  // World to window pixels through the camera's (orthographic) matrices
+  r_camera* camera = r_ctx_draw_camera(ctx);
+  float*    proj_x = camera->projection[0];
+  float*    proj_y = camera->projection[1];
+  float*    proj_w = camera->projection[3];
+  float*    view_w = camera->view[3];
+
+  float half_w = viewport[2] * 0.5f, half_h = viewport[3] * 0.5f;
+  vec2  scale  = {proj_x[0] * half_w, proj_y[1] * half_h};
+  vec2  offset = {((proj_x[0] * view_w[0]) + proj_w[0] + 1.f) * half_w,
+                 ((proj_y[1] * view_w[1]) + proj_w[1] + 1.f) * half_h};
+
+  r_lights_bin(lights, count, lighting->ranges, scale, offset, tiles_x,
+               tiles_y);
+
+  // Count the lights in each tile
+  uint32_t* tiles = lighting->tiles;
+  memset(tiles, 0, sizeof(uint32_t) * tile_count * 2);
+
+  uint32_t index_count = 0;
+  for (uint32_t i = 0; i < count; ++i) {
+    int32_t* range = &lighting->ranges[i * 4];
+    for (int32_t y = range[1]; y <= range[3]; ++y) {
+      for (int32_t x = range[0]; x <= range[2]; ++x) {
+        ++tiles[((y * tiles_x) + x) * 2 + 1];
+        ++index_count;
+      }
+    }
+  }
+
+  uint32_t total = (tile_count * 2) + index_count;
+  if (!r_lighting_reserve(lighting, count + 1, total)) {
+    return;
+  }
+  tiles = lighting->tiles;
+
+  // Give each tile its start, then fill in the indices
+  uint32_t start = tile_count * 2;
+  for (int32_t i = 0; i < tile_count; ++i) {
+    tiles[i * 2] = start;
+    start += tiles[(i * 2) + 1];
+    tiles[(i * 2) + 1] = 0;
+  }
+
+  for (uint32_t i = 0; i < count; ++i) {
+    int32_t* range = &lighting->ranges[i * 4];
+    for (int32_t y = range[1]; y <= range[3]; ++y) {
+      for (int32_t x = range[0]; x <= range[2]; ++x) {
+        uint32_t* header = &tiles[((y * tiles_x) + x) * 2];
+        tiles[header[0] + header[1]] = i;
+        ++header[1];
+      }
+    }
+
+    float* light = &lighting->lights[i * 8];
+    light[0]     = lights[i].position[0];
+    light[1]     = lights[i].position[1];
+    light[2]     = lights[i].radius;
+    light[3]     = lights[i].intensity;
+    light[4]     = lights[i].color[0];
+    light[5]     = lights[i].color[1];
+    light[6]     = lights[i].color[2];
+    light[7]     = 0.f;
+  }
+
+  memset(&lighting->lights[count * 8], 0, sizeof(float) * 8);
+
+  glBindBuffer(GL_TEXTURE_BUFFER, lighting->light_buf);
+  glBufferData(GL_TEXTURE_BUFFER, sizeof(float) * 8 * (count + 1),
+               lighting->lights, GL_STREAM_DRAW);
+  glBindBuffer(GL_TEXTURE_BUFFER, lighting->tile_buf);
+  glBufferData(GL_TEXTURE_BUFFER, sizeof(uint32_t) * total, tiles,
+               GL_STREAM_DRAW);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+
+  r_res_track(R_RES_BUFFER, lighting->light_buf,
+              sizeof(float) * 8 * (count + 1), __func__);
+  r_res_track(R_RES_BUFFER, lighting->tile_buf, sizeof(uint32_t) * total,
+              __func__);
+
+  r_shader_bind(lighting->shader);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_BUFFER, lighting->light_tex);
+  glActiveTexture(GL_TEXTURE1);
+  glBindTexture(GL_TEXTURE_BUFFER, lighting->tile_tex);
+
+  vec2 world_scale  = {1.f / scale[0], 1.f / scale[1]};
+  vec2 world_offset = {-offset[0] / scale[0], -offset[1] / scale[1]};
+
+  r_set_uniformi(lighting->shader, "lights", 0);
+  r_set_uniformi(lighting->shader, "tiles", 1);
+  r_set_uniformi(lighting->shader, "tile_size", R_LIGHT_TILE);
+  r_set_uniformi(lighting->shader, "tiles_x", tiles_x);
+  r_set_v2(lighting->shader, "world_scale", world_scale);
+  r_set_v2(lighting->shader, "world_offset", world_offset);
+  r_set_v3(lighting->shader, "ambient", ambient);
+
+  // Multiply whatever is drawn by the light
+  glDisable(GL_DEPTH_TEST);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_DST_COLOR, GL_ZERO);
+
+  glBindVertexArray(lighting->vao);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+  glBindVertexArray(0);
+
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glEnable(GL_DEPTH_TEST);
+
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_BUFFER, 0);
+  r_shader_bind(0);
+}
+
+void r_lights_draw(r_ctx* ctx, r_light* lights, uint32_t count,
+                   vec3 ambient) {
+  if (count && !lights) {
+    ASTERA_DBG("r_lights_draw: no lights passed.\n");
+    return;
+  }
+
+  if (r_ctx_recording(ctx)) {
+    r_cmd_camera_sync(ctx);
+
+    r_cmd_lights* cmd = r_cmd_rec(ctx, R_CMD_LIGHTS,
+                                  sizeof(r_cmd_lights) +
+                                      (sizeof(r_light) * count));
+    if (cmd) {
+      cmd->count = count;
+      vec3_dup(cmd->ambient, ambient);
+      if (count) {
+        memcpy(cmd + 1, lights, sizeof(r_light) * count);
+      }
+    }
+    return;
+  }
+
+  r_lights_render(ctx, lights, count, ambient);
+}
+
+uint32_t r_check_error(void) { return glGetError(); }
+
+uint32_t r_check_error_loc(const char* loc) {
+  uint32_t error = glGetError();
+
+  if (error != GL_NO_ERROR) {
+    ASTERA_DBG("GL Error: %i at location: %s\n", error, loc);
+  }
+
+  return error;
+}
+
+r_quad r_quad_create(float width, float height, uint8_t use_vto) {
+  uint32_t vao = 0, vbo = 0, vboi = 0, vto = 0;
+
+  glGenVertexArrays(1, &vao);
+  glBindVertexArray(vao);
+
+  glGenBuffers(1, &vbo);
+  glGenBuffers(1, &vboi);
+
+  uint16_t inds[6] = {0, 1, 2, 2, 3, 0};
+
+  if (use_vto) {
+    glGenBuffers(1, &vto);
+
+    float verts[12] = {-0.5f, -0.5f, 0.f, -0.5f, 0.5f,  0.f,
+                       0.5f,  0.5f,  0.f, 0.5f,  -0.5f, 0.f};
+    float texcs[8]  = {0.f, 0.f, 0.f, 1.f, 1.f, 1.f, 1.f, 0.f};
+
+    for (uint8_t i = 0; i < 12; i += 3) {
+      verts[i] *= width;
+      verts[i + 1] *= height;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, 12 * sizeof(float), verts, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 0, 0);
+
+    glBindBuffer(GL_ARRAY_BUFFER, vto);
+    glBufferData(GL_ARRAY_BUFFER, 8 * sizeof(float), texcs, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 0, 0);
+  } else {
+    float verts[20] = {-0.5f, -0.5f, 0.f,   0.f,  0.f,  -0.5f, 0.5f,
+                       0.f,   0.f,   1.f,   0.5f, 0.5f, 0.f,   1.f,
+                       1.f,   0.5f,  -0.5f, 0.f,  1.f,  0.f};
+
+    for (uint8_t i = 0; i < 20; i += 5) {
+      verts[i] *= width;
+      verts[i + 1] *= height;
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, vbo);
+    glBufferData(GL_ARRAY_BUFFER, 20 * sizeof(float), verts, GL_STATIC_DRAW);
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 20, 0);
+    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 20, 12);
+  }
 
   glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vboi);
-  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * ind_count, inds,
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, 6 * sizeof(uint16_t), inds,
                GL_STATIC_DRAW);
 
   glBindVertexArray(0);
 
-  free(verts);
-  free(inds);
+  r_res_track(R_RES_VAO, vao, 0, __func__);
+  r_res_track(R_RES_BUFFER, vbo, (use_vto ? 12 : 20) * sizeof(float), __func__);
+  r_res_track(R_RES_BUFFER, vboi, 6 * sizeof(uint16_t), __func__);
+  if (use_vto) {
+    r_res_track(R_RES_BUFFER, vto, 8 * sizeof(float), __func__);
+  }
 
-  r_baked_sheet baked_sheet = (r_baked_sheet){
-      .vao        = vao,
-      .vbo        = vbo,
-      .vboi       = vboi,
-      .quad_count = quad_count,
-      .sheet      = sheet,
-  };
+  return (r_quad){.vao     = vao,
+                  .vbo     = vbo,
+                  .vto     = vto,
+                  .vboi    = vboi,
+                  .width   = width,
+                  .height  = height,
+                  .use_vto = use_vto};
+}
 
-  vec2 sheet_size = {bounds[2] - bounds[0], bounds[3] - bounds[1]};
-  vec2_dup(baked_sheet.size, sheet_size);
-  vec2_dup(baked_sheet.position, position);
+void r_quad_draw(r_quad quad) {
+  glBindVertexArray(quad.vao);
 
-  mat4x4_identity(baked_sheet.model);
-  mat4x4_translate(baked_sheet.model, position[0], position[1], 0.f);
-  mat4x4_scale_aniso(baked_sheet.model, baked_sheet.model, 1.f, 1.f, 1.f);
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
 
-  return baked_sheet;
+  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
+
+  // TODO test if this is something we need to do
+  glBindVertexArray(0);
+  glUseProgram(0);
 }
 
-void r_baked_sheet_draw(r_ctx* ctx, r_shader shader, r_baked_sheet* sheet) {
-  if (shader == 0)
-    ASTERA_DBG("r_baked_sheet_draw: Invalid shader.\n");
+void r_quad_draw_instanced(r_quad quad, uint32_t count) {
+  glBindVertexArray(quad.vao);
 
-  r_shader_bind(shader);
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
 
-  r_set_m4(shader, "projection", ctx->camera.projection);
-  r_set_m4(shader, "view", ctx->camera.view);
-  r_set_m4(shader, "model", sheet->model);
+  glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0, count);
 
-  r_tex_bind(sheet->sheet->id);
+  // TODO test if this is something we need to do
+  glBindVertexArray(0);
+  glUseProgram(0);
+}
 
-  glBindVertexArray(sheet->vao);
+void r_quad_destroy(r_quad* quad) {
+  r_res_untrack(R_RES_VAO, quad->vao);
+  r_res_untrack(R_RES_BUFFER, quad->vbo);
+  r_res_untrack(R_RES_BUFFER, quad->vboi);
+
+  glDeleteVertexArrays(1, &quad->vao);
+  glDeleteBuffers(1, &quad->vbo);
+  glDeleteBuffers(1, &quad->vboi);
+
+  if (quad->use_vto) {
+    r_res_untrack(R_RES_BUFFER, quad->vto);
+    glDeleteBuffers(1, &quad->vto);
+  }
+}
+
+r_window_params r_window_params_create(uint32_t width, uint32_t height,
+                                       uint8_t resizable, uint8_t fullscreen,
+                                       uint8_t vsync, uint8_t borderless,
+                                       uint16_t    refresh_rate,
+                                       const char* title) {
+  return (r_window_params){.width        = width,
+                           .height       = height,
+                           .resizable    = resizable,
+                           .fullscreen   = fullscreen,
+                           .vsync        = vsync,
+                           .borderless   = borderless,
+                           .refresh_rate = refresh_rate,
+                           .title        = title,
+                           .min_width    = 0,
+                           .min_height   = 0,
+                           .max_width    = 0,
+                           .max_height   = 0,
+                           .x            = 0,
+                           .y            = 0};
+}
+
+/* Grow an array to hold at least `needed` elements
+ * returns: 1 = success, 0 = fail */
+static uint8_t r_pick_reserve(void** array, uint32_t* capacity,
+                              uint32_t needed, size_t size) {
+  if (needed <= *capacity) {
+    return 1;
+  }
+
+  uint32_t grown_capacity = (*capacity) ? *capacity : 256;
+  while (grown_capacity < needed) {
+    grown_capacity *= 2;
+  }
+
+  void* grown = realloc(*array, grown_capacity * size);
+  if (!grown) {
+    ASTERA_DBG("r_pick_reserve: unable to grow pick storage.\n");
+    return 0;
+  }
+
+  *array    = grown;
+  *capacity = grown_capacity;
+  return 1;
+}
+
+static void r_pick_destroy(r_pick* pick) {
+  free(pick->entries);
+  free(pick->ready);
+  free(pick->cell_starts);
+  free(pick->cell_items);
+  free(pick->large);
+  free(pick->stamps);
+  *pick = (r_pick){0};
+}
+
+/* Record a sprite drawn this frame */
+static void r_pick_add(r_ctx* ctx, r_sprite* sprite) {
+  r_pick* pick = &ctx->pick;
+
+  if (!r_pick_reserve((void**)&pick->entries, &pick->entry_capacity,
+                      pick->entry_count + 1, sizeof(r_pick_entry))) {
+    return;
+  }
+
+  // The bounds of the model's unit quad (-0.5 to 0.5), exact for rotation too
+  float* center = sprite->model[3];
+  float  half_x =
+      0.5f * (fabsf(sprite->model[0][0]) + fabsf(sprite->model[1][0]));
+  float half_y =
+      0.5f * (fabsf(sprite->model[0][1]) + fabsf(sprite->model[1][1]));
+
+  r_pick_entry* entry = &pick->entries[pick->entry_count];
+  entry->sprite       = sprite;
+  entry->layer        = sprite->layer;
+  entry->bounds[0]    = center[0] - half_x;
+  entry->bounds[1]    = center[1] - half_y;
+  entry->bounds[2]    = center[0] + half_x;
+  entry->bounds[3]    = center[1] + half_y;
+
+  ++pick->entry_count;
+}
+
+/* Make this frame's sprites the ones queried, called at the end of a frame */
+static void r_pick_swap(r_pick* pick) {
+  r_pick_entry* entries  = pick->ready;
+  uint32_t      capacity = pick->ready_capacity;
+
+  pick->ready          = pick->entries;
+  pick->ready_count    = pick->entry_count;
+  pick->ready_capacity = pick->entry_capacity;
+  pick->entries        = entries;
+  pick->entry_capacity = capacity;
+  pick->entry_count    = 0;
+  pick->built          = 0;
+}
+
+static inline uint32_t r_pick_bucket(r_pick* pick, int32_t x, int32_t y) {
+  return (((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u)) &
+         (pick->bucket_count - 1);
+}
+
+static inline void r_pick_cells(r_pick* pick, float* bounds, int32_t* cells) {
+  cells[0] = (int32_t)floorf(bounds[0] / pick->cell_size);
+  cells[1] = (int32_t)floorf(bounds[1] / pick->cell_size);
+  cells[2] = (int32_t)floorf(bounds[2] / pick->cell_size);
+  cells[3] = (int32_t)floorf(bounds[3] / pick->cell_size);
+}
+
+/* Bucket last frame's sprites into the hashed grid (counting sort)
+ * returns: 1 = success, 0 = fail */
+static uint8_t r_pick_build(r_pick* pick) {
+  if (pick->built) {
+    return 1;
+  }
+
+  uint32_t bucket_count = 256;
+  while (bucket_count < pick->ready_count) {
+    bucket_count *= 2;
+  }
+
+  if (!r_pick_reserve((void**)&pick->cell_starts, &pick->bucket_capacity,
+                      bucket_count + 1, sizeof(uint32_t)) ||
+      !r_pick_reserve((void**)&pick->stamps, &pick->stamp_capacity,
+                      pick->ready_count, sizeof(uint32_t))) {
+    return 0;
+  }
+
+  pick->bucket_count = bucket_count;
+  memset(pick->cell_starts, 0, sizeof(uint32_t) * (bucket_count + 1));
+  memset(pick->stamps, 0, sizeof(uint32_t) * pick->ready_count);
+  pick->query       = 0;
+  pick->large_count = 0;
+
+  // Count the items of each bucket, large entries are flagged in stamps
+  uint32_t item_count = 0;
+  for (uint32_t i = 0; i < pick->ready_count; ++i) {
+    int32_t cells[4];
+    r_pick_cells(pick, pick->ready[i].bounds, cells);
+
+    int64_t cell_count =
+        ((int64_t)cells[2] - cells[0] + 1) * ((int64_t)cells[3] - cells[1] + 1);
+    if (cell_count > R_PICK_MAX_CELLS) {
+      pick->stamps[i] = 1;
+      ++pick->large_count;
+      continue;
+    }
+
+    for (int32_t y = cells[1]; y <= cells[3]; ++y) {
+      for (int32_t x = cells[0]; x <= cells[2]; ++x) {
+        ++pick->cell_starts[r_pick_bucket(pick, x, y)];
+        ++item_count;
+      }
+    }
+  }
+
+  if (!r_pick_reserve((void**)&pick->cell_items, &pick->item_capacity,
+                      item_count + 1, sizeof(uint32_t)) ||
+      !r_pick_reserve((void**)&pick->large, &pick->large_capacity,
+                      pick->large_count + 1, sizeof(uint32_t))) {
+    return 0;
+  }
+
+  // Prefix sum to each bucket's end, filling backwards leaves each its start
+  uint32_t total = 0;
+  for (uint32_t i = 0; i < bucket_count; ++i) {
+    total += pick->cell_starts[i];
+    pick->cell_starts[i] = total;
+  }
+  pick->cell_starts[bucket_count] = total;
+
+  uint32_t large_count = 0;
+  for (uint32_t i = 0; i < pick->ready_count; ++i) {
+    if (pick->stamps[i]) {
+      pick->large[large_count] = i;
+      pick->stamps[i]          = 0;
+      ++large_count;
+      continue;
+    }
+
+    int32_t cells[4];
+    r_pick_cells(pick, pick->ready[i].bounds, cells);
+
+    for (int32_t y = cells[1]; y <= cells[3]; ++y) {
+      for (int32_t x = cells[0]; x <= cells[2]; ++x) {
+        uint32_t bucket = r_pick_bucket(pick, x, y);
+        --pick->cell_starts[bucket];
+        pick->cell_items[pick->cell_starts[bucket]] = i;
+      }
+    }
+  }
+
+  pick->built = 1;
+  return 1;
+}
+
+static inline uint8_t r_pick_overlaps(float* a, float* b) {
+  return a[0] <= b[2] && a[2] >= b[0] && a[1] <= b[3] && a[3] >= b[1];
+}
+
+void r_pick_enable(r_ctx* ctx, float cell_size) {
+  if (cell_size <= 0.f) {
+    r_pick_destroy(&ctx->pick);
+    return;
+  }
+
+  ctx->pick.cell_size = cell_size;
+  ctx->pick.built     = 0;
+}
+
+r_sprite* r_pick_point(r_ctx* ctx, vec2 point) {
+  r_pick* pick = &ctx->pick;
+  if (!pick->cell_size || !pick->ready_count || !r_pick_build(pick)) {
+    return 0;
+  }
+
+  vec4    bounds = {point[0], point[1], point[0], point[1]};
+  int32_t cells[4];
+  r_pick_cells(pick, bounds, cells);
+
+  uint32_t  bucket = r_pick_bucket(pick, cells[0], cells[1]);
+  uint32_t* items  = &pick->cell_items[pick->cell_starts[bucket]];
+  uint32_t  count = pick->cell_starts[bucket + 1] - pick->cell_starts[bucket];
+
+  // The top most sprite: highest layer, then the last drawn within it
+  int64_t best = -1;
+  for (uint32_t pass = 0; pass < 2; ++pass) {
+    for (uint32_t i = 0; i < count; ++i) {
+      r_pick_entry* entry = &pick->ready[items[i]];
+      if (!r_pick_overlaps(entry->bounds, bounds)) {
+        continue;
+      }
+
+      if (best == -1 || entry->layer > pick->ready[best].layer ||
+          (entry->layer == pick->ready[best].layer && items[i] > best)) {
+        best = items[i];
+      }
+    }
+
+    items = pick->large;
+    count = pick->large_count;
+  }
+
+  return (best == -1) ? 0 : pick->ready[best].sprite;
+}
+
+uint32_t r_pick_rect(r_ctx* ctx, vec4 bounds, r_sprite** dst,
+                     uint32_t capacity) {
+  r_pick* pick = &ctx->pick;
+  if (!dst || !pick->cell_size || !pick->ready_count || !r_pick_build(pick)) {
+    return 0;
+  }
+
+  uint32_t found = 0;
+
+  int32_t cells[4];
+  r_pick_cells(pick, bounds, cells);
+
+  // Past a point walking every entry is cheaper than walking every cell
+  int64_t cell_count =
+      ((int64_t)cells[2] - cells[0] + 1) * ((int64_t)cells[3] - cells[1] + 1);
+  if (cell_count > pick->bucket_count) {
+    for (uint32_t i = 0; i < pick->ready_count && found < capacity; ++i) {
+      if (r_pick_overlaps(pick->ready[i].bounds, bounds)) {
+        dst[found] = pick->ready[i].sprite;
+        ++found;
+      }
+    }
+    return found;
+  }
+
+  ++pick->query;
+
+  for (uint32_t i = 0; i < pick->large_count && found < capacity; ++i) {
+    r_pick_entry* entry = &pick->ready[pick->large[i]];
+    if (r_pick_overlaps(entry->bounds, bounds)) {
+      dst[found] = entry->sprite;
+      ++found;
+    }
+  }
+
+  for (int32_t y = cells[1]; y <= cells[3]; ++y) {
+    for (int32_t x = cells[0]; x <= cells[2]; ++x) {
+      uint32_t bucket = r_pick_bucket(pick, x, y);
+      for (uint32_t i = pick->cell_starts[bucket];
+           i < pick->cell_starts[bucket + 1] && found < capacity; ++i) {
+        uint32_t      index = pick->cell_items[i];
+        r_pick_entry* entry = &pick->ready[index];
+
+        if (pick->stamps[index] == pick->query ||
+            !r_pick_overlaps(entry->bounds, bounds)) {
+          continue;
+        }
+
+        pick->stamps[index] = pick->query;
+        dst[found]          = entry->sprite;
+        ++found;
+      }
+    }
+  }
+
+  return found;
+}
+
+r_ctx* r_ctx_create(r_window_params params, uint8_t use_fbo,
+                    uint32_t batch_count, uint32_t batch_size,
+                    uint32_t anim_map_size, uint32_t shader_map_size) {
+  r_ctx* ctx = (r_ctx*)malloc(sizeof(r_ctx));
+  memset(ctx, 0, sizeof(r_ctx));
+
+#if !defined(ASTERA_NO_THREADS)
+  if (!_r_res.lock) {
+    _r_res.lock = s_mutex_create();
+  }
+#endif
+
+  if (!r_window_create(ctx, params)) {
+    ASTERA_DBG("r_ctx_create: unable to create window.\n");
+    free(ctx);
+    return 0;
+  }
+
+  if (use_fbo) {
+    ctx->framebuffer = r_framebuffer_create(params.width, params.height, 0);
+  }
+
+  if (batch_count > 0) {
+    ctx->batches = (r_batch*)malloc(sizeof(r_batch) * batch_count);
+    memset(ctx->batches, 0, sizeof(r_batch) * batch_count);
+  } else {
+    ctx->batches = 0;
+  }
+
+  ctx->batch_capacity = batch_count;
+  ctx->batch_count    = 0;
+  ctx->batch_size     = batch_size;
+
+  for (uint32_t i = 0; i < batch_count; ++i) {
+    ctx->batches[i].capacity = batch_size;
+  }
+
+  if (batch_count > 0) {
+    ctx->sort_cursors = (uint32_t*)calloc(batch_count, sizeof(uint32_t));
+  }
+
+  if (anim_map_size > 0) {
+    ctx->anim_names  = (const char**)calloc(anim_map_size, sizeof(char*));
+    ctx->anims       = (r_anim*)calloc(anim_map_size, sizeof(r_anim));
+    ctx->anim_hashes = (uint32_t*)calloc(anim_map_size, sizeof(uint32_t));
+
+    // Keep the map at most half full so probes stay short
+    ctx->anim_map_size = 16;
+    while (ctx->anim_map_size < anim_map_size * 2) {
+      ctx->anim_map_size *= 2;
+    }
+
+    ctx->anim_map = (uint16_t*)calloc(ctx->anim_map_size, sizeof(uint16_t));
+  } else {
+    ctx->anim_names = 0;
+    ctx->anims      = 0;
+  }
+
+  ctx->anim_count    = 0;
+  ctx->anim_capacity = anim_map_size;
+
+  if (shader_map_size > 0) {
+    ctx->shaders      = (r_shader*)malloc(sizeof(r_shader) * shader_map_size);
+    ctx->shader_names = (const char**)malloc(sizeof(char*) * shader_map_size);
+  } else {
+    ctx->shaders      = 0;
+    ctx->shader_names = 0;
+  }
+
+  ctx->shader_count    = 0;
+  ctx->shader_capacity = shader_map_size;
+
+  ctx->default_quad = r_quad_create(1.f, 1.f, 0);
+
+  vec3 camera_position = {0.f, 0.f, 0.f};
+  vec2 camera_size     = {(float)params.width, (float)params.height};
+  ctx->camera = r_camera_create(camera_position, camera_size, -100.f, 100.f);
+
+  return ctx;
+}
+
+r_camera* r_ctx_get_camera(r_ctx* ctx) { return &ctx->camera; }
+
+void r_ctx_make_current(r_ctx* ctx) { _r_ctx = ctx; }
+
+void r_ctx_set_i_ctx(r_ctx* ctx, i_ctx* input) { ctx->input_ctx = input; }
+
+void r_ctx_set_fbo_shader(r_ctx* ctx, r_shader shader) {
+  ctx->framebuffer.shader = shader;
+}
+
+void r_ctx_destroy(r_ctx* ctx) {
+  r_ctx_capture_stop(ctx);
+  r_ctx_thread_stop(ctx);
+
+  for (uint8_t i = 0; i < 2; ++i) {
+    if (ctx->cmd_lists[i].data)
+      free(ctx->cmd_lists[i].data);
+  }
+
+  if (ctx->capture_scratch.data) {
+    free(ctx->capture_scratch.data);
+  }
+
+  if (ctx->capture_keys) {
+    free(ctx->capture_keys);
+  }
+
+  if (ctx->anims) {
+    for (int i = 0; i < ctx->anim_capacity; ++i) {
+      r_anim* anim = &ctx->anims[i];
+      if (anim->count != 0 && anim->frames)
+        free(anim->frames);
+    }
+    free(ctx->anims);
+  }
+
+  if (ctx->anim_names) {
+    free(ctx->anim_names);
+  }
+
+  if (ctx->anim_hashes) {
+    free(ctx->anim_hashes);
+  }
+
+  if (ctx->anim_map) {
+    free(ctx->anim_map);
+  }
+
+  r_anim_pool* pool = &ctx->anim_pool;
+  if (pool->capacity) {
+    free(pool->anim);
+    free(pool->frames);
+    free(pool->curr);
+    free(pool->subtex);
+    free(pool->frame_time);
+    free(pool->time);
+    free(pool->state);
+    free(pool->loop);
+    free(pool->alive);
+    free(pool->free_list);
+  }
+
+  if (ctx->shaders) {
+    for (uint16_t i = 0; i < ctx->shader_capacity; ++i) {
+      if (ctx->shaders[i]) {
+        r_res_untrack(R_RES_PROGRAM, ctx->shaders[i]);
+        glDeleteProgram(ctx->shaders[i]);
+      }
+    }
+
+    free(ctx->shaders);
+    free(ctx->shader_names);
+  }
+
+  if (ctx->batches) {
+    for (uint16_t i = 0; i < ctx->batch_capacity; ++i) {
+      if (ctx->batches[i].mats)
+        free(ctx->batches[i].mats);
+
+      if (ctx->batches[i].coords)
+        free(ctx->batches[i].coords);
+
+      if (ctx->batches[i].colors)
+        free(ctx->batches[i].colors);
+
+      if (ctx->batches[i].flip_x)
+        free(ctx->batches[i].flip_x);
+
+      if (ctx->batches[i].flip_y)
+        free(ctx->batches[i].flip_y);
+
+      if (ctx->batches[i].layers)
+        free(ctx->batches[i].layers);
+    }
+
+    free(ctx->batches);
+    free(ctx->sort_cursors);
+  }
+
+  if (ctx->sort_batch.mats) {
+    free(ctx->sort_batch.mats);
+    free(ctx->sort_batch.coords);
+    free(ctx->sort_batch.colors);
+    free(ctx->sort_batch.flip_x);
+    free(ctx->sort_batch.flip_y);
+    free(ctx->sort_batch.layers);
+  }
+
+  r_im_destroy(&ctx->im);
+  r_pick_destroy(&ctx->pick);
+  r_readback_destroy(ctx);
+  r_lighting_destroy(&ctx->lighting);
+#if !defined(ASTERA_NO_THREADS)
+  r_png_worker_destroy(ctx->png_worker);
+#endif
+  r_stream_destroy(&ctx->stream);
+  r_quad_destroy(&ctx->default_quad);
+
+  r_window_destroy(ctx);
+  glfwTerminate();
+
+  r_res_clear();
+}
+
+void r_ctx_update(r_ctx* ctx) { r_camera_update(&ctx->camera); }
+
+void r_ctx_draw(r_ctx* ctx) {
+  if (r_ctx_recording(ctx)) {
+    r_cmd_rec(ctx, R_CMD_FLUSH, 0);
+    r_im_flush(ctx);
+    return;
+  }
+
+  r_batch_draw_all(ctx);
+  r_im_flush(ctx);
+}
+
+r_camera r_camera_create(vec3 position, vec2 size, float near, float far) {
+  r_camera cam = (r_camera){.near = near, .far = far, .rotation = 0.f};
+
+  mat4x4_identity(cam.projection);
+  mat4x4_ortho(cam.projection, 0, size[0], size[1], 0, near, far);
+  vec2_dup(cam.size, size);
+  vec2_dup(cam.position, position);
+
+  mat4x4_identity(cam.view);
+  mat4x4_translate(cam.view, position[0], position[1], 0.f);
+
+  return cam;
+}
+
+void r_camera_move(r_camera* camera, vec3 dist) {
+  vec3_add(camera->position, camera->position, dist);
+}
+
+void r_camera_get_size(vec2 dst, r_camera* camera) {
+  vec2_dup(dst, camera->size);
+}
+
+void r_camera_set_size(r_camera* camera, vec2 size) {
+  vec2_dup(camera->size, size);
+  mat4x4_ortho(camera->projection, 0, camera->size[0], camera->size[1], 0,
+               camera->near, camera->far);
+}
+
+void r_camera_update(r_camera* camera) {
+  mat4x4_identity(camera->view);
+  mat4x4_translate(camera->view, camera->position[0], camera->position[1],
+                   camera->position[2]);
+}
+
+void r_cam_screen_to_world(vec2 dst, r_camera* camera, vec2 point) {
+  if (!dst || !camera || !point) {
+    return;
+  }
+
+  dst[0] = point[0] * camera->size[0] + camera->position[0];
+  dst[1] = point[1] * camera->size[1] + camera->position[1];
+}
+
+void r_cam_world_to_screen(vec2 dst, r_camera* camera, vec2 point) {
+  if (!dst || !camera || !point) {
+    return;
+  }
+
+  dst[0] =
+      (point[0] / camera->size[0]) - (camera->position[0] / camera->size[0]);
+  dst[1] =
+      (point[1] / camera->size[1]) - (camera->position[1] / camera->size[1]);
+}
+
+r_framebuffer r_framebuffer_create(uint32_t width, uint32_t height,
+                                   r_shader shader) {
+  r_framebuffer fbo =
+      (r_framebuffer){.width = width, .height = height, .shader = shader};
+
+  glGenFramebuffers(1, &fbo.fbo);
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo.fbo);
+
+  glGenTextures(1, &fbo.tex);
+  glBindTexture(GL_TEXTURE_2D, fbo.tex);
+
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, width, height, 0, GL_RGBA,
+               GL_FLOAT, NULL);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         fbo.tex, 0);
+
+  glGenRenderbuffers(1, &fbo.rbo);
+  glBindRenderbuffer(GL_RENDERBUFFER, fbo.rbo);
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH24_STENCIL8, width, height);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_STENCIL_ATTACHMENT,
+                            GL_RENDERBUFFER, fbo.rbo);
+
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+    ASTERA_DBG("Incomplete FBO: %i\n", fbo.fbo);
+
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+  float verts[20] = {-0.5f, -0.5f, 0.f, 0.f, 0.f, -0.5f, 0.5f,  0.f, 0.f, 1.f,
+                     0.5f,  0.5f,  0.f, 1.f, 1.f, 0.5f,  -0.5f, 0.f, 1.f, 0.f};
+
+  for (uint8_t i = 0; i < 20; i += 5) {
+    verts[i] *= 2;
+    verts[i + 1] *= 2;
+  }
+
+  uint16_t indices[6] = {0, 1, 2, 2, 3, 0};
+
+  glGenVertexArrays(1, &fbo.vao);
+  glGenBuffers(1, &fbo.vbo);
+  glGenBuffers(1, &fbo.vboi);
+
+  glBindVertexArray(fbo.vao);
+
+  glBindBuffer(GL_ARRAY_BUFFER, fbo.vbo);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 20, verts, GL_STATIC_DRAW);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 20, 0);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 20, 12);
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, fbo.vboi);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * 6, indices,
+               GL_STATIC_DRAW);
+
+  glBindVertexArray(0);
+
+  // RGBA16F color & 24 bit depth + 8 bit stencil
+  r_res_track(R_RES_FRAMEBUFFER, fbo.fbo, 0, __func__);
+  r_res_track(R_RES_TEXTURE, fbo.tex, width * height * 8, __func__);
+  r_res_track(R_RES_RENDERBUFFER, fbo.rbo, width * height * 4, __func__);
+  r_res_track(R_RES_VAO, fbo.vao, 0, __func__);
+  r_res_track(R_RES_BUFFER, fbo.vbo, sizeof(float) * 20, __func__);
+  r_res_track(R_RES_BUFFER, fbo.vboi, sizeof(uint16_t) * 6, __func__);
+
+  return fbo;
+}
+
+void r_framebuffer_destroy(r_framebuffer fbo) {
+  r_res_untrack(R_RES_FRAMEBUFFER, fbo.fbo);
+  r_res_untrack(R_RES_TEXTURE, fbo.tex);
+  r_res_untrack(R_RES_RENDERBUFFER, fbo.rbo);
+  r_res_untrack(R_RES_BUFFER, fbo.vbo);
+  r_res_untrack(R_RES_BUFFER, fbo.vboi);
+  r_res_untrack(R_RES_VAO, fbo.vao);
+
+  glDeleteFramebuffers(1, &fbo.fbo);
+  glDeleteTextures(1, &fbo.tex);
+  glDeleteRenderbuffers(1, &fbo.rbo);
+  glDeleteBuffers(1, &fbo.vbo);
+  glDeleteBuffers(1, &fbo.vboi);
+  glDeleteVertexArrays(1, &fbo.vao);
+}
+
+void r_framebuffer_bind(r_framebuffer fbo) {
+  if (r_ctx_recording(_r_rec_ctx)) {
+    r_cmd_fbo* cmd = r_cmd_rec(_r_rec_ctx, R_CMD_FBO_BIND, sizeof(r_cmd_fbo));
+    if (cmd) {
+      cmd->fbo   = fbo;
+      cmd->gamma = 0.f;
+    }
+    return;
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, fbo.fbo);
+}
+
+static void r_framebuffer_render(r_framebuffer fbo, float gamma) {
+  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  glDisable(GL_DEPTH_TEST);
+
+  glBindVertexArray(fbo.vao);
+  glUseProgram(fbo.shader);
+
+  r_set_uniformf(fbo.shader, "gamma", gamma);
+
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, fbo.tex);
+
+  glBindBuffer(GL_ARRAY_BUFFER, fbo.vbo);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, fbo.vboi);
+
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 20, 0);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 20, 12);
+
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+
+  glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0);
+
+  glBindVertexArray(0);
+  glUseProgram(0);
+
+  glEnable(GL_DEPTH_TEST);
+}
+
+void r_framebuffer_draw(r_ctx* ctx, r_framebuffer fbo) {
+  if (r_ctx_recording(ctx)) {
+    r_cmd_fbo* cmd = r_cmd_rec(ctx, R_CMD_FBO_DRAW, sizeof(r_cmd_fbo));
+    if (cmd) {
+      cmd->fbo   = fbo;
+      cmd->gamma = ctx->window.params.gamma;
+    }
+    return;
+  }
+
+  r_framebuffer_render(fbo, ctx->window.params.gamma);
+}
+
+void r_tex_bind(uint32_t tex) {
+  glActiveTexture(GL_TEXTURE0);
+  glBindTexture(GL_TEXTURE_2D, tex);
+}
+
+r_tex r_tex_create(unsigned char* data, uint32_t length) {
+  int            w, h, ch;
+  unsigned char* img = stbi_load_from_memory(data, length, &w, &h, &ch, 0);
+  uint32_t       id;
+  glGenTextures(1, &id);
+  glBindTexture(GL_TEXTURE_2D, id);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, w, h, 0, GL_RGBA, GL_UNSIGNED_BYTE,
+               img);
+  r_res_track(R_RES_TEXTURE, id, w * h * 4, __func__);
+
+  stbi_image_free(img);
+
+  return (r_tex){id, (uint32_t)w, (uint32_t)h};
+}
+
+void r_tex_destroy(r_tex* tex) {
+  r_res_untrack(R_RES_TEXTURE, tex->id);
+  glDeleteTextures(1, &tex->id);
+}
+
+/* Upload decoded pixels to a sheet texture
+ * returns: the OpenGL texture ID */
+static uint32_t r_sheet_tex_upload(unsigned char* img, uint32_t w, uint32_t h,
+                                   int format) {
+  uint32_t id;
+  glGenTextures(1, &id);
+  glBindTexture(GL_TEXTURE_2D, id);
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  glTexImage2D(GL_TEXTURE_2D, 0, format, w, h, 0, format, GL_UNSIGNED_BYTE,
+               img);
+  r_res_track(R_RES_TEXTURE, id, w * h * ((format == GL_RGBA) ? 4 : 3),
+              __func__);
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  return id;
+}
+
+/* Upload a sheet's image data to a texture
+ * returns: the OpenGL texture ID, 0 = fail */
+static uint32_t r_sheet_tex_create(unsigned char* data, uint32_t length,
+                                   uint32_t* w, uint32_t* h) {
+  int            ch;
+  unsigned char* img =
+      stbi_load_from_memory(data, length, (int*)w, (int*)h, &ch, 0);
+
+  if (!img) {
+    ASTERA_DBG("r_sheet_tex_create: unable to load image data.\n");
+    return 0;
+  }
+
+  int format = (ch == 4) ? GL_RGBA : (ch == 3) ? GL_RGB : GL_RGB;
+
+  uint32_t id = r_sheet_tex_upload(img, *w, *h, format);
+  stbi_image_free(img);
+
+  return id;
+}
+
+r_sheet r_sheet_create_tiled(unsigned char* data, uint32_t length,
+                             uint32_t sub_width, uint32_t sub_height,
+                             uint32_t width_pad, uint32_t height_pad) {
+  if (!data || !length || !sub_width || !sub_height) {
+    ASTERA_DBG("r_sheet_create_tiled: invalid texture data passed.\n");
+    return (r_sheet){0};
+  }
+  // Load the texture data
+  uint32_t w, h;
+  uint32_t id = r_sheet_tex_create(data, length, &w, &h);
+
+  if (!id) {
+    return (r_sheet){0};
+  }
+
+  uint32_t per_width = w / sub_width;
+  uint32_t rows      = h / sub_height;
+  uint32_t sub_count = rows * per_width;
+
+  r_subtex* subtexs = (r_subtex*)malloc(sizeof(r_subtex) * sub_count);
+
+  for (uint32_t i = 0; i < sub_count; ++i) {
+    uint32_t x = i % per_width;
+    uint32_t y = i / per_width;
+
+    float x_offset = (x * sub_width) + width_pad;
+    float y_offset = (y * sub_height) + height_pad;
+    float width    = sub_width - (width_pad * 2);
+    float height   = sub_height - (height_pad * 2);
+
+    vec4 coords = {x_offset / w, y_offset / h, (x_offset + width) / w,
+                   (y_offset + height) / h};
+
+    subtexs[i] = (r_subtex){.x      = (uint32_t)x_offset,
+                            .y      = (uint32_t)y_offset,
+                            .width  = (uint32_t)width,
+                            .height = (uint32_t)height};
+    vec4_dup(subtexs[i].coords, coords);
+  }
+
+  return (r_sheet){.id       = id,
+                   .width    = w,
+                   .height   = h,
+                   .subtexs  = subtexs,
+                   .count    = sub_count,
+                   .capacity = sub_count};
+}
+
+/* Set mask to 1 for each RGBA pixel with a non-zero alpha */
+static void r_sheet_alpha_mask(const unsigned char* pixels, uint8_t* mask,
+                               uint32_t count) {
+  uint32_t i = 0;
+
+#if defined(R_SSE2)
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i one  = _mm_set1_epi8(1);
+
+  for (; i + 16 <= count; i += 16) {
+    const __m128i* src = (const __m128i*)(pixels + (i * 4));
+
+    // Shift each pixel's alpha down & narrow 16 of them into one register
+    __m128i a0 = _mm_srli_epi32(_mm_loadu_si128(src), 24);
+    __m128i a1 = _mm_srli_epi32(_mm_loadu_si128(src + 1), 24);
+    __m128i a2 = _mm_srli_epi32(_mm_loadu_si128(src + 2), 24);
+    __m128i a3 = _mm_srli_epi32(_mm_loadu_si128(src + 3), 24);
+
+    __m128i alpha = _mm_packus_epi16(_mm_packs_epi32(a0, a1),
+                                     _mm_packs_epi32(a2, a3));
+
+    __m128i opaque = _mm_andnot_si128(_mm_cmpeq_epi8(alpha, zero), one);
+    _mm_storeu_si128((__m128i*)(mask + i), opaque);
+  }
+#endif
+
+  for (; i < count; ++i) {
+    mask[i] = pixels[(i * 4) + 3] != 0;
+  }
+}
+
+/* Grow a mask by radius pixels right & down (trailing box dilation) so that
+ * regions with gaps of radius pixels or less end up connected
+ * col_sum - scratch space of width elements */
+static void r_sheet_dilate(const uint8_t* src, uint8_t* tmp, uint8_t* dst,
+                           uint32_t* col_sum, uint32_t w, uint32_t h,
+                           uint32_t radius) {
+  // Horizontal, sliding window over [x - radius, x]
+  for (uint32_t y = 0; y < h; ++y) {
+    const uint8_t* row = src + (y * w);
+    uint8_t*       out = tmp + (y * w);
+    uint32_t       sum = 0;
+
+    for (uint32_t x = 0; x < w; ++x) {
+      sum += row[x];
+      if (x > radius)
+        sum -= row[x - radius - 1];
+      out[x] = sum != 0;
+    }
+  }
+
+  // Vertical, keeping a running sum per column so rows are read in order
+  memset(col_sum, 0, sizeof(uint32_t) * w);
+  for (uint32_t y = 0; y < h; ++y) {
+    const uint8_t* row = tmp + (y * w);
+    for (uint32_t x = 0; x < w; ++x) {
+      col_sum[x] += row[x];
+    }
+
+    if (y > radius) {
+      const uint8_t* old = tmp + ((y - radius - 1) * w);
+      for (uint32_t x = 0; x < w; ++x) {
+        col_sum[x] -= old[x];
+      }
+    }
+
+    uint8_t* out = dst + (y * w);
+    for (uint32_t x = 0; x < w; ++x) {
+      out[x] = col_sum[x] != 0;
+    }
+  }
+}
+
+static uint32_t r_sheet_find_root(uint32_t* parents, uint32_t label) {
+  while (parents[label] != label) {
+    parents[label] = parents[parents[label]];
+    label          = parents[label];
+  }
+  return label;
+}
+
+/* Find the bounds of each connected opaque region in an RGBA image
+ * rects - set to an array of [x, y, width, height] per region (may be 0)
+ * count - set to the amount of regions found
+ * returns: 1 = success, 0 = fail */
+static uint8_t r_sheet_slice(const unsigned char* pixels, uint32_t w,
+                             uint32_t h, uint32_t tollerance, uint32_t** rects,
+                             uint32_t* count) {
+  uint32_t  pixel_count = w * h;
+  uint8_t*  mask        = (uint8_t*)malloc(pixel_count * 3);
+  uint32_t* labels      = (uint32_t*)calloc(pixel_count, sizeof(uint32_t));
+  uint32_t* col_sum     = (uint32_t*)malloc(sizeof(uint32_t) * w);
+
+  uint32_t  parent_cap = 256, label_count = 1;
+  uint32_t* parents    = (uint32_t*)malloc(sizeof(uint32_t) * parent_cap);
+
+  *rects = 0;
+  *count = 0;
+
+  if (!mask || !labels || !col_sum || !parents) {
+    ASTERA_DBG("r_sheet_slice: unable to allocate scratch space.\n");
+    free(mask);
+    free(labels);
+    free(col_sum);
+    free(parents);
+    return 0;
+  }
+
+  uint8_t* joined = mask + pixel_count;
+  r_sheet_alpha_mask(pixels, mask, pixel_count);
+
+  if (tollerance) {
+    r_sheet_dilate(mask, mask + (pixel_count * 2), joined, col_sum, w, h,
+                   tollerance);
+  } else {
+    memcpy(joined, mask, pixel_count);
+  }
+
+  // First pass: label the joined mask (8-connected), merging labels that meet
+  parents[0] = 0;
+  for (uint32_t y = 0; y < h; ++y) {
+    for (uint32_t x = 0; x < w; ++x) {
+      uint32_t index = (y * w) + x;
+      if (!joined[index]) {
+        continue;
+      }
+
+      uint32_t near[4], near_count = 0;
+      if (x > 0 && labels[index - 1])
+        near[near_count++] = labels[index - 1];
+      if (y > 0) {
+        uint32_t above = index - w;
+        if (x > 0 && labels[above - 1])
+          near[near_count++] = labels[above - 1];
+        if (labels[above])
+          near[near_count++] = labels[above];
+        if (x + 1 < w && labels[above + 1])
+          near[near_count++] = labels[above + 1];
+      }
+
+      if (!near_count) {
+        if (label_count == parent_cap) {
+          parent_cap *= 2;
+          uint32_t* grown =
+              (uint32_t*)realloc(parents, sizeof(uint32_t) * parent_cap);
+          if (!grown) {
+            ASTERA_DBG("r_sheet_slice: unable to grow labels.\n");
+            free(mask);
+            free(labels);
+            free(col_sum);
+            free(parents);
+            return 0;
+          }
+          parents = grown;
+        }
+
+        parents[label_count] = label_count;
+        labels[index]        = label_count;
+        ++label_count;
+        continue;
+      }
+
+      // Keep the earliest label as the root so regions stay in read order
+      uint32_t root = r_sheet_find_root(parents, near[0]);
+      for (uint32_t i = 1; i < near_count; ++i) {
+        uint32_t other = r_sheet_find_root(parents, near[i]);
+        if (other < root) {
+          parents[root] = other;
+          root          = other;
+        } else if (other > root) {
+          parents[other] = root;
+        }
+      }
+
+      labels[index] = root;
+    }
+  }
+
+  // Second pass: tight bounds from the original (undilated) pixels
+  uint32_t* bounds = (uint32_t*)malloc(sizeof(uint32_t) * 4 * label_count);
+  if (!bounds) {
+    ASTERA_DBG("r_sheet_slice: unable to allocate bounds.\n");
+    free(mask);
+    free(labels);
+    free(col_sum);
+    free(parents);
+    return 0;
+  }
+
+  for (uint32_t i = 0; i < label_count; ++i) {
+    bounds[(i * 4) + 0] = UINT32_MAX;
+    bounds[(i * 4) + 1] = UINT32_MAX;
+    bounds[(i * 4) + 2] = 0;
+    bounds[(i * 4) + 3] = 0;
+  }
+
+  for (uint32_t y = 0; y < h; ++y) {
+    for (uint32_t x = 0; x < w; ++x) {
+      uint32_t index = (y * w) + x;
+      if (!mask[index]) {
+        continue;
+      }
+
+      uint32_t* b = &bounds[r_sheet_find_root(parents, labels[index]) * 4];
+      if (x < b[0])
+        b[0] = x;
+      if (y < b[1])
+        b[1] = y;
+      if (x > b[2])
+        b[2] = x;
+      if (y > b[3])
+        b[3] = y;
+    }
+  }
+
+  free(mask);
+  free(labels);
+  free(col_sum);
+
+  uint32_t found = 0;
+  for (uint32_t i = 1; i < label_count; ++i) {
+    if (parents[i] == i && bounds[i * 4] != UINT32_MAX) {
+      ++found;
+    }
+  }
+
+  uint32_t* out = 0;
+  if (found) {
+    out = (uint32_t*)malloc(sizeof(uint32_t) * 4 * found);
+    if (!out) {
+      ASTERA_DBG("r_sheet_slice: unable to allocate rects.\n");
+      free(parents);
+      free(bounds);
+      return 0;
+    }
+
+    uint32_t cursor = 0;
+    for (uint32_t i = 1; i < label_count; ++i) {
+      uint32_t* b = &bounds[i * 4];
+      if (parents[i] != i || b[0] == UINT32_MAX) {
+        continue;
+      }
+
+      out[cursor + 0] = b[0];
+      out[cursor + 1] = b[1];
+      out[cursor + 2] = b[2] - b[0] + 1;
+      out[cursor + 3] = b[3] - b[1] + 1;
+      cursor += 4;
+    }
+  }
+
+  free(parents);
+  free(bounds);
+
+  *rects = out;
+  *count = found;
+  return 1;
+}
+
+typedef struct {
+  // magic - "ASUB"
+  // hash, length - the s_hash_data & length of the encoded image
+  // tollerance - the tolerance the image was sliced with
+  // width, height - the size of the image in pixels
+  // count - the amount of rects ([x, y, width, height]) following
+  char     magic[4];
+  uint32_t hash, length, tollerance;
+  uint32_t width, height, count;
+} r_sheet_cache_header;
+
+/* Read the rects of a previous slice if the cache matches the image
+ * returns: 1 = cache hit, 0 = missing or stale */
+static uint8_t r_sheet_cache_read(const char* path, r_sheet_cache_header* key,
+                                  uint32_t** rects) {
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    return 0;
+  }
+
+  r_sheet_cache_header header;
+  uint8_t              hit = 0;
+
+  if (fread(&header, sizeof(r_sheet_cache_header), 1, file) == 1 &&
+      memcmp(header.magic, key->magic, 4) == 0 && header.hash == key->hash &&
+      header.length == key->length && header.tollerance == key->tollerance &&
+      header.width == key->width && header.height == key->height &&
+      header.count <= (key->width * key->height)) {
+    uint32_t* cached = 0;
+
+    if (header.count) {
+      cached = (uint32_t*)malloc(sizeof(uint32_t) * 4 * header.count);
+    }
+
+    if (!header.count || (cached && fread(cached, sizeof(uint32_t) * 4,
+                                          header.count,
+                                          file) == header.count)) {
+      *rects     = cached;
+      key->count = header.count;
+      hit        = 1;
+    } else {
+      free(cached);
+    }
+  }
+
+  fclose(file);
+  return hit;
+}
+
+static void r_sheet_cache_write(const char* path, r_sheet_cache_header* key,
+                                uint32_t* rects) {
+  FILE* file = fopen(path, "wb");
+  if (!file) {
+    ASTERA_DBG("r_sheet_cache_write: unable to open %s.\n", path);
+    return;
+  }
+
+  fwrite(key, sizeof(r_sheet_cache_header), 1, file);
+  if (key->count) {
+    fwrite(rects, sizeof(uint32_t) * 4, key->count, file);
+  }
+
+  fclose(file);
+}
+
+r_sheet r_sheet_create_auto_cached(unsigned char* data, uint32_t length,
+                                   uint32_t tollerance,
+                                   const char* cache_path) {
+  if (!data || !length) {
+    ASTERA_DBG("r_sheet_create_auto: invalid texture data passed.\n");
+    return (r_sheet){0};
+  }
+
+  int            w, h, ch;
+  unsigned char* img = stbi_load_from_memory(data, length, &w, &h, &ch, 4);
+
+  if (!img) {
+    ASTERA_DBG("r_sheet_create_auto: unable to load image data.\n");
+    return (r_sheet){0};
+  }
+
+  r_sheet_cache_header key = {.magic      = {'A', 'S', 'U', 'B'},
+                              .length     = length,
+                              .tollerance = tollerance,
+                              .width      = (uint32_t)w,
+                              .height     = (uint32_t)h};
+
+  uint32_t* rects = 0;
+  uint8_t   found = 0;
+
+  if (cache_path) {
+    key.hash = s_hash_data(data, length);
+    found    = r_sheet_cache_read(cache_path, &key, &rects);
+  }
+
+  if (!found) {
+    if (!r_sheet_slice(img, w, h, tollerance, &rects, &key.count)) {
+      stbi_image_free(img);
+      return (r_sheet){0};
+    }
+
+    if (cache_path) {
+      r_sheet_cache_write(cache_path, &key, rects);
+    }
+  }
+
+  uint32_t id = r_sheet_tex_upload(img, w, h, GL_RGBA);
+  stbi_image_free(img);
+
+  r_subtex* subtexs = 0;
+  if (key.count) {
+    subtexs = (r_subtex*)malloc(sizeof(r_subtex) * key.count);
+  }
+
+  for (uint32_t i = 0; i < key.count && subtexs; ++i) {
+    uint32_t* rect = &rects[i * 4];
+    subtexs[i]     = (r_subtex){.sub_id = i,
+                            .x      = rect[0],
+                            .y      = rect[1],
+                            .width  = rect[2],
+                            .height = rect[3]};
+
+    vec4 coords = {(float)rect[0] / w, (float)rect[1] / h,
+                   (float)(rect[0] + rect[2]) / w,
+                   (float)(rect[1] + rect[3]) / h};
+    vec4_dup(subtexs[i].coords, coords);
+  }
+
+  free(rects);
+
+  return (r_sheet){.id       = id,
+                   .width    = (uint32_t)w,
+                   .height   = (uint32_t)h,
+                   .subtexs  = subtexs,
+                   .count    = (subtexs) ? key.count : 0,
+                   .capacity = (subtexs) ? key.count : 0};
+}
+
+r_sheet r_sheet_create_auto(unsigned char* data, uint32_t length,
+                            uint32_t tollerance) {
+  return r_sheet_create_auto_cached(data, length, tollerance, 0);
+}
+
+void r_sheet_destroy(r_sheet* sheet) {
+  r_res_untrack(R_RES_TEXTURE, sheet->id);
+  glDeleteTextures(1, &sheet->id);
+  free(sheet->subtexs);
+}
+
+struct r_layout {
+  r_layout_header header;
+
+  // Each section of the file, pointing into the data following the struct
+  r_layout_sheet* sheets;
+  r_subtex*       subtexs;
+  r_layout_anim*  anims;
+  uint32_t*       frames;
+  r_layout_name*  names;
+  const char*     strings;
+};
+
+r_layout* r_layout_load(unsigned char* data, uint32_t length) {
+  if (!data || length < sizeof(r_layout_header)) {
+    ASTERA_DBG("r_layout_load: invalid data passed.\n");
+    return 0;
+  }
+
+  r_layout_header header;
+  memcpy(&header, data, sizeof(r_layout_header));
+
+  if (memcmp(header.magic, "ALAY", 4) != 0 ||
+      header.version != R_LAYOUT_VERSION) {
+    ASTERA_DBG("r_layout_load: invalid header or version.\n");
+    return 0;
+  }
+
+  uint64_t expected = (uint64_t)sizeof(r_layout_header) +
+                      (uint64_t)header.sheet_count * sizeof(r_layout_sheet) +
+                      (uint64_t)header.subtex_count * sizeof(r_subtex) +
+                      (uint64_t)header.anim_count * sizeof(r_layout_anim) +
+                      (uint64_t)header.frame_count * sizeof(uint32_t) +
+                      (uint64_t)header.name_count * sizeof(r_layout_name) +
+                      header.string_size;
+
+  if (expected != length || !header.string_size ||
+      data[length - 1] != '\0') {
+    ASTERA_DBG("r_layout_load: truncated or malformed data.\n");
+    return 0;
+  }
+
+  // One allocation for the struct & the data so everything can be used in
+  // place after fixing up the section pointers
+  r_layout* layout = (r_layout*)malloc(sizeof(r_layout) + length);
+  if (!layout) {
+    ASTERA_DBG("r_layout_load: unable to allocate layout.\n");
+    return 0;
+  }
+
+  uint8_t* cursor = (uint8_t*)(layout + 1);
+  memcpy(cursor, data, length);
+
+  layout->header = header;
+  cursor += sizeof(r_layout_header);
+
+  layout->sheets = (r_layout_sheet*)cursor;
+  cursor += header.sheet_count * sizeof(r_layout_sheet);
+  layout->subtexs = (r_subtex*)cursor;
+  cursor += header.subtex_count * sizeof(r_subtex);
+  layout->anims = (r_layout_anim*)cursor;
+  cursor += header.anim_count * sizeof(r_layout_anim);
+  layout->frames = (uint32_t*)cursor;
+  cursor += header.frame_count * sizeof(uint32_t);
+  layout->names = (r_layout_name*)cursor;
+  cursor += header.name_count * sizeof(r_layout_name);
+  layout->strings = (const char*)cursor;
+
+  // Make sure nothing indexes outside of the file
+  uint8_t valid = 1;
+  for (uint32_t i = 0; i < header.sheet_count && valid; ++i) {
+    r_layout_sheet* sheet = &layout->sheets[i];
+    valid = sheet->name < header.string_size &&
+            (uint64_t)sheet->subtex_start + sheet->subtex_count <=
+                header.subtex_count;
+  }
+
+  for (uint32_t i = 0; i < header.anim_count && valid; ++i) {
+    r_layout_anim* anim = &layout->anims[i];
+    valid = anim->name < header.string_size &&
+            anim->sheet < header.sheet_count && anim->frame_count &&
+            (uint64_t)anim->frame_start + anim->frame_count <=
+                header.frame_count;
+
+    for (uint32_t j = 0; j < anim->frame_count && valid; ++j) {
+      valid = layout->frames[anim->frame_start + j] <
+              layout->sheets[anim->sheet].subtex_count;
+    }
+  }
+
+  for (uint32_t i = 0; i < header.name_count && valid; ++i) {
+    r_layout_name* name = &layout->names[i];
+    valid = (name->type == R_LAYOUT_SHEET) ? name->index < header.sheet_count
+            : (name->type == R_LAYOUT_ANIM) ? name->index < header.anim_count
+                                            : 0;
+  }
+
+  if (!valid) {
+    ASTERA_DBG("r_layout_load: out of bounds index in layout.\n");
+    free(layout);
+    return 0;
+  }
+
+  return layout;
+}
+
+void r_layout_destroy(r_layout* layout) { free(layout); }
+
+/* Binary search the sorted name table for a name of a type
+ * returns: the index of the sheet / animation, -1 = not found */
+static int32_t r_layout_find(r_layout* layout, const char* name,
+                             uint32_t type) {
+  if (!layout || !name) {
+    return -1;
+  }
+
+  uint32_t hash = s_hash_str(name);
+  uint32_t low = 0, high = layout->header.name_count;
+
+  while (low < high) {
+    uint32_t mid = low + (high - low) / 2;
+    if (layout->names[mid].hash < hash) {
+      low = mid + 1;
+    } else {
+      high = mid;
+    }
+  }
+
+  // The converter rejects duplicate hashes, so compare the name to rule out
+  // a query colliding with a different entry
+  for (; low < layout->header.name_count && layout->names[low].hash == hash;
+       ++low) {
+    r_layout_name* entry = &layout->names[low];
+    if (entry->type != type) {
+      continue;
+    }
+
+    uint32_t offset = (type == R_LAYOUT_SHEET)
+                          ? layout->sheets[entry->index].name
+                          : layout->anims[entry->index].name;
+
+    if (strcmp(layout->strings + offset, name) == 0) {
+      return (int32_t)entry->index;
+    }
+  }
+
+  return -1;
+}
+
+int32_t r_layout_find_sheet(r_layout* layout, const char* name) {
+  return r_layout_find(layout, name, R_LAYOUT_SHEET);
+}
+
+int32_t r_layout_find_anim(r_layout* layout, const char* name) {
+  return r_layout_find(layout, name, R_LAYOUT_ANIM);
+}
+
+r_sheet r_sheet_create_layout(unsigned char* data, uint32_t length,
+                              r_layout* layout, uint32_t sheet_index) {
+  if (!data || !length || !layout ||
+      sheet_index >= layout->header.sheet_count) {
+    ASTERA_DBG("r_sheet_create_layout: invalid parameters passed.\n");
+    return (r_sheet){0};
+  }
+
+  r_layout_sheet* info = &layout->sheets[sheet_index];
+
+  uint32_t w, h;
+  uint32_t id = r_sheet_tex_create(data, length, &w, &h);
+
+  if (!id) {
+    return (r_sheet){0};
+  }
+
+  if (w != info->width || h != info->height) {
+    ASTERA_DBG("r_sheet_create_layout: image size doesn't match layout.\n");
+  }
+
+  // The subtexs are stored ready to use (coordinates included)
+  r_subtex* subtexs = 0;
+  if (info->subtex_count) {
+    subtexs = (r_subtex*)malloc(sizeof(r_subtex) * info->subtex_count);
+    memcpy(subtexs, &layout->subtexs[info->subtex_start],
+           sizeof(r_subtex) * info->subtex_count);
+  }
+
+  return (r_sheet){.id       = id,
+                   .width    = w,
+                   .height   = h,
+                   .subtexs  = subtexs,
+                   .count    = info->subtex_count,
+                   .capacity = info->subtex_count};
+}
+
+/* Build the vertices (x, y, z, u, v) & optionally indices of baked quads
+ * offset - added to each quad's position
+ * bounds - set to the min / max of the quads' positions [min_x, min_y, max_x,
+ *          max_y], optional */
+static void r_baked_quads_build(r_sheet* sheet, r_baked_quad* quads,
+                                uint32_t quad_count, vec2 offset, float* verts,
+                                uint16_t* inds, vec4 bounds) {
+  uint16_t _inds[6]  = {0, 1, 2, 2, 3, 0};
+  float    _verts[8] = {-0.5f, 0.5f, 0.5f, 0.5f, 0.5f, -0.5f, -0.5f, -0.5f};
+  float    _texcs[8] = {0.f, 1.f, 1.f, 1.f, 1.f, 0.f, 0.f, 0.f};
+
+  uint32_t vert_count = 0, ind_count = 0, uvert_count = 0;
+
+  if (bounds) {
+    bounds[0] = bounds[1] = 3.402823466e+38f;
+    bounds[2] = bounds[3] = -3.402823466e+38f;
+  }
+
+  for (uint32_t i = 0; i < quad_count; ++i) {
+    r_baked_quad* quad   = &quads[i];
+    r_subtex*     subtex = &sheet->subtexs[quad->subtex];
+
+    vec2 _offset = {quad->x + offset[0], quad->y + offset[1]};
+    vec2 _size   = {quad->width, quad->height};
+
+    vec2 _tex_offset = {subtex->coords[0], subtex->coords[1]};
+    vec2 _tex_size   = {subtex->coords[2], subtex->coords[3]};
+    vec2_sub(_tex_size, _tex_size, _tex_offset);
+
+    for (uint32_t j = 0; j < 4; ++j) {
+      verts[vert_count]     = (_verts[j * 2] * _size[0]) + _offset[0];
+      verts[vert_count + 1] = (_verts[(j * 2) + 1] * _size[1]) + _offset[1];
+      verts[vert_count + 2] = quad->layer * ASTERA_RENDER_LAYER_MOD;
+
+      float sample_x = _texcs[j * 2];
+      float sample_y = _texcs[(j * 2) + 1];
+
+      if (quad->flip_x) {
+        sample_x = 1.f - sample_x;
+      }
+
+      if (quad->flip_y) {
+        sample_y = 1.f - sample_y;
+      }
+
+      verts[vert_count + 3] = (sample_x * _tex_size[0]) + _tex_offset[0];
+      verts[vert_count + 4] = (sample_y * _tex_size[1]) + _tex_offset[1];
+
+      if (bounds) {
+        bounds[0] = fminf(bounds[0], verts[vert_count]);
+        bounds[1] = fminf(bounds[1], verts[vert_count + 1]);
+        bounds[2] = fmaxf(bounds[2], verts[vert_count]);
+        bounds[3] = fmaxf(bounds[3], verts[vert_count + 1]);
+      }
+
+      vert_count += 5;
+    }
+
+    if (inds) {
+      for (uint32_t j = 0; j < 6; ++j) {
+        inds[ind_count] = _inds[j] + uvert_count;
+        ++ind_count;
+      }
+    }
+    uvert_count += 4;
+  }
+}
+
+r_baked_sheet r_baked_sheet_create(r_sheet* sheet, r_baked_quad* quads,
+                                   uint32_t quad_count, vec2 position) {
+  if (!quads || !quad_count) {
+    ASTERA_DBG("r_baked_sheet_create: invalid quad parameters.\n");
+    return (r_baked_sheet){0};
+  }
+
+  uint32_t vert_count = quad_count * 20;
+  uint32_t ind_count  = quad_count * 6;
+
+  float*    verts = (float*)malloc(sizeof(float) * vert_count);
+  uint16_t* inds  = (uint16_t*)malloc(sizeof(uint16_t) * ind_count);
+
+  vec2 no_offset = {0.f, 0.f};
+  vec4 bounds    = {0.f, 0.f, 0.f, 0.f};
+  r_baked_quads_build(sheet, quads, quad_count, no_offset, verts, inds,
+                      bounds);
+
+  uint32_t vao, vbo, vboi;
+  glGenVertexArrays(1, &vao);
+  glBindVertexArray(vao);
+
+  glGenBuffers(1, &vbo);
+  glGenBuffers(1, &vboi);
+
+  glBindBuffer(GL_ARRAY_BUFFER, vbo);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * vert_count, verts,
+               GL_STATIC_DRAW);
+
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 20, 0);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 20, 12);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vboi);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(uint16_t) * ind_count, inds,
+               GL_STATIC_DRAW);
+
+  glBindVertexArray(0);
+
+  r_res_track(R_RES_VAO, vao, 0, __func__);
+  r_res_track(R_RES_BUFFER, vbo, sizeof(float) * vert_count, __func__);
+  r_res_track(R_RES_BUFFER, vboi, sizeof(uint16_t) * ind_count, __func__);
+
+  free(verts);
+  free(inds);
+
+  r_baked_sheet baked_sheet = (r_baked_sheet){
+      .vao        = vao,
+      .vbo        = vbo,
+      .vboi       = vboi,
+      .quad_count = quad_count,
+      .sheet      = sheet,
+  };
+
+  vec2 sheet_size = {bounds[2] - bounds[0], bounds[3] - bounds[1]};
+  vec2_dup(baked_sheet.size, sheet_size);
+  vec2_dup(baked_sheet.position, position);
+
+  mat4x4_identity(baked_sheet.model);
+  mat4x4_translate(baked_sheet.model, position[0], position[1], 0.f);
+  mat4x4_scale_aniso(baked_sheet.model, baked_sheet.model, 1.f, 1.f, 1.f);
+
+  return baked_sheet;
+}
+
+static void r_baked_sheet_render(r_ctx* ctx, r_shader shader,
+                                 r_baked_sheet* sheet) {
+  r_camera* camera = r_ctx_draw_camera(ctx);
+
+  r_shader_bind(shader);
+
+  r_set_m4(shader, "projection", camera->projection);
+  r_set_m4(shader, "view", camera->view);
+  r_set_m4(shader, "model", sheet->model);
+
+  r_tex_bind(sheet->sheet->id);
+
+  glBindVertexArray(sheet->vao);
+
+  // TODO Test binding requirements
+  glBindBuffer(GL_ARRAY_BUFFER, sheet->vbo);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sheet->vboi);
+
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 20, 0);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 20, 12);
+
+  // Opaque sheets don't need blending & can fill the depth buffer early
+  if (sheet->opaque)
+    glDisable(GL_BLEND);
+
+  glDrawElements(GL_TRIANGLES, sheet->quad_count * 6, GL_UNSIGNED_SHORT, 0);
+
+  if (sheet->opaque)
+    glEnable(GL_BLEND);
+
+  glDisableVertexAttribArray(0);
+  glDisableVertexAttribArray(1);
+
+  glBindVertexArray(0);
+  r_tex_bind(0);
+  r_shader_bind(0);
+}
+
+void r_baked_sheet_draw(r_ctx* ctx, r_shader shader, r_baked_sheet* sheet) {
+  if (shader == 0)
+    ASTERA_DBG("r_baked_sheet_draw: Invalid shader.\n");
+
+  if (r_ctx_recording(ctx)) {
+    r_cmd_camera_sync(ctx);
+
+    r_cmd_baked* cmd = r_cmd_rec(ctx, R_CMD_BAKED, sizeof(r_cmd_baked));
+    if (cmd) {
+      cmd->shader = shader;
+      cmd->sheet  = *sheet;
+    }
+    return;
+  }
+
+  r_baked_sheet_render(ctx, shader, sheet);
+}
+
+void r_baked_sheet_destroy(r_baked_sheet* sheet) {
+  r_res_untrack(R_RES_BUFFER, sheet->vbo);
+  r_res_untrack(R_RES_BUFFER, sheet->vboi);
+  r_res_untrack(R_RES_VAO, sheet->vao);
+
+  // Baked sheets interleave texture coordinates, `vto` is never generated
+  glDeleteBuffers(1, &sheet->vbo);
+  glDeleteBuffers(1, &sheet->vboi);
+  glDeleteVertexArrays(1, &sheet->vao);
+}
+
+// The most quads a single chunk of a baked pack can hold (16 bit indices)
+#define R_BAKED_CHUNK_MAX 16384
+
+struct r_baked_pack {
+  // sheet - the texture sheet every chunk uses
+  // vao, vbo, vboi - the buffers shared by every chunk
+  r_sheet* sheet;
+  uint32_t vao, vbo, vboi;
+
+  // verts - copy of the vertex data, used to move chunks
+  // quad_count, quad_capacity - the quads used / allocated in the buffers
+  // index_quads - the amount of quads the shared index pattern covers
+  float*   verts;
+  uint32_t quad_count, quad_capacity;
+  uint32_t index_quads;
+
+  // chunk_starts - the first quad of each chunk
+  // chunk_quads - the amount of quads in each chunk
+  // chunk_positions - the offset each chunk's vertices are built with
+  // chunk_bounds - the min / max of each chunk's vertices
+  uint32_t* chunk_starts;
+  uint32_t* chunk_quads;
+  vec2*     chunk_positions;
+  vec4*     chunk_bounds;
+  uint32_t  chunk_count, chunk_capacity;
+
+  // draw_counts, draw_offsets, draw_bases - glMultiDrawElementsBaseVertex
+  // parameters, reused every draw
+  GLsizei* draw_counts;
+  void**   draw_offsets;
+  GLint*   draw_bases;
+
+  // opaque - draw without blending
+  uint8_t opaque;
+};
+
+r_baked_pack* r_baked_pack_create(r_sheet* sheet, uint32_t chunk_capacity,
+                                  uint32_t quad_capacity) {
+  if (!sheet || !chunk_capacity || !quad_capacity) {
+    ASTERA_DBG("r_baked_pack_create: invalid parameters passed.\n");
+    return 0;
+  }
+
+  r_baked_pack* pack = (r_baked_pack*)calloc(1, sizeof(r_baked_pack));
+  if (!pack) {
+    ASTERA_DBG("r_baked_pack_create: unable to allocate pack.\n");
+    return 0;
+  }
+
+  pack->sheet          = sheet;
+  pack->quad_capacity  = quad_capacity;
+  pack->chunk_capacity = chunk_capacity;
+  pack->index_quads    = (quad_capacity < R_BAKED_CHUNK_MAX) ? quad_capacity
+                                                             : R_BAKED_CHUNK_MAX;
+
+  pack->verts           = (float*)malloc(sizeof(float) * 20 * quad_capacity);
+  pack->chunk_starts    = (uint32_t*)malloc(sizeof(uint32_t) * chunk_capacity);
+  pack->chunk_quads     = (uint32_t*)malloc(sizeof(uint32_t) * chunk_capacity);
+  pack->chunk_positions = (vec2*)malloc(sizeof(vec2) * chunk_capacity);
+  pack->chunk_bounds    = (vec4*)malloc(sizeof(vec4) * chunk_capacity);
+  pack->draw_counts     = (GLsizei*)malloc(sizeof(GLsizei) * chunk_capacity);
+  pack->draw_offsets    = (void**)calloc(chunk_capacity, sizeof(void*));
+  pack->draw_bases      = (GLint*)malloc(sizeof(GLint) * chunk_capacity);
+
+  uint16_t* inds = (uint16_t*)malloc(sizeof(uint16_t) * 6 * pack->index_quads);
+
+  if (!pack->verts || !pack->chunk_starts || !pack->chunk_quads ||
+      !pack->chunk_positions || !pack->chunk_bounds || !pack->draw_counts ||
+      !pack->draw_offsets || !pack->draw_bases || !inds) {
+    ASTERA_DBG("r_baked_pack_create: unable to allocate pack storage.\n");
+    free(inds);
+    r_baked_pack_destroy(pack);
+    return 0;
+  }
+
+  // Every chunk starts its indices at 0 (offset by its base vertex), so one
+  // quad index pattern is shared by all of them
+  uint16_t _inds[6] = {0, 1, 2, 2, 3, 0};
+  for (uint32_t i = 0; i < pack->index_quads; ++i) {
+    for (uint32_t j = 0; j < 6; ++j) {
+      inds[(i * 6) + j] = (uint16_t)(_inds[j] + (i * 4));
+    }
+  }
+
+  glGenVertexArrays(1, &pack->vao);
+  glBindVertexArray(pack->vao);
+
+  glGenBuffers(1, &pack->vbo);
+  glGenBuffers(1, &pack->vboi);
+
+  glBindBuffer(GL_ARRAY_BUFFER, pack->vbo);
+  glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 20 * quad_capacity, 0,
+               GL_STATIC_DRAW);
+
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 20, 0);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 20, (void*)12);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, pack->vboi);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER,
+               sizeof(uint16_t) * 6 * pack->index_quads, inds, GL_STATIC_DRAW);
+
+  glBindVertexArray(0);
+
+  r_res_track(R_RES_VAO, pack->vao, 0, __func__);
+  r_res_track(R_RES_BUFFER, pack->vbo, sizeof(float) * 20 * quad_capacity,
+              __func__);
+  r_res_track(R_RES_BUFFER, pack->vboi,
+              sizeof(uint16_t) * 6 * pack->index_quads, __func__);
+
+  free(inds);
+
+  return pack;
+}
+
+int32_t r_baked_pack_add(r_baked_pack* pack, r_baked_quad* quads,
+                         uint32_t quad_count, vec2 position) {
+  if (!pack || !quads || !quad_count) {
+    ASTERA_DBG("r_baked_pack_add: invalid parameters passed.\n");
+    return -1;
+  }
+
+  if (pack->chunk_count == pack->chunk_capacity ||
+      pack->quad_count + quad_count > pack->quad_capacity) {
+    ASTERA_DBG("r_baked_pack_add: no space left in pack.\n");
+    return -1;
+  }
+
+  if (quad_count > pack->index_quads) {
+    ASTERA_DBG("r_baked_pack_add: chunk exceeds %i quads.\n",
+               pack->index_quads);
+    return -1;
+  }
+
+  uint32_t chunk = pack->chunk_count;
+  uint32_t start = pack->quad_count;
+  float*   verts = &pack->verts[start * 20];
+
+  // Positions are baked into the vertices so every chunk shares one model
+  r_baked_quads_build(pack->sheet, quads, quad_count, position, verts, 0,
+                      pack->chunk_bounds[chunk]);
+
+  glBindBuffer(GL_ARRAY_BUFFER, pack->vbo);
+  glBufferSubData(GL_ARRAY_BUFFER, sizeof(float) * 20 * start,
+                  sizeof(float) * 20 * quad_count, verts);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  pack->chunk_starts[chunk] = start;
+  pack->chunk_quads[chunk]  = quad_count;
+  vec2_dup(pack->chunk_positions[chunk], position);
+
+  pack->quad_count += quad_count;
+  ++pack->chunk_count;
+
+  return (int32_t)chunk;
+}
+
+void r_baked_pack_set_position(r_baked_pack* pack, uint32_t chunk, vec2 position) {
+  if (!pack || chunk >= pack->chunk_count) {
+    ASTERA_DBG("r_baked_pack_set_position: invalid chunk %i.\n", chunk);
+    return;
+  }
+
+  float dx = position[0] - pack->chunk_positions[chunk][0];
+  float dy = position[1] - pack->chunk_positions[chunk][1];
+
+  uint32_t start = pack->chunk_starts[chunk];
+  uint32_t count = pack->chunk_quads[chunk] * 4;
+  float*   verts = &pack->verts[start * 20];
+
+  for (uint32_t i = 0; i < count; ++i) {
+    verts[(i * 5) + 0] += dx;
+    verts[(i * 5) + 1] += dy;
+  }
+
+  float* bounds = pack->chunk_bounds[chunk];
+  bounds[0] += dx;
+  bounds[1] += dy;
+  bounds[2] += dx;
+  bounds[3] += dy;
+  vec2_dup(pack->chunk_positions[chunk], position);
+
+  glBindBuffer(GL_ARRAY_BUFFER, pack->vbo);
+  glBufferSubData(GL_ARRAY_BUFFER, sizeof(float) * 20 * start,
+                  sizeof(float) * 5 * count, verts);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+uint32_t r_baked_pack_get_visible(r_baked_pack* pack, vec4 bounds,
+                                  uint32_t* chunks, uint32_t capacity) {
+  if (!pack || !chunks) {
+    return 0;
+  }
+
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < pack->chunk_count && count < capacity; ++i) {
+    float* chunk = pack->chunk_bounds[i];
+    if (chunk[0] <= bounds[2] && chunk[2] >= bounds[0] &&
+        chunk[1] <= bounds[3] && chunk[3] >= bounds[1]) {
+      chunks[count] = i;
+      ++count;
+    }
+  }
+
+  return count;
+}
+
+void r_baked_pack_set_opaque(r_baked_pack* pack, uint8_t opaque) {
+  if (pack)
+    pack->opaque = opaque;
+}
+
+static void r_baked_pack_render(r_ctx* ctx, r_shader shader,
+                                r_baked_pack* pack, uint32_t* chunks,
+                                uint32_t count) {
+  uint32_t draw_count = 0;
+
+  if (chunks) {
+    // The draw arrays hold chunk_capacity entries, a longer list (i.e with
+    // repeats) is cut off there
+    for (uint32_t i = 0; i < count && draw_count < pack->chunk_capacity; ++i) {
+      uint32_t chunk = chunks[i];
+      if (chunk >= pack->chunk_count) {
+        continue;
+      }
+
+      pack->draw_counts[draw_count] = pack->chunk_quads[chunk] * 6;
+      pack->draw_bases[draw_count]  = pack->chunk_starts[chunk] * 4;
+      ++draw_count;
+    }
+  } else {
+    for (uint32_t i = 0; i < pack->chunk_count; ++i) {
+      pack->draw_counts[i] = pack->chunk_quads[i] * 6;
+      pack->draw_bases[i]  = pack->chunk_starts[i] * 4;
+    }
+    draw_count = pack->chunk_count;
+  }
+
+  if (!draw_count) {
+    return;
+  }
+
+  r_camera* camera = r_ctx_draw_camera(ctx);
+
+  mat4x4 model;
+  mat4x4_identity(model);
+
+  r_shader_bind(shader);
+
+  r_set_m4(shader, "projection", camera->projection);
+  r_set_m4(shader, "view", camera->view);
+  r_set_m4(shader, "model", model);
+
+  r_tex_bind(pack->sheet->id);
+
+  glBindVertexArray(pack->vao);
+
+  if (pack->opaque)
+    glDisable(GL_BLEND);
+
+  glMultiDrawElementsBaseVertex(GL_TRIANGLES, pack->draw_counts,
+                                GL_UNSIGNED_SHORT,
+                                (const void* const*)pack->draw_offsets,
+                                draw_count, pack->draw_bases);
+
+  if (pack->opaque)
+    glEnable(GL_BLEND);
+
+  glBindVertexArray(0);
+  r_tex_bind(0);
+  r_shader_bind(0);
+}
+
+void r_baked_pack_draw(r_ctx* ctx, r_shader shader, r_baked_pack* pack,
+                       uint32_t* chunks, uint32_t count) {
+  if (!pack || !shader) {
+    ASTERA_DBG("r_baked_pack_draw: invalid pack or shader.\n");
+    return;
+  }
+
+  if (r_ctx_recording(ctx)) {
+    r_cmd_camera_sync(ctx);
+
+    uint32_t         chunk_count = (chunks) ? count : 0;
+    r_cmd_baked_pack* cmd        = r_cmd_rec(
+        ctx, R_CMD_BAKED_PACK,
+        sizeof(r_cmd_baked_pack) + (sizeof(uint32_t) * chunk_count));
+    if (cmd) {
+      cmd->shader = shader;
+      cmd->pack   = pack;
+      cmd->count  = chunk_count;
+      cmd->all    = (chunks == 0);
+      if (chunk_count) {
+        memcpy(cmd + 1, chunks, sizeof(uint32_t) * chunk_count);
+      }
+    }
+    return;
+  }
+
+  r_baked_pack_render(ctx, shader, pack, chunks, count);
+}
+
+void r_baked_pack_destroy(r_baked_pack* pack) {
+  if (!pack) {
+    return;
+  }
+
+  if (pack->vao) {
+    r_res_untrack(R_RES_BUFFER, pack->vbo);
+    r_res_untrack(R_RES_BUFFER, pack->vboi);
+    r_res_untrack(R_RES_VAO, pack->vao);
+
+    glDeleteBuffers(1, &pack->vbo);
+    glDeleteBuffers(1, &pack->vboi);
+    glDeleteVertexArrays(1, &pack->vao);
+  }
+
+  free(pack->verts);
+  free(pack->chunk_starts);
+  free(pack->chunk_quads);
+  free(pack->chunk_positions);
+  free(pack->chunk_bounds);
+  free(pack->draw_counts);
+  free(pack->draw_offsets);
+  free(pack->draw_bases);
+  free(pack);
+}
+
+r_particles r_particles_create(uint32_t emit_rate, float particle_life,
+                               uint32_t particle_capacity, uint32_t emit_count,
+                               int8_t particle_type, int8_t calculate,
+                               uint16_t uniform_cap) {
+  r_particles particles = (r_particles){0};
+
+  if (!particle_capacity) {
+    return particles;
+  }
+
+  particles.time       = 0;
+  particles.spawn_time = 0;
+  particles.spawn_rate = MS_TO_SEC / emit_rate;
+
+  particles.calculate      = calculate;
+  particles.max_emission   = emit_count;
+  particles.emission_count = 0;
+
+  if (calculate) {
+    particles.mats   = (mat4x4*)malloc(sizeof(mat4x4) * uniform_cap);
+    particles.colors = (vec4*)malloc(sizeof(vec4) * uniform_cap);
+    particles.coords = (vec4*)malloc(sizeof(vec4) * uniform_cap);
+  }
+
+  particles.uniform_cap = uniform_cap;
+
+  particles.particle_life = particle_life;
+
+  particles.type = particle_type;
+
+  particles.particle_size[0] = 1.f;
+  particles.particle_size[1] = 1.f;
+
+  particles.position[0] = 0.f;
+  particles.position[1] = 0.f;
+
+  particles.size[0] = 0.f;
+  particles.size[1] = 0.f;
+
+  particles.list = (r_particle*)malloc(sizeof(r_particle) * particle_capacity);
+  memset(particles.list, 0, sizeof(r_particle) * particle_capacity);
+
+  particles.capacity = particle_capacity;
+  particles.count    = 0;
+
+  return particles;
+}
+
+void r_particles_set_particle(r_particles* system, vec4 color,
+                              float particle_life, vec2 particle_size,
+                              vec2 particle_velocity) {
+  if (!system)
+    return;
+
+  if (color) {
+    vec4_dup(system->color, color);
+  }
+
+  if (particle_life != 0.f) {
+    system->particle_life = particle_life;
+  }
+
+  if (particle_size) {
+    vec2_dup(system->particle_size, particle_size);
+  }
+
+  if (particle_velocity) {
+    vec2_dup(system->particle_velocity, particle_velocity);
+  }
+}
+
+void r_particles_update(r_particles* system, time_s delta) {
+  system->time += delta;
+  system->spawn_time += delta;
+
+  int32_t to_spawn = (int32_t)system->spawn_time / system->spawn_rate;
+
+  if (system->count + to_spawn >= system->capacity) {
+    to_spawn = system->capacity - system->count;
+  }
+
+  system->spawn_time -= system->spawn_rate * to_spawn;
+
+  for (int i = 0; i < to_spawn; ++i) {
+    r_particle* open = 0;
+
+    for (uint32_t j = 0; j < system->capacity; ++j) {
+      if (system->list[j].life <= 0.f) {
+        open = &system->list[j];
+        break;
+      }
+    }
+
+    if (!open) {
+      break;
+    }
+
+    open->life = system->particle_life;
+    vec2_dup(open->size, system->particle_size);
+    vec2_dup(open->velocity, system->particle_velocity);
+    vec4_dup(open->color, system->color);
+
+    if (system->use_spawner) {
+      system->spawner_func(system, open);
+    } else {
+      open->position[0] = fmod(rand(), system->size[0]);
+      open->position[1] = fmod(rand(), system->size[1]);
+
+      open->layer = system->particle_layer;
+
+      if (system->type == PARTICLE_ANIMATED) {
+        open->frame = 0;
+      } else if (system->type == PARTICLE_TEXTURED) {
+        open->frame = system->render.subtex;
+      }
+    }
+
+    ++system->count;
+  }
+
+  float    frame_time  = 0.f;
+  uint32_t frame_count = 0;
+  uint8_t  anim_loop;
+  if (system->type == PARTICLE_ANIMATED) {
+    frame_time  = MS_TO_SEC / system->render.anim.rate;
+    frame_count = system->render.anim.count;
+    anim_loop   = system->render.anim.loop;
+  }
+
+  // Update particles
+  for (uint32_t i = 0; i < system->capacity; ++i) {
+    r_particle* particle = &system->list[i];
+    if (particle->life > 0.f) {
+      particle->life -= delta;
+    } else {
+      continue;
+    }
+
+    if (particle->life <= 0.f) {
+      particle->life = 0.f;
+      --system->count;
+      // TODO Test if this causes any weird issues
+      continue;
+    }
+
+    vec2 movement;
+    vec2_scale(movement, particle->velocity, delta);
+    vec2_add(particle->position, particle->position, movement);
+
+    if (system->use_animator) {
+      (*system->animator_func)(system, &system->list[i]);
+    } else if (system->type == PARTICLE_ANIMATED) {
+      float   life_span = system->particle_life - particle->life;
+      int32_t frame     = (int32_t)(life_span / frame_time);
+
+      if (frame > frame_count) {
+        if (anim_loop) {
+          frame = frame % frame_count;
+        } else {
+          frame = frame_count;
+        }
+      }
+
+      particle->frame = frame;
+    }
+  }
+}
+
+void r_particles_set_anim(r_particles* particles, r_anim anim) {
+  if (!particles)
+    return;
+
+  particles->sheet       = anim.sheet;
+  particles->render.anim = anim;
+}
+
+void r_particles_set_subtex(r_particles* particles, r_sheet* sheet,
+                            uint32_t subtex) {
+  if (!particles)
+    return;
+
+  particles->sheet         = sheet;
+  particles->render.subtex = subtex;
+}
+
+void r_particles_destroy(r_particles* particles) {
+  free(particles->list);
+
+  if (particles->calculate) {
+    free(particles->colors);
+    free(particles->coords);
+    free(particles->mats);
+  }
+
+  particles->capacity = 0;
+  particles->count    = 0;
+}
+
+static void r_particles_render(r_ctx* ctx, r_shader shader, r_sheet* sheet,
+                               int8_t type, uint32_t count, mat4x4* mats,
+                               vec4* colors, vec4* coords) {
+  r_camera* camera = r_ctx_draw_camera(ctx);
+
+  r_shader_bind(shader);
+  if ((type == PARTICLE_ANIMATED || type == PARTICLE_TEXTURED) && sheet) {
+    r_tex_bind(sheet->id);
+    r_set_uniformi(shader, "use_tex", 1);
+  } else {
+    r_set_uniformi(shader, "use_tex", 0);
+  }
+
+  r_set_m4(shader, "view", camera->view);
+  r_set_m4(shader, "projection", camera->projection);
+
+  r_set_v4x(shader, count, "coords", coords);
+  r_set_v4x(shader, count, "colors", colors);
+  r_set_m4x(shader, count, "mats", mats);
+
+  glBindVertexArray(ctx->default_quad.vao);
+  glBindBuffer(GL_ARRAY_BUFFER, ctx->default_quad.vbo);
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ctx->default_quad.vboi);
+
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 20, 0);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 20, 12);
+
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+
+  glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0, count);
+
+  glDisableVertexAttribArray(0);
+  glDisableVertexAttribArray(1);
+
+  glBindVertexArray(0);
+  r_tex_bind(0);
+  r_shader_bind(0);
+}
+
+/* Clear out the uniforms for the next draw call */
+static void r_particles_clear(r_particles* particles) {
+  memset(particles->mats, 0, sizeof(mat4x4) * particles->uniform_count);
+  memset(particles->colors, 0, sizeof(vec4) * particles->uniform_count);
+  memset(particles->coords, 0, sizeof(vec4) * particles->uniform_count);
+  particles->uniform_count = 0;
+}
+
+static void r_particles_flush(r_ctx* ctx, r_particles* particles,
+                              r_shader shader) {
+  r_particles_render(ctx, shader, particles->sheet, particles->type,
+                     particles->uniform_count, particles->mats,
+                     particles->colors, particles->coords);
+  r_particles_clear(particles);
+}
+
+/* Calculate the uniforms for a single (live) particle */
+static void r_particle_calc(r_particles* particles, r_particle* particle,
+                            mat4x4 mat, vec4 color, vec4 coords) {
+  mat4x4_identity(mat);
+  mat4x4_translate(mat, particle->position[0], particle->position[1],
+                   particle->layer * ASTERA_RENDER_LAYER_MOD);
+  mat4x4_scale_aniso(mat, mat, particle->size[0], particle->size[1], 1.f);
+  mat4x4_rotate_z(mat, mat, particle->rotation);
+
+  vec4_dup(color, particle->color);
+
+  if (particles->sheet && (particles->type == PARTICLE_TEXTURED ||
+                           particles->type == PARTICLE_ANIMATED)) {
+    vec4_dup(coords, particles->sheet->subtexs[particle->frame].coords);
+  }
+}
+
+/* Record the particle system's uniforms into the command list */
+static void r_particles_record(r_ctx* ctx, r_particles* particles,
+                               r_shader shader) {
+  uint32_t count = 0;
+
+  if (particles->calculate) {
+    for (uint32_t i = 0; i < particles->capacity; ++i) {
+      if (particles->list[i].life > 0.f) {
+        ++count;
+      }
+    }
+  } else {
+    count = particles->uniform_count;
+  }
+
+  if (!count) {
+    return;
+  }
+
+  r_cmd_camera_sync(ctx);
+
+  uint32_t size = sizeof(r_cmd_particles) +
+                  (sizeof(mat4x4) + sizeof(vec4) * 2) * count;
+
+  r_cmd_particles* cmd = r_cmd_rec(ctx, R_CMD_PARTICLES, size);
+  if (!cmd) {
+    return;
+  }
+
+  cmd->shader      = shader;
+  cmd->sheet       = particles->sheet;
+  cmd->type        = particles->type;
+  cmd->uniform_cap = particles->uniform_cap;
+  cmd->count       = count;
+
+  mat4x4* mats   = (mat4x4*)(cmd + 1);
+  vec4*   colors = (vec4*)(mats + count);
+  vec4*   coords = colors + count;
+
+  if (particles->calculate) {
+    memset(coords, 0, sizeof(vec4) * count);
+
+    uint32_t index = 0;
+    for (uint32_t i = 0; i < particles->capacity; ++i) {
+      r_particle* particle = &particles->list[i];
+
+      if (particle->life > 0.f) {
+        r_particle_calc(particles, particle, mats[index], colors[index],
+                        coords[index]);
+        ++index;
+      }
+    }
+  } else {
+    memcpy(mats, particles->mats, sizeof(mat4x4) * count);
+    memcpy(colors, particles->colors, sizeof(vec4) * count);
+    memcpy(coords, particles->coords, sizeof(vec4) * count);
+    r_particles_clear(particles);
+  }
+}
+
+void r_particles_draw(r_ctx* ctx, r_particles* particles, r_shader shader) {
+  if (r_ctx_recording(ctx)) {
+    r_particles_record(ctx, particles, shader);
+    return;
+  }
+
+  if (particles->calculate) {
+    for (uint32_t i = 0; i < particles->capacity; ++i) {
+      r_particle* particle = &particles->list[i];
+
+      if (particle->life > 0.f) {
+        uint32_t index = particles->uniform_count;
+        r_particle_calc(particles, particle, particles->mats[index],
+                        particles->colors[index], particles->coords[index]);
+
+        ++particles->uniform_count;
+      }
+
+      if (particles->uniform_count == particles->uniform_cap) {
+        r_particles_flush(ctx, particles, shader);
+      }
+    }
+
+    if (particles->uniform_count != 0) {
+      r_particles_flush(ctx, particles, shader);
+    }
+  } else {
+    r_particles_flush(ctx, particles, shader);
+  }
+}
+
+void r_particles_set_spawner(r_particles* system, r_particle_spawner spawner) {
+  system->use_spawner  = 1;
+  system->spawner_func = spawner;
+}
+
+void r_particles_set_animator(r_particles*        system,
+                              r_particle_animator animator) {
+  system->use_animator  = 1;
+  system->animator_func = animator;
+}
+
+void r_particles_remove_spawner(r_particles* system) {
+  system->use_spawner  = 0;
+  system->spawner_func = 0;
+}
+
+void r_particles_remove_animator(r_particles* system) {
+  system->use_animator  = 0;
+  system->animator_func = 0;
+}
+
+void r_sprite_draw(r_ctx* ctx, r_sprite* sprite) {
+  if (!sprite->visible) {
+    return;
+  }
+
+  vec4 coords;
+  r_sprite_get_coords(ctx, sprite, coords);
+
+  if (ctx->pick.cell_size) {
+    r_pick_add(ctx, sprite);
+  }
+
+  if (r_ctx_recording(ctx)) {
+    r_cmd_camera_sync(ctx);
+
+    r_cmd_sprite* cmd = r_cmd_rec(ctx, R_CMD_SPRITE, sizeof(r_cmd_sprite));
+    if (cmd) {
+      cmd->shader = sprite->shader;
+      cmd->sheet  = sprite->sheet;
+      mat4x4_dup(cmd->model, sprite->model);
+      vec4_dup(cmd->color, sprite->color);
+      vec4_dup(cmd->coords, coords);
+      cmd->flip_x = sprite->flip_x;
+      cmd->flip_y = sprite->flip_y;
+      cmd->layer  = sprite->layer;
+      cmd->opaque = sprite->opaque != 0;
+    }
+    return;
+  }
+
+  r_batch_submit(ctx, sprite->sheet, sprite->shader, sprite->model,
+                 sprite->color, coords, sprite->flip_x, sprite->flip_y,
+                 sprite->layer, sprite->opaque != 0);
+}
+
+/* Execute all of the commands in a list on the calling (GL) thread */
+static void r_cmd_exec(r_ctx* ctx, r_cmd_list* list) {
+  uint32_t offset = 0;
+
+  ctx->executing = 1;
+
+  while (offset < list->size) {
+    r_cmd* cmd     = (r_cmd*)(list->data + offset);
+    void*  payload = (void*)(cmd + 1);
+
+    switch (cmd->type) {
+      case R_CMD_NONE:
+        break;
+      case R_CMD_CAMERA: {
+        r_cmd_camera* camera = (r_cmd_camera*)payload;
+        mat4x4_dup(ctx->exec_camera.view, camera->view);
+        mat4x4_dup(ctx->exec_camera.projection, camera->projection);
+      } break;
+      case R_CMD_CLEAR:
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        break;
+      case R_CMD_CLEAR_COLOR: {
+        r_cmd_color* color = (r_cmd_color*)payload;
+        glClearColor(color->color[0], color->color[1], color->color[2],
+                     color->color[3]);
+      } break;
+      case R_CMD_VIEWPORT: {
+        r_cmd_viewport* viewport = (r_cmd_viewport*)payload;
+        glViewport(0, 0, viewport->width, viewport->height);
+      } break;
+      case R_CMD_FBO_BIND: {
+        r_cmd_fbo* fbo = (r_cmd_fbo*)payload;
+        glBindFramebuffer(GL_FRAMEBUFFER, fbo->fbo.fbo);
+      } break;
+      case R_CMD_FBO_DRAW: {
+        r_cmd_fbo* fbo = (r_cmd_fbo*)payload;
+        r_framebuffer_render(fbo->fbo, fbo->gamma);
+      } break;
+      case R_CMD_SPRITE: {
+        r_cmd_sprite* sprite = (r_cmd_sprite*)payload;
+        r_batch_submit(ctx, sprite->sheet, sprite->shader, sprite->model,
+                       sprite->color, sprite->coords, sprite->flip_x,
+                       sprite->flip_y, sprite->layer, sprite->opaque);
+      } break;
+      case R_CMD_BAKED: {
+        r_cmd_baked* baked = (r_cmd_baked*)payload;
+        r_baked_sheet_render(ctx, baked->shader, &baked->sheet);
+      } break;
+      case R_CMD_PARTICLES: {
+        r_cmd_particles* particles = (r_cmd_particles*)payload;
+
+        uint32_t count = particles->count;
+        uint32_t cap =
+            (particles->uniform_cap) ? particles->uniform_cap : count;
+
+        mat4x4* mats   = (mat4x4*)(particles + 1);
+        vec4*   colors = (vec4*)(mats + count);
+        vec4*   coords = colors + count;
+
+        for (uint32_t i = 0; i < count; i += cap) {
+          uint32_t chunk = (count - i < cap) ? count - i : cap;
+          r_particles_render(ctx, particles->shader, particles->sheet,
+                             particles->type, chunk, &mats[i], &colors[i],
+                             &coords[i]);
+        }
+      } break;
+      case R_CMD_FLUSH:
+        r_batch_draw_all(ctx);
+        break;
+      case R_CMD_LIGHTS: {
+        r_cmd_lights* lights = (r_cmd_lights*)payload;
+        r_lights_render(ctx, (r_light*)(lights + 1), lights->count,
+                        lights->ambient);
+      } break;
+      case R_CMD_READBACK: {
+        r_cmd_readback* readback = (r_cmd_readback*)payload;
+        r_readback_read(ctx, readback->fbo, readback->width, readback->height,
+                        readback->func, readback->data);
+      } break;
+      case R_CMD_BAKED_PACK: {
+        r_cmd_baked_pack* pack = (r_cmd_baked_pack*)payload;
+        r_baked_pack_render(ctx, pack->shader, pack->pack,
+                            (pack->all) ? 0 : (uint32_t*)(pack + 1),
+                            pack->count);
+      } break;
+      case R_CMD_IM: {
+        r_cmd_im*  im    = (r_cmd_im*)payload;
+        r_im_vert* verts = (r_im_vert*)(im + 1);
+        r_im_render(ctx, verts, im->tri_count, verts + im->tri_count,
+                    im->line_count);
+      } break;
+      default:
+        ASTERA_DBG("r_cmd_exec: unknown command type %i.\n", cmd->type);
+        break;
+    }
+
+    offset += sizeof(r_cmd) + cmd->size;
+  }
+
+  ctx->executing = 0;
+}
+
+/* Check if a resource has been written to the capture, marks it if not */
+static uint8_t r_capture_seen(r_ctx* ctx, uint32_t type, uint32_t id) {
+  uint64_t key = ((uint64_t)type << 32) | id;
+
+  for (uint32_t i = 0; i < ctx->capture_key_count; ++i) {
+    if (ctx->capture_keys[i] == key) {
+      return 1;
+    }
+  }
+
+  if (ctx->capture_key_count == ctx->capture_key_capacity) {
+    uint32_t capacity =
+        (ctx->capture_key_capacity) ? ctx->capture_key_capacity * 2 : 32;
+    uint64_t* keys =
+        (uint64_t*)realloc(ctx->capture_keys, sizeof(uint64_t) * capacity);
+    if (!keys) {
+      ASTERA_DBG("r_capture_seen: unable to grow resource keys.\n");
+      return 1;
+    }
+
+    ctx->capture_keys         = keys;
+    ctx->capture_key_capacity = capacity;
+  }
+
+  ctx->capture_keys[ctx->capture_key_count] = key;
+  ++ctx->capture_key_count;
+  return 0;
+}
+
+static void r_capture_write(r_ctx* ctx, uint32_t type, const void* data,
+                            uint32_t size, const void* extra,
+                            uint32_t extra_size) {
+  r_cap_chunk chunk = (r_cap_chunk){type, size + extra_size};
+  fwrite(&chunk, sizeof(r_cap_chunk), 1, ctx->capture);
+  fwrite(data, size, 1, ctx->capture);
+
+  if (extra && extra_size) {
+    fwrite(extra, extra_size, 1, ctx->capture);
+  }
+}
+
+static void r_capture_tex(r_ctx* ctx, uint32_t tex) {
+  if (!tex || r_capture_seen(ctx, R_CAP_TEX, tex)) {
+    return;
+  }
+
+  int width = 0, height = 0;
+  glBindTexture(GL_TEXTURE_2D, tex);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+  glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+
+  uint32_t       size   = (uint32_t)(width * height * 4);
+  unsigned char* pixels = (unsigned char*)malloc(size);
+  if (!pixels) {
+    ASTERA_DBG("r_capture_tex: unable to allocate %i bytes.\n", size);
+    glBindTexture(GL_TEXTURE_2D, 0);
+    return;
+  }
+
+  glGetTexImage(GL_TEXTURE_2D, 0, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+  glBindTexture(GL_TEXTURE_2D, 0);
+
+  r_cap_tex info = (r_cap_tex){tex, (uint32_t)width, (uint32_t)height};
+  r_capture_write(ctx, R_CAP_TEX, &info, sizeof(r_cap_tex), pixels, size);
+
+  free(pixels);
+}
+
+static void r_capture_shader(r_ctx* ctx, r_shader shader) {
+  if (!shader || r_capture_seen(ctx, R_CAP_SHADER, shader)) {
+    return;
+  }
+
+  r_cap_shader info = (r_cap_shader){0};
+  info.id           = shader;
+
+  for (uint32_t i = 0; i < ctx->shader_count; ++i) {
+    if (ctx->shaders[i] == shader) {
+      strncpy(info.name, ctx->shader_names[i], sizeof(info.name) - 1);
+      break;
+    }
+  }
+
+  // Uncached shaders can only be matched up by their id
+  if (!info.name[0]) {
+    snprintf(info.name, sizeof(info.name), "shader_%u", shader);
+  }
+
+  r_capture_write(ctx, R_CAP_SHADER, &info, sizeof(r_cap_shader), 0, 0);
+}
+
+static void r_capture_baked(r_ctx* ctx, r_baked_sheet* sheet) {
+  if (r_capture_seen(ctx, R_CAP_BAKED, sheet->vao)) {
+    return;
+  }
+
+  uint32_t vert_size = sizeof(float) * 20 * sheet->quad_count;
+  uint32_t ind_size  = sizeof(uint16_t) * 6 * sheet->quad_count;
+
+  unsigned char* data = (unsigned char*)malloc(vert_size + ind_size);
+  if (!data) {
+    ASTERA_DBG("r_capture_baked: unable to allocate buffer copy.\n");
+    return;
+  }
+
+  glBindVertexArray(0);
+  glBindBuffer(GL_ARRAY_BUFFER, sheet->vbo);
+  glGetBufferSubData(GL_ARRAY_BUFFER, 0, vert_size, data);
+  glBindBuffer(GL_ARRAY_BUFFER, sheet->vboi);
+  glGetBufferSubData(GL_ARRAY_BUFFER, 0, ind_size, data + vert_size);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  r_cap_baked info = (r_cap_baked){sheet->vao, sheet->quad_count};
+  r_capture_write(ctx, R_CAP_BAKED, &info, sizeof(r_cap_baked), data,
+                  vert_size + ind_size);
+
+  free(data);
+}
+
+static void r_capture_fbo(r_ctx* ctx, r_framebuffer* fbo) {
+  if (!fbo->fbo || r_capture_seen(ctx, R_CAP_FBO, fbo->fbo)) {
+    return;
+  }
+
+  r_capture_shader(ctx, fbo->shader);
+
+  r_cap_fbo info = (r_cap_fbo){fbo->fbo, fbo->width, fbo->height, fbo->shader};
+  r_capture_write(ctx, R_CAP_FBO, &info, sizeof(r_cap_fbo), 0, 0);
+}
+
+/* Finish the capture's header & close the file */
+static void r_capture_close(r_ctx* ctx) {
+  if (!ctx->capture) {
+    return;
+  }
+
+  r_cap_header header = (r_cap_header){
+      .magic    = {'A', 'C', 'A', 'P'},
+      .version  = R_CAP_VERSION,
+      .ptr_size = sizeof(void*),
+      .width    = ctx->window.params.width,
+      .height   = ctx->window.params.height,
+      .frames   = ctx->capture_count,
+  };
+
+  fseek(ctx->capture, 0, SEEK_SET);
+  fwrite(&header, sizeof(r_cap_header), 1, ctx->capture);
+  fclose(ctx->capture);
+
+  ctx->capture           = 0;
+  ctx->capture_key_count = 0;
+}
+
+/* Write an executed frame to the capture, swapping pointers for resource ids
+ * NOTE: Called on the thread owning the GL context (to read back resources) */
+static void r_capture_frame(r_ctx* ctx, r_cmd_list* list) {
+  r_cmd_list* scratch = &ctx->capture_scratch;
+  scratch->size       = 0;
+
+  if (!r_cmd_push(scratch, R_CMD_NONE, list->size)) {
+    return;
+  }
+
+  // Skip the placeholder header, the frame is copied in whole
+  unsigned char* frame = scratch->data + sizeof(r_cmd);
+  memcpy(frame, list->data, list->size);
+
+  uint32_t offset = 0;
+  while (offset < list->size) {
+    r_cmd* cmd     = (r_cmd*)(frame + offset);
+    void*  payload = (void*)(cmd + 1);
+
+    switch (cmd->type) {
+      case R_CMD_SPRITE: {
+        r_cmd_sprite* sprite = (r_cmd_sprite*)payload;
+        r_capture_shader(ctx, sprite->shader);
+        r_capture_tex(ctx, sprite->sheet->id);
+        sprite->sheet = (r_sheet*)(uintptr_t)sprite->sheet->id;
+      } break;
+      case R_CMD_BAKED: {
+        r_cmd_baked* baked = (r_cmd_baked*)payload;
+        r_capture_shader(ctx, baked->shader);
+        r_capture_tex(ctx, baked->sheet.sheet->id);
+        r_capture_baked(ctx, &baked->sheet);
+        baked->sheet.sheet = (r_sheet*)(uintptr_t)baked->sheet.sheet->id;
+      } break;
+      case R_CMD_PARTICLES: {
+        r_cmd_particles* particles = (r_cmd_particles*)payload;
+        r_capture_shader(ctx, particles->shader);
+        if (particles->sheet) {
+          r_capture_tex(ctx, particles->sheet->id);
+          particles->sheet = (r_sheet*)(uintptr_t)particles->sheet->id;
+        }
+      } break;
+      case R_CMD_FBO_BIND:
+      case R_CMD_FBO_DRAW: {
+        r_cmd_fbo* fbo = (r_cmd_fbo*)payload;
+        r_capture_fbo(ctx, &fbo->fbo);
+      } break;
+      case R_CMD_BAKED_PACK:
+      case R_CMD_READBACK:
+        // Packs & callbacks aren't stored in captures, so they're left out
+        cmd->type = R_CMD_NONE;
+        break;
+      default:
+        break;
+    }
+
+    offset += sizeof(r_cmd) + cmd->size;
+  }
+
+  r_capture_write(ctx, R_CAP_FRAME, &ctx->capture_count, sizeof(uint32_t),
+                  frame, list->size);
+  ++ctx->capture_count;
+
+  if (ctx->capture_frames && ctx->capture_count >= ctx->capture_frames) {
+#if !defined(ASTERA_NO_THREADS)
+    // r_ctx_is_capturing reads the file under the lock from the game thread
+    if (ctx->thread) {
+      s_mutex_lock(ctx->cmd_lock);
+      r_capture_close(ctx);
+      s_mutex_unlock(ctx->cmd_lock);
+      return;
+    }
+#endif
+
+    r_capture_close(ctx);
+  }
+}
+
+#if !defined(ASTERA_NO_THREADS)
+static void r_ctx_thread_main(void* data) {
+  r_ctx* ctx = (r_ctx*)data;
+
+  glfwMakeContextCurrent(ctx->window.glfw);
+
+  s_mutex_lock(ctx->cmd_lock);
+  for (;;) {
+    while (!ctx->cmd_pending && !ctx->cmd_quit) {
+      s_cond_wait(ctx->cmd_cond, ctx->cmd_lock);
+    }
+
+    // Always finish a submitted frame before quitting
+    if (!ctx->cmd_pending) {
+      break;
+    }
+
+    r_cmd_list* list = &ctx->cmd_lists[ctx->cmd_record ^ 1];
+    ctx->cmd_pending = 0;
+    ctx->cmd_busy    = 1;
+    s_mutex_unlock(ctx->cmd_lock);
+
+    r_cmd_exec(ctx, list);
+
+    if (ctx->capture) {
+      r_capture_frame(ctx, list);
+    }
+
+    r_readback_poll(ctx, 0);
+    r_stream_advance(&ctx->stream);
+    glfwSwapBuffers(ctx->window.glfw);
+    list->size = 0;
+
+    s_mutex_lock(ctx->cmd_lock);
+    ctx->cmd_busy = 0;
+    s_cond_broadcast(ctx->cmd_cond);
+  }
+  s_mutex_unlock(ctx->cmd_lock);
+
+  glfwMakeContextCurrent(NULL);
+}
+
+/* Wait for the render thread to finish its work, returns with the lock held */
+static void r_ctx_thread_idle(r_ctx* ctx) {
+  s_mutex_lock(ctx->cmd_lock);
+  while (ctx->cmd_pending || ctx->cmd_busy) {
+    s_cond_wait(ctx->cmd_cond, ctx->cmd_lock);
+  }
+}
+
+/* Hand the recorded frame to the render thread & start recording the next */
+static void r_ctx_thread_submit(r_ctx* ctx) {
+  r_ctx_thread_idle(ctx);
+
+  ctx->cmd_record ^= 1;
+  ctx->cmd_pending = 1;
+  s_cond_broadcast(ctx->cmd_cond);
+  s_mutex_unlock(ctx->cmd_lock);
+
+  // Each frame's list starts out with the camera state
+  ctx->rec_camera_valid = 0;
+}
+#endif
+
+uint8_t r_ctx_thread_start(r_ctx* ctx) {
+#if defined(ASTERA_NO_THREADS)
+  (void)ctx;
+  ASTERA_DBG("r_ctx_thread_start: built without thread support.\n");
+  return 0;
+#else
+  if (!ctx) {
+    ASTERA_DBG("r_ctx_thread_start: no context passed.\n");
+    return 0;
+  }
+
+  if (ctx->thread) {
+    ASTERA_DBG("r_ctx_thread_start: render thread already running.\n");
+    return 1;
+  }
+
+  ctx->cmd_lock = s_mutex_create();
+  ctx->cmd_cond = s_cond_create();
+
+  if (!ctx->cmd_lock || !ctx->cmd_cond) {
+    ASTERA_DBG("r_ctx_thread_start: unable to create sync primitives.\n");
+    s_mutex_destroy(ctx->cmd_lock);
+    s_cond_destroy(ctx->cmd_cond);
+    ctx->cmd_lock = 0;
+    ctx->cmd_cond = 0;
+    return 0;
+  }
+
+  ctx->cmd_record        = 0;
+  ctx->cmd_pending       = 0;
+  ctx->cmd_busy          = 0;
+  ctx->cmd_quit          = 0;
+  ctx->rec_camera_valid  = 0;
+  ctx->cmd_lists[0].size = 0;
+  ctx->cmd_lists[1].size = 0;
+
+  // The GL context can only be current on one thread at a time
+  glfwMakeContextCurrent(NULL);
+
+  ctx->thread = s_thread_create(r_ctx_thread_main, ctx);
+  if (!ctx->thread) {
+    ASTERA_DBG("r_ctx_thread_start: unable to create render thread.\n");
+    glfwMakeContextCurrent(ctx->window.glfw);
+    s_mutex_destroy(ctx->cmd_lock);
+    s_cond_destroy(ctx->cmd_cond);
+    ctx->cmd_lock = 0;
+    ctx->cmd_cond = 0;
+    return 0;
+  }
 
-  // TODO Test binding requirements
-  glBindBuffer(GL_ARRAY_BUFFER, sheet->vbo);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sheet->vboi);
+  _r_rec_ctx = ctx;
 
-  glEnableVertexAttribArray(0);
-  glEnableVertexAttribArray(1);
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 20, 0);
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 20, 12);
+  return 1;
+#endif
+}
 
-  glDrawElements(GL_TRIANGLES, sheet->quad_count * 2, GL_UNSIGNED_SHORT, 0);
+void r_ctx_thread_stop(r_ctx* ctx) {
+#if !defined(ASTERA_NO_THREADS)
+  if (!ctx || !ctx->thread) {
+    return;
+  }
 
-  glDisableVertexAttribArray(0);
-  glDisableVertexAttribArray(1);
+  s_mutex_lock(ctx->cmd_lock);
+  ctx->cmd_quit = 1;
+  s_cond_broadcast(ctx->cmd_cond);
+  s_mutex_unlock(ctx->cmd_lock);
 
-  glBindVertexArray(0);
-  r_tex_bind(0);
-  r_shader_bind(0);
-}
+  s_thread_join(ctx->thread);
+  ctx->thread = 0;
 
-void r_baked_sheet_destroy(r_baked_sheet* sheet) {
-  glDeleteBuffers(1, &sheet->vbo);
-  glDeleteBuffers(1, &sheet->vto);
-  glDeleteBuffers(1, &sheet->vboi);
-  glDeleteVertexArrays(1, &sheet->vao);
-}
+  s_mutex_destroy(ctx->cmd_lock);
+  s_cond_destroy(ctx->cmd_cond);
+  ctx->cmd_lock = 0;
+  ctx->cmd_cond = 0;
 
-r_particles r_particles_create(uint32_t emit_rate, float particle_life,
-                               uint32_t particle_capacity, uint32_t emit_count,
-                               int8_t particle_type, int8_t calculate,
-                               uint16_t uniform_cap) {
-  r_particles particles = (r_particles){0};
+  // Anything recorded but not submitted is dropped
+  ctx->cmd_lists[ctx->cmd_record].size = 0;
 
-  if (!particle_capacity) {
-    return particles;
+  // Still recording if it's being captured
+  if (_r_rec_ctx == ctx && !ctx->capture) {
+    _r_rec_ctx = 0;
   }
 
-  particles.time       = 0;
-  particles.spawn_time = 0;
-  particles.spawn_rate = MS_TO_SEC / emit_rate;
+  glfwMakeContextCurrent(ctx->window.glfw);
+#else
+  (void)ctx;
+#endif
+}
 
-  particles.calculate      = calculate;
-  particles.max_emission   = emit_count;
-  particles.emission_count = 0;
+uint8_t r_ctx_is_threaded(r_ctx* ctx) {
+#if !defined(ASTERA_NO_THREADS)
+  return ctx && ctx->thread;
+#else
+  (void)ctx;
+  return 0;
+#endif
+}
 
-  if (calculate) {
-    particles.mats   = (mat4x4*)malloc(sizeof(mat4x4) * uniform_cap);
-    particles.colors = (vec4*)malloc(sizeof(vec4) * uniform_cap);
-    particles.coords = (vec4*)malloc(sizeof(vec4) * uniform_cap);
+uint8_t r_ctx_capture_start(r_ctx* ctx, const char* path, uint32_t frames) {
+  if (!ctx || !path) {
+    ASTERA_DBG("r_ctx_capture_start: incomplete arguments passed.\n");
+    return 0;
   }
 
-  particles.uniform_cap = uniform_cap;
-
-  particles.particle_life = particle_life;
+  FILE* f = fopen(path, "wb");
+  if (!f) {
+    ASTERA_DBG("r_ctx_capture_start: unable to open %s.\n", path);
+    return 0;
+  }
 
-  particles.type = particle_type;
+  // Reserve space for the header, it's filled out on close
+  r_cap_header header = (r_cap_header){0};
+  fwrite(&header, sizeof(r_cap_header), 1, f);
 
-  particles.particle_size[0] = 1.f;
-  particles.particle_size[1] = 1.f;
+#if !defined(ASTERA_NO_THREADS)
+  if (ctx->thread) {
+    r_ctx_thread_idle(ctx);
+  }
+#endif
 
-  particles.position[0] = 0.f;
-  particles.position[1] = 0.f;
+  r_capture_close(ctx);
 
-  particles.size[0] = 0.f;
-  particles.size[1] = 0.f;
+  ctx->capture           = f;
+  ctx->capture_frames    = frames;
+  ctx->capture_count     = 0;
+  ctx->capture_key_count = 0;
+  ctx->rec_camera_valid  = 0;
 
-  particles.list = (r_particle*)malloc(sizeof(r_particle) * particle_capacity);
-  memset(particles.list, 0, sizeof(r_particle) * particle_capacity);
+  // Framebuffer binds & clears don't pass a context, they record into this
+  _r_rec_ctx = ctx;
 
-  particles.capacity = particle_capacity;
-  particles.count    = 0;
+#if !defined(ASTERA_NO_THREADS)
+  if (ctx->thread) {
+    s_mutex_unlock(ctx->cmd_lock);
+  }
+#endif
 
-  return particles;
+  return 1;
 }
 
-void r_particles_set_particle(r_particles* system, vec4 color,
-                              float particle_life, vec2 particle_size,
-                              vec2 particle_velocity) {
-  if (!system)
+void r_ctx_capture_stop(r_ctx* ctx) {
+  if (!ctx) {
     return;
-
-  if (color) {
-    vec4_dup(system->color, color);
   }
 
-  if (particle_life != 0.f) {
-    system->particle_life = particle_life;
+#if !defined(ASTERA_NO_THREADS)
+  if (ctx->thread) {
+    r_ctx_thread_idle(ctx);
+    r_capture_close(ctx);
+    s_mutex_unlock(ctx->cmd_lock);
+    return;
   }
+#endif
 
-  if (particle_size) {
-    vec2_dup(system->particle_size, particle_size);
+  if (!ctx->capture) {
+    return;
   }
 
-  if (particle_velocity) {
-    vec2_dup(system->particle_velocity, particle_velocity);
+  r_capture_close(ctx);
+
+  if (_r_rec_ctx == ctx) {
+    _r_rec_ctx = 0;
   }
+
+  // Issue anything recorded this frame since it's no longer being captured
+  r_cmd_list* list = &ctx->cmd_lists[ctx->cmd_record];
+  r_cmd_exec(ctx, list);
+  list->size = 0;
 }
 
-void r_particles_update(r_particles* system, time_s delta) {
-  system->time += delta;
-  system->spawn_time += delta;
+uint8_t r_ctx_is_capturing(r_ctx* ctx) {
+  uint8_t capturing = 0;
 
-  int32_t to_spawn = (int32_t)system->spawn_time / system->spawn_rate;
+#if !defined(ASTERA_NO_THREADS)
+  if (ctx->thread) {
+    s_mutex_lock(ctx->cmd_lock);
+    capturing = ctx->capture != 0;
+    s_mutex_unlock(ctx->cmd_lock);
+    return capturing;
+  }
+#endif
 
-  if (system->count + to_spawn >= system->capacity) {
-    to_spawn = system->capacity - system->count;
+  capturing = ctx->capture != 0;
+  return capturing;
+}
+
+uint8_t r_capture_get_size(unsigned char* data, uint32_t length,
+                           uint32_t* width, uint32_t* height) {
+  if (!data || length < sizeof(r_cap_header)) {
+    ASTERA_DBG("r_capture_get_size: invalid capture data.\n");
+    return 0;
   }
 
-  system->spawn_time -= system->spawn_rate * to_spawn;
+  r_cap_header* header = (r_cap_header*)data;
+  if (memcmp(header->magic, "ACAP", 4) != 0) {
+    ASTERA_DBG("r_capture_get_size: invalid capture header.\n");
+    return 0;
+  }
 
-  for (int i = 0; i < to_spawn; ++i) {
-    r_particle* open = 0;
+  if (width)
+    *width = header->width;
 
-    for (uint32_t j = 0; j < system->capacity; ++j) {
-      if (system->list[j].life <= 0.f) {
-        open = &system->list[j];
-        break;
-      }
-    }
+  if (height)
+    *height = header->height;
 
-    if (!open) {
-      break;
-    }
+  return 1;
+}
 
-    open->life = system->particle_life;
-    vec2_dup(open->size, system->particle_size);
-    vec2_dup(open->velocity, system->particle_velocity);
-    vec4_dup(open->color, system->color);
+static r_sheet* r_capture_find_sheet(r_capture* capture, r_sheet* key) {
+  for (uint32_t i = 0; i < capture->sheet_count; ++i) {
+    if (capture->sheet_keys[i] == (uint32_t)(uintptr_t)key) {
+      return &capture->sheets[i];
+    }
+  }
+  return 0;
+}
 
-    if (system->use_spawner) {
-      system->spawner_func(system, open);
-    } else {
-      open->position[0] = fmod(rand(), system->size[0]);
-      open->position[1] = fmod(rand(), system->size[1]);
+static r_shader r_capture_find_shader(r_capture* capture, r_shader key) {
+  for (uint32_t i = 0; i < capture->shader_count; ++i) {
+    if (capture->shader_keys[i] == key) {
+      return capture->shaders[i];
+    }
+  }
+  return 0;
+}
 
-      open->layer = system->particle_layer;
+/* Check a captured command's payload holds everything it's read for */
+static uint8_t r_capture_cmd_valid(r_cmd* cmd, void* payload) {
+  uint64_t size = cmd->size;
+
+  switch (cmd->type) {
+    case R_CMD_NONE:
+    case R_CMD_CLEAR:
+    case R_CMD_FLUSH:
+      return 1;
+    case R_CMD_CAMERA:
+      return size >= sizeof(r_cmd_camera);
+    case R_CMD_CLEAR_COLOR:
+      return size >= sizeof(r_cmd_color);
+    case R_CMD_VIEWPORT:
+      return size >= sizeof(r_cmd_viewport);
+    case R_CMD_FBO_BIND:
+    case R_CMD_FBO_DRAW:
+      return size >= sizeof(r_cmd_fbo);
+    case R_CMD_SPRITE:
+      return size >= sizeof(r_cmd_sprite);
+    case R_CMD_BAKED:
+      return size >= sizeof(r_cmd_baked);
+    case R_CMD_PARTICLES: {
+      if (size < sizeof(r_cmd_particles)) {
+        return 0;
+      }
 
-      if (system->type == PARTICLE_ANIMATED) {
-        open->frame = 0;
-      } else if (system->type == PARTICLE_TEXTURED) {
-        open->frame = system->render.subtex;
+      r_cmd_particles* particles = (r_cmd_particles*)payload;
+      return size >= sizeof(r_cmd_particles) +
+                         (uint64_t)particles->count *
+                             (sizeof(mat4x4) + sizeof(vec4) * 2);
+    }
+    case R_CMD_LIGHTS: {
+      if (size < sizeof(r_cmd_lights)) {
+        return 0;
       }
+
+      r_cmd_lights* lights = (r_cmd_lights*)payload;
+      return size >= sizeof(r_cmd_lights) +
+                         (uint64_t)lights->count * sizeof(r_light);
     }
+    case R_CMD_IM: {
+      if (size < sizeof(r_cmd_im)) {
+        return 0;
+      }
 
-    ++system->count;
+      r_cmd_im* im = (r_cmd_im*)payload;
+      return size >= sizeof(r_cmd_im) +
+                         ((uint64_t)im->tri_count + im->line_count) *
+                             sizeof(r_im_vert);
+    }
+    default:
+      // Packs & readbacks aren't stored in captures, anything else is unknown
+      return 0;
   }
+}
 
-  float    frame_time  = 0.f;
-  uint32_t frame_count = 0;
-  uint8_t  anim_loop;
-  if (system->type == PARTICLE_ANIMATED) {
-    frame_time  = MS_TO_SEC / system->render.anim.rate;
-    frame_count = system->render.anim.count;
-    anim_loop   = system->render.anim.loop;
-  }
+/* Resolve a captured frame's resource ids to the recreated resources */
+static void r_capture_resolve(r_capture* capture, r_cmd_list* list) {
+  uint32_t offset = 0;
 
-  // Update particles
-  for (uint32_t i = 0; i < system->capacity; ++i) {
-    r_particle* particle = &system->list[i];
-    if (particle->life > 0.f) {
-      particle->life -= delta;
-    } else {
-      continue;
+  while (offset < list->size) {
+    // A command running past the frame ends it
+    if (list->size - offset < sizeof(r_cmd)) {
+      list->size = offset;
+      break;
     }
 
-    if (particle->life <= 0.f) {
-      particle->life = 0.f;
-      --system->count;
-      // TODO Test if this causes any weird issues
-      continue;
-    }
+    r_cmd* cmd     = (r_cmd*)(list->data + offset);
+    void*  payload = (void*)(cmd + 1);
 
-    vec2 movement;
-    vec2_scale(movement, particle->velocity, delta);
-    vec2_add(particle->position, particle->position, movement);
+    if (cmd->size > list->size - offset - sizeof(r_cmd)) {
+      list->size = offset;
+      break;
+    }
 
-    if (system->use_animator) {
-      (*system->animator_func)(system, &system->list[i]);
-    } else if (system->type == PARTICLE_ANIMATED) {
-      float   life_span = system->particle_life - particle->life;
-      int32_t frame     = (int32_t)(life_span / frame_time);
+    if (!r_capture_cmd_valid(cmd, payload)) {
+      cmd->type = R_CMD_NONE;
+    }
 
-      if (frame > frame_count) {
-        if (anim_loop) {
-          frame = frame % frame_count;
-        } else {
-          frame = frame_count;
+    switch (cmd->type) {
+      case R_CMD_SPRITE: {
+        r_cmd_sprite* sprite = (r_cmd_sprite*)payload;
+        sprite->shader       = r_capture_find_shader(capture, sprite->shader);
+        sprite->sheet        = r_capture_find_sheet(capture, sprite->sheet);
+        if (!sprite->shader || !sprite->sheet) {
+          cmd->type = R_CMD_NONE;
+        }
+      } break;
+      case R_CMD_BAKED: {
+        r_cmd_baked* baked = (r_cmd_baked*)payload;
+        r_sheet*     sheet = r_capture_find_sheet(capture, baked->sheet.sheet);
+        uint32_t     vao   = baked->sheet.vao;
+
+        baked->shader = r_capture_find_shader(capture, baked->shader);
+        cmd->type     = R_CMD_NONE;
+
+        for (uint32_t i = 0; i < capture->baked_count; ++i) {
+          if (capture->baked_keys[i] == vao && sheet && baked->shader) {
+            r_baked_sheet* local    = &capture->baked[i];
+            baked->sheet.vao        = local->vao;
+            baked->sheet.vbo        = local->vbo;
+            baked->sheet.vboi       = local->vboi;
+            baked->sheet.quad_count = local->quad_count;
+            baked->sheet.sheet      = sheet;
+            cmd->type               = R_CMD_BAKED;
+            break;
+          }
+        }
+      } break;
+      case R_CMD_PARTICLES: {
+        r_cmd_particles* particles = (r_cmd_particles*)payload;
+        particles->shader = r_capture_find_shader(capture, particles->shader);
+        if (particles->sheet) {
+          particles->sheet = r_capture_find_sheet(capture, particles->sheet);
         }
-      }
 
-      particle->frame = frame;
+        if (!particles->shader) {
+          cmd->type = R_CMD_NONE;
+        }
+      } break;
+      case R_CMD_FBO_BIND:
+      case R_CMD_FBO_DRAW: {
+        r_cmd_fbo* fbo  = (r_cmd_fbo*)payload;
+        uint32_t   key  = fbo->fbo.fbo;
+        uint32_t   type = cmd->type;
+
+        if (key) {
+          cmd->type = R_CMD_NONE;
+          for (uint32_t i = 0; i < capture->fbo_count; ++i) {
+            if (capture->fbo_keys[i] == key) {
+              fbo->fbo  = capture->fbos[i];
+              cmd->type = type;
+              break;
+            }
+          }
+        }
+      } break;
+      default:
+        break;
     }
+
+    offset += sizeof(r_cmd) + cmd->size;
   }
 }
 
-void r_particles_set_anim(r_particles* particles, r_anim anim) {
-  if (!particles)
-    return;
+static uint32_t r_capture_tex_create(uint32_t width, uint32_t height,
+                                     const unsigned char* pixels) {
+  uint32_t id;
+  glGenTextures(1, &id);
+  glBindTexture(GL_TEXTURE_2D, id);
 
-  particles->sheet       = anim.sheet;
-  particles->render.anim = anim;
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+
+  glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, width, height, 0, GL_RGBA,
+               GL_UNSIGNED_BYTE, pixels);
+  r_res_track(R_RES_TEXTURE, id, width * height * 4, __func__);
+
+  glBindTexture(GL_TEXTURE_2D, 0);
+  return id;
 }
 
-void r_particles_set_subtex(r_particles* particles, r_sheet* sheet,
-                            uint32_t subtex) {
-  if (!particles)
-    return;
+static void r_capture_baked_create(r_baked_sheet* sheet, uint32_t quad_count,
+                                   const unsigned char* data) {
+  uint32_t vert_size = sizeof(float) * 20 * quad_count;
+  uint32_t ind_size  = sizeof(uint16_t) * 6 * quad_count;
 
-  particles->sheet         = sheet;
-  particles->render.subtex = subtex;
+  *sheet            = (r_baked_sheet){0};
+  sheet->quad_count = quad_count;
+
+  glGenVertexArrays(1, &sheet->vao);
+  glBindVertexArray(sheet->vao);
+
+  glGenBuffers(1, &sheet->vbo);
+  glGenBuffers(1, &sheet->vboi);
+
+  glBindBuffer(GL_ARRAY_BUFFER, sheet->vbo);
+  glBufferData(GL_ARRAY_BUFFER, vert_size, data, GL_STATIC_DRAW);
+
+  glEnableVertexAttribArray(0);
+  glEnableVertexAttribArray(1);
+  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 20, 0);
+  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 20, 12);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, sheet->vboi);
+  glBufferData(GL_ELEMENT_ARRAY_BUFFER, ind_size, data + vert_size,
+               GL_STATIC_DRAW);
+
+  glBindVertexArray(0);
+
+  r_res_track(R_RES_VAO, sheet->vao, 0, __func__);
+  r_res_track(R_RES_BUFFER, sheet->vbo, vert_size, __func__);
+  r_res_track(R_RES_BUFFER, sheet->vboi, ind_size, __func__);
 }
 
-void r_particles_destroy(r_particles* particles) {
-  free(particles->list);
+r_capture* r_capture_load(r_ctx* ctx, unsigned char* data, uint32_t length,
+                          r_capture_shader_loader loader, void* loader_data) {
+  if (!ctx || !data || length < sizeof(r_cap_header)) {
+    ASTERA_DBG("r_capture_load: incomplete arguments passed.\n");
+    return 0;
+  }
+
+  if (r_ctx_recording(ctx)) {
+    ASTERA_DBG("r_capture_load: unable to load while threaded / capturing.\n");
+    return 0;
+  }
+
+  r_cap_header header;
+  memcpy(&header, data, sizeof(r_cap_header));
+
+  if (memcmp(header.magic, "ACAP", 4) != 0 || header.version != R_CAP_VERSION) {
+    ASTERA_DBG("r_capture_load: invalid capture header.\n");
+    return 0;
+  }
+
+  if (header.ptr_size != sizeof(void*)) {
+    ASTERA_DBG("r_capture_load: capture recorded with %i byte pointers.\n",
+               header.ptr_size);
+    return 0;
+  }
+
+  r_capture* capture = (r_capture*)calloc(1, sizeof(r_capture));
+  if (!capture) {
+    ASTERA_DBG("r_capture_load: unable to allocate capture.\n");
+    return 0;
+  }
+
+  capture->width  = header.width;
+  capture->height = header.height;
+
+  // Count the chunks first so the resource arrays never move
+  uint32_t    counts[R_CAP_FRAME + 1] = {0};
+  uint32_t    offset                  = sizeof(r_cap_header);
+  r_cap_chunk chunk;
+
+  while (offset + sizeof(r_cap_chunk) <= length) {
+    memcpy(&chunk, data + offset, sizeof(r_cap_chunk));
+
+    if (chunk.size > length - offset - sizeof(r_cap_chunk)) {
+      ASTERA_DBG("r_capture_load: truncated capture.\n");
+      break;
+    }
+
+    if (chunk.type <= R_CAP_FRAME) {
+      ++counts[chunk.type];
+    }
 
-  if (particles->calculate) {
-    free(particles->colors);
-    free(particles->coords);
-    free(particles->mats);
+    offset += sizeof(r_cap_chunk) + chunk.size;
   }
 
-  particles->capacity = 0;
-  particles->count    = 0;
-}
-
-static void r_particles_render(r_ctx* ctx, r_particles* particles,
-                               r_shader shader) {
-  r_shader_bind(shader);
-  if ((particles->type == PARTICLE_ANIMATED ||
-       particles->type == PARTICLE_TEXTURED) &&
-      particles->sheet) {
-    r_tex_bind(particles->sheet->id);
-    r_set_uniformi(shader, "use_tex", 1);
-  } else {
-    r_set_uniformi(shader, "use_tex", 0);
+  capture->sheets = (r_sheet*)calloc(counts[R_CAP_TEX] + 1, sizeof(r_sheet));
+  capture->sheet_keys =
+      (uint32_t*)calloc(counts[R_CAP_TEX] + 1, sizeof(uint32_t));
+  capture->shaders =
+      (r_shader*)calloc(counts[R_CAP_SHADER] + 1, sizeof(r_shader));
+  capture->shader_keys =
+      (uint32_t*)calloc(counts[R_CAP_SHADER] + 1, sizeof(uint32_t));
+  capture->baked =
+      (r_baked_sheet*)calloc(counts[R_CAP_BAKED] + 1, sizeof(r_baked_sheet));
+  capture->baked_keys =
+      (uint32_t*)calloc(counts[R_CAP_BAKED] + 1, sizeof(uint32_t));
+  capture->fbos =
+      (r_framebuffer*)calloc(counts[R_CAP_FBO] + 1, sizeof(r_framebuffer));
+  capture->fbo_keys =
+      (uint32_t*)calloc(counts[R_CAP_FBO] + 1, sizeof(uint32_t));
+  capture->frames =
+      (r_cmd_list*)calloc(counts[R_CAP_FRAME] + 1, sizeof(r_cmd_list));
+
+  if (!capture->sheets || !capture->sheet_keys || !capture->shaders ||
+      !capture->shader_keys || !capture->baked || !capture->baked_keys ||
+      !capture->fbos || !capture->fbo_keys || !capture->frames) {
+    ASTERA_DBG("r_capture_load: unable to allocate resource tables.\n");
+    r_capture_destroy(capture);
+    return 0;
   }
 
-  r_set_m4(shader, "view", ctx->camera.view);
-  r_set_m4(shader, "projection", ctx->camera.projection);
+  offset = sizeof(r_cap_header);
+  while (offset + sizeof(r_cap_chunk) <= length) {
+    memcpy(&chunk, data + offset, sizeof(r_cap_chunk));
+    offset += sizeof(r_cap_chunk);
 
-  r_set_v4x(shader, particles->uniform_count, "coords", particles->coords);
-  r_set_v4x(shader, particles->uniform_count, "colors", particles->colors);
-  r_set_m4x(shader, particles->uniform_count, "mats", particles->mats);
+    if (chunk.size > length - offset) {
+      break;
+    }
 
-  glBindVertexArray(ctx->default_quad.vao);
-  glBindBuffer(GL_ARRAY_BUFFER, ctx->default_quad.vbo);
-  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ctx->default_quad.vboi);
+    unsigned char* chunk_data = data + offset;
+    offset += chunk.size;
 
-  glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 20, 0);
-  glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 20, 12);
+    switch (chunk.type) {
+      case R_CAP_TEX: {
+        r_cap_tex info;
+        if (chunk.size < sizeof(r_cap_tex)) {
+          break;
+        }
+        memcpy(&info, chunk_data, sizeof(r_cap_tex));
 
-  glEnableVertexAttribArray(0);
-  glEnableVertexAttribArray(1);
+        if ((uint64_t)info.width * info.height * 4 >
+            chunk.size - sizeof(r_cap_tex)) {
+          ASTERA_DBG("r_capture_load: texture %i is missing pixels.\n",
+                     info.id);
+          break;
+        }
 
-  glDrawElementsInstanced(GL_TRIANGLES, 6, GL_UNSIGNED_SHORT, 0,
-                          particles->uniform_count);
+        r_sheet* sheet = &capture->sheets[capture->sheet_count];
+        sheet->id      = r_capture_tex_create(info.width, info.height,
+                                         chunk_data + sizeof(r_cap_tex));
+        sheet->width   = info.width;
+        sheet->height  = info.height;
+
+        capture->sheet_keys[capture->sheet_count] = info.id;
+        ++capture->sheet_count;
+      } break;
+      case R_CAP_SHADER: {
+        r_cap_shader info;
+        if (chunk.size < sizeof(r_cap_shader)) {
+          break;
+        }
+        memcpy(&info, chunk_data, sizeof(r_cap_shader));
+        info.name[sizeof(info.name) - 1] = '\0';
 
-  glDisableVertexAttribArray(0);
-  glDisableVertexAttribArray(1);
+        r_shader shader = (loader) ? loader(info.name, loader_data) : 0;
+        if (!shader) {
+          ASTERA_DBG("r_capture_load: no shader for %s, skipping its draws.\n",
+                     info.name);
+        }
 
-  glBindVertexArray(0);
-  r_tex_bind(0);
-  r_shader_bind(0);
+        capture->shaders[capture->shader_count]     = shader;
+        capture->shader_keys[capture->shader_count] = info.id;
+        ++capture->shader_count;
+      } break;
+      case R_CAP_BAKED: {
+        r_cap_baked info;
+        if (chunk.size < sizeof(r_cap_baked)) {
+          break;
+        }
+        memcpy(&info, chunk_data, sizeof(r_cap_baked));
+
+        // 4 vertices of 5 floats & 6 indices per quad
+        if ((uint64_t)info.quad_count *
+                (sizeof(float) * 20 + sizeof(uint16_t) * 6) >
+            chunk.size - sizeof(r_cap_baked)) {
+          ASTERA_DBG("r_capture_load: baked sheet %i is missing quads.\n",
+                     info.vao);
+          break;
+        }
 
-  // Clear out the uniforms for the next draw call
-  memset(particles->mats, 0, sizeof(mat4x4) * particles->uniform_count);
-  memset(particles->colors, 0, sizeof(vec4) * particles->uniform_count);
-  memset(particles->coords, 0, sizeof(vec4) * particles->uniform_count);
-  particles->uniform_count = 0;
-}
+        r_capture_baked_create(&capture->baked[capture->baked_count],
+                               info.quad_count,
+                               chunk_data + sizeof(r_cap_baked));
 
-void r_particles_draw(r_ctx* ctx, r_particles* particles, r_shader shader) {
-  if (particles->calculate) {
-    r_sheet* sheet = particles->sheet;
+        capture->baked_keys[capture->baked_count] = info.vao;
+        ++capture->baked_count;
+      } break;
+      case R_CAP_FBO: {
+        r_cap_fbo info;
+        if (chunk.size < sizeof(r_cap_fbo)) {
+          break;
+        }
+        memcpy(&info, chunk_data, sizeof(r_cap_fbo));
+
+        r_shader shader = r_capture_find_shader(capture, info.shader);
+        capture->fbos[capture->fbo_count] =
+            r_framebuffer_create(info.width, info.height, shader);
+        capture->fbo_keys[capture->fbo_count] = info.fbo;
+        ++capture->fbo_count;
+      } break;
+      case R_CAP_FRAME: {
+        if (chunk.size < sizeof(uint32_t)) {
+          break;
+        }
 
-    for (uint32_t i = 0; i < particles->capacity; ++i) {
-      r_particle* particle = &particles->list[i];
+        r_cmd_list* frame = &capture->frames[capture->frame_count];
+        uint32_t    size  = chunk.size - sizeof(uint32_t);
 
-      if (particle->life > 0.f) {
-        mat4x4* mat = &particles->mats[particles->uniform_count];
-
-        mat4x4_identity(*mat);
-        mat4x4_translate(*mat, particle->position[0], particle->position[1],
-                         particle->layer * ASTERA_RENDER_LAYER_MOD);
-        mat4x4_scale_aniso(*mat, *mat, particle->size[0], particle->size[1],
-                           1.f);
-        mat4x4_rotate_z(*mat, *mat, particle->rotation);
-
-        vec4_dup(particles->colors[particles->uniform_count], particle->color);
-
-        if (sheet) {
-          if (particles->type == PARTICLE_TEXTURED ||
-              particles->type == PARTICLE_ANIMATED) {
-            vec4_dup(particles->coords[particles->uniform_count],
-                     sheet->subtexs[particle->frame].coords);
-          }
+        frame->data = (uint8_t*)malloc((size) ? size : 1);
+        if (!frame->data) {
+          ASTERA_DBG("r_capture_load: unable to allocate frame.\n");
+          break;
         }
 
-        ++particles->uniform_count;
-      }
-
-      if (particles->uniform_count == particles->uniform_cap) {
-        r_particles_render(ctx, particles, shader);
-      }
-    }
+        memcpy(frame->data, chunk_data + sizeof(uint32_t), size);
+        frame->size     = size;
+        frame->capacity = size;
 
-    if (particles->uniform_count != 0) {
-      r_particles_render(ctx, particles, shader);
+        r_capture_resolve(capture, frame);
+        ++capture->frame_count;
+      } break;
+      default:
+        ASTERA_DBG("r_capture_load: unknown chunk type %i.\n", chunk.type);
+        break;
     }
-  } else {
-    r_particles_render(ctx, particles, shader);
   }
-}
 
-void r_particles_set_spawner(r_particles* system, r_particle_spawner spawner) {
-  system->use_spawner  = 1;
-  system->spawner_func = spawner;
+  return capture;
 }
 
-void r_particles_set_animator(r_particles*        system,
-                              r_particle_animator animator) {
-  system->use_animator  = 1;
-  system->animator_func = animator;
+uint32_t r_capture_frame_count(r_capture* capture) {
+  return (capture) ? capture->frame_count : 0;
 }
 
-void r_particles_remove_spawner(r_particles* system) {
-  system->use_spawner  = 0;
-  system->spawner_func = 0;
-}
+void r_capture_replay(r_ctx* ctx, r_capture* capture, uint32_t frame) {
+  if (!ctx || !capture || frame >= capture->frame_count) {
+    ASTERA_DBG("r_capture_replay: invalid frame %i.\n", frame);
+    return;
+  }
 
-void r_particles_remove_animator(r_particles* system) {
-  system->use_animator  = 0;
-  system->animator_func = 0;
+  if (r_ctx_recording(ctx)) {
+    ASTERA_DBG("r_capture_replay: unable to replay while threaded / "
+               "capturing.\n");
+    return;
+  }
+
+  r_cmd_exec(ctx, &capture->frames[frame]);
 }
 
-void r_sprite_draw(r_ctx* ctx, r_sprite* sprite) {
-  if (!sprite->visible) {
+void r_capture_destroy(r_capture* capture) {
+  if (!capture) {
     return;
   }
 
-  r_batch* batch = r_batch_get(ctx, sprite->sheet, sprite->shader);
+  for (uint32_t i = 0; i < capture->sheet_count; ++i) {
+    r_res_untrack(R_RES_TEXTURE, capture->sheets[i].id);
+    glDeleteTextures(1, &capture->sheets[i].id);
+  }
 
-  if (batch) {
-    if (batch->count == batch->capacity) {
-      r_batch_draw(ctx, batch);
-    }
+  for (uint32_t i = 0; i < capture->baked_count; ++i) {
+    r_baked_sheet_destroy(&capture->baked[i]);
+  }
+
+  for (uint32_t i = 0; i < capture->fbo_count; ++i) {
+    r_framebuffer_destroy(capture->fbos[i]);
+  }
 
-    r_batch_add(batch, sprite);
+  if (capture->frames) {
+    for (uint32_t i = 0; i < capture->frame_count; ++i) {
+      free(capture->frames[i].data);
+    }
   }
+
+  free(capture->sheets);
+  free(capture->sheet_keys);
+  free(capture->shaders);
+  free(capture->shader_keys);
+  free(capture->baked);
+  free(capture->baked_keys);
+  free(capture->fbos);
+  free(capture->fbo_keys);
+  free(capture->frames);
+  free(capture);
 }
 
 uint8_t r_sprite_get_anim_state(r_sprite* sprite) {
@@ -1364,6 +6123,14 @@ r_shader r_shader_create(unsigned char* vert_data, unsigned char* frag_data) {
     free(log);
   }
 
+  // The program keeps what it needs once linked
+  glDetachShader(id, v);
+  glDetachShader(id, f);
+  glDeleteShader(v);
+  glDeleteShader(f);
+
+  r_res_track(R_RES_PROGRAM, id, 0, __func__);
+
   return (r_shader)id;
 }
 
@@ -1402,6 +6169,7 @@ void r_shader_cache(r_ctx* ctx, r_shader shader, const char* name) {
 void r_shader_bind(r_shader shader) { glUseProgram(shader); }
 
 void r_shader_destroy(r_ctx* ctx, r_shader shader) {
+  r_res_untrack(R_RES_PROGRAM, shader);
   glDeleteProgram(shader);
 
   int8_t start = 0;
@@ -1504,8 +6272,139 @@ r_anim r_anim_create(r_sheet* sheet, uint32_t* frames, uint32_t count,
                   .loop   = 0};
 }
 
+r_anim r_layout_get_anim(r_layout* layout, uint32_t anim_index,
+                         r_sheet* sheet) {
+  if (!layout || anim_index >= layout->header.anim_count) {
+    ASTERA_DBG("r_layout_get_anim: invalid animation %i.\n", anim_index);
+    return (r_anim){0};
+  }
+
+  r_layout_anim* info = &layout->anims[anim_index];
+  r_anim         anim = r_anim_create(sheet, &layout->frames[info->frame_start],
+                                      info->frame_count, info->rate);
+  anim.loop = (int8_t)info->loop;
+
+  return anim;
+}
+
+uint32_t r_layout_cache_anims(r_ctx* ctx, r_layout* layout,
+                              uint32_t sheet_index, r_sheet* sheet) {
+  if (!ctx || !layout) {
+    ASTERA_DBG("r_layout_cache_anims: invalid parameters passed.\n");
+    return 0;
+  }
+
+  uint32_t count = 0;
+  for (uint32_t i = 0; i < layout->header.anim_count; ++i) {
+    r_layout_anim* info = &layout->anims[i];
+    if (info->sheet != sheet_index) {
+      continue;
+    }
+
+    r_anim anim = r_layout_get_anim(layout, i, sheet);
+    if (!r_anim_cache(ctx, anim, layout->strings + info->name)) {
+      free(anim.frames);
+      break;
+    }
+
+    ++count;
+  }
+
+  return count;
+}
+
+// Marks a removed entry in the animation map so probing continues past it
+#define R_ANIM_MAP_TOMB 0xFFFF
+
+/* Find the map slot holding an animation index, returns anim_map_size if not
+ * found */
+static uint32_t r_anim_map_find(r_ctx* ctx, const char* name, uint32_t hash) {
+  uint32_t mask = ctx->anim_map_size - 1;
+
+  for (uint32_t i = 0; i < ctx->anim_map_size; ++i) {
+    uint32_t slot  = (hash + i) & mask;
+    uint16_t entry = ctx->anim_map[slot];
+
+    if (entry == 0) {
+      break;
+    } else if (entry == R_ANIM_MAP_TOMB) {
+      continue;
+    }
+
+    uint16_t index = entry - 1;
+    if (ctx->anim_hashes[index] == hash &&
+        strcmp(ctx->anim_names[index], name) == 0) {
+      return slot;
+    }
+  }
+
+  return ctx->anim_map_size;
+}
+
+static void r_anim_map_insert(r_ctx* ctx, uint16_t index, uint32_t hash) {
+  uint32_t mask = ctx->anim_map_size - 1;
+
+  for (uint32_t i = 0; i < ctx->anim_map_size; ++i) {
+    uint32_t slot = (hash + i) & mask;
+
+    if (ctx->anim_map[slot] == 0 || ctx->anim_map[slot] == R_ANIM_MAP_TOMB) {
+      ctx->anim_map[slot] = index + 1;
+      return;
+    }
+  }
+}
+
+static void r_anim_map_remove(r_ctx* ctx, uint16_t index) {
+  const char* name = ctx->anim_names[index];
+  if (!name || !ctx->anim_map) {
+    return;
+  }
+
+  uint32_t slot = r_anim_map_find(ctx, name, ctx->anim_hashes[index]);
+  if (slot != ctx->anim_map_size) {
+    ctx->anim_map[slot] = R_ANIM_MAP_TOMB;
+  }
+
+  ctx->anim_names[index]  = 0;
+  ctx->anim_hashes[index] = 0;
+}
+
+/* Get an instance's slot if the handle is live
+ * returns: the slot's index + 1, 0 = invalid / destroyed */
+static uint32_t r_anim_inst_slot(r_ctx* ctx, uint32_t inst) {
+  r_anim_pool* pool = &ctx->anim_pool;
+  if (!inst || inst > pool->high || !pool->alive[inst - 1]) {
+    return 0;
+  }
+
+  return inst;
+}
+
+/* Stop an instance in a state the update kernel skips over */
+static void r_anim_inst_park(r_anim_pool* pool, uint32_t index) {
+  pool->state[index]      = R_ANIM_STOP;
+  pool->frames[index]     = 1;
+  pool->curr[index]       = 0;
+  pool->frame_time[index] = 1.f;
+  pool->time[index]       = 0.f;
+}
+
+/* Stop & detach any pooled instances still playing an animation, they keep
+ * their last frame until destroyed */
+static void r_anim_detach(r_ctx* ctx, uint32_t id) {
+  r_anim_pool* pool = &ctx->anim_pool;
+  for (uint32_t i = 0; i < pool->high; ++i) {
+    if (pool->alive[i] && pool->anim[i] == id) {
+      r_anim_inst_park(pool, i);
+      pool->anim[i] = R_ANIM_POOL_NONE;
+    }
+  }
+}
+
 void r_anim_destroy(r_ctx* ctx, r_anim* anim) {
+  r_anim_detach(ctx, anim->id);
   free(anim->frames);
+  r_anim_map_remove(ctx, anim->id);
   ctx->anims[anim->id] = (r_anim){0};
   --ctx->anim_count;
 }
@@ -1516,17 +6415,24 @@ r_anim* r_anim_cache(r_ctx* ctx, r_anim anim, const char* name) {
     return 0;
   }
 
-  for (uint32_t i = 0; i < ctx->anim_high; ++i) {
+  for (uint32_t i = 0; i < ctx->anim_capacity; ++i) {
     r_anim* slot = &ctx->anims[i];
 
     if (!slot->frames) {
       *slot              = anim;
+      slot->id           = i;
       ctx->anim_names[i] = name;
 
-      if (i > ctx->anim_high) {
-        ctx->anim_high = i;
+      if (name) {
+        ctx->anim_hashes[i] = s_hash_str(name);
+        r_anim_map_insert(ctx, i, ctx->anim_hashes[i]);
       }
 
+      if (i >= ctx->anim_high) {
+        ctx->anim_high = i + 1;
+      }
+
+      ++ctx->anim_count;
       return slot;
     }
   }
@@ -1559,7 +6465,7 @@ void r_anim_reset(r_anim* anim) {
 }
 
 r_anim* r_anim_get(r_ctx* ctx, uint32_t id) {
-  if (ctx->anim_count < id) {
+  if (id >= ctx->anim_capacity) {
     return 0;
   }
 
@@ -1576,28 +6482,29 @@ r_anim* r_anim_get_name(r_ctx* ctx, const char* name) {
     return 0;
   }
 
-  for (uint32_t i = 0; i < ctx->anim_high; ++i) {
-    if (ctx->anim_names[i]) {
-      if (strcmp(ctx->anim_names[i], name) == 0) {
-        return &ctx->anims[i];
-      }
-    }
+  uint32_t slot = r_anim_map_find(ctx, name, s_hash_str(name));
+  if (slot == ctx->anim_map_size) {
+    return 0;
   }
 
-  return 0;
+  return &ctx->anims[ctx->anim_map[slot] - 1];
 }
 
 r_anim r_anim_remove(r_ctx* ctx, uint32_t id) {
-  if (ctx->anim_count < id) {
-    ASTERA_DBG("r_anim_remove: no animations in cache.\n");
+  if (id >= ctx->anim_capacity) {
+    ASTERA_DBG("r_anim_remove: no animation in slot %i.\n", id);
     return (r_anim){0};
   }
 
   if (ctx->anims[id].frames) {
     r_anim ret = ctx->anims[id];
 
+    r_anim_map_remove(ctx, id);
     ctx->anims[id].id     = 0;
     ctx->anims[id].frames = 0;
+    --ctx->anim_count;
+
+    r_anim_detach(ctx, id);
 
     if (id >= ctx->anim_high) {
       // recurse down to the next available animation
@@ -1617,9 +6524,177 @@ r_anim r_anim_remove(r_ctx* ctx, uint32_t id) {
 
 r_anim r_anim_remove_name(r_ctx* ctx, const char* name) {
   r_anim* anim = r_anim_get_name(ctx, name);
+  if (!anim) {
+    return (r_anim){0};
+  }
+
   return r_anim_remove(ctx, anim->id);
 }
 
+/* Grow the animation pool's arrays to hold capacity instances */
+static uint8_t r_anim_pool_grow(r_anim_pool* pool, uint32_t capacity) {
+#define R_POOL_GROW(field, type)                                              \
+  do {                                                                        \
+    type* grown = (type*)realloc(pool->field, sizeof(type) * capacity);       \
+    if (!grown)                                                               \
+      return 0;                                                               \
+    pool->field = grown;                                                      \
+  } while (0)
+
+  R_POOL_GROW(anim, uint32_t);
+  R_POOL_GROW(frames, uint32_t);
+  R_POOL_GROW(curr, uint32_t);
+  R_POOL_GROW(subtex, uint32_t);
+  R_POOL_GROW(frame_time, float);
+  R_POOL_GROW(time, float);
+  R_POOL_GROW(state, uint8_t);
+  R_POOL_GROW(loop, uint8_t);
+  R_POOL_GROW(alive, uint8_t);
+  R_POOL_GROW(free_list, uint32_t);
+
+#undef R_POOL_GROW
+
+  pool->capacity = capacity;
+  return 1;
+}
+
+uint32_t r_anim_inst_create(r_ctx* ctx, uint32_t anim_id) {
+  r_anim* anim = r_anim_get(ctx, anim_id);
+  if (!anim || !anim->count || !anim->rate) {
+    ASTERA_DBG("r_anim_inst_create: invalid animation %i.\n", anim_id);
+    return 0;
+  }
+
+  r_anim_pool* pool = &ctx->anim_pool;
+  uint32_t     index;
+
+  if (pool->free_count) {
+    --pool->free_count;
+    index = pool->free_list[pool->free_count];
+  } else {
+    if (pool->high == pool->capacity) {
+      uint32_t capacity = (pool->capacity) ? pool->capacity * 2 : 256;
+      if (!r_anim_pool_grow(pool, capacity)) {
+        ASTERA_DBG("r_anim_inst_create: unable to grow animation pool.\n");
+        return 0;
+      }
+    }
+
+    index = pool->high;
+    ++pool->high;
+  }
+
+  pool->anim[index]       = anim->id;
+  pool->frames[index]     = anim->count;
+  pool->curr[index]       = 0;
+  pool->subtex[index]     = anim->frames[0];
+  pool->frame_time[index] = MS_TO_SEC / anim->rate;
+  pool->time[index]       = 0.f;
+  pool->state[index]      = R_ANIM_STOP;
+  pool->loop[index]       = anim->loop;
+  pool->alive[index]      = 1;
+
+  return index + 1;
+}
+
+void r_anim_inst_destroy(r_ctx* ctx, uint32_t inst) {
+  r_anim_pool* pool = &ctx->anim_pool;
+  if (!r_anim_inst_slot(ctx, inst)) {
+    ASTERA_DBG("r_anim_inst_destroy: invalid instance %i.\n", inst);
+    return;
+  }
+
+  uint32_t index = inst - 1;
+
+  r_anim_inst_park(pool, index);
+  pool->alive[index] = 0;
+
+  pool->free_list[pool->free_count] = index;
+  ++pool->free_count;
+}
+
+void r_anim_inst_play(r_ctx* ctx, uint32_t inst) {
+  // Instances of a removed animation have nothing left to play
+  if (!r_anim_inst_slot(ctx, inst) ||
+      ctx->anim_pool.anim[inst - 1] == R_ANIM_POOL_NONE)
+    return;
+  ctx->anim_pool.state[inst - 1] = R_ANIM_PLAY;
+}
+
+void r_anim_inst_pause(r_ctx* ctx, uint32_t inst) {
+  if (!r_anim_inst_slot(ctx, inst))
+    return;
+  ctx->anim_pool.state[inst - 1] = R_ANIM_PAUSE;
+}
+
+void r_anim_inst_stop(r_ctx* ctx, uint32_t inst) {
+  r_anim_pool* pool = &ctx->anim_pool;
+  if (!r_anim_inst_slot(ctx, inst))
+    return;
+
+  uint32_t index     = inst - 1;
+  pool->state[index] = R_ANIM_STOP;
+  pool->time[index]  = 0.f;
+  pool->curr[index]  = 0;
+
+  if (pool->anim[index] != R_ANIM_POOL_NONE) {
+    pool->subtex[index] = ctx->anims[pool->anim[index]].frames[0];
+  }
+}
+
+uint8_t r_anim_inst_get_state(r_ctx* ctx, uint32_t inst) {
+  if (!r_anim_inst_slot(ctx, inst))
+    return R_ANIM_STOP;
+  return ctx->anim_pool.state[inst - 1];
+}
+
+uint32_t r_anim_inst_get_frame(r_ctx* ctx, uint32_t inst) {
+  if (!r_anim_inst_slot(ctx, inst))
+    return 0;
+  return ctx->anim_pool.curr[inst - 1];
+}
+
+void r_anim_pool_update(r_ctx* ctx, time_s delta) {
+  r_anim_pool* pool = &ctx->anim_pool;
+  uint32_t     high = pool->high;
+  float        step = (float)delta;
+
+  uint32_t* restrict curr       = pool->curr;
+  float* restrict    time       = pool->time;
+  const float* restrict frame_time = pool->frame_time;
+  const uint8_t* restrict state = pool->state;
+
+  // Advance every clock at once, branch free so the compiler can vectorize it
+  for (uint32_t i = 0; i < high; ++i) {
+    float    playing = (float)(state[i] == R_ANIM_PLAY);
+    float    t       = time[i] + step * playing;
+    uint32_t steps   = (uint32_t)(t / frame_time[i]);
+
+    time[i] = t - (float)steps * frame_time[i];
+    curr[i] += steps;
+  }
+
+  // Wrap / finish instances that ran past their last frame & resolve the
+  // subtexture the batcher reads
+  for (uint32_t i = 0; i < high; ++i) {
+    if (state[i] != R_ANIM_PLAY) {
+      continue;
+    }
+
+    if (curr[i] >= pool->frames[i]) {
+      if (pool->loop[i]) {
+        curr[i] %= pool->frames[i];
+      } else {
+        pool->state[i] = R_ANIM_STOP;
+        curr[i]        = 0;
+        time[i]        = 0.f;
+      }
+    }
+
+    pool->subtex[i] = ctx->anims[pool->anim[i]].frames[curr[i]];
+  }
+}
+
 r_subtex* r_subtex_create_tiled(r_sheet* sheet, uint32_t id, uint32_t width,
                                 uint32_t height, uint32_t width_pad,
                                 uint32_t height_pad) {
@@ -1690,17 +6765,36 @@ r_subtex* r_subtex_create(r_sheet* sheet, uint32_t x, uint32_t y,
 void r_sprite_set_anim(r_sprite* sprite, r_anim anim) {
   sprite->render.anim = anim;
   sprite->animated    = 1;
+  sprite->pooled      = 0;
   sprite->sheet       = anim.sheet;
 }
 
+void r_sprite_set_anim_inst(r_ctx* ctx, r_sprite* sprite, uint32_t inst) {
+  if (!r_anim_inst_slot(ctx, inst) ||
+      ctx->anim_pool.anim[inst - 1] == R_ANIM_POOL_NONE) {
+    ASTERA_DBG("r_sprite_set_anim_inst: invalid instance %i.\n", inst);
+    return;
+  }
+
+  sprite->render.inst = inst;
+  sprite->animated    = 0;
+  sprite->pooled      = 1;
+  sprite->sheet       = ctx->anims[ctx->anim_pool.anim[inst - 1]].sheet;
+}
+
+void r_sprite_set_opaque(r_sprite* sprite, uint8_t opaque) {
+  sprite->opaque = (opaque) ? 1 : 0;
+}
+
 void r_sprite_set_tex(r_sprite* sprite, r_sheet* sheet, uint32_t id) {
   sprite->animated   = 0;
+  sprite->pooled     = 0;
   sprite->render.tex = id;
   sprite->sheet      = sheet;
 }
 
 r_sprite r_sprite_create(r_shader shader, vec2 pos, vec2 size) {
-  r_sprite sprite;
+  r_sprite sprite = (r_sprite){0};
 
   if (pos) {
     vec2_dup(sprite.position, pos);
@@ -1710,10 +6804,8 @@ r_sprite r_sprite_create(r_shader shader, vec2 pos, vec2 size) {
     vec2_dup(sprite.size, size);
   }
 
-  mat4x4_identity(sprite.model);
-  mat4x4_translate(sprite.model, sprite.position[0], sprite.position[1], 0.f);
-  mat4x4_scale_aniso(sprite.model, sprite.model, sprite.size[0], sprite.size[1],
-                     1.f);
+  mat4x4_2d_bulk(&sprite.model, &sprite.position[0], &sprite.position[1], 0,
+                 &sprite.size[0], &sprite.size[1], 0, 0, 0, 1);
 
   sprite.layer = 0;
 
@@ -1730,12 +6822,8 @@ r_sprite r_sprite_create(r_shader shader, vec2 pos, vec2 size) {
   return sprite;
 }
 
-void r_sprite_update(r_sprite* sprite, long delta) {
-  mat4x4_translate(sprite->model, sprite->position[0], sprite->position[1],
-                   (sprite->layer * ASTERA_RENDER_LAYER_MOD));
-  mat4x4_scale_aniso(sprite->model, sprite->model, sprite->size[0],
-                     sprite->size[0], sprite->size[1]);
-
+/* Advance a sprite's animation */
+static void r_sprite_anim_update(r_sprite* sprite, long delta) {
   sprite->change = 0;
 
   if (sprite->animated) {
@@ -1763,6 +6851,53 @@ void r_sprite_update(r_sprite* sprite, long delta) {
   }
 }
 
+void r_sprite_update(r_sprite* sprite, long delta) {
+  float z = sprite->layer * ASTERA_RENDER_LAYER_MOD;
+  mat4x4_2d_bulk(&sprite->model, &sprite->position[0], &sprite->position[1],
+                 &z, &sprite->size[0], &sprite->size[1], &sprite->rotation,
+                 &sprite->pivot[0], &sprite->pivot[1], 1);
+
+  r_sprite_anim_update(sprite, delta);
+}
+
+// The amount of sprites gathered per call of the transform kernel
+#define R_SPRITE_UPDATE_CHUNK 64
+
+void r_sprites_update(r_sprite* sprites, uint32_t count, long delta) {
+  float  x[R_SPRITE_UPDATE_CHUNK], y[R_SPRITE_UPDATE_CHUNK];
+  float  z[R_SPRITE_UPDATE_CHUNK], rotation[R_SPRITE_UPDATE_CHUNK];
+  float  w[R_SPRITE_UPDATE_CHUNK], h[R_SPRITE_UPDATE_CHUNK];
+  float  pivot_x[R_SPRITE_UPDATE_CHUNK], pivot_y[R_SPRITE_UPDATE_CHUNK];
+  mat4x4 models[R_SPRITE_UPDATE_CHUNK];
+
+  for (uint32_t start = 0; start < count; start += R_SPRITE_UPDATE_CHUNK) {
+    uint32_t chunk = count - start;
+    chunk = (chunk > R_SPRITE_UPDATE_CHUNK) ? R_SPRITE_UPDATE_CHUNK : chunk;
+
+    // Gather into arrays per component so the kernel can work across sprites
+    for (uint32_t i = 0; i < chunk; ++i) {
+      r_sprite* sprite = &sprites[start + i];
+      x[i]             = sprite->position[0];
+      y[i]             = sprite->position[1];
+      z[i]             = sprite->layer * ASTERA_RENDER_LAYER_MOD;
+      w[i]             = sprite->size[0];
+      h[i]             = sprite->size[1];
+      rotation[i]      = sprite->rotation;
+      pivot_x[i]       = sprite->pivot[0];
+      pivot_y[i]       = sprite->pivot[1];
+    }
+
+    mat4x4_2d_bulk(models, x, y, z, w, h, rotation, pivot_x, pivot_y,
+                   (int)chunk);
+
+    for (uint32_t i = 0; i < chunk; ++i) {
+      r_sprite* sprite = &sprites[start + i];
+      mat4x4_dup(sprite->model, models[i]);
+      r_sprite_anim_update(sprite, delta);
+    }
+  }
+}
+
 inline void r_set_uniformf(r_shader shader, const char* name, float value) {
   glUniform1f(glGetUniformLocation(shader, name), value);
 }
@@ -2220,15 +7355,53 @@ uint8_t r_window_should_close(r_ctx* ctx) {
   return ctx->window.close_requested;
 }
 
-void r_window_swap_buffers(r_ctx* ctx) { glfwSwapBuffers(ctx->window.glfw); }
+void r_window_swap_buffers(r_ctx* ctx) {
+  if (ctx->pick.cell_size) {
+    r_pick_swap(&ctx->pick);
+  }
+
+#if !defined(ASTERA_NO_THREADS)
+  if (ctx->thread) {
+    r_ctx_thread_submit(ctx);
+    return;
+  }
+#endif
+
+  if (ctx->capture) {
+    r_cmd_list* list = &ctx->cmd_lists[ctx->cmd_record];
+    r_cmd_exec(ctx, list);
+    r_capture_frame(ctx, list);
+    list->size            = 0;
+    ctx->rec_camera_valid = 0;
+  }
+
+  r_readback_poll(ctx, 0);
+  r_stream_advance(&ctx->stream);
+  glfwSwapBuffers(ctx->window.glfw);
+}
 
 void r_window_clear(void) {
+  if (r_ctx_recording(_r_rec_ctx)) {
+    r_cmd_rec(_r_rec_ctx, R_CMD_CLEAR, 0);
+    return;
+  }
+
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 }
 
 void r_window_clear_color(const char* str) {
   vec4 color;
   r_get_color4f(color, str);
+
+  if (r_ctx_recording(_r_rec_ctx)) {
+    r_cmd_color* cmd = r_cmd_rec(_r_rec_ctx, R_CMD_CLEAR_COLOR,
+                                 sizeof(r_cmd_color));
+    if (cmd) {
+      vec4_dup(cmd->color, color);
+    }
+    return;
+  }
+
   glClearColor(color[0], color[1], color[2], color[3]);
 }
 
@@ -15,6 +15,13 @@
 #include <time.h>
 #endif
 
+#if !defined(ASTERA_NO_THREADS)
+#include <stdlib.h>
+#if !defined(_WIN32) && !defined(_WIN64)
+#include <pthread.h>
+#endif
+#endif
+
 #if !defined(ASTERA_NO_CONF)
 #include <ctype.h>
 #include <stdio.h>
@@ -78,23 +85,159 @@ static uint64_t s_get_ns() {
 
 /* Call the OS's sleep function for given milliseconds */
 time_s s_sleep(time_s duration) {
+  if (duration <= 0) {
+    return 0;
+  }
+
+  uint64_t start = s_get_ns();
 #if defined(_WIN32) || defined(_WIN64)
-  Sleep(duration * MS_TO_MCS);
+  Sleep((DWORD)duration);
 #elif _POSIX_C_SOURCE >= 199309L
   struct timespec ts;
-  ts.tv_sec  = duration / MS_TO_SEC;
-  ts.tv_nsec = fmod(duration, MS_TO_NS);
+  ts.tv_sec  = (time_t)(duration / MS_TO_SEC);
+  ts.tv_nsec = (long)(fmod(duration, MS_TO_SEC) * NS_TO_MS);
   nanosleep(&ts, NULL);
 #else
   uint32_t sleep_conv = duration / MS_TO_MCS;
   usleep(sleep_conv);
 #endif
-  return duration;
+  return (s_get_ns() - start) / NS_TO_MS;
 }
 
 /* Returns time in milliseconds */
 time_s s_get_time() { return s_get_ns() / NS_TO_MS; }
 
+/* Sleep until just short of a time, then spin the rest of the way
+ * target - the time to wait until (milliseconds, s_get_time) */
+static void s_pacer_wait_until(s_pacer* pacer, time_s target) {
+  time_s remaining = target - s_get_time();
+
+  // Only sleep if the OS is expected to wake us up in time
+  if (remaining > pacer->oversleep) {
+    time_s requested = remaining - pacer->oversleep;
+    time_s over      = s_sleep(requested) - requested;
+
+    // Spin for the usual overshoot plus 2 deviations, a one off stall
+    // shouldn't make every frame spin for its length
+    time_s diff = over - pacer->sleep_mean;
+    pacer->sleep_mean += diff * 0.1;
+    pacer->sleep_var = (pacer->sleep_var + (diff * diff * 0.1)) * 0.9;
+
+    pacer->oversleep = pacer->sleep_mean + (2.0 * sqrt(pacer->sleep_var));
+    if (pacer->oversleep > S_PACER_MAX_SPIN) {
+      pacer->oversleep = S_PACER_MAX_SPIN;
+    }
+  }
+
+  while (s_get_time() < target) {
+  }
+}
+
+s_pacer s_pacer_create(time_s rate, uint8_t low_latency) {
+  s_pacer pacer     = (s_pacer){0};
+  pacer.period      = (rate > 0) ? MS_TO_SEC / rate : 0;
+  pacer.low_latency = low_latency;
+  pacer.margin      = 1.0;
+  pacer.oversleep   = 1.0;
+  pacer.sleep_mean  = 0.5;
+  return pacer;
+}
+
+void s_pacer_set_rate(s_pacer* pacer, time_s rate) {
+  pacer->period   = (rate > 0) ? MS_TO_SEC / rate : 0;
+  pacer->deadline = 0;
+}
+
+time_s s_pacer_wait(s_pacer* pacer) {
+  time_s target = 0;
+
+  if (pacer->period > 0 && pacer->start > 0) {
+    if (pacer->low_latency && pacer->present > 0) {
+      // Start as late as the slowest recent frame allows before the next
+      // present, so input is sampled as close to the display as possible
+      time_s work = 0;
+      for (uint32_t i = 0; i < pacer->count; ++i) {
+        if (pacer->work[i] > work) {
+          work = pacer->work[i];
+        }
+      }
+
+      target = pacer->present + pacer->period - work - pacer->margin;
+    } else {
+      target = pacer->deadline;
+    }
+
+    s_pacer_wait_until(pacer, target);
+  }
+
+  time_s now = s_get_time();
+
+  if (pacer->start > 0) {
+    pacer->frames[pacer->index] = now - pacer->start;
+    pacer->index                = (pacer->index + 1) % S_PACER_HISTORY;
+    pacer->work[pacer->index]   = 0;
+
+    if (pacer->count < S_PACER_HISTORY) {
+      ++pacer->count;
+    }
+  }
+
+  time_s delta = (pacer->start > 0) ? now - pacer->start : 0;
+  pacer->start = now;
+
+  // Keep a fixed cadence, but don't try to catch up on frames already missed
+  pacer->deadline += pacer->period;
+  if (pacer->deadline < now) {
+    pacer->deadline = now + pacer->period;
+  }
+
+  return delta;
+}
+
+void s_pacer_presented(s_pacer* pacer) {
+  time_s now                = s_get_time();
+  pacer->present            = now;
+  pacer->work[pacer->index] = now - pacer->start;
+}
+
+void s_pacer_get_stats(s_pacer* pacer, s_pacer_stats* dst) {
+  *dst = (s_pacer_stats){0};
+
+  if (!pacer->count) {
+    return;
+  }
+
+  uint32_t work_count = 0;
+  time_s   total = 0, total_sq = 0, work = 0;
+
+  dst->min = pacer->frames[0];
+  for (uint32_t i = 0; i < pacer->count; ++i) {
+    time_s frame = pacer->frames[i];
+
+    total += frame;
+    total_sq += frame * frame;
+
+    if (frame < dst->min)
+      dst->min = frame;
+
+    if (frame > dst->max)
+      dst->max = frame;
+
+    if (pacer->period > 0 && frame > pacer->period * 1.5)
+      ++dst->missed;
+
+    if (pacer->work[i] > 0) {
+      work += pacer->work[i];
+      ++work_count;
+    }
+  }
+
+  dst->average  = total / pacer->count;
+  time_s spread = (total_sq / pacer->count) - (dst->average * dst->average);
+  dst->jitter   = (spread > 0) ? sqrt(spread) : 0;
+  dst->work     = (work_count) ? work / work_count : 0;
+}
+
 /* Update a timer with current time & calculate delta from last update */
 time_s s_timer_update(s_timer* t) {
   time_s current = s_get_time();
@@ -162,6 +305,276 @@ char* s_itoa(int32_t value, char* string, int8_t base) {
   return string;
 }
 
+uint32_t s_hash_str(const char* str) {
+  uint32_t hash = 2166136261u;
+
+  if (!str)
+    return hash;
+
+  while (*str) {
+    hash ^= (unsigned char)*str;
+    hash *= 16777619u;
+    ++str;
+  }
+
+  return hash;
+}
+
+uint32_t s_hash_data(const void* data, uint32_t length) {
+  const unsigned char* bytes = (const unsigned char*)data;
+  uint32_t             hash  = 2166136261u;
+
+  if (!data)
+    return hash;
+
+  for (uint32_t i = 0; i < length; ++i) {
+    hash ^= bytes[i];
+    hash *= 16777619u;
+  }
+
+  return hash;
+}
+
+#if !defined(ASTERA_NO_THREADS)
+#if defined(_WIN32) || defined(_WIN64)
+struct s_thread {
+  HANDLE        handle;
+  s_thread_func func;
+  void*         data;
+};
+
+struct s_mutex {
+  CRITICAL_SECTION section;
+};
+
+struct s_cond {
+  CONDITION_VARIABLE var;
+};
+
+static DWORD WINAPI s_thread_entry(LPVOID param) {
+  s_thread* thread = (s_thread*)param;
+  thread->func(thread->data);
+  return 0;
+}
+#else
+struct s_thread {
+  pthread_t     handle;
+  s_thread_func func;
+  void*         data;
+};
+
+struct s_mutex {
+  pthread_mutex_t handle;
+};
+
+struct s_cond {
+  pthread_cond_t handle;
+};
+
+static void* s_thread_entry(void* param) {
+  s_thread* thread = (s_thread*)param;
+  thread->func(thread->data);
+  return 0;
+}
+#endif
+
+s_thread* s_thread_create(s_thread_func func, void* data) {
+  if (!func) {
+    ASTERA_DBG("s_thread_create: no function passed.\n");
+    return 0;
+  }
+
+  s_thread* thread = (s_thread*)malloc(sizeof(s_thread));
+  if (!thread) {
+    ASTERA_DBG("s_thread_create: unable to allocate thread.\n");
+    return 0;
+  }
+
+  thread->func = func;
+  thread->data = data;
+
+#if defined(_WIN32) || defined(_WIN64)
+  thread->handle = CreateThread(NULL, 0, s_thread_entry, thread, 0, NULL);
+  if (!thread->handle) {
+#else
+  if (pthread_create(&thread->handle, NULL, s_thread_entry, thread) != 0) {
+#endif
+    ASTERA_DBG("s_thread_create: unable to start thread.\n");
+    free(thread);
+    return 0;
+  }
+
+  return thread;
+}
+
+void s_thread_join(s_thread* thread) {
+  if (!thread)
+    return;
+
+#if defined(_WIN32) || defined(_WIN64)
+  WaitForSingleObject(thread->handle, INFINITE);
+  CloseHandle(thread->handle);
+#else
+  pthread_join(thread->handle, NULL);
+#endif
+
+  free(thread);
+}
+
+s_mutex* s_mutex_create(void) {
+  s_mutex* mutex = (s_mutex*)malloc(sizeof(s_mutex));
+  if (!mutex) {
+    ASTERA_DBG("s_mutex_create: unable to allocate mutex.\n");
+    return 0;
+  }
+
+#if defined(_WIN32) || defined(_WIN64)
+  InitializeCriticalSection(&mutex->section);
+#else
+  pthread_mutex_init(&mutex->handle, NULL);
+#endif
+
+  return mutex;
+}
+
+void s_mutex_lock(s_mutex* mutex) {
+#if defined(_WIN32) || defined(_WIN64)
+  EnterCriticalSection(&mutex->section);
+#else
+  pthread_mutex_lock(&mutex->handle);
+#endif
+}
+
+void s_mutex_unlock(s_mutex* mutex) {
+#if defined(_WIN32) || defined(_WIN64)
+  LeaveCriticalSection(&mutex->section);
+#else
+  pthread_mutex_unlock(&mutex->handle);
+#endif
+}
+
+void s_mutex_destroy(s_mutex* mutex) {
+  if (!mutex)
+    return;
+
+#if defined(_WIN32) || defined(_WIN64)
+  DeleteCriticalSection(&mutex->section);
+#else
+  pthread_mutex_destroy(&mutex->handle);
+#endif
+
+  free(mutex);
+}
+
+s_cond* s_cond_create(void) {
+  s_cond* cond = (s_cond*)malloc(sizeof(s_cond));
+  if (!cond) {
+    ASTERA_DBG("s_cond_create: unable to allocate condition variable.\n");
+    return 0;
+  }
+
+#if defined(_WIN32) || defined(_WIN64)
+  InitializeConditionVariable(&cond->var);
+#else
+  pthread_cond_init(&cond->handle, NULL);
+#endif
+
+  return cond;
+}
+
+void s_cond_wait(s_cond* cond, s_mutex* mutex) {
+#if defined(_WIN32) || defined(_WIN64)
+  SleepConditionVariableCS(&cond->var, &mutex->section, INFINITE);
+#else
+  pthread_cond_wait(&cond->handle, &mutex->handle);
+#endif
+}
+
+void s_cond_signal(s_cond* cond) {
+#if defined(_WIN32) || defined(_WIN64)
+  WakeConditionVariable(&cond->var);
+#else
+  pthread_cond_signal(&cond->handle);
+#endif
+}
+
+void s_cond_broadcast(s_cond* cond) {
+#if defined(_WIN32) || defined(_WIN64)
+  WakeAllConditionVariable(&cond->var);
+#else
+  pthread_cond_broadcast(&cond->handle);
+#endif
+}
+
+void s_cond_destroy(s_cond* cond) {
+  if (!cond)
+    return;
+
+#if defined(_WIN32) || defined(_WIN64)
+  // Win32 condition variables don't need to be destroyed
+#else
+  pthread_cond_destroy(&cond->handle);
+#endif
+
+  free(cond);
+}
+
+#if defined(_WIN32) || defined(_WIN64)
+uint32_t s_atomic_load(volatile uint32_t* value) {
+  return (uint32_t)InterlockedCompareExchange((volatile LONG*)value, 0, 0);
+}
+
+void s_atomic_store(volatile uint32_t* value, uint32_t desired) {
+  InterlockedExchange((volatile LONG*)value, (LONG)desired);
+}
+
+uint32_t s_atomic_add(volatile uint32_t* value, uint32_t amount) {
+  return (uint32_t)InterlockedExchangeAdd((volatile LONG*)value, (LONG)amount);
+}
+
+uint8_t s_atomic_cas(volatile uint32_t* value, uint32_t expected,
+                     uint32_t desired) {
+  return (uint32_t)InterlockedCompareExchange((volatile LONG*)value,
+                                              (LONG)desired,
+                                              (LONG)expected) == expected;
+}
+
+uint64_t s_atomic_load64(volatile uint64_t* value) {
+  return (uint64_t)InterlockedCompareExchange64((volatile LONG64*)value, 0, 0);
+}
+
+void s_atomic_store64(volatile uint64_t* value, uint64_t desired) {
+  InterlockedExchange64((volatile LONG64*)value, (LONG64)desired);
+}
+#else
+uint32_t s_atomic_load(volatile uint32_t* value) {
+  return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+void s_atomic_store(volatile uint32_t* value, uint32_t desired) {
+  __atomic_store_n(value, desired, __ATOMIC_RELEASE);
+}
+
+uint32_t s_atomic_add(volatile uint32_t* value, uint32_t amount) {
+  return __atomic_fetch_add(value, amount, __ATOMIC_ACQ_REL);
+}
+
+uint8_t s_atomic_cas(volatile uint32_t* value, uint32_t expected,
+                     uint32_t desired) {
+  return __atomic_compare_exchange_n(value, &expected, desired, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+uint64_t s_atomic_load64(volatile uint64_t* value) {
+  return __atomic_load_n(value, __ATOMIC_ACQUIRE);
+}
+
+void s_atomic_store64(volatile uint64_t* value, uint64_t desired) {
+  __atomic_store_n(value, desired, __ATOMIC_RELEASE);
+}
+#endif
+#endif
+
 #if !defined(ASTERA_NO_CONF)
 void s_table_free(s_table table) {
   if (table.keys)
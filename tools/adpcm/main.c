@@ -0,0 +1,270 @@
+// Encodes a 16 bit PCM WAV file as 4 bit IMA ADPCM (WAV format 0x11), which
+// a_buf_create keeps compressed in OpenAL at about 4:1. Best for sfx that
+// don't mind a little noise, music & quiet detailed sounds are better left
+// as PCM / OGG.
+//
+// The block size is in samples per channel & must be 8n + 1. Anything other
+// than 65 needs AL_SOFT_block_alignment, which OpenAL Soft supports.
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_BLOCK_SAMPLES 2041
+
+static const int32_t ima_steps[89] = {
+    7,     8,     9,     10,    11,    12,    13,    14,    16,    17,
+    19,    21,    23,    25,    28,    31,    34,    37,    41,    45,
+    50,    55,    60,    66,    73,    80,    88,    97,    107,   118,
+    130,   143,   157,   173,   190,   209,   230,   253,   279,   307,
+    337,   371,   408,   449,   494,   544,   598,   658,   724,   796,
+    876,   963,   1060,  1166,  1282,  1411,  1552,  1707,  1878,  2066,
+    2272,  2499,  2749,  3024,  3327,  3660,  4026,  4428,  4871,  5358,
+    5894,  6484,  7132,  7845,  8630,  9493,  10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767};
+
+static const int32_t ima_index[16] = {-1, -1, -1, -1, 2, 4, 6, 8,
+                                      -1, -1, -1, -1, 2, 4, 6, 8};
+
+typedef struct {
+  int32_t predictor, index;
+} ima_state;
+
+static uint16_t load_u16(const unsigned char* data) {
+  return (uint16_t)(data[0] | (data[1] << 8));
+}
+
+static uint32_t load_u32(const unsigned char* data) {
+  return (uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+         ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+}
+
+static void store_u16(unsigned char* data, uint16_t value) {
+  data[0] = (unsigned char)(value & 0xFF);
+  data[1] = (unsigned char)(value >> 8);
+}
+
+static void store_u32(unsigned char* data, uint32_t value) {
+  store_u16(data, (uint16_t)(value & 0xFFFF));
+  store_u16(data + 2, (uint16_t)(value >> 16));
+}
+
+// Encode one sample, stepping the state the same way the decoder will
+static uint8_t ima_encode(ima_state* state, int32_t sample) {
+  int32_t step  = ima_steps[state->index];
+  int32_t diff  = sample - state->predictor;
+  int32_t delta = step >> 3;
+  uint8_t code  = 0;
+
+  if (diff < 0) {
+    code = 8;
+    diff = -diff;
+  }
+
+  for (uint8_t bit = 4; bit; bit >>= 1) {
+    if (diff >= step) {
+      code |= bit;
+      diff -= step;
+      delta += step;
+    }
+    step >>= 1;
+  }
+
+  state->predictor += (code & 8) ? -delta : delta;
+  if (state->predictor > 32767) {
+    state->predictor = 32767;
+  } else if (state->predictor < -32768) {
+    state->predictor = -32768;
+  }
+
+  state->index += ima_index[code];
+  if (state->index < 0) {
+    state->index = 0;
+  } else if (state->index > 88) {
+    state->index = 88;
+  }
+
+  return code;
+}
+
+// Get a sample, past the end repeats the last one so the padding is quiet
+static int32_t get_sample(const int16_t* pcm, uint32_t frames,
+                          uint16_t channels, uint32_t frame, uint16_t channel) {
+  if (frame >= frames) {
+    frame = frames - 1;
+  }
+  return pcm[frame * channels + channel];
+}
+
+static void encode_block(const int16_t* pcm, uint32_t frames,
+                         uint16_t channels, uint32_t start,
+                         uint32_t block_samples, ima_state* states,
+                         unsigned char* dst) {
+  // A header per channel: the first sample as is & the step index
+  for (uint16_t c = 0; c < channels; ++c) {
+    states[c].predictor = get_sample(pcm, frames, channels, start, c);
+
+    store_u16(dst, (uint16_t)(int16_t)states[c].predictor);
+    dst[2] = (unsigned char)states[c].index;
+    dst[3] = 0;
+    dst += 4;
+  }
+
+  // Then groups of 8 samples (4 bytes) per channel, low nibble first
+  for (uint32_t i = 1; i < block_samples; i += 8) {
+    for (uint16_t c = 0; c < channels; ++c) {
+      for (uint32_t j = 0; j < 8; j += 2) {
+        uint8_t low  = ima_encode(&states[c], get_sample(pcm, frames, channels,
+                                                         start + i + j, c));
+        uint8_t high = ima_encode(
+            &states[c], get_sample(pcm, frames, channels, start + i + j + 1, c));
+        *dst++ = (unsigned char)(low | (high << 4));
+      }
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    printf("Usage: %s in.wav out.wav [block_samples]\n", argv[0]);
+    return 1;
+  }
+
+  uint32_t block_samples = DEFAULT_BLOCK_SAMPLES;
+  if (argc > 3) {
+    block_samples = (uint32_t)atoi(argv[3]);
+    if (block_samples < 9 || (block_samples - 1) % 8 != 0 ||
+        block_samples > 65535) {
+      printf("Block samples must be 8n + 1 (i.e 65, 505, 2041).\n");
+      return 1;
+    }
+  }
+
+  FILE* in = fopen(argv[1], "rb");
+  if (!in) {
+    printf("Unable to open: %s\n", argv[1]);
+    return 1;
+  }
+
+  fseek(in, 0, SEEK_END);
+  long length = ftell(in);
+  fseek(in, 0, SEEK_SET);
+
+  unsigned char* data = (unsigned char*)malloc(length > 0 ? length : 1);
+  if (!data || length < 12 || fread(data, 1, length, in) != (size_t)length) {
+    printf("Unable to read: %s\n", argv[1]);
+    fclose(in);
+    return 1;
+  }
+  fclose(in);
+
+  if (memcmp(data, "RIFF", 4) != 0 || memcmp(data + 8, "WAVE", 4) != 0) {
+    printf("Not a wave file: %s\n", argv[1]);
+    return 1;
+  }
+
+  uint16_t       tag = 0, channels = 0, bps = 0;
+  uint32_t       sample_rate = 0, pcm_length = 0;
+  unsigned char* pcm_data = 0;
+
+  uint32_t offset = 12;
+  while (offset + 8 <= (uint32_t)length) {
+    uint32_t size  = load_u32(data + offset + 4);
+    uint32_t start = offset + 8;
+
+    if (size > (uint32_t)length - start) {
+      size = (uint32_t)length - start;
+    }
+
+    if (memcmp(data + offset, "fmt ", 4) == 0 && size >= 16) {
+      tag         = load_u16(data + start);
+      channels    = load_u16(data + start + 2);
+      sample_rate = load_u32(data + start + 4);
+      bps         = load_u16(data + start + 14);
+    } else if (memcmp(data + offset, "data", 4) == 0) {
+      pcm_data   = data + start;
+      pcm_length = size;
+    }
+
+    offset = start + size + (size & 1);
+  }
+
+  if (tag != 1 || bps != 16 || !channels || channels > 2 || !pcm_data) {
+    printf("Only 16 bit mono / stereo PCM wave files can be encoded.\n");
+    return 1;
+  }
+
+  uint32_t frames = pcm_length / (2 * channels);
+  if (!frames) {
+    printf("No samples in: %s\n", argv[1]);
+    return 1;
+  }
+
+  // Wave data is little endian, so is every platform astera targets
+  int16_t* pcm = (int16_t*)malloc(frames * channels * sizeof(int16_t));
+  memcpy(pcm, pcm_data, frames * channels * sizeof(int16_t));
+
+  uint32_t block_bytes = channels * (4 + (block_samples - 1) / 2);
+  uint32_t blocks      = (frames + block_samples - 1) / block_samples;
+  uint32_t adpcm_size  = blocks * block_bytes;
+
+  unsigned char* adpcm = (unsigned char*)malloc(adpcm_size);
+  ima_state      states[2] = {{0, 0}, {0, 0}};
+
+  for (uint32_t i = 0; i < blocks; ++i) {
+    encode_block(pcm, frames, channels, i * block_samples, block_samples,
+                 states, adpcm + i * block_bytes);
+  }
+
+  // RIFF, fmt (with the samples per block), fact (the real sample count)
+  unsigned char header[60];
+  memcpy(header, "RIFF", 4);
+  store_u32(header + 4, 52 + adpcm_size);
+  memcpy(header + 8, "WAVE", 4);
+
+  memcpy(header + 12, "fmt ", 4);
+  store_u32(header + 16, 20);
+  store_u16(header + 20, 0x11);
+  store_u16(header + 22, channels);
+  store_u32(header + 24, sample_rate);
+  store_u32(header + 28,
+            (uint32_t)((uint64_t)sample_rate * block_bytes / block_samples));
+  store_u16(header + 32, (uint16_t)block_bytes);
+  store_u16(header + 34, 4);
+  store_u16(header + 36, 2);
+  store_u16(header + 38, (uint16_t)block_samples);
+
+  memcpy(header + 40, "fact", 4);
+  store_u32(header + 44, 4);
+  store_u32(header + 48, frames);
+
+  memcpy(header + 52, "data", 4);
+  store_u32(header + 56, adpcm_size);
+
+  FILE* out = fopen(argv[2], "wb");
+  if (!out) {
+    printf("Unable to open: %s\n", argv[2]);
+    return 1;
+  }
+
+  fwrite(header, 1, sizeof(header), out);
+  fwrite(adpcm, 1, adpcm_size, out);
+
+  uint8_t failed = ferror(out) != 0;
+  fclose(out);
+
+  if (failed) {
+    printf("Unable to write: %s\n", argv[2]);
+    return 1;
+  }
+
+  printf("%u samples, %u channel(s): %u bytes -> %u bytes\n", frames, channels,
+         pcm_length, adpcm_size + (uint32_t)sizeof(header));
+
+  free(adpcm);
+  free(pcm);
+  free(data);
+
+  return 0;
+}
@@ -0,0 +1,252 @@
+// Measures the CPU cost of the audio engine on its own. Everything is mixed
+// into memory through a loopback context (a_ctx_create_loopback), so it runs
+// the same with or without a sound card:
+//
+// decode - the time to decode the OGG file into a buffer (a_buf_create)
+// mix - the time to render a second of output, per active voice count
+// update - the time a_ctx_update takes, per active voice count
+// fx - the same as mix with every voice sent through a reverb slot
+//
+// Each voice loops the OGG file around the listener. Per voice costs are the
+// difference from no voices at all, divided by the voice count.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <astera/audio.h>
+#include <astera/sys.h>
+
+#define SAMPLE_RATE        44100
+#define RENDER_FRAMES      1024
+#define DEFAULT_SECONDS    2.0
+#define DEFAULT_VOICES     64
+#define UPDATE_ITERATIONS  1000
+#define DECODE_MIN_TIME    500.0
+#define DECODE_MAX_REPEATS 64
+
+typedef struct {
+  a_ctx*   ctx;
+  uint16_t buffer, reverb;
+  float*   output;
+  double   seconds;
+
+  a_req*    reqs;
+  uint16_t* sfx;
+  uint16_t  count;
+} bench;
+
+static unsigned char* read_file(const char* path, uint32_t* length) {
+  FILE* file = fopen(path, "rb");
+  if (!file) {
+    return 0;
+  }
+
+  fseek(file, 0, SEEK_END);
+  long size = ftell(file);
+  fseek(file, 0, SEEK_SET);
+
+  unsigned char* data = (size > 0) ? (unsigned char*)malloc(size) : 0;
+  if (!data || fread(data, 1, size, file) != (size_t)size) {
+    free(data);
+    fclose(file);
+    return 0;
+  }
+
+  fclose(file);
+  *length = (uint32_t)size;
+  return data;
+}
+
+// Start count looping voices spread around the listener
+static void voices_start(bench* b, uint16_t count, uint8_t use_fx) {
+  for (uint16_t i = 0; i < count; ++i) {
+    float angle    = (float)i / count * 6.2831853f;
+    vec3  position = {cosf(angle) * 4.f, sinf(angle) * 4.f, 0.f};
+
+    b->reqs[i] = a_req_create(position, 1.f / count, 50.f, 1,
+                              use_fx ? &b->reverb : 0, use_fx ? 1 : 0, 0, 0);
+    b->sfx[i]  = a_sfx_play(b->ctx, 0, b->buffer, &b->reqs[i]);
+  }
+
+  b->count = count;
+
+  // Let the voices get assigned before measuring
+  a_ctx_update(b->ctx);
+}
+
+static void voices_stop(bench* b) {
+  for (uint16_t i = 0; i < b->count; ++i) {
+    if (b->sfx[i]) {
+      a_sfx_stop(b->ctx, b->sfx[i]);
+    }
+  }
+
+  b->count = 0;
+  a_ctx_update(b->ctx);
+}
+
+// Returns the time it takes to render a second of output (ms)
+static double time_mix(bench* b) {
+  uint32_t frames = (uint32_t)(b->seconds * SAMPLE_RATE);
+  double   total  = 0.0;
+
+  for (uint32_t done = 0; done < frames; done += RENDER_FRAMES) {
+    time_s start = s_get_time();
+    a_ctx_render(b->ctx, b->output, RENDER_FRAMES);
+    total += s_get_time() - start;
+  }
+
+  return total / b->seconds;
+}
+
+// Returns the average time of an update (ms), rendering between each so the
+// voices move along like they would in a game
+static double time_update(bench* b) {
+  double total = 0.0;
+
+  for (uint32_t i = 0; i < UPDATE_ITERATIONS; ++i) {
+    a_ctx_render(b->ctx, b->output, RENDER_FRAMES / 4);
+
+    time_s start = s_get_time();
+    a_ctx_update(b->ctx);
+    total += s_get_time() - start;
+  }
+
+  return total / UPDATE_ITERATIONS;
+}
+
+static void bench_decode(bench* b, unsigned char* data, uint32_t length) {
+  uint32_t repeats = 0, samples = 0, sample_rate = 0;
+  double   total   = 0.0;
+
+  while (total < DECODE_MIN_TIME && repeats < DECODE_MAX_REPEATS) {
+    time_s   start = s_get_time();
+    uint16_t id    = a_buf_create(b->ctx, data, length, 0, 1);
+    total += s_get_time() - start;
+
+    a_buf* buf = a_buf_get_id(b->ctx, id);
+    if (!id || !buf) {
+      printf("Unable to decode the OGG file.\n");
+      exit(1);
+    }
+
+    samples     = buf->length;
+    sample_rate = buf->sample_rate;
+
+    a_buf_destroy(b->ctx, id);
+    ++repeats;
+  }
+
+  double decode   = total / repeats;
+  double duration = (double)samples / sample_rate * 1000.0;
+
+  printf("decode: %.2f ms for %.2f s of audio (%.1fx realtime, %u runs)\n",
+         decode, duration / 1000.0, duration / decode, repeats);
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2) {
+    printf("Usage: %s sound.ogg [seconds] [max_voices]\n", argv[0]);
+    return 1;
+  }
+
+  double   seconds    = (argc > 2) ? atof(argv[2]) : DEFAULT_SECONDS;
+  uint16_t max_voices = (argc > 3) ? (uint16_t)atoi(argv[3]) : DEFAULT_VOICES;
+
+  if (seconds <= 0.0 || !max_voices) {
+    printf("Seconds & max voices must be above 0.\n");
+    return 1;
+  }
+
+  uint32_t       length;
+  unsigned char* data = read_file(argv[1], &length);
+  if (!data) {
+    printf("Unable to read: %s\n", argv[1]);
+    return 1;
+  }
+
+  bench b = (bench){0};
+  b.ctx   = a_ctx_create_loopback(SAMPLE_RATE, 1, max_voices, 2, 1, 1, 1, 4096);
+  if (!b.ctx) {
+    printf("Unable to create a loopback audio context.\n");
+    return 1;
+  }
+
+  b.seconds = seconds;
+  b.output  = (float*)malloc(sizeof(float) * 2 * RENDER_FRAMES);
+  b.reqs    = (a_req*)malloc(sizeof(a_req) * max_voices);
+  b.sfx     = (uint16_t*)calloc(max_voices, sizeof(uint16_t));
+
+  bench_decode(&b, data, length);
+
+  b.buffer = a_buf_create(b.ctx, data, length, "bench", 1);
+
+  // Only as many voices as the device gives sources for, the rest would be
+  // virtual & never mixed
+  if (max_voices > b.ctx->voice_capacity) {
+    max_voices = b.ctx->voice_capacity;
+  }
+
+  static a_fx_reverb reverb;
+  reverb   = a_fx_reverb_default();
+  b.reverb = (b.ctx->use_fx) ? a_fx_create(b.ctx, REVERB, &reverb) : 0;
+  if (!b.reverb) {
+    printf("Effects unsupported, skipping fx.\n");
+  }
+
+  printf("%u hz, %u voices max, %.1f s rendered per measurement\n\n",
+         SAMPLE_RATE, max_voices, seconds);
+  printf("voices | mix ms/s | per voice | update us | fx ms/s | per voice\n");
+
+  double mix_base = 0.0, fx_base = 0.0;
+
+  // 0, 1, 2, 4 ... up to & including max_voices
+  uint16_t count = 0;
+  for (;;) {
+    voices_start(&b, count, 0);
+    double mix    = time_mix(&b);
+    double update = time_update(&b);
+    voices_stop(&b);
+
+    double fx = 0.0;
+    if (b.reverb) {
+      voices_start(&b, count, 1);
+      fx = time_mix(&b);
+      voices_stop(&b);
+    }
+
+    if (!count) {
+      mix_base = mix;
+      fx_base  = fx;
+    }
+
+    double mix_voice = (count) ? (mix - mix_base) / count : 0.0;
+    double fx_voice  = (count) ? (fx - fx_base) / count : 0.0;
+
+    printf("%6u | %8.3f | %9.4f | %9.2f | %7.3f | %9.4f\n", count, mix,
+           mix_voice, update * 1000.0, fx, fx_voice);
+
+    if (count >= max_voices) {
+      break;
+    }
+
+    count = (count) ? count * 2 : 1;
+    if (count > max_voices) {
+      count = max_voices;
+    }
+  }
+
+  if (b.reverb) {
+    a_fx_destroy(b.ctx, b.reverb);
+  }
+
+  a_ctx_destroy(b.ctx);
+
+  free(b.output);
+  free(b.reqs);
+  free(b.sfx);
+  free(data);
+
+  return 0;
+}
@@ -0,0 +1,322 @@
+// Converts a text layout description into a binary layout file for
+// r_layout_load. The text format is one entry per line:
+//
+// # comment
+// sheet name width height
+// subtex x y width height
+// tiles sub_width sub_height [width_pad height_pad]
+// anim name rate loop frame ... frame
+//
+// `subtex`, `tiles` & `anim` belong to the last `sheet` declared. `tiles`
+// fills the sheet with a grid the same way r_sheet_create_tiled does & frames
+// are the index of a subtex within its sheet.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <astera/render.h>
+#include <astera/sys.h>
+
+#define LINE_MAX_LENGTH 1024
+
+typedef struct {
+  r_layout_sheet* sheets;
+  r_subtex*       subtexs;
+  r_layout_anim*  anims;
+  uint32_t*       frames;
+  r_layout_name*  names;
+  char*           strings;
+
+  uint32_t sheet_count, sheet_cap;
+  uint32_t subtex_count, subtex_cap;
+  uint32_t anim_count, anim_cap;
+  uint32_t frame_count, frame_cap;
+  uint32_t name_count, name_cap;
+  uint32_t string_size, string_cap;
+} layout_data;
+
+// Make room for one more element in a growable array
+static void* grow(void* array, uint32_t count, uint32_t* cap, size_t size) {
+  if (count < *cap) {
+    return array;
+  }
+
+  *cap = (*cap) ? *cap * 2 : 64;
+  void* grown = realloc(array, *cap * size);
+  if (!grown) {
+    printf("Out of memory.\n");
+    exit(1);
+  }
+
+  return grown;
+}
+
+static uint32_t add_name(layout_data* layout, const char* name, uint32_t type,
+                         uint32_t index) {
+  uint32_t length = (uint32_t)strlen(name) + 1;
+  while (layout->string_size + length > layout->string_cap) {
+    layout->strings = (char*)grow(layout->strings, layout->string_cap,
+                                  &layout->string_cap, sizeof(char));
+  }
+
+  uint32_t offset = layout->string_size;
+  memcpy(layout->strings + offset, name, length);
+  layout->string_size += length;
+
+  layout->names = (r_layout_name*)grow(layout->names, layout->name_count,
+                                       &layout->name_cap,
+                                       sizeof(r_layout_name));
+  layout->names[layout->name_count] =
+      (r_layout_name){.hash = s_hash_str(name), .type = type, .index = index};
+  ++layout->name_count;
+
+  return offset;
+}
+
+static void add_subtex(layout_data* layout, r_layout_sheet* sheet, uint32_t x,
+                       uint32_t y, uint32_t width, uint32_t height) {
+  layout->subtexs = (r_subtex*)grow(layout->subtexs, layout->subtex_count,
+                                    &layout->subtex_cap, sizeof(r_subtex));
+
+  r_subtex* subtex = &layout->subtexs[layout->subtex_count];
+  *subtex           = (r_subtex){.sub_id = sheet->subtex_count,
+                       .x      = x,
+                       .y      = y,
+                       .width  = width,
+                       .height = height};
+
+  subtex->coords[0] = (float)x / sheet->width;
+  subtex->coords[1] = (float)y / sheet->height;
+  subtex->coords[2] = (float)(x + width) / sheet->width;
+  subtex->coords[3] = (float)(y + height) / sheet->height;
+
+  ++layout->subtex_count;
+  ++sheet->subtex_count;
+}
+
+static int compare_names(const void* a, const void* b) {
+  uint32_t hash_a = ((const r_layout_name*)a)->hash;
+  uint32_t hash_b = ((const r_layout_name*)b)->hash;
+  return (hash_a > hash_b) - (hash_a < hash_b);
+}
+
+// Returns the error for a line, 0 if it was parsed
+static const char* parse_line(layout_data* layout, char* line) {
+  char* cmd = strtok(line, " \t\r\n");
+  if (!cmd || cmd[0] == '#') {
+    return 0;
+  }
+
+  r_layout_sheet* sheet = (layout->sheet_count)
+                              ? &layout->sheets[layout->sheet_count - 1]
+                              : 0;
+
+  if (strcmp(cmd, "sheet") == 0) {
+    char* name   = strtok(0, " \t\r\n");
+    char* width  = strtok(0, " \t\r\n");
+    char* height = strtok(0, " \t\r\n");
+
+    if (!name || !width || !height || atoi(width) <= 0 || atoi(height) <= 0) {
+      return "expected: sheet name width height";
+    }
+
+    layout->sheets = (r_layout_sheet*)grow(layout->sheets, layout->sheet_count,
+                                           &layout->sheet_cap,
+                                           sizeof(r_layout_sheet));
+    uint32_t index  = layout->sheet_count;
+    uint32_t offset = add_name(layout, name, R_LAYOUT_SHEET, index);
+
+    layout->sheets[index] =
+        (r_layout_sheet){.name         = offset,
+                         .width        = (uint32_t)atoi(width),
+                         .height       = (uint32_t)atoi(height),
+                         .subtex_start = layout->subtex_count,
+                         .subtex_count = 0};
+    ++layout->sheet_count;
+  } else if (strcmp(cmd, "subtex") == 0) {
+    uint32_t values[4];
+    for (uint32_t i = 0; i < 4; ++i) {
+      char* value = strtok(0, " \t\r\n");
+      if (!value) {
+        return "expected: subtex x y width height";
+      }
+      values[i] = (uint32_t)atoi(value);
+    }
+
+    if (!sheet) {
+      return "subtex declared before a sheet";
+    }
+
+    add_subtex(layout, sheet, values[0], values[1], values[2], values[3]);
+  } else if (strcmp(cmd, "tiles") == 0) {
+    uint32_t values[4] = {0, 0, 0, 0};
+    for (uint32_t i = 0; i < 4; ++i) {
+      char* value = strtok(0, " \t\r\n");
+      if (!value) {
+        if (i < 2) {
+          return "expected: tiles sub_width sub_height [width_pad height_pad]";
+        }
+        break;
+      }
+      values[i] = (uint32_t)atoi(value);
+    }
+
+    if (!sheet) {
+      return "tiles declared before a sheet";
+    }
+
+    if (!values[0] || !values[1]) {
+      return "tile size must be non-zero";
+    }
+
+    uint32_t per_width = sheet->width / values[0];
+    uint32_t rows      = sheet->height / values[1];
+
+    for (uint32_t i = 0; i < per_width * rows; ++i) {
+      uint32_t x = (i % per_width) * values[0] + values[2];
+      uint32_t y = (i / per_width) * values[1] + values[3];
+      add_subtex(layout, sheet, x, y, values[0] - (values[2] * 2),
+                 values[1] - (values[3] * 2));
+    }
+  } else if (strcmp(cmd, "anim") == 0) {
+    char* name = strtok(0, " \t\r\n");
+    char* rate = strtok(0, " \t\r\n");
+    char* loop = strtok(0, " \t\r\n");
+
+    if (!name || !rate || !loop || atoi(rate) <= 0) {
+      return "expected: anim name rate loop frame ... frame";
+    }
+
+    if (!sheet) {
+      return "anim declared before a sheet";
+    }
+
+    uint32_t frame_start = layout->frame_count;
+    char*    frame;
+    while ((frame = strtok(0, " \t\r\n"))) {
+      uint32_t id = (uint32_t)atoi(frame);
+      if (id >= sheet->subtex_count) {
+        return "frame outside of the sheet's subtexs";
+      }
+
+      layout->frames = (uint32_t*)grow(layout->frames, layout->frame_count,
+                                       &layout->frame_cap, sizeof(uint32_t));
+      layout->frames[layout->frame_count] = id;
+      ++layout->frame_count;
+    }
+
+    if (layout->frame_count == frame_start) {
+      return "animation has no frames";
+    }
+
+    layout->anims =
+        (r_layout_anim*)grow(layout->anims, layout->anim_count,
+                             &layout->anim_cap, sizeof(r_layout_anim));
+    uint32_t index  = layout->anim_count;
+    uint32_t offset = add_name(layout, name, R_LAYOUT_ANIM, index);
+
+    layout->anims[index] =
+        (r_layout_anim){.name        = offset,
+                        .sheet       = layout->sheet_count - 1,
+                        .rate        = (uint32_t)atoi(rate),
+                        .loop        = (atoi(loop) != 0),
+                        .frame_start = frame_start,
+                        .frame_count = layout->frame_count - frame_start};
+    ++layout->anim_count;
+  } else {
+    return "unknown entry";
+  }
+
+  return 0;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    printf("Usage: %s layout.txt layout.bin\n", argv[0]);
+    return 1;
+  }
+
+  FILE* in = fopen(argv[1], "r");
+  if (!in) {
+    printf("Unable to open: %s\n", argv[1]);
+    return 1;
+  }
+
+  layout_data layout = (layout_data){0};
+  char        line[LINE_MAX_LENGTH];
+  uint32_t    line_number = 0;
+
+  while (fgets(line, LINE_MAX_LENGTH, in)) {
+    ++line_number;
+
+    const char* error = parse_line(&layout, line);
+    if (error) {
+      printf("%s:%u: %s\n", argv[1], line_number, error);
+      fclose(in);
+      return 1;
+    }
+  }
+
+  fclose(in);
+
+  // Sorted by hash so r_layout_find can binary search, duplicate hashes would
+  // make lookups ambiguous
+  qsort(layout.names, layout.name_count, sizeof(r_layout_name), compare_names);
+  for (uint32_t i = 1; i < layout.name_count; ++i) {
+    if (layout.names[i].hash == layout.names[i - 1].hash) {
+      printf("Duplicate or colliding name hash: %08x\n", layout.names[i].hash);
+      return 1;
+    }
+  }
+
+  // Keep the string table non-empty & null terminated
+  if (!layout.string_size) {
+    layout.strings = (char*)grow(layout.strings, 0, &layout.string_cap, 1);
+    layout.strings[0]  = '\0';
+    layout.string_size = 1;
+  }
+
+  r_layout_header header = {.magic        = {'A', 'L', 'A', 'Y'},
+                            .version      = R_LAYOUT_VERSION,
+                            .sheet_count  = layout.sheet_count,
+                            .subtex_count = layout.subtex_count,
+                            .anim_count   = layout.anim_count,
+                            .frame_count  = layout.frame_count,
+                            .name_count   = layout.name_count,
+                            .string_size  = layout.string_size};
+
+  FILE* out = fopen(argv[2], "wb");
+  if (!out) {
+    printf("Unable to open: %s\n", argv[2]);
+    return 1;
+  }
+
+  fwrite(&header, sizeof(r_layout_header), 1, out);
+  fwrite(layout.sheets, sizeof(r_layout_sheet), layout.sheet_count, out);
+  fwrite(layout.subtexs, sizeof(r_subtex), layout.subtex_count, out);
+  fwrite(layout.anims, sizeof(r_layout_anim), layout.anim_count, out);
+  fwrite(layout.frames, sizeof(uint32_t), layout.frame_count, out);
+  fwrite(layout.names, sizeof(r_layout_name), layout.name_count, out);
+  fwrite(layout.strings, 1, layout.string_size, out);
+
+  uint8_t failed = ferror(out) != 0;
+  fclose(out);
+
+  if (failed) {
+    printf("Unable to write: %s\n", argv[2]);
+    return 1;
+  }
+
+  printf("%u sheets, %u subtexs, %u animations\n", layout.sheet_count,
+         layout.subtex_count, layout.anim_count);
+
+  free(layout.sheets);
+  free(layout.subtexs);
+  free(layout.anims);
+  free(layout.frames);
+  free(layout.names);
+  free(layout.strings);
+
+  return 0;
+}
@@ -0,0 +1,168 @@
+// Replays a frame capture (see r_ctx_capture_start) in a tight loop & times
+// each frame. Shaders are loaded from `shader_dir/name.vert` & `.frag` using
+// the names they were cached with (r_shader_cache).
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <astera/asset.h>
+#include <astera/render.h>
+#include <astera/sys.h>
+
+typedef struct {
+  // total - the sum of every time measured (ms)
+  // min - the fastest time (ms)
+  // max - the slowest time (ms)
+  time_s total, min, max;
+} frame_stats;
+
+static r_shader load_shader(const char* name, void* data) {
+  const char* shader_dir = (const char*)data;
+  char        vs_path[256], fs_path[256];
+
+  snprintf(vs_path, 256, "%s/%s.vert", shader_dir, name);
+  snprintf(fs_path, 256, "%s/%s.frag", shader_dir, name);
+
+  asset_t* vs_data = asset_get(vs_path);
+  asset_t* fs_data = asset_get(fs_path);
+
+  r_shader shader = 0;
+  if (vs_data && fs_data) {
+    shader = r_shader_create(vs_data->data, fs_data->data);
+  } else {
+    printf("Unable to find shader: %s\n", name);
+  }
+
+  if (vs_data) {
+    asset_free(vs_data);
+    free(vs_data);
+  }
+
+  if (fs_data) {
+    asset_free(fs_data);
+    free(fs_data);
+  }
+
+  return shader;
+}
+
+static void stats_add(frame_stats* stats, time_s time) {
+  stats->total += time;
+
+  if (time < stats->min || stats->min == 0.0)
+    stats->min = time;
+
+  if (time > stats->max)
+    stats->max = time;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    printf("Usage: %s capture_file shader_dir [loops]\n", argv[0]);
+    return 1;
+  }
+
+  uint32_t loops = (argc > 3) ? (uint32_t)atoi(argv[3]) : 100;
+  if (loops == 0) {
+    loops = 1;
+  }
+
+  asset_t* capture_data = asset_get(argv[1]);
+  if (!capture_data) {
+    printf("Unable to open capture: %s\n", argv[1]);
+    return 1;
+  }
+
+  uint32_t width, height;
+  if (!r_capture_get_size(capture_data->data, capture_data->data_length,
+                          &width, &height)) {
+    printf("Invalid capture: %s\n", argv[1]);
+    return 1;
+  }
+
+  // No vsync so that the GPU time isn't hidden behind the refresh rate
+  r_window_params params =
+      r_window_params_create(width, height, 0, 0, 0, 0, 0, "Astera Replay");
+
+  r_ctx* ctx = r_ctx_create(params, 0, 16, 512, 0, 0);
+  if (!ctx) {
+    printf("Unable to create render context.\n");
+    return 1;
+  }
+
+  r_ctx_make_current(ctx);
+
+  r_capture* capture =
+      r_capture_load(ctx, capture_data->data, capture_data->data_length,
+                     load_shader, argv[2]);
+
+  asset_free(capture_data);
+  free(capture_data);
+
+  if (!capture) {
+    printf("Unable to load capture.\n");
+    r_ctx_destroy(ctx);
+    free(ctx);
+    return 1;
+  }
+
+  uint32_t     frame_count = r_capture_frame_count(capture);
+  frame_stats* stats = (frame_stats*)calloc(frame_count, sizeof(frame_stats));
+
+  if (!stats || frame_count == 0) {
+    printf("No frames to replay.\n");
+    r_capture_destroy(capture);
+    r_ctx_destroy(ctx);
+    free(ctx);
+    return 1;
+  }
+
+  frame_stats submit = (frame_stats){0}, total = (frame_stats){0};
+
+  for (uint32_t loop = 0; loop < loops; ++loop) {
+    for (uint32_t i = 0; i < frame_count; ++i) {
+      time_s start = s_get_time();
+
+      r_capture_replay(ctx, capture, i);
+      time_s submitted = s_get_time();
+
+      // Wait on the GPU so each frame is measured on its own
+      glFinish();
+      time_s finished = s_get_time();
+
+      stats_add(&submit, submitted - start);
+      stats_add(&stats[i], finished - start);
+      stats_add(&total, finished - start);
+
+      r_window_swap_buffers(ctx);
+      glfwPollEvents();
+    }
+
+    if (r_window_should_close(ctx)) {
+      loops = loop + 1;
+      break;
+    }
+  }
+
+  uint32_t samples = frame_count * loops;
+
+  printf("%-8s %10s %10s %10s\n", "frame", "avg (ms)", "min (ms)",
+         "max (ms)");
+  for (uint32_t i = 0; i < frame_count; ++i) {
+    printf("%-8u %10.3f %10.3f %10.3f\n", i, stats[i].total / loops,
+           stats[i].min, stats[i].max);
+  }
+
+  printf("\n%u frames x %u loops\n", frame_count, loops);
+  printf("submit: avg %.3f ms, min %.3f ms, max %.3f ms\n",
+         submit.total / samples, submit.min, submit.max);
+  printf("frame:  avg %.3f ms, min %.3f ms, max %.3f ms\n",
+         total.total / samples, total.min, total.max);
+
+  free(stats);
+  r_capture_destroy(capture);
+  r_ctx_destroy(ctx);
+  free(ctx);
+
+  return 0;
+}